@@ -0,0 +1,449 @@
+#include <dx12_sample/worldgen/IslandMesh.h>
+#include <dx12_sample/worldgen/WorldGen.h>
+
+#include <utils/BVHScene.h>
+#include <utils/CpuRaytracer.h>
+#include <utils/FrameStats.h>
+#include <utils/ImageWriter.h>
+#include <utils/Profiler.h>
+#include <utils/TemporalReconstruction.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Renders the sample scenes without a GPU, the images are the references of the DXR output
+// and the throughput is the baseline of the CPU queries. The checkerboard mode renders a camera
+// orbit both ways and compares the reconstructed frames to the fully traced ones, the water culling
+// compares the frame to the one tracing all the water rays. The profile has a frame per rendered
+// image, the scene building is the first one.
+
+using namespace DirectX;
+
+namespace
+{
+struct Options
+{
+    std::string scene            = "island";
+    uint32_t    width            = 1280;
+    uint32_t    height           = 720;
+    std::size_t threadsCount     = std::thread::hardware_concurrency();
+    uint32_t    tileSize         = 16;
+    float       aoSamples        = 4.0f;  // per pixel, like the ray budget of the sample sets them
+    float       aoRadius         = 2.0f;
+    uint32_t    frameIndex       = 0;
+    uint32_t    checkerboard     = 0;  // frames of the orbit, 0 renders a single full frame
+    float       waterMinWeight   = 0.0f;
+    float       waterFarDistance = 0.0f;
+    std::string output           = "output.png";
+    std::string profile;  // the Chrome trace, the CSV goes next to it
+};
+
+// the camera turns around the target by this angle every frame of the orbit
+constexpr float orbitStep = XM_PI / 1800.0f;
+
+struct Object
+{
+    std::vector<GeometryVertex> vertices;
+    std::vector<uint32_t>       indices;
+    CpuRaytracer::HitShader     shader    = CpuRaytracer::HitShader::Diffuse;
+    MaterialParams              material  = {};
+    XMMATRIX                    transform = XMMatrixIdentity();
+};
+
+// an instance per object, like the ones of SceneManager::CreateCustomObject
+struct Scene
+{
+    std::vector<Object>                 objects;
+    std::vector<CpuRaytracer::Geometry> geometries;
+    std::vector<InstanceParams>         instances;
+    BVH::Scene                          bvh;
+    XMFLOAT3                            cameraPosition;
+    XMFLOAT3                            cameraTarget;
+};
+
+// the default materials of the sample
+constexpr MaterialParams specularMaterial = {10.0f};
+constexpr MaterialParams waterMaterial    = {1.33f};
+
+// the same as CreatePlane of the sample, it faces up
+Object CreatePlane(float width, XMFLOAT3 color)
+{
+    const float3 normal  = {0.0f, 0.0f, 1.0f};
+    const float  width_2 = width / 2.0f;
+
+    Object output;
+    output.vertices = {{{-width_2, -width_2, 0.0f}, normal, color},
+                       {{width_2, -width_2, 0.0f}, normal, color},
+                       {{-width_2, width_2, 0.0f}, normal, color},
+                       {{width_2, width_2, 0.0f}, normal, color}};
+    output.indices  = {0, 3, 2, 0, 1, 3};
+    return output;
+}
+
+Object CreateCube(float size, XMFLOAT3 color)
+{
+    Object output;
+
+    // every face is a quad spanned by two axes, their cross product is the face normal
+    const XMFLOAT3 axes[3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (float side : {-1.0f, 1.0f})
+        {
+            XMVECTOR normal = XMVectorScale(XMLoadFloat3(&axes[axis]), side);
+            XMVECTOR u      = XMLoadFloat3(&axes[(axis + 1) % 3]);
+            XMVECTOR v      = XMVector3Cross(normal, u);
+
+            // the triangles are front facing when seen from the outside
+            const XMVECTOR center = XMVectorScale(normal, size / 2.0f);
+            u                     = XMVectorScale(u, size / 2.0f);
+            v                     = XMVectorScale(v, size / 2.0f);
+
+            const uint32_t first = (uint32_t)output.vertices.size();
+            for (const auto& [uSign, vSign] : {std::pair{-1.0f, -1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}, {1.0f, 1.0f}})
+            {
+                GeometryVertex vertex;
+                XMStoreFloat3(&vertex.position, XMVectorAdd(center, XMVectorAdd(XMVectorScale(u, uSign), XMVectorScale(v, vSign))));
+                XMStoreFloat3(&vertex.normal, normal);
+                vertex.color = color;
+                output.vertices.push_back(vertex);
+            }
+
+            output.indices.insert(output.indices.end(), {first, first + 1, first + 2, first + 3, first + 2, first + 1});
+        }
+    }
+
+    return output;
+}
+
+// the scene of DX12Sample::CreateObjects
+void CreatePlanes(Scene& scene)
+{
+    scene.objects.push_back(CreatePlane(3.0f, {0.2f, 0.5f, 0.5f}));
+
+    Object plane    = CreatePlane(1.5f, {0.7f, 0.7f, 0.2f});
+    plane.transform = XMMatrixTranslation(0.0f, 0.0f, 1.0f);
+    scene.objects.push_back(std::move(plane));
+
+    scene.cameraPosition = {5.0f, 5.0f, 5.0f};
+    scene.cameraTarget   = {0.0f, 0.0f, 0.0f};
+}
+
+// the island of DX12Sample::CreateIsland with a sea and a mirror cube, so every hit shader is used
+void CreateIsland(Scene& scene)
+{
+    constexpr std::size_t mapSize = 1024;
+
+    // the ones of the sample
+    const std::map<uint8_t, XMUINT3> colorsLut = {
+        {40, XMUINT3{63, 72, 204}},     // deep water
+        {50, XMUINT3{0, 162, 232}},     // shallow water
+        {55, XMUINT3{255, 242, 0}},     // sand
+        {80, XMUINT3{181, 230, 29}},    // grass
+        {95, XMUINT3{34, 177, 76}},     // forest
+        {105, XMUINT3{127, 127, 127}},  // rock
+        {255, XMUINT3{255, 255, 255}}   // snow
+    };
+
+    WorldGen worldGen(mapSize);
+    worldGen.GenerateHeightMap(6, 0.5, 1.0, 2.0);
+
+    const IslandMesh island{worldGen, colorsLut};
+    for (const IslandTile& tile : island.GetTiles())
+    {
+        Object object;
+        object.vertices = tile.vertices;
+        object.indices  = tile.lods.front();
+        scene.objects.push_back(std::move(object));
+    }
+
+    // the shallow water ends at 25 (the 50 colors step of the halved heights)
+    Object sea    = CreatePlane(160.0f, {0.0f, 0.45f, 0.69f});
+    sea.shader    = CpuRaytracer::HitShader::Water;
+    sea.material  = waterMaterial;
+    sea.transform = XMMatrixTranslation(0.0f, 0.0f, 24.5f);
+    scene.objects.push_back(std::move(sea));
+
+    const float top = worldGen.GetHeight(mapSize / 2, mapSize / 2) * 0.5f;
+
+    Object cube    = CreateCube(8.0f, {0.8f, 0.2f, 0.2f});
+    cube.shader    = CpuRaytracer::HitShader::Specular;
+    cube.material  = specularMaterial;
+    cube.transform = XMMatrixTranslation(0.0f, 0.0f, top + 10.0f);
+    scene.objects.push_back(std::move(cube));
+
+    scene.cameraPosition = {-70.0f, 70.0f, 70.0f};
+    scene.cameraTarget   = {0.0f, 0.0f, 20.0f};
+}
+
+void BuildScene(Scene& scene)
+{
+    scene.bvh.Resize(scene.objects.size());
+    for (std::size_t i = 0; i < scene.objects.size(); ++i)
+    {
+        const Object& object = scene.objects[i];
+
+        scene.instances.push_back({{1.0f, 1.0f, 1.0f}, (uint32_t)scene.geometries.size()});
+        scene.geometries.push_back({object.vertices, object.indices, object.shader, object.material});
+
+        XMFLOAT3X4 transform;
+        XMStoreFloat3x4(&transform, object.transform);
+        // the masks of SceneObject::GetInstanceMask
+        const uint32_t mask = object.shader == CpuRaytracer::HitShader::Water ? INSTANCE_MASK_WATER : INSTANCE_MASK_OPAQUE;
+        scene.bvh.SetInstance(i, std::make_shared<BVH::Mesh>(object.vertices, object.indices), transform, mask);
+    }
+
+    scene.bvh.Update();
+}
+
+// of the 8-bit images, the values are clamped like the PNG ones
+double ComputePSNR(std::span<const XMFLOAT4> reference, std::span<const XMFLOAT4> image)
+{
+    double squaredError = 0.0;
+    for (std::size_t i = 0; i < reference.size(); ++i)
+    {
+        const float expected[3] = {reference[i].x, reference[i].y, reference[i].z};
+        const float actual[3]   = {image[i].x, image[i].y, image[i].z};
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            const double error = std::clamp(actual[channel], 0.0f, 1.0f) - std::clamp(expected[channel], 0.0f, 1.0f);
+            squaredError += error * error;
+        }
+    }
+
+    const double meanSquaredError = squaredError / (reference.size() * 3);
+    return meanSquaredError > 0.0 ? 10.0 * std::log10(1.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string name  = argv[i];
+        const char*       value = argv[i + 1];
+
+        if (name == "--scene")
+            options.scene = value;
+        else if (name == "--width")
+            options.width = (uint32_t)std::atoi(value);
+        else if (name == "--height")
+            options.height = (uint32_t)std::atoi(value);
+        else if (name == "--threads")
+            options.threadsCount = (std::size_t)std::atoi(value);
+        else if (name == "--tile")
+            options.tileSize = (uint32_t)std::atoi(value);
+        else if (name == "--ao-samples")
+            options.aoSamples = (float)std::atof(value);
+        else if (name == "--ao-radius")
+            options.aoRadius = (float)std::atof(value);
+        else if (name == "--frame")
+            options.frameIndex = (uint32_t)std::atoi(value);
+        else if (name == "--checkerboard")
+            options.checkerboard = (uint32_t)std::atoi(value);
+        else if (name == "--water-min-weight")
+            options.waterMinWeight = (float)std::atof(value);
+        else if (name == "--water-far-distance")
+            options.waterFarDistance = (float)std::atof(value);
+        else if (name == "--output")
+            options.output = value;
+        else if (name == "--profile")
+            options.profile = value;
+        else
+            return false;
+    }
+
+    return argc % 2 == 1 && options.width > 0 && options.height > 0 && options.aoSamples >= 0.0f &&
+           options.waterMinWeight >= 0.0f && options.waterMinWeight <= 1.0f && options.waterFarDistance >= 0.0f &&
+           (options.scene == "island" || options.scene == "planes");
+}
+
+void ExportProfile(const Options& options)
+{
+    if (options.profile.empty())
+        return;
+
+    const std::filesystem::path trace = options.profile;
+    Profiler::Get().ExportChromeTrace(trace);
+    Profiler::Get().ExportCSV(std::filesystem::path(trace).replace_extension(".csv"));
+    std::cout << "Profile written to " << trace.string() << std::endl;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: cpu_tracer <opts>" << std::endl;
+        std::cout << "where <opts>:" << std::endl;
+        std::cout << "\t--scene island|planes" << std::endl;
+        std::cout << "\t--width <pixels>, --height <pixels>" << std::endl;
+        std::cout << "\t--threads <count>, --tile <pixels>" << std::endl;
+        std::cout << "\t--ao-samples <per pixel>, --ao-radius <distance>, --frame <index>" << std::endl;
+        std::cout << "\t--checkerboard <frames> compares the reconstructed orbit to the traced one" << std::endl;
+        std::cout << "\t--water-min-weight <weight>, --water-far-distance <distance> compare the culled water rays to all of them" << std::endl;
+        std::cout << "\t--output <file.png|file.exr>" << std::endl;
+        std::cout << "\t--profile <file.json> writes the timings of the scopes, a CSV of them goes next to it" << std::endl;
+        return -1;
+    }
+
+    Profiler::Get().SetEnabled(!options.profile.empty());
+    Profiler::Get().SetThreadName("Main thread");
+
+    try
+    {
+        Scene scene;
+        if (options.scene == "planes")
+            CreatePlanes(scene);
+        else
+            CreateIsland(scene);
+
+        BuildScene(scene);
+        Profiler::Get().EndFrame();
+
+        // the WASD camera of the sample and the default lighting of its UI
+        constexpr float znear = 0.1f;
+        constexpr float zfar  = 3100.0f;
+        constexpr float fov   = 7.5f * XM_PI / 18.0f;
+
+        const XMMATRIX proj = XMMatrixPerspectiveFovLH(fov, (float)options.width / options.height, znear, zfar);
+
+        ViewParams viewParams;
+        viewParams.ambientColor = XMVectorSet(0.1f, 0.1f, 0.1f, 1.0f);
+        viewParams.aoRadius     = options.aoRadius;
+        viewParams.aoSamples    = options.aoSamples;
+        viewParams.frameIndex   = options.frameIndex;
+        viewParams.sampling     = SAMPLING_FULL;
+
+        viewParams.waterMinWeight   = options.waterMinWeight;
+        viewParams.waterFarDistance = options.waterFarDistance;
+        const bool isWaterCulled    = options.waterMinWeight > 0.0f || options.waterFarDistance > 0.0f;
+
+        // the camera of a frame of the orbit, the first one is at the scene camera, returns the view projection
+        const auto setCamera = [&](uint32_t frame) {
+            const XMVECTOR target   = XMLoadFloat3(&scene.cameraTarget);
+            const XMVECTOR offset   = XMVector3TransformNormal(XMVectorSubtract(XMLoadFloat3(&scene.cameraPosition), target), XMMatrixRotationZ(frame * orbitStep));
+            const XMVECTOR position = XMVectorSetW(XMVectorAdd(target, offset), 1.0f);
+            const XMMATRIX viewProj = XMMatrixMultiply(XMMatrixLookAtLH(position, target, XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)), proj);
+
+            viewParams.inverseViewProj = XMMatrixInverse(nullptr, viewProj);
+            viewParams.viewPos         = position;
+            return viewProj;
+        };
+
+        LightParams lightParams;
+        lightParams.direction = XMVectorSet(0.0f, -0.154f, -0.148f, 1.0f);
+        lightParams.color     = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
+
+        CpuRaytracer                  raytracer(options.threadsCount, options.tileSize);
+        const CpuRaytracer::SceneDesc sceneDesc   = {&scene.bvh, scene.instances, scene.geometries};
+        const std::size_t             pixelsCount = (std::size_t)options.width * options.height;
+
+        if (options.checkerboard == 0)
+        {
+            setCamera(0);
+
+            std::vector<XMFLOAT4>     image(pixelsCount);
+            const CpuRaytracer::Stats stats = raytracer.Render(sceneDesc, viewParams, lightParams, options.width, options.height, image);
+            Profiler::Get().EndFrame();
+
+            std::cout << "Rendered " << options.width << "x" << options.height << " in " << stats.milliseconds << " ms, "
+                      << stats.raysCount << " rays, " << stats.megaraysPerSecond << " Mrays/s" << std::endl;
+
+            if (isWaterCulled)
+            {
+                // the full quality one traces every water ray to its whole length
+                ViewParams fullParams       = viewParams;
+                fullParams.waterMinWeight   = 0.0f;
+                fullParams.waterFarDistance = 0.0f;
+
+                std::vector<XMFLOAT4>     reference(pixelsCount);
+                const CpuRaytracer::Stats fullStats = raytracer.Render(sceneDesc, fullParams, lightParams, options.width, options.height, reference);
+                Profiler::Get().EndFrame();
+
+                std::cout << "Water culling skipped " << stats.skippedRaysCount << " rays, traced " << stats.raysCount << " of " << fullStats.raysCount
+                          << " (" << 100.0 * stats.raysCount / fullStats.raysCount << "%) in " << stats.milliseconds << " ms of "
+                          << fullStats.milliseconds << " ms, " << ComputePSNR(reference, image) << " dB" << std::endl;
+            }
+
+            ImageWriter::Write(options.output, options.width, options.height, image);
+            ExportProfile(options);
+            return 0;
+        }
+
+        // the frames and their histories swap every frame like the outputs of the sample do
+        std::vector<XMFLOAT4>                reference(pixelsCount);
+        std::array<std::vector<XMFLOAT4>, 2> colors   = {std::vector<XMFLOAT4>(pixelsCount), std::vector<XMFLOAT4>(pixelsCount)};
+        std::array<std::vector<XMFLOAT4>, 2> gbuffers = {std::vector<XMFLOAT4>(pixelsCount), std::vector<XMFLOAT4>(pixelsCount)};
+
+        ReconstructionParams reconstructionParams = {};
+        reconstructionParams.width                = options.width;
+        reconstructionParams.height               = options.height;
+
+        uint64_t   fullRays         = 0;
+        uint64_t   checkerboardRays = 0;
+        double     psnrSum          = 0.0;
+        FrameStats frameStats;  // of the checkerboard frames with their reconstruction
+        for (uint32_t frame = 0; frame < options.checkerboard; ++frame)
+        {
+            const XMMATRIX viewProj = setCamera(frame);
+            viewParams.frameIndex   = options.frameIndex + frame;
+
+            viewParams.sampling = SAMPLING_FULL;
+            fullRays += raytracer.Render(sceneDesc, viewParams, lightParams, options.width, options.height, reference).raysCount;
+
+            std::vector<XMFLOAT4>& color   = colors[frame & 1];
+            std::vector<XMFLOAT4>& gbuffer = gbuffers[frame & 1];
+
+            const auto frameStart = std::chrono::steady_clock::now();
+
+            viewParams.sampling = SAMPLING_CHECKERBOARD;
+            checkerboardRays += raytracer.Render(sceneDesc, viewParams, lightParams, options.width, options.height, color, gbuffer).raysCount;
+
+            reconstructionParams.inverseViewProj = viewParams.inverseViewProj;
+            reconstructionParams.viewPos         = viewParams.viewPos;
+            reconstructionParams.frameIndex      = viewParams.frameIndex;
+            reconstructionParams.historyValid    = frame > 0 ? 1 : 0;
+            TemporalReconstruction::Reconstruct(reconstructionParams, color, gbuffer, colors[(frame + 1) & 1], gbuffers[(frame + 1) & 1]);
+            frameStats.AddFrame(FrameStats::Track::Cpu, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+            Profiler::Get().EndFrame();
+
+            reconstructionParams.previousViewProj        = viewProj;
+            reconstructionParams.previousInverseViewProj = viewParams.inverseViewProj;
+            reconstructionParams.previousViewPos         = viewParams.viewPos;
+
+            const double psnr = ComputePSNR(reference, color);
+            psnrSum += psnr;
+            std::cout << "Frame " << frame << ": " << psnr << " dB" << std::endl;
+        }
+
+        std::cout << "Checkerboard traced " << checkerboardRays << " rays of " << fullRays << " (" << 100.0 * checkerboardRays / fullRays
+                  << "%), the reconstruction is " << psnrSum / options.checkerboard << " dB on average" << std::endl;
+
+        const FrameStats::Summary summary = frameStats.GetSummary(FrameStats::Track::Cpu, FrameStats::Window::Session);
+        std::cout << "Checkerboard frames: p50 " << summary.p50 << " ms, p95 " << summary.p95 << " ms, p99 " << summary.p99 << " ms, max "
+                  << summary.max << " ms" << std::endl;
+
+        ImageWriter::Write(options.output, options.width, options.height, colors[(options.checkerboard - 1) & 1]);
+        ExportProfile(options);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
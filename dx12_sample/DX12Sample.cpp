@@ -1,22 +1,35 @@
 #include "stdafx.h"
 
 #include "DX12Sample.h"
+#include "ProfilerWindow.h"
+#include "worldgen/IslandMesh.h"
 #include "worldgen/TerrainManager.h"
 
 #include <utils/CommandList.h>
 #include <utils/FeaturesCollector.h>
 #include <utils/Math.h>
+#include <utils/Profiler.h>
 
 #include <imgui.h>
 #include <backends/imgui_impl_dx12.h>
 #include <backends/imgui_impl_win32.h>
 
+#include <iostream>
+
 constexpr std::size_t mapSize = Math::AlignTo(1024, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
 
 using namespace std::chrono;
 
-DX12Sample::DX12Sample(int windowWidth, int windowHeight, std::set<optTypes>& opts)
+namespace
+{
+// the camera is a sphere a bit larger than its near plane distance, so it never clips the surfaces
+constexpr float cameraRadius = 0.2f;
+constexpr float cameraHeight = 0.5f;  // above the terrain
+}  // namespace
+
+DX12Sample::DX12Sample(int windowWidth, int windowHeight, CommandLineOptions cmdLineOpts)
     : DXSample(windowWidth, windowHeight, L"HELLO YOPTA")
+    , _cmdLineOpts(cmdLineOpts)
     , _worldGen(mapSize)
 {
 }
@@ -38,14 +51,16 @@ void DX12Sample::OnInit()
     }
 #endif
 
+    Profiler::Get().SetThreadName("Main thread");
+
     _deviceResources = CreateDeviceResources();
     DumpFeatures();
 
     GameInput::Initialize(m_hwnd);
     GameInput::AcquireMouse();
 
-    _uiCmdList = std::make_unique<CommandList>(CommandListType::Direct, _deviceResources->GetDevice());
-    _uiCmdList->Close();
+    for (std::size_t frame = 0; frame < _deviceResources->GetFramesCount(); ++frame)
+        _uiCmdLists.emplace_back(CommandListType::Direct, _deviceResources->GetDevice()).Close();
 
     _RTManager    = std::make_unique<RenderTargetManager>(_deviceResources->GetDevice());
     auto swapChainRts = _RTManager->CreateRenderTargetsForSwapChain(_deviceResources->GetSwapChain());
@@ -76,42 +91,43 @@ void DX12Sample::OnInit()
 
     // Setup Platform/Renderer back ends
     ImGui_ImplWin32_Init(DXSample::m_hwnd);
-    ImGui_ImplDX12_Init(_deviceResources->GetDevice().Get(), 2, DXGI_FORMAT_R8G8B8A8_UNORM, _uiDescriptors.Get(),
+    ImGui_ImplDX12_Init(_deviceResources->GetDevice().Get(), (int)_deviceResources->GetFramesCount(),
+                        DXGI_FORMAT_R8G8B8A8_UNORM, _uiDescriptors.Get(),
                         _uiDescriptors->GetCPUDescriptorHandleForHeapStart(),
                         _uiDescriptors->GetGPUDescriptorHandleForHeapStart());
 
     _camera = _sceneManager->CreateWASDCamera();
     _camera->SetPosition({mapSize / 2.0f, mapSize / 2.0f, (float)_worldGen.GetHeight(mapSize / 2, mapSize / 2) + 25.0f});
 
+    _worldQuery = std::make_unique<WorldQuery>();
+    _camera->SetCollider([this](const XMFLOAT3& from, const XMFLOAT3& to) {
+        XMFLOAT3 position = _worldQuery->MoveSphere(from, to, cameraRadius);
+        if (const std::optional<float> ground = _worldQuery->GetGroundHeight(position.x, position.y))
+            position.z = std::max(position.z, *ground + cameraHeight);
+
+        return position;
+    });
+
     CreateObjects();
 }
 
 void DX12Sample::OnUpdate()
 {
+    PROFILE_SCOPE("DX12Sample::OnUpdate");
+
     static auto prevTime = high_resolution_clock::now();
-    static int elapsedFrames = 0;
-    static double elapsedTime = 0.0;
 
-    auto diff = duration_cast<microseconds>(high_resolution_clock::now() - prevTime);
-    double dt = (double)diff.count() / 1000000.0;
+    // the time since the previous update is of the whole previous frame
+    const auto now  = high_resolution_clock::now();
+    const auto diff = duration_cast<microseconds>(now - prevTime);
+    double     dt   = (double)diff.count() / 1000000.0;
+    prevTime        = now;
 
     GameInput::Update(dt, m_hwnd);
+    _frameStats.AddFrame(FrameStats::Track::Cpu, dt * 1000.0);
 
-    prevTime = high_resolution_clock::now();
-    elapsedFrames++;
-    elapsedTime += dt;
-
-    if (elapsedTime > 1.0)
-    {
-        for (auto i = 0; i < _frameTimes.size() - 1; ++i)
-        {
-            _frameTimes[i] = _frameTimes[i + 1];
-            _frameTimes.back() = (float)elapsedFrames;
-        }
-
-        elapsedFrames = 0;
-        elapsedTime -= 1.0;
-    }
+    // the snapshot of the last TLAS build, the camera moves and the picking go against it
+    _worldQuery->SetScene(_sceneManager->GetCpuScene());
 
     float mult = GameInput::IsPressed(GameInput::kKey_lshift) ? 4.0f : 1.0f;
     if (GameInput::IsPressed(GameInput::kKey_w))
@@ -135,11 +151,43 @@ void DX12Sample::OnUpdate()
         _camera->RotateHorizontally(dx);
         _camera->RotateVertically(dy);
     }
+
+    if (GameInput::IsFirstPressed(GameInput::kMouse0) && !ImGui::GetIO().WantCaptureMouse)
+    {
+        POINT cursor;
+        GetCursorPos(&cursor);
+        ScreenToClient(m_hwnd, &cursor);
+
+        XMFLOAT3 origin, direction;
+        _camera->GetPickingRay((float)cursor.x, (float)cursor.y, origin, direction);
+        _selection = _worldQuery->Raycast(origin, direction, std::numeric_limits<float>::max());
+    }
 }
 
 void DX12Sample::OnRender()
 {
-    _sceneManager->DrawScene();
+    {
+        PROFILE_SCOPE("DX12Sample::OnRender");
+
+        _sceneManager->DrawScene();
+
+        // the GPU time is of a frame a few frames back, the tags are of the CPU one being recorded
+        if (const std::optional<double> gpuMilliseconds = _sceneManager->GetGpuProfiler().GetFrameMilliseconds())
+            _frameStats.AddFrame(FrameStats::Track::Gpu, *gpuMilliseconds);
+        if (_sceneManager->IsTlasRebuilt())
+            _frameStats.AddTag("TLAS rebuild");
+
+        RenderUI();
+    }
+
+    // the frame ends with the present, so the wait for the next one is a part of it
+    _sceneManager->Present();
+    Profiler::Get().EndFrame();
+}
+
+void DX12Sample::RenderUI()
+{
+    PROFILE_SCOPE("DX12Sample::RenderUI");
 
     // Start the Dear ImGui frame
     ImGui_ImplDX12_NewFrame();
@@ -156,6 +204,12 @@ void DX12Sample::OnRender()
         static ImVec4 ambientColor{ 0.1f, 0.1f, 0.1f, 1.0f };
         static ImVec4 lightColor{1.0f, 1.0f, 1.0f, 1.0f};
         static ImVec4 lightDir{ 0.0f, -0.154f, -0.148f, 1.0f };
+        static float  aoRadius         = 2.0f;
+        static float  aoMaxSamples     = 4.0f;
+        static float  frameTimeTarget  = 16.6f;
+        static bool   checkerboard     = false;
+        static float  waterMinWeight   = 0.0f;
+        static float  waterFarDistance = 0.0f;
 
         ImVec2 window_pos;
         window_pos.x = viewport->WorkPos.x + padding;
@@ -165,7 +219,21 @@ void DX12Sample::OnRender()
 
         ImGui::Begin("Overlay", nullptr, windowFlags);
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-        ImGui::PlotHistogram("FPS", _frameTimes.data(), _frameTimes.size());
+        {
+            const auto getter = [](void* data, int index) {
+                return static_cast<const FrameStats*>(data)->GetRecentMilliseconds(FrameStats::Track::Cpu, index);
+            };
+            ImGui::PlotLines("Frame time, ms", getter, &_frameStats, (int)_frameStats.GetRecentCount(FrameStats::Track::Cpu),
+                             0, nullptr, 0.0f, FLT_MAX, {0.0f, 60.0f});
+
+            // of the short window, the max shows the single hitches the averages hide
+            for (FrameStats::Track track : {FrameStats::Track::Cpu, FrameStats::Track::Gpu})
+            {
+                const FrameStats::Summary summary = _frameStats.GetSummary(track, FrameStats::Window::Short);
+                ImGui::Text("%s ms: p50 %.2f, p95 %.2f, p99 %.2f, max %.2f, hitches %llu", track == FrameStats::Track::Cpu ? "CPU" : "GPU",
+                            summary.p50, summary.p95, summary.p99, summary.max, (unsigned long long)_frameStats.GetHitchesCount(track));
+            }
+        }
         ImGui::Text("Camera position:");
         ImGui::SameLine();
         ImGui::Text("X: %.3f", _camera->GetPosition().x);
@@ -173,9 +241,35 @@ void DX12Sample::OnRender()
         ImGui::Text("Y: %.3f", _camera->GetPosition().y);
         ImGui::SameLine();
         ImGui::Text("Z: %.3f", _camera->GetPosition().z);
+        if (_selection)
+        {
+            if (_selection->isTerrain)
+                ImGui::Text("Selected: terrain");
+            else
+                ImGui::Text("Selected: instance %u, geometry %u, triangle %u", _selection->instance, _selection->geometry, _selection->triangle);
+
+            ImGui::Text("At X: %.3f Y: %.3f Z: %.3f, distance %.3f", _selection->position.x, _selection->position.y, _selection->position.z, _selection->distance);
+        }
+        else
+        {
+            ImGui::Text("Selected: nothing");
+        }
         ImGui::ColorEdit3("Ambient color", (float*)&ambientColor);
         ImGui::ColorEdit3("Light color", (float*)&lightColor);
         ImGui::SliderFloat3("Light direction", (float*)&lightDir, -1.0f, 1.0f);
+        ImGui::SliderFloat("AO radius", &aoRadius, 0.1f, 10.0f);
+        ImGui::SliderFloat("AO max samples", &aoMaxSamples, 0.0f, 16.0f);
+        ImGui::SliderFloat("GPU frame time target, ms", &frameTimeTarget, 4.0f, 33.3f);
+        ImGui::Checkbox("Checkerboard tracing", &checkerboard);
+        ImGui::SliderFloat("Water rays min weight", &waterMinWeight, 0.0f, 0.2f);
+        ImGui::SliderFloat("Water far distance", &waterFarDistance, 0.0f, 500.0f);
+
+        // the checkerboard traces half of the pixels
+        const RayBudget& rayBudget   = _sceneManager->GetRayBudget();
+        const uint32_t   tracedWidth = checkerboard ? ((uint32_t)m_width + 1) / 2 : (uint32_t)m_width;
+        ImGui::Text("AO samples: %.2f per pixel, up to %.2f Mrays per frame", rayBudget.GetSamples(),
+                    rayBudget.GetRaysCount(tracedWidth, (uint32_t)m_height) / 1e6);
+        ImGui::Text("Water rays skipped: %.3f M per frame", _sceneManager->GetSkippedWaterRays() / 1e6);
         ImGui::End();
 
         if (ImGui::BeginMainMenuBar())
@@ -186,6 +280,10 @@ void DX12Sample::OnRender()
                 {
                     _showTerrainControls = !_showTerrainControls;
                 }
+                if (ImGui::MenuItem("Show profiler", nullptr, _showProfiler))
+                {
+                    _showProfiler = !_showProfiler;
+                }
                 ImGui::EndMenu();
             }
             
@@ -195,6 +293,10 @@ void DX12Sample::OnRender()
         _sceneManager->SetAmbientColor(ambientColor.x, ambientColor.y, ambientColor.z);
         _sceneManager->SetLightColor(lightColor.x, lightColor.y, lightColor.z);
         _sceneManager->SetLightDirection(lightDir.x, lightDir.y, lightDir.z);
+        _sceneManager->SetAmbientOcclusion(aoRadius, aoMaxSamples);
+        _sceneManager->SetFrameTimeTarget(frameTimeTarget);
+        _sceneManager->SetCheckerboard(checkerboard);
+        _sceneManager->SetWaterCulling(waterMinWeight, waterFarDistance);
 
         if (_showTerrainControls)
         {
@@ -209,9 +311,13 @@ void DX12Sample::OnRender()
                 _worldGen.GenerateHeightMap(_worldGenParams.octaves, _worldGenParams.persistance,
                                             _worldGenParams.frequency, _worldGenParams.lacunarity);
                 UpdateWorldTexture();
+                _frameStats.AddTag("Terrain generation");
             }
             ImGui::End();
         }
+
+        if (_showProfiler)
+            ProfilerWindow::Draw(Profiler::Get(), &_showProfiler);
     }
 
     // Rendering
@@ -220,10 +326,15 @@ void DX12Sample::OnRender()
     UINT backBufferIdx = _deviceResources->GetSwapChain()->GetCurrentBackBufferIndex();
     RenderTarget* rts[8] = {_deviceResources->GetSwapChainRts()[backBufferIdx].get()};
 
-    _uiCmdList->Reset();
-    _RTManager->BindRenderTargets(rts, nullptr, *_uiCmdList);
-    _uiCmdList->GetInternal()->SetDescriptorHeaps(1, _uiDescriptors.GetAddressOf());
-    ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), _uiCmdList->GetInternal().Get());
+    CommandList& uiCmdList = _uiCmdLists[_deviceResources->GetFrameIndex()];
+    uiCmdList.Reset();
+    GpuProfiler& gpuProfiler = _sceneManager->GetGpuProfiler();
+    {
+        PROFILE_GPU_SCOPE(gpuProfiler, uiCmdList.GetInternal().Get(), "UI");
+        _RTManager->BindRenderTargets(rts, nullptr, uiCmdList);
+        uiCmdList->SetDescriptorHeaps(1, _uiDescriptors.GetAddressOf());
+        ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), uiCmdList.GetInternal().Get());
+    }
 
     D3D12_RESOURCE_BARRIER barrier = {};
     barrier.Type                   = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -232,15 +343,22 @@ void DX12Sample::OnRender()
     barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
     barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
     barrier.Transition.StateAfter  = D3D12_RESOURCE_STATE_PRESENT;
-    _uiCmdList->GetInternal()->ResourceBarrier(1, &barrier);
-    _uiCmdList->Close();
+    uiCmdList->ResourceBarrier(1, &barrier);
+    // the UI is the last list of the frame
+    gpuProfiler.EndFrame(uiCmdList.GetInternal().Get());
+    uiCmdList.Close();
 
-    _sceneManager->ExecuteCommandList(*_uiCmdList);
-    _sceneManager->Present();
+    // the UI goes right after the scene, nothing waits for the GPU here
+    _sceneManager->SubmitCommandList(uiCmdList);
 }
 
 void DX12Sample::OnDestroy()
 {
+    // the console of the debug builds gets it too
+    _frameStats.Print(std::cout);
+    std::ofstream frameStatsFile("frame_stats.txt", std::ios::trunc);
+    _frameStats.Print(frameStatsFile);
+
     GameInput::Shutdown();
     ImGui_ImplDX12_Shutdown();
     ImGui_ImplWin32_Shutdown();
@@ -424,9 +542,11 @@ void DX12Sample::AdjustSizes()
 
     m_width = width;
     m_height = height;
-    // update window size
+    // update window size, the frames in flight still use the buffers
+    _deviceResources->WaitForCurrentFrame();
     _deviceResources->ClearSwapChainRts();
-    ThrowIfFailed(_deviceResources->GetSwapChain()->ResizeBuffers(0, m_width, m_height, DXGI_FORMAT_UNKNOWN, NULL));
+    ThrowIfFailed(_deviceResources->GetSwapChain()->ResizeBuffers(0, m_width, m_height, DXGI_FORMAT_UNKNOWN,
+                                                                  DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT));
     auto swapChainRts = _RTManager->CreateRenderTargetsForSwapChain(_deviceResources->GetSwapChain());
     _deviceResources->SetSwapChainRts(swapChainRts);
     _sceneManager->UpdateWindowSize(m_width, m_height);
@@ -440,7 +560,7 @@ std::shared_ptr<DeviceResources> DX12Sample::CreateDeviceResources()
     auto device    = CreateDevice(factory);
     auto cmdQueue  = CreateCommandQueue(device);
     auto swapChain = CreateSwapChain(factory, cmdQueue, m_hwnd, _swapChainBuffersCount, m_width, m_height);
-    resources      = std::make_shared<DeviceResources>(device, factory, swapChain, cmdQueue);
+    resources      = std::make_shared<DeviceResources>(device, factory, swapChain, cmdQueue, _cmdLineOpts.maxFrameLatency);
     return resources;
 }
 
@@ -491,7 +611,7 @@ ComPtr<IDXGISwapChain3> DX12Sample::CreateSwapChain(ComPtr<IDXGIFactory4>      f
     swapChainDesc.AlphaMode             = DXGI_ALPHA_MODE_UNSPECIFIED;
     swapChainDesc.BufferCount           = buffersCount;
     swapChainDesc.BufferUsage           = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    swapChainDesc.Flags                 = 0;
+    swapChainDesc.Flags                 = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
     swapChainDesc.Format                = DXGI_FORMAT_R8G8B8A8_UNORM;
     swapChainDesc.Height                = height;
     swapChainDesc.Width                 = width;
@@ -528,6 +648,13 @@ std::shared_ptr<SceneObject> CreatePlane(SceneManager* sceneManager, float width
 
 void DX12Sample::CreateObjects()
 {
+    // the camera is above the center of the map already
+    if (_cmdLineOpts.island)
+    {
+        CreateIsland();
+        return;
+    }
+
     //auto lut = _colorsLut;
     //// we do not need to gen colors for water
     //lut.erase(40);
@@ -558,85 +685,28 @@ void DX12Sample::CreateObjects()
     plane2->Position({0.0f, 0.0f, 1.0f});
 }
 
-void CalculateNormal(std::vector<GeometryVertex>& vertices, uint32_t index, int islandSize)
-{
-    auto calcNorm = [&vertices](uint32_t i1, uint32_t i2, uint32_t i3) {
-        GeometryVertex& vertex1 = vertices[i1];
-        const float3& position = vertex1.position;
-        DirectX::FXMVECTOR pos1 = DirectX::FXMVECTOR({ position.x, position.y, position.z });
-
-        GeometryVertex& vertex2 = vertices[i2];
-        const float3& position2 = vertex2.position;
-        DirectX::FXMVECTOR pos2 = DirectX::FXMVECTOR({ position2.x, position2.y, position2.z });
-
-        GeometryVertex& vertex3 = vertices[i3];
-        const float3& position3 = vertex3.position;
-        DirectX::FXMVECTOR pos3 = DirectX::FXMVECTOR({ position3.x, position3.y, position3.z });
-
-        XMVECTOR vector1 = DirectX::XMVectorSubtract(pos2, pos1);
-        XMVECTOR vector2 = DirectX::XMVectorSubtract(pos3, pos1);
-
-        XMVECTOR cross = DirectX::XMVector3Cross(vector1, vector2);
-        DirectX::XMVECTOR norm = DirectX::XMVector3Normalize(cross);
-        DirectX::XMStoreFloat3(&vertex1.normal, norm);
-        DirectX::XMStoreFloat3(&vertex2.normal, norm);
-        DirectX::XMStoreFloat3(&vertex3.normal, norm);
-    };
-
-    if (vertices.size() > index + islandSize + 2)
-    {
-        calcNorm(index, index + 1, index + islandSize + 1);
-        calcNorm(index + islandSize + 2, index + islandSize + 1, index + 1);
-    }
-}
-
 void DX12Sample::CreateIsland()
 {
-    int islandSize = _worldGen.GetSideSize() - 1;
-
-    float multi = 0.5f;
+    PROFILE_SCOPE("DX12Sample::CreateIsland");
 
-    std::vector<GeometryVertex> vertices;
-    vertices.reserve(islandSize * islandSize);
+    IslandMesh island{_worldGen, _colorsLut};
+    island.GenerateLods(5, 0.05f);
+    _worldQuery->SetHeightField(std::make_shared<HeightField>(island.CreateHeightField()));
 
-    float islandWidth = 100.0f;
+    const XMFLOAT3 cameraPosition = _camera->GetPosition();
 
-    for (int y = 0; y <= islandSize; y++)
+    std::vector<CustomObjectDesc> objects;
+    objects.reserve(island.GetTiles().size());
+    for (const IslandTile& tile : island.GetTiles())
     {
-        for (int x = 0; x <= islandSize; x++)
-        {
-            uint8_t height = _worldGen.GetHeight(x, y) * multi;
-
-            const float nz     = height;
-            const float nx     = -islandWidth / 2 + islandWidth * ((float)x / islandSize);
-            const float ny     = -islandWidth / 2 + islandWidth * ((float)y / islandSize);
-            float3      normal = {0.0f, 0.0f, 0.0f};
-            const auto     colorX = _colorsLut.lower_bound(nz / multi)->second;
-            const XMFLOAT3 color  = {colorX.x / 255.0f, colorX.y / 255.0f, colorX.z / 255.0f};
-            vertices.emplace_back(GeometryVertex{{nx, ny, nz}, normal, color});
-        }
-    }
-
-    int                   colCnt = 0;
-    std::vector<uint32_t> indices;
-    for (uint32_t i = 0; i < islandSize * (islandSize - 1); ++i)
-    {
-        colCnt++;
-        if (colCnt > islandSize)
-        {
-            colCnt = 0;
-            continue;
-        }
-
-        CalculateNormal(vertices, i, islandSize);
-        indices.emplace_back(i);
-        indices.emplace_back(i + 1);
-        indices.emplace_back(i + islandSize + 1);
+        const XMVECTOR offset   = XMVectorSubtract(XMLoadFloat3(&tile.center), XMLoadFloat3(&cameraPosition));
+        const float    distance = XMVectorGetX(XMVector3Length(offset));
 
-        indices.emplace_back(i + islandSize + 2);
-        indices.emplace_back(i + islandSize + 1);
-        indices.emplace_back(i + 1);
+        const std::size_t lod = island.SelectLod(tile, distance);
+        objects.push_back({tile.vertices, tile.lods[lod], Material{MaterialType::Diffuse}});
     }
 
-    _sceneManager->CreateCustomObject(vertices, indices, Material{MaterialType::Diffuse});
+    // tiles are static, so neighbouring ones share BLASes, TLAS instances get fewer and so do rebuilds
+    constexpr std::size_t tilesPerObject = 16;
+    _sceneManager->CreateMergedObjects(objects, tilesPerObject);
 }
@@ -8,12 +8,14 @@
 #include "SceneManager.h"
 #include "worldgen/WorldGen.h"
 
+#include <utils/FrameStats.h>
 #include <utils/SceneObject.h>
+#include <utils/WorldQuery.h>
 
 class DX12Sample : public DXSample
 {
 public:
-    DX12Sample(int windowWidth, int windowHeight, std::set<optTypes>& opts);
+    DX12Sample(int windowWidth, int windowHeight, CommandLineOptions cmdLineOpts);
     ~DX12Sample();
 
     void OnInit() override;
@@ -24,6 +26,8 @@ public:
     void HandleWindowMessage(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) override;
 
 private:
+    // records and submits the UI list, it goes after the scene ones
+    void RenderUI();
     void UpdateWorldTexture();
     void CreateUITexture();
     void AdjustSizes();
@@ -49,17 +53,20 @@ private:
     std::shared_ptr<DeviceResources>     _deviceResources = nullptr;
     std::unique_ptr<SceneManager>        _sceneManager    = nullptr;
     std::unique_ptr<RenderTargetManager> _RTManager       = nullptr;
-    CommandLineOptions                   _cmdLineOpts{};
+    CommandLineOptions                   _cmdLineOpts;
 
     // Main sample parameters
-    static constexpr size_t _swapChainBuffersCount = 2;
+    static constexpr size_t _swapChainBuffersCount = 3;
     bool                    _isResizing            = false;
 
     ComPtr<ID3D12DescriptorHeap>               _uiDescriptors = nullptr;
-    std::unique_ptr<CommandList>               _uiCmdList;
-    std::array<float, 30>                      _frameTimes          = {};
+    std::vector<CommandList>                   _uiCmdLists;  // per frame in flight
+    FrameStats                                 _frameStats;  // printed on exit
     bool                                       _showTerrainControls = false;
+    bool                                       _showProfiler        = false;
     std::shared_ptr<Graphics::WASDCamera>      _camera;
+    std::unique_ptr<WorldQuery>                _worldQuery;
+    std::optional<WorldQuery::Hit>             _selection;  // of the last click
 
     WorldGen                     _worldGen;
     ComPtr<ID3D12Resource>       _heightMapTexture;
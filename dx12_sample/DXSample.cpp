@@ -106,7 +106,7 @@ int DXSample::Run(HINSTANCE hInstance, int nCmdShow)
     return static_cast<char>(returnCode);
 }
 
-// Returns bool whether the device supports DirectX Raytracing tier.
+// Returns bool whether the device supports DirectX Raytracing tier 1.1, the hit shaders use GeometryIndex().
 bool IsDirectXRaytracingSupported(IDXGIAdapter1* adapter)
 {
     ComPtr<ID3D12Device> testDevice;
@@ -114,7 +114,7 @@ bool IsDirectXRaytracingSupported(IDXGIAdapter1* adapter)
 
     return SUCCEEDED(D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&testDevice)))
         && SUCCEEDED(testDevice->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS5, &featureSupportData, sizeof(featureSupportData)))
-        && featureSupportData.RaytracingTier != D3D12_RAYTRACING_TIER_NOT_SUPPORTED;
+        && featureSupportData.RaytracingTier >= D3D12_RAYTRACING_TIER_1_1;
 }
 
 // Helper function for acquiring the first available hardware adapter that supports Direct3D 12.
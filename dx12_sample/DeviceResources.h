@@ -4,29 +4,49 @@
 
 #include <utils/RenderTargetManager.h>
 
+#include <deque>
+
 class DeviceResources
 {
 public:
+    // the swap chain has to be created with DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT,
+    // CPU records up to framesCount frames ahead of the GPU
     DeviceResources(ComPtr<ID3D12Device5>      device,
                     ComPtr<IDXGIFactory4>      factory,
                     ComPtr<IDXGISwapChain3>    swapChain,
-                    ComPtr<ID3D12CommandQueue> cmdQueue)
+                    ComPtr<ID3D12CommandQueue> cmdQueue,
+                    UINT                       framesCount)
         : _device(device)
         , _factory(factory)
         , _swapChain(swapChain)
         , _cmdQueue(cmdQueue)
+        , _frameFenceValues(framesCount, 0)
     {
         assert(device);
         assert(factory);
         assert(swapChain);
         assert(cmdQueue);
+        assert(framesCount > 0);
 
         // Have to create Fence and Event.
         ThrowIfFailed(_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_frameFence)));
         _frameEndEvent = CreateEvent(NULL, FALSE, FALSE, nullptr);
         assert(_frameEndEvent);
+
+        ThrowIfFailed(_swapChain->SetMaximumFrameLatency(framesCount));
+        _frameLatencyWaitable = _swapChain->GetFrameLatencyWaitableObject();
+        assert(_frameLatencyWaitable);
+    }
+
+    ~DeviceResources()
+    {
+        CloseHandle(_frameLatencyWaitable);
+        CloseHandle(_frameEndEvent);
     }
 
+    DeviceResources(const DeviceResources&) = delete;
+    DeviceResources& operator=(const DeviceResources&) = delete;
+
     ComPtr<ID3D12Device5> GetDevice() const
     {
         return _device;
@@ -42,18 +62,67 @@ public:
         return _swapChain;
     }
 
+    // waits till the swap chain may accept a new frame and the resources of the frame context are free
+    void BeginFrame()
+    {
+        WaitForSingleObjectEx(_frameLatencyWaitable, 1000, TRUE);
+        WaitForFenceValue(_frameFenceValues[_frameIndex]);
+
+        // objects released by the frames which are finished now
+        const uint64_t completedValue = _frameFence->GetCompletedValue();
+        while (!_releasedObjects.empty() && _releasedObjects.front().first <= completedValue)
+            _releasedObjects.pop_front();
+    }
+
+    // to be called after Present, the frame context is reused once the GPU reaches the signal
+    void EndFrame()
+    {
+        _frameFenceValues[_frameIndex] = Signal();
+        _frameIndex                    = (_frameIndex + 1) % _frameFenceValues.size();
+    }
+
+    // flushes the queue, e.g. before resizing the swap chain or uploading textures
     void WaitForCurrentFrame()
     {
-        uint64_t newFenceValue = _fenceValue;
+        WaitForFenceValue(Signal());
+    }
+
+    // keeps the object alive till the GPU finishes the frame being recorded and the previous ones
+    void ReleaseAfterFrame(std::shared_ptr<void> object)
+    {
+        _releasedObjects.emplace_back(_fenceValue, std::move(object));
+    }
 
-        ThrowIfFailed(_cmdQueue->Signal(_frameFence.Get(), newFenceValue));
-        _fenceValue++;
+    std::size_t GetFrameIndex() const
+    {
+        return _frameIndex;
+    }
 
-        if (_frameFence->GetCompletedValue() != newFenceValue)
-        {
-            ThrowIfFailed(_frameFence->SetEventOnCompletion(newFenceValue, _frameEndEvent));
-            WaitForSingleObject(_frameEndEvent, INFINITE);
-        }
+    std::size_t GetFramesCount() const
+    {
+        return _frameFenceValues.size();
+    }
+
+    // the fence is signalled at the end of every frame, other queues may wait for it on the GPU
+    ComPtr<ID3D12Fence> GetFrameFence() const
+    {
+        return _frameFence;
+    }
+
+    uint64_t GetLastSignaledFenceValue() const
+    {
+        return _fenceValue - 1;
+    }
+
+    // the value the frame being recorded is going to be signalled with
+    uint64_t GetCurrentFrameFenceValue() const
+    {
+        return _fenceValue;
+    }
+
+    bool IsFenceValueCompleted(uint64_t value) const
+    {
+        return _frameFence->GetCompletedValue() >= value;
     }
 
     void SetSwapChainRts(std::vector<std::shared_ptr<RenderTarget>> swapChainRts)
@@ -72,6 +141,22 @@ public:
     }
 
 private:
+    uint64_t Signal()
+    {
+        const uint64_t value = _fenceValue++;
+        ThrowIfFailed(_cmdQueue->Signal(_frameFence.Get(), value));
+        return value;
+    }
+
+    void WaitForFenceValue(uint64_t value)
+    {
+        if (_frameFence->GetCompletedValue() >= value)
+            return;
+
+        ThrowIfFailed(_frameFence->SetEventOnCompletion(value, _frameEndEvent));
+        WaitForSingleObject(_frameEndEvent, INFINITE);
+    }
+
     ComPtr<ID3D12Device5>                      _device;
     ComPtr<IDXGIFactory4>                      _factory;
     ComPtr<IDXGISwapChain3>                    _swapChain;
@@ -79,7 +164,14 @@ private:
     std::vector<std::shared_ptr<RenderTarget>> _swapChainRTs;
 
     // sync primitives
-    HANDLE              _frameEndEvent = nullptr;
-    uint64_t            _fenceValue    = 1; // avoid 0 as a default value of ID3D12Fence::GetCompletedValue()
-    ComPtr<ID3D12Fence> _frameFence    = nullptr;
+    HANDLE              _frameEndEvent        = nullptr;
+    HANDLE              _frameLatencyWaitable = nullptr;
+    uint64_t            _fenceValue           = 1; // avoid 0 as a default value of ID3D12Fence::GetCompletedValue()
+    ComPtr<ID3D12Fence> _frameFence           = nullptr;
+
+    // frame contexts, the fence value of the last use of every one
+    std::vector<uint64_t> _frameFenceValues;
+    std::size_t           _frameIndex = 0;
+
+    std::deque<std::pair<uint64_t, std::shared_ptr<void>>> _releasedObjects;
 };
@@ -0,0 +1,196 @@
+#include "stdafx.h"
+
+#include "ProfilerWindow.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+// the frames averaged by the table, a second or so
+constexpr std::size_t summaryFramesCount = 60;
+
+constexpr float laneHeight  = 18.0f;
+constexpr float labelsWidth = 100.0f;
+
+// the result of the last export, a failed one is reported in the window instead of leaving the frame
+std::string exportStatus;
+
+template <typename Write>
+void Export(const char* path, Write write)
+{
+    try
+    {
+        write(path);
+        exportStatus = std::string("Written to ") + path;
+    }
+    catch (const std::runtime_error& e)
+    {
+        exportStatus = std::string("Export failed: ") + e.what();
+    }
+}
+
+// the GPU lane is the last one
+std::vector<uint32_t> GetThreads(const Profiler::Frame& frame)
+{
+    std::vector<uint32_t> threads;
+    for (const Profiler::Event& event : frame.events)
+    {
+        if (std::find(threads.begin(), threads.end(), event.thread) == threads.end())
+            threads.push_back(event.thread);
+    }
+    std::sort(threads.begin(), threads.end());
+    return threads;
+}
+
+void DrawTimeline(const Profiler& profiler, const Profiler::Frame& frame)
+{
+    const std::vector<uint32_t> threads = GetThreads(frame);
+
+    // the GPU passes of the frame run after its CPU part, so the timeline covers them too
+    int64_t start = frame.start;
+    int64_t end   = frame.end;
+    for (const Profiler::Event& event : frame.events)
+    {
+        start = std::min(start, event.start);
+        end   = std::max(end, event.end);
+    }
+
+    ImGui::Text("Frame %llu: %.3f ms, the timeline is %.3f ms", (unsigned long long)frame.index,
+                (frame.end - frame.start) / 1e6, (end - start) / 1e6);
+
+    std::vector<uint32_t> lanesDepths(threads.size(), 1);
+    for (const Profiler::Event& event : frame.events)
+    {
+        const std::size_t lane = std::find(threads.begin(), threads.end(), event.thread) - threads.begin();
+        lanesDepths[lane]      = std::max(lanesDepths[lane], event.depth + 1);
+    }
+
+    float height = 0.0f;
+    for (uint32_t depth : lanesDepths)
+        height += depth * laneHeight;
+
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float  width  = std::max(ImGui::GetContentRegionAvail().x - labelsWidth, 1.0f);
+    const double scale  = width / (double)std::max<int64_t>(end - start, 1);
+
+    ImGui::InvisibleButton("Timeline", {labelsWidth + width, height});
+    const bool   isHovered = ImGui::IsItemHovered();
+    const ImVec2 mouse     = ImGui::GetIO().MousePos;
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect(origin, {origin.x + labelsWidth + width, origin.y + height}, true);
+
+    float laneTop = origin.y;
+    for (std::size_t lane = 0; lane < threads.size(); ++lane)
+    {
+        drawList->AddText({origin.x, laneTop}, ImGui::GetColorU32(ImGuiCol_Text), profiler.GetThreadName(threads[lane]).c_str());
+
+        const ImU32 color = threads[lane] == Profiler::gpuThread ? IM_COL32(200, 120, 60, 255) : IM_COL32(70, 130, 200, 255);
+        for (const Profiler::Event& event : frame.events)
+        {
+            if (event.thread != threads[lane])
+                continue;
+
+            const ImVec2 min = {origin.x + labelsWidth + (float)((event.start - start) * scale), laneTop + event.depth * laneHeight};
+            const ImVec2 max = {std::max(origin.x + labelsWidth + (float)((event.end - start) * scale), min.x + 1.0f),
+                                min.y + laneHeight - 1.0f};
+            drawList->AddRectFilled(min, max, color);
+            drawList->AddRect(min, max, IM_COL32(0, 0, 0, 255));
+
+            // the names are shown by the scopes wide enough for them
+            const ImVec2 textSize = ImGui::CalcTextSize(event.name);
+            if (textSize.x + 4.0f < max.x - min.x)
+                drawList->AddText({min.x + 2.0f, min.y + 1.0f}, IM_COL32(255, 255, 255, 255), event.name);
+
+            if (isHovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.start) / 1e6);
+        }
+
+        laneTop += lanesDepths[lane] * laneHeight;
+    }
+
+    drawList->PopClipRect();
+}
+
+void DrawTable(const Profiler& profiler)
+{
+    const std::vector<Profiler::ScopeStats> stats = profiler.Summarize(summaryFramesCount);
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp;
+    if (!ImGui::BeginTable("Scopes", 5, flags))
+        return;
+
+    ImGui::TableSetupColumn("Thread");
+    ImGui::TableSetupColumn("Scope");
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableSetupColumn("Average, ms");
+    ImGui::TableSetupColumn("Max, ms");
+    ImGui::TableHeadersRow();
+
+    for (const Profiler::ScopeStats& scope : stats)
+    {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(profiler.GetThreadName(scope.thread).c_str());
+        ImGui::TableNextColumn();
+        ImGui::Indent(scope.depth * 10.0f + 1.0f);
+        ImGui::TextUnformatted(scope.name);
+        ImGui::Unindent(scope.depth * 10.0f + 1.0f);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", scope.calls);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", scope.averageMilliseconds);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", scope.maxMilliseconds);
+    }
+
+    ImGui::EndTable();
+}
+}  // namespace
+
+void ProfilerWindow::Draw(Profiler& profiler, bool* isOpen)
+{
+    if (!ImGui::Begin("Profiler", isOpen))
+    {
+        ImGui::End();
+        return;
+    }
+
+    bool isEnabled = profiler.IsEnabled();
+    if (ImGui::Checkbox("Enabled", &isEnabled))
+        profiler.SetEnabled(isEnabled);
+
+    // the traces are written to the working directory
+    ImGui::SameLine();
+    if (ImGui::Button("Export trace"))
+        Export("profile.json", [&](const char* path) { profiler.ExportChromeTrace(path); });
+    ImGui::SameLine();
+    if (ImGui::Button("Export CSV"))
+        Export("profile.csv", [&](const char* path) { profiler.ExportCSV(path); });
+    ImGui::SameLine();
+    ImGui::Text("Dropped events: %llu", (unsigned long long)profiler.GetDroppedEventsCount());
+    if (!exportStatus.empty())
+        ImGui::TextUnformatted(exportStatus.c_str());
+
+    // the GPU passes of the last frames are not read back yet
+    const std::deque<Profiler::Frame>& frames = profiler.GetFrames();
+    auto frame = std::find_if(frames.rbegin(), frames.rend(), [](const Profiler::Frame& frame) { return frame.hasGpuEvents; });
+    if (frame == frames.rend() && !frames.empty())
+        frame = frames.rbegin();
+
+    if (frame != frames.rend())
+    {
+        DrawTimeline(profiler, *frame);
+        DrawTable(profiler);
+    }
+    else
+    {
+        ImGui::Text("No frames recorded");
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <utils/Profiler.h>
+
+// The timeline of the last frame with the GPU passes and the table of the scopes averaged over the
+// last frames. The profiler is drawn by the thread calling its EndFrame.
+namespace ProfilerWindow
+{
+void Draw(Profiler& profiler, bool* isOpen);
+}
@@ -3,14 +3,28 @@
 #include "SceneManager.h"
 
 #include <shaders/Common.h>
+#include <utils/D3D12Timestamps.h>
 #include <utils/RenderTargetManager.h>
 
 #include <filesystem>
 #include <iostream>
+#include <limits>
 #include <random>
 
 constexpr auto pi = 3.14159265f;
 
+// the ring keeps the constants of all the frames in flight
+constexpr std::size_t frameConstantsSize = 4 * 1024 * 1024;
+
+// the shader visible heap is never reallocated, a geometry takes a pair of views
+constexpr std::size_t descriptorsCount = 4096;
+
+// InstanceID() indexes the instance params, it has 24 bits only
+constexpr std::size_t maxInstancesCount = 1 << 24;
+
+// the timed passes of a frame, the UI ones included
+constexpr uint32_t maxGpuZones = 16;
+
 SceneManager::SceneManager(std::shared_ptr<DeviceResources> deviceResources,
                            UINT                             screenWidth,
                            UINT                             screenHeight,
@@ -19,14 +33,23 @@ SceneManager::SceneManager(std::shared_ptr<DeviceResources> deviceResources,
     : _deviceResources(deviceResources)
     , _rtManager(rtManager)
     , _meshManager(_deviceResources->GetDevice())
-    , _descriptorHeap(_deviceResources->GetDevice(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 512)
-    , _cmdList(CommandListType::Direct, _deviceResources->GetDevice())
-    , _depthPassCmdList(CommandListType::Direct, _deviceResources->GetDevice())
+    , _descriptorHeap(_deviceResources->GetDevice(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, descriptorsCount)
+    , _asyncBuilds(_deviceResources->GetDevice())
+    , _frameConstants(_deviceResources->GetDevice(), _deviceResources->GetFrameFence(),
+                      _deviceResources->GetFramesCount() * frameConstantsSize)
+    , _gpuProfiler(Profiler::Get(),
+                   std::make_unique<D3D12Timestamps>(_deviceResources->GetDevice(), _deviceResources->GetCommandQueue(),
+                                                     (uint32_t)_deviceResources->GetFramesCount() * maxGpuZones * 2),
+                   _deviceResources->GetFramesCount(), maxGpuZones)
 {
     assert(rtManager);
 
-    _cmdList.Close();
-    _depthPassCmdList.Close();
+    // frames in flight are recorded to their own lists, so the allocators are reset after the GPU is done with them
+    for (std::size_t frame = 0; frame < _deviceResources->GetFramesCount(); ++frame)
+    {
+        _cmdLists.emplace_back(CommandListType::Direct, _deviceResources->GetDevice()).Close();
+        _depthPassCmdLists.emplace_back(CommandListType::Direct, _deviceResources->GetDevice()).Close();
+    }
 
     SetThreadDescription(GetCurrentThread(), L"Main thread");
 
@@ -34,37 +57,55 @@ SceneManager::SceneManager(std::shared_ptr<DeviceResources> deviceResources,
     UpdateWindowSize(screenWidth, screenHeight);
     CreateRootSignatures();
     CreateRaytracingPSO();
+    CreateReconstructionPSO();
 
-    CreateRayGenMissTables();
+    CreateShaderTables();
 }
 
 SceneManager::~SceneManager()
 {
+    _asyncBuilds.Flush();
     _deviceResources->WaitForCurrentFrame();
 }
 
 void SceneManager::DrawScene()
 {
-    CheckObjectsState();
+    PROFILE_SCOPE("SceneManager::DrawScene");
+
+    {
+        PROFILE_SCOPE("Wait for the frame");
+        _deviceResources->BeginFrame();
+    }
+    _gpuProfiler.BeginFrame(_deviceResources->GetFrameIndex());
+    _descriptorHeap.BeginFrame(_deviceResources->GetCurrentFrameFenceValue(),
+                               _deviceResources->GetFrameFence()->GetCompletedValue());
 
     std::vector<ID3D12CommandList*> cmdListArray;
     cmdListArray.reserve(16); // just to avoid any allocations
     UpdateObjects();
 
     PopulateDepthPassCommandList();
-    cmdListArray.push_back(_depthPassCmdList.GetInternal().Get());
+    cmdListArray.push_back(_depthPassCmdLists[_deviceResources->GetFrameIndex()].GetInternal().Get());
 
     PopulateCommandList();
-    cmdListArray.push_back(_cmdList.GetInternal().Get());
+    cmdListArray.push_back(_cmdLists[_deviceResources->GetFrameIndex()].GetInternal().Get());
 
-    _deviceResources->GetCommandQueue()->ExecuteCommandLists(1, cmdListArray.data());
+    // new meshes may still be uploading, the frame waits for them on the GPU only
+    if (!_asyncBuilds.IsCompleted(_geometryBuildValue))
+        _asyncBuilds.InsertWait(_deviceResources->GetCommandQueue().Get(), _geometryBuildValue);
+
+    _deviceResources->GetCommandQueue()->ExecuteCommandLists((UINT)cmdListArray.size(), cmdListArray.data());
 }
 
 void SceneManager::Present()
 {
+    PROFILE_SCOPE("SceneManager::Present");
+
     // Swap buffers
     _deviceResources->GetSwapChain()->Present(0, 0);
-    _deviceResources->WaitForCurrentFrame();
+    _deviceResources->EndFrame();
+
+    _frameConstants.FinishFrame(_deviceResources->GetLastSignaledFenceValue());
 }
 
 void SceneManager::ExecuteCommandList(const CommandList& commandList)
@@ -74,6 +115,22 @@ void SceneManager::ExecuteCommandList(const CommandList& commandList)
     _deviceResources->WaitForCurrentFrame();
 }
 
+void SceneManager::SubmitCommandList(const CommandList& commandList)
+{
+    std::array<ID3D12CommandList*, 1> cmdListsArray = {commandList.GetInternal().Get()};
+    _deviceResources->GetCommandQueue()->ExecuteCommandLists((UINT)cmdListsArray.size(), cmdListsArray.data());
+}
+
+GpuProfiler& SceneManager::GetGpuProfiler()
+{
+    return _gpuProfiler;
+}
+
+void SceneManager::SubmitBuild(const CommandList& commandList)
+{
+    _geometryBuildValue = _asyncBuilds.Execute(commandList);
+}
+
 void SceneManager::SetLightColor(float r, float g, float b)
 {
     _lightColors[0] = r;
@@ -95,6 +152,48 @@ void SceneManager::SetAmbientColor(float r, float g, float b)
     _ambientColor[2] = b;
 }
 
+void SceneManager::SetAmbientOcclusion(float radius, float maxSamples)
+{
+    _aoRadius = radius;
+    _rayBudget.SetMaxSamples(maxSamples);
+}
+
+void SceneManager::SetFrameTimeTarget(float milliseconds)
+{
+    _rayBudget.SetTarget(milliseconds);
+}
+
+const RayBudget& SceneManager::GetRayBudget() const
+{
+    return _rayBudget;
+}
+
+void SceneManager::SetCheckerboard(bool isEnabled)
+{
+    _sampling = isEnabled ? SAMPLING_CHECKERBOARD : SAMPLING_FULL;
+}
+
+bool SceneManager::IsCheckerboard() const
+{
+    return _sampling == SAMPLING_CHECKERBOARD;
+}
+
+void SceneManager::SetWaterCulling(float minWeight, float farDistance)
+{
+    _waterMinWeight   = std::clamp(minWeight, 0.0f, 1.0f);
+    _waterFarDistance = std::max(farDistance, 0.0f);
+}
+
+uint32_t SceneManager::GetSkippedWaterRays() const
+{
+    return _skippedWaterRays;
+}
+
+bool SceneManager::IsTlasRebuilt() const
+{
+    return _isTlasRebuilt;
+}
+
 void SceneManager::UpdateWindowSize(UINT screenWidth, UINT screenHeight)
 {
     if (_screenHeight == screenHeight && _screenWidth == screenWidth)
@@ -120,29 +219,47 @@ void SceneManager::CreateRenderTargets()
     dxrOutputDesc.Flags               = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
     dxrOutputDesc.SampleDesc.Count    = 1;
 
+    // the distances need more than 8 bits, the half floats keep them within 0.05%
+    D3D12_RESOURCE_DESC gbufferDesc = dxrOutputDesc;
+    gbufferDesc.Format              = DXGI_FORMAT_R16G16B16A16_FLOAT;
+
     D3D12_HEAP_PROPERTIES heapProps = {};
     heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
 
-    ThrowIfFailed(_deviceResources->GetDevice()->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
-        &dxrOutputDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr,
-        IID_PPV_ARGS(&_raytracingOutput)));
-
-    FreeAddress<D3D12_CPU_DESCRIPTOR_HANDLE> heapHandle = {};
-    if (_dispatchUavIdx == ~0ULL)
-    {
-        heapHandle = _descriptorHeap.GetFreeCPUAddress();
-        _dispatchUavIdx = heapHandle.index;
-    }
-    else
+    for (std::size_t i = 0; i < _raytracingOutputs.size(); ++i)
     {
-        heapHandle.index = _dispatchUavIdx;
-        heapHandle.handle = _descriptorHeap.GetCPUAddress(_dispatchUavIdx);
+        ThrowIfFailed(_deviceResources->GetDevice()->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
+            &dxrOutputDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr,
+            IID_PPV_ARGS(&_raytracingOutputs[i])));
+        ThrowIfFailed(_deviceResources->GetDevice()->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
+            &gbufferDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr,
+            IID_PPV_ARGS(&_gbuffers[i])));
     }
 
+    // the views are recreated in new descriptors, the old ones are freed after the frames using them
+    if (_dispatchUavIdx != ~0ULL)
+        _descriptorHeap.Free(_dispatchUavIdx, 8);
+
+    auto heapHandle = _descriptorHeap.GetFreeCPUAddress(8);
+    _dispatchUavIdx = heapHandle.index;
+
     D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-    uavDesc.Format        = DXGI_FORMAT_R8G8B8A8_UNORM;
     uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-    _deviceResources->GetDevice()->CreateUnorderedAccessView(_raytracingOutput.Get(), nullptr, &uavDesc, heapHandle.handle);
+    for (std::size_t i = 0; i < _raytracingOutputs.size(); ++i)
+    {
+        // the output and the gbuffer of the frame, then the history ones
+        for (std::size_t j = 0; j < 2; ++j)
+        {
+            const std::size_t index = _dispatchUavIdx + i * 4 + j * 2;
+            const std::size_t pair  = (i + j) % 2;
+
+            uavDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            _deviceResources->GetDevice()->CreateUnorderedAccessView(_raytracingOutputs[pair].Get(), nullptr, &uavDesc, _descriptorHeap.GetCPUAddress(index));
+            uavDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+            _deviceResources->GetDevice()->CreateUnorderedAccessView(_gbuffers[pair].Get(), nullptr, &uavDesc, _descriptorHeap.GetCPUAddress(index + 1));
+        }
+    }
+    _historyValid = false;
 
     _shadowDepth = _rtManager->CreateDepthStencil(_screenWidth, _screenHeight, DXGI_FORMAT_R24G8_TYPELESS,
                                                   DXGI_FORMAT_D24_UNORM_S8_UINT, L"DepthStencil");
@@ -154,67 +271,118 @@ void SceneManager::CreateRenderTargets()
         dsDesc.Texture2D.MipLevels             = 1;
         dsDesc.Texture2D.MostDetailedMip       = 0;
 
+        if (_shadowDepthSrvIdx != ~0ULL)
+            _descriptorHeap.Free(_shadowDepthSrvIdx);
+
         auto address = _descriptorHeap.GetFreeCPUAddress();
+        _shadowDepthSrvIdx = address.index;
         _deviceResources->GetDevice()->CreateShaderResourceView(_shadowDepth->_texture.Get(), &dsDesc, address.handle);
     }
 }
 
-void SceneManager::CreateRayGenMissTables()
+void SceneManager::CreateShaderTables()
 {
-    _raygenTable = std::make_unique<ShaderTable>(1, 0, _deviceResources->GetDevice());
-    _missTable   = std::make_unique<ShaderTable>(1, 0, _deviceResources->GetDevice());
+    const std::size_t framesCount = _deviceResources->GetFramesCount();
+    _raygenTable = std::make_unique<ShaderTable>(0, framesCount, _deviceResources->GetDevice());
+    _missTable   = std::make_unique<ShaderTable>(0, framesCount, _deviceResources->GetDevice());
+    _hitTable    = std::make_unique<ShaderTable>(0, framesCount, _deviceResources->GetDevice());
 
-    ComPtr<ID3D12StateObjectProperties> props;
-    ThrowIfFailed(_raytracingState->QueryInterface(props.GetAddressOf()));
+    _raygenTable->AddEntry(ShaderEntry{GetShaderIdentifier(L"RayGenShader")});
+    _missTable->AddEntry(ShaderEntry{GetShaderIdentifier(L"MissShader")});
 
-    _raygenTable->AddEntry(0, ShaderEntry{props->GetShaderIdentifier(L"RayGenShader")});
-    _missTable->AddEntry(0, ShaderEntry{props->GetShaderIdentifier(L"MissShader")});
+    // single geometry objects share these records, so adding them doesn't change the hit table
+    for (MaterialType material : {MaterialType::Diffuse, MaterialType::Specular, MaterialType::Water})
+        AddHitGroupRun({material});
 }
 
-void SceneManager::CreateHitTable()
+void* SceneManager::GetShaderIdentifier(const std::wstring& exportName)
 {
-    constexpr uint32_t lrsBindingsCount = 2;
-
-    _hitTable = std::make_unique<ShaderTable>(_sceneObjects.size(), lrsBindingsCount * sizeof(D3D12_GPU_VIRTUAL_ADDRESS),
-                                              _deviceResources->GetDevice());
-
-    ComPtr<ID3D12StateObjectProperties> props;
-    ThrowIfFailed(_raytracingState->QueryInterface(props.GetAddressOf()));
-
-    // fill shader tables with scene objects data
-    for (std::size_t i = 0; i < _sceneObjects.size(); i++)
+    auto [it, inserted] = _shaderIdentifiers.try_emplace(exportName, nullptr);
+    if (inserted)
     {
-        auto& object = _sceneObjects[i];
-
-        std::vector<uint64_t> data;
-        data.reserve(lrsBindingsCount);
+        it->second = _raytracingProps->GetShaderIdentifier(exportName.c_str());
+        assert(it->second);
+    }
 
-        auto buffersHandle = _descriptorHeap.GetGPUAddress(object->GetDescriptorIdx());
-        data.push_back(object->GetConstantBuffer()->GetGPUVirtualAddress());
-        data.push_back(buffersHandle.ptr);
+    return it->second;
+}
 
-        void* shaderIdentifier = nullptr;
-        switch (object->GetMaterial().GetType())
+std::size_t SceneManager::AddHitGroupRun(const std::vector<MaterialType>& materials)
+{
+    // the geometry index selects the record in the run, so the objects with the same
+    // materials sequence share it, only new sequences (merged objects) are appended
+    auto [it, inserted] = _hitGroupRuns.try_emplace(materials, 0);
+    if (!inserted)
+        return it->second;
+
+    std::vector<ShaderEntry> entries;
+    entries.reserve(materials.size());
+    for (MaterialType material : materials)
+    {
+        switch (material)
         {
         case MaterialType::Diffuse:
-            shaderIdentifier = props->GetShaderIdentifier(L"DiffuseHitGroup");
+            entries.push_back(ShaderEntry{GetShaderIdentifier(L"DiffuseHitGroup")});
             break;
         case MaterialType::Specular:
-            shaderIdentifier = props->GetShaderIdentifier(L"SpecularHitGroup");
+            entries.push_back(ShaderEntry{GetShaderIdentifier(L"SpecularHitGroup")});
             break;
         case MaterialType::Water:
-            shaderIdentifier = props->GetShaderIdentifier(L"WaterHitGroup");
+            entries.push_back(ShaderEntry{GetShaderIdentifier(L"WaterHitGroup")});
             break;
         }
+    }
 
-        _hitTable->AddEntry(i, ShaderEntry{shaderIdentifier, data.data(), data.size() * sizeof(D3D12_GPU_VIRTUAL_ADDRESS)});
+    it->second = _hitTable->AddEntries(entries);
+    return it->second;
+}
+
+void SceneManager::AddToTables(SceneObject& object)
+{
+    const std::size_t geometriesCount = object.GetGeometriesCount();
+    if (_geometryParamsCount + geometriesCount > _geometryParamsCapacity)
+        ReserveGeometryParams(std::max(_geometryParamsCount + geometriesCount, _geometryParamsCapacity * 2));
+
+    // the appended entries are not read by the frames in flight, so they are written in place
+    std::vector<MaterialType> materials;
+    materials.reserve(geometriesCount);
+    for (std::size_t geometry = 0; geometry < geometriesCount; ++geometry)
+    {
+        _geometryParamsData[_geometryParamsCount + geometry] = object.GetGeometryParams(geometry);
+        materials.push_back(object.GetMaterial(geometry).GetType());
     }
+
+    object.SetTablesOffsets(_geometryParamsCount, AddHitGroupRun(materials));
+    _geometryParamsCount += geometriesCount;
+}
+
+void SceneManager::ReserveGeometryParams(std::size_t geometriesCount)
+{
+    ComPtr<ID3D12Resource> buffer = nullptr;
+    GeometryParams*        data   = nullptr;
+    CreateConstantBuffer(sizeof(GeometryParams) * geometriesCount, &buffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+    ThrowIfFailed(buffer->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+
+    if (_geometryParamsCount)
+        memcpy(data, _geometryParamsData, sizeof(GeometryParams) * _geometryParamsCount);
+
+    // frames in flight still read the previous table
+    if (_geometryParams)
+        _deviceResources->ReleaseAfterFrame(std::make_shared<ComPtr<ID3D12Resource>>(std::move(_geometryParams)));
+
+    _geometryParams         = buffer;
+    _geometryParamsData     = data;
+    _geometryParamsCapacity = geometriesCount;
 }
 
 void SceneManager::PopulateDepthPassCommandList()
 {
-    _depthPassCmdList.Reset();
-    ComPtr<ID3D12GraphicsCommandList> pCmdList = _depthPassCmdList.GetInternal();
+    PROFILE_SCOPE("SceneManager::PopulateDepthPassCommandList");
+
+    CommandList& depthPassCmdList = _depthPassCmdLists[_deviceResources->GetFrameIndex()];
+    depthPassCmdList.Reset();
+    ComPtr<ID3D12GraphicsCommandList> pCmdList = depthPassCmdList.GetInternal();
+    PROFILE_GPU_SCOPE(_gpuProfiler, pCmdList.Get(), "Depth pass");
 
     pCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -230,82 +398,150 @@ void SceneManager::PopulateDepthPassCommandList()
         pCmdList->ResourceBarrier(1, &transition);
     }
 
-    _rtManager->ClearDepthStencil(*_shadowDepth, _depthPassCmdList);
+    _rtManager->ClearDepthStencil(*_shadowDepth, depthPassCmdList);
     RenderTarget* rts[8] = {};
-    _rtManager->BindRenderTargets(rts, _shadowDepth.get(), _depthPassCmdList);
+    _rtManager->BindRenderTargets(rts, _shadowDepth.get(), depthPassCmdList);
 
     pCmdList->SetGraphicsRootSignature(_depthRootSignature.GetInternal().Get());
     pCmdList->SetGraphicsRootConstantBufferView(1, _cbvDepthFrameParams->GetGPUVirtualAddress());
 
+    // instanced objects are ray traced only
     for (size_t i = 0; i < _sceneObjects.size(); ++i)
     {
-        pCmdList->SetGraphicsRootConstantBufferView(0, _sceneObjects[i]->GetConstantBuffer()->GetGPUVirtualAddress());
+        const ModelParams modelParams = {_sceneObjects[i]->GetWorldMatrix()};
+        pCmdList->SetGraphicsRootConstantBufferView(0, _frameConstants.Push(modelParams));
         _sceneObjects[i]->Draw(pCmdList);
     }
 
-    _depthPassCmdList->Close();
+    // the next frame expects it to be readable again
+    {
+        auto transition = CD3DX12_RESOURCE_BARRIER::Transition(
+            _shadowDepth->_texture.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        pCmdList->ResourceBarrier(1, &transition);
+    }
+
+    depthPassCmdList->Close();
 }
 
 void SceneManager::PopulateCommandList()
 {
-    ComPtr<ID3D12StateObjectProperties> props;
-    ThrowIfFailed(_raytracingState->QueryInterface(props.GetAddressOf()));
+    PROFILE_SCOPE("SceneManager::PopulateCommandList");
+
+    // the tables of the frame receive the records changed since the frame was recorded last time
+    const std::size_t frame = _deviceResources->GetFrameIndex();
+
+    // a checkerboard launch traces one pixel of a horizontal pair
+    const bool isCheckerboard = _sampling == SAMPLING_CHECKERBOARD;
 
     D3D12_DISPATCH_RAYS_DESC desc = {};
     desc.Height = _screenHeight;
-    desc.Width = _screenWidth;
+    desc.Width = isCheckerboard ? (_screenWidth + 1) / 2 : _screenWidth;
     desc.Depth = 1;
 
-    desc.RayGenerationShaderRecord.StartAddress = _raygenTable->GetResource()->GetGPUVirtualAddress();
+    desc.RayGenerationShaderRecord.StartAddress = _raygenTable->Commit(frame);
     desc.RayGenerationShaderRecord.SizeInBytes  = _raygenTable->GetSize();
 
-    desc.MissShaderTable.StartAddress  = _missTable->GetResource()->GetGPUVirtualAddress();
+    desc.MissShaderTable.StartAddress  = _missTable->Commit(frame);
     desc.MissShaderTable.SizeInBytes   = _missTable->GetSize();
     desc.MissShaderTable.StrideInBytes = _missTable->GetStride();
 
-    desc.HitGroupTable.StartAddress  = _hitTable->GetResource()->GetGPUVirtualAddress();
+    desc.HitGroupTable.StartAddress  = _hitTable->Commit(frame);
     desc.HitGroupTable.SizeInBytes   = _hitTable->GetSize();
     desc.HitGroupTable.StrideInBytes = _hitTable->GetStride();
 
-    _cmdList.Reset();
-    _cmdList->SetPipelineState1(_raytracingState.Get());
+    CommandList& cmdList = _cmdLists[_deviceResources->GetFrameIndex()];
+    cmdList.Reset();
+
+    // the slot of the frame was written frames count frames ago, the slots are read in the order of the
+    // frames, so the difference of the totals is the count of a single frame (the wrap-around included)
+    {
+        const D3D12_RANGE range = {sizeof(uint32_t) * frame, sizeof(uint32_t) * (frame + 1)};
+        uint32_t*         data  = nullptr;
+        ThrowIfFailed(_rayCountersReadback->Map(0, &range, reinterpret_cast<void**>(&data)));
+        const uint32_t skippedRays = data[frame];
+        const D3D12_RANGE written  = {0, 0};
+        _rayCountersReadback->Unmap(0, &written);
+
+        _skippedWaterRays      = skippedRays - _skippedWaterRaysTotal;
+        _skippedWaterRaysTotal = skippedRays;
+    }
+
+    cmdList->SetPipelineState1(_raytracingState.Get());
 
     ID3D12DescriptorHeap* heaps[] = { _descriptorHeap.GetResource().Get()};
-    _cmdList->SetDescriptorHeaps(1, heaps);
-    _cmdList->SetComputeRootSignature(_globalRootSignature.GetInternal().Get());
-    _cmdList->SetComputeRootDescriptorTable(0, _descriptorHeap.GetGPUAddress(_dispatchUavIdx));
-    _cmdList->SetComputeRootDescriptorTable(1, _descriptorHeap.GetGPUAddress(_tlasIdx));
-    _cmdList->SetComputeRootConstantBufferView(2, _viewParams->GetGPUVirtualAddress());
-    _cmdList->SetComputeRootConstantBufferView(3, _lightParams->GetGPUVirtualAddress());
-    _cmdList->DispatchRays(&desc);
+    cmdList->SetDescriptorHeaps(1, heaps);
+    cmdList->SetComputeRootSignature(_globalRootSignature.GetInternal().Get());
+    const D3D12_GPU_DESCRIPTOR_HANDLE outputTable = _descriptorHeap.GetGPUAddress(_dispatchUavIdx + _outputIndex * 4);
+    cmdList->SetComputeRootDescriptorTable(0, outputTable);
+    // the back buffer is not rebuilt till the frame is finished
+    TLASBuffer& tlas     = _tlasBuffers[_tlasFront];
+    tlas.frameFenceValue = _deviceResources->GetCurrentFrameFenceValue();
+    cmdList->SetComputeRootDescriptorTable(1, _descriptorHeap.GetGPUAddress(tlas.descriptorIdx));
+    cmdList->SetComputeRootConstantBufferView(2, _viewParams);
+    cmdList->SetComputeRootConstantBufferView(3, _lightParams);
+    cmdList->SetComputeRootShaderResourceView(4, tlas.instanceParams ? tlas.instanceParams->GetGPUVirtualAddress() : 0);
+    cmdList->SetComputeRootShaderResourceView(5, _geometryParams ? _geometryParams->GetGPUVirtualAddress() : 0);
+    // the unbounded ranges start at the beginning of the heap, the geometry params keep absolute indices
+    cmdList->SetComputeRootDescriptorTable(6, _descriptorHeap.GetGPUAddress(0));
+    cmdList->SetComputeRootUnorderedAccessView(7, _rayCounters->GetGPUVirtualAddress());
+    {
+        PROFILE_GPU_SCOPE(_gpuProfiler, cmdList.GetInternal().Get(), "Ray tracing");
+        cmdList->DispatchRays(&desc);
+    }
+
+    ID3D12Resource* output = _raytracingOutputs[_outputIndex].Get();
+    if (isCheckerboard)
+    {
+        PROFILE_GPU_SCOPE(_gpuProfiler, cmdList.GetInternal().Get(), "Reconstruction");
+
+        // the traced pixels are read by the reconstruction
+        std::array<CD3DX12_RESOURCE_BARRIER, 2> barriers = {CD3DX12_RESOURCE_BARRIER::UAV(output),
+                                                            CD3DX12_RESOURCE_BARRIER::UAV(_gbuffers[_outputIndex].Get())};
+        cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+        cmdList->SetPipelineState(_reconstructionState.GetPSO().Get());
+        cmdList->SetComputeRootSignature(_reconstructionRootSignature.GetInternal().Get());
+        cmdList->SetComputeRootDescriptorTable(0, outputTable);
+        cmdList->SetComputeRootConstantBufferView(1, _reconstructionParams);
+        cmdList->Dispatch((_screenWidth + 7) / 8, (_screenHeight + 7) / 8, 1);
+    }
 
     size_t frameIndex = _deviceResources->GetSwapChain()->GetCurrentBackBufferIndex();
     {
         auto transition = CD3DX12_RESOURCE_BARRIER::Transition(_deviceResources->GetSwapChainRts()[frameIndex]->_texture.Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-        _cmdList->ResourceBarrier(1, &transition);
+        cmdList->ResourceBarrier(1, &transition);
     }
 
     auto rtBuffer = _deviceResources->GetSwapChainRts()[frameIndex].get();
-    _rtManager->ClearRenderTarget(*rtBuffer, _cmdList);
+    _rtManager->ClearRenderTarget(*rtBuffer, cmdList);
 
     {
-        std::vector< CD3DX12_RESOURCE_BARRIER> transitions(2);
+        std::vector< CD3DX12_RESOURCE_BARRIER> transitions(3);
         transitions[0] = CD3DX12_RESOURCE_BARRIER::Transition(_deviceResources->GetSwapChainRts()[frameIndex]->_texture.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_DEST);
-        transitions[1] = CD3DX12_RESOURCE_BARRIER::Transition(_raytracingOutput.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-        _cmdList->ResourceBarrier(transitions.size(), transitions.data());
+        transitions[1] = CD3DX12_RESOURCE_BARRIER::Transition(output, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        transitions[2] = CD3DX12_RESOURCE_BARRIER::Transition(_rayCounters.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        cmdList->ResourceBarrier(transitions.size(), transitions.data());
     }
 
-    _cmdList->CopyResource(rtBuffer->_texture.Get(), _raytracingOutput.Get());
+    {
+        PROFILE_GPU_SCOPE(_gpuProfiler, cmdList.GetInternal().Get(), "Copy to back buffer");
+        cmdList->CopyResource(rtBuffer->_texture.Get(), output);
+        cmdList->CopyBufferRegion(_rayCountersReadback.Get(), sizeof(uint32_t) * frame, _rayCounters.Get(), 0, sizeof(uint32_t));
+    }
 
     // Indicate that the back buffer will be used as a render target.
     {
-        std::vector< CD3DX12_RESOURCE_BARRIER> transitions(2);
+        std::vector< CD3DX12_RESOURCE_BARRIER> transitions(3);
         transitions[0] = CD3DX12_RESOURCE_BARRIER::Transition(_deviceResources->GetSwapChainRts()[frameIndex]->_texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET);
-        transitions[1] = CD3DX12_RESOURCE_BARRIER::Transition(_raytracingOutput.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        _cmdList->ResourceBarrier(transitions.size(), transitions.data());
+        transitions[1] = CD3DX12_RESOURCE_BARRIER::Transition(output, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        transitions[2] = CD3DX12_RESOURCE_BARRIER::Transition(_rayCounters.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        cmdList->ResourceBarrier(transitions.size(), transitions.data());
     }
 
-    _cmdList->Close();
+    cmdList->Close();
+
+    // the next frame reprojects this one
+    _historyValid = true;
 }
 
 void SceneManager::CreateConstantBuffer(size_t bufferSize, ComPtr<ID3D12Resource>* pOutBuffer, D3D12_RESOURCE_STATES initialState)
@@ -433,7 +669,7 @@ void SceneManager::CreateRaytracingPSO()
     }
 
     D3D12_RAYTRACING_SHADER_CONFIG descShaderConfig = {};
-    descShaderConfig.MaxPayloadSizeInBytes = sizeof(float) * 4; // TODO(DB): is it enough?
+    descShaderConfig.MaxPayloadSizeInBytes = sizeof(float) * 7; // the color, the distance and the normal
     descShaderConfig.MaxAttributeSizeInBytes = D3D12_RAYTRACING_MAX_ATTRIBUTE_SIZE_IN_BYTES;
     {
         D3D12_STATE_SUBOBJECT shaderSubobject = {};
@@ -451,21 +687,22 @@ void SceneManager::CreateRaytracingPSO()
         subobjects.emplace_back(globalRootSignature);
     }
 
-    D3D12_LOCAL_ROOT_SIGNATURE lrsDesc = {};
-    lrsDesc.pLocalRootSignature = _localRootSignature.GetInternal().Get();
-    {
-        D3D12_STATE_SUBOBJECT localRootSignature = {};
-        localRootSignature.Type  = D3D12_STATE_SUBOBJECT_TYPE_LOCAL_ROOT_SIGNATURE;
-        localRootSignature.pDesc = &lrsDesc;
-        subobjects.emplace_back(localRootSignature);
-    }
-
     D3D12_STATE_OBJECT_DESC pDesc = {};
     pDesc.Type = D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE;
     pDesc.NumSubobjects = subobjects.size();
     pDesc.pSubobjects = subobjects.data();
 
     ThrowIfFailed(_deviceResources->GetDevice()->CreateStateObject(&pDesc, IID_PPV_ARGS(&_raytracingState)));
+    ThrowIfFailed(_raytracingState->QueryInterface(_raytracingProps.GetAddressOf()));
+}
+
+void SceneManager::CreateReconstructionPSO()
+{
+    std::vector<char> bytes = readBytecode("Reconstruction.cso");
+
+    _reconstructionState.SetRootSignature(_reconstructionRootSignature);
+    _reconstructionState.SetShaderCode(bytes.data(), bytes.size());
+    _reconstructionState.Finalize(_deviceResources->GetDevice());
 }
 
 void SceneManager::CreateDepthPassPSO()
@@ -478,15 +715,21 @@ void SceneManager::CreateDepthPassPSO()
 
 void SceneManager::CreateRootSignatures()
 {
-    _globalRootSignature.Init(4, 0);
-    _globalRootSignature[0].InitAsDescriptorsTable(1); // Output UAV
-    _globalRootSignature[0].InitTableRange(0, 0, 1, D3D12_DESCRIPTOR_RANGE_TYPE_UAV);
+    _globalRootSignature.Init(8, 0);
+    _globalRootSignature[0].InitAsDescriptorsTable(1); // output and gbuffer UAVs
+    _globalRootSignature[0].InitTableRange(0, 0, 2, D3D12_DESCRIPTOR_RANGE_TYPE_UAV);
 
     _globalRootSignature[1].InitAsDescriptorsTable(1); // TLAS
     _globalRootSignature[1].InitTableRange(0, 0, 1, D3D12_DESCRIPTOR_RANGE_TYPE_SRV);
 
     _globalRootSignature[2].InitAsCBV(0);
     _globalRootSignature[3].InitAsCBV(1);
+    _globalRootSignature[4].InitAsSRV(3); // instance params
+    _globalRootSignature[5].InitAsSRV(4); // geometry params
+    _globalRootSignature[6].InitAsDescriptorsTable(2); // bindless VB/IB views
+    _globalRootSignature[6].InitTableRange(0, 0, UINT_MAX, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+    _globalRootSignature[6].InitTableRange(1, 0, UINT_MAX, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0);
+    _globalRootSignature[7].InitAsUAV(2); // ray counters
     _globalRootSignature.Finalize(_deviceResources->GetDevice());
 
     _depthRootSignature.Init(2, 0);
@@ -494,38 +737,59 @@ void SceneManager::CreateRootSignatures()
     _depthRootSignature[1].InitAsCBV(1);
     _depthRootSignature.Finalize(_deviceResources->GetDevice(), D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
-    _localRootSignature.Init(2, 0);
-    _localRootSignature[0].InitAsCBV(2);
-    _localRootSignature[1].InitAsDescriptorsTable(1); // VB/IB views
-    _localRootSignature[1].InitTableRange(0, 1, 2, D3D12_DESCRIPTOR_RANGE_TYPE_SRV);
-    _localRootSignature.Finalize(_deviceResources->GetDevice(), D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE);
+    _reconstructionRootSignature.Init(2, 0);
+    _reconstructionRootSignature[0].InitAsDescriptorsTable(1); // output, gbuffer and their history
+    _reconstructionRootSignature[0].InitTableRange(0, 0, 4, D3D12_DESCRIPTOR_RANGE_TYPE_UAV);
+    _reconstructionRootSignature[1].InitAsCBV(0);
+    _reconstructionRootSignature.Finalize(_deviceResources->GetDevice());
 }
 
 void SceneManager::CreateFrameResources()
 {
-    CreateConstantBuffer(sizeof(ViewParams), &_viewParams, D3D12_RESOURCE_STATE_GENERIC_READ);
     CreateConstantBuffer(sizeof(ViewParams), &_cbvDepthFrameParams, D3D12_RESOURCE_STATE_GENERIC_READ);
-    CreateConstantBuffer(sizeof(LightParams), &_lightParams, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    // the counters are never cleared, every frame copies them to its own readback slot
+    CreateUAVBuffer(sizeof(uint32_t), &_rayCounters, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    _rayCounters->SetName(L"Ray counters");
+
+    D3D12_RESOURCE_DESC readbackDesc = _rayCounters->GetDesc();
+    readbackDesc.Width               = sizeof(uint32_t) * _deviceResources->GetFramesCount();
+    readbackDesc.Flags               = D3D12_RESOURCE_FLAG_NONE;
+
+    D3D12_HEAP_PROPERTIES heapProp = {D3D12_HEAP_TYPE_READBACK};
+    ThrowIfFailed(_deviceResources->GetDevice()->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &readbackDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&_rayCountersReadback)));
 }
 
 std::shared_ptr<SceneObject> SceneManager::CreateObject(std::shared_ptr<MeshObject> meshObject, Material material)
 {
-    _isObjectsChanged = true;
+    return CreateObject(meshObject, std::vector<Material>(meshObject->GeometriesCount(), material));
+}
+
+std::shared_ptr<SceneObject> SceneManager::CreateObject(std::shared_ptr<MeshObject> meshObject,
+                                                        std::vector<Material>       materials)
+{
+    // the mesh was just submitted, it is compacted once its build is finished
+    if (meshObject->CanCompact())
+        _pendingCompactions.push_back({_geometryBuildValue, meshObject});
 
-    return _sceneObjects.emplace_back(
+    SceneObjectPtr& object = _sceneObjects.emplace_back(
         std::make_shared<SceneObject>(
             meshObject,
             _descriptorHeap,
             _deviceResources->GetDevice(),
-            material
+            std::move(materials)
             )
     );
+
+    AddToTables(*object);
+    return object;
 }
 
 std::shared_ptr<SceneObject> SceneManager::CreateEmptyCube()
 {
     return CreateObject(
-        _meshManager.CreateEmptyCube([this](CommandList& cmdList) { ExecuteCommandList(cmdList); }),
+        _meshManager.CreateEmptyCube([this](CommandList& cmdList) { SubmitBuild(cmdList); }),
         Material{MaterialType::Diffuse}
     );
 }
@@ -533,14 +797,14 @@ std::shared_ptr<SceneObject> SceneManager::CreateEmptyCube()
 std::shared_ptr<SceneObject> SceneManager::CreateCube()
 {
     return CreateObject(
-        _meshManager.CreateCube([this](CommandList& cmdList) { ExecuteCommandList(cmdList); }),
+        _meshManager.CreateCube([this](CommandList& cmdList) { SubmitBuild(cmdList); }),
         Material(MaterialType::Specular)
     );
 }
 
 std::shared_ptr<SceneObject> SceneManager::CreateAxis()
 {
-    return CreateObject(_meshManager.CreateAxes([this](CommandList& cmdList) { ExecuteCommandList(cmdList); }),
+    return CreateObject(_meshManager.CreateAxes([this](CommandList& cmdList) { SubmitBuild(cmdList); }),
                         Material{MaterialType::Diffuse});
 }
 
@@ -548,14 +812,169 @@ std::shared_ptr<SceneObject> SceneManager::CreateCustomObject(const std::vector<
                                                               const std::vector<uint32_t>&       indices,
                                                               Material                           material)
 {
-    return CreateObject(
-        _meshManager.CreateCustomObject(
-            vertices,
-            indices,
-            [this](CommandList& cmdList) { ExecuteCommandList(cmdList); }
-        ),
-        material
+    std::shared_ptr<MeshObject> meshObject = _meshManager.CreateCustomObject(
+        vertices,
+        indices,
+        [this](CommandList& cmdList) { SubmitBuild(cmdList); }
+    );
+
+    const std::array<BVH::Mesh::Geometry, 1> geometries = {BVH::Mesh::Geometry{vertices, indices}};
+    AddCpuMesh(*meshObject, geometries);
+
+    return CreateObject(meshObject, material);
+}
+
+SceneManager::SceneObjects SceneManager::CreateCustomObjects(std::span<const CustomObjectDesc> objects)
+{
+    std::vector<MeshBatch::MeshDesc> meshes;
+    meshes.reserve(objects.size());
+    for (const CustomObjectDesc& object : objects)
+    {
+        std::span<const uint8_t> vertexData{(const uint8_t*)object.vertices.data(), object.vertices.size_bytes()};
+        meshes.push_back({vertexData, sizeof(GeometryVertex), object.indices});
+    }
+
+    MeshManager::MeshObjects meshObjects = _meshManager.CreateCustomObjects(
+        meshes,
+        [this](CommandList& cmdList) { SubmitBuild(cmdList); }
     );
+
+    SceneObjects output;
+    output.reserve(objects.size());
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        const std::array<BVH::Mesh::Geometry, 1> geometries = {BVH::Mesh::Geometry{objects[i].vertices, objects[i].indices}};
+        AddCpuMesh(*meshObjects[i], geometries);
+
+        output.push_back(CreateObject(meshObjects[i], objects[i].material));
+    }
+
+    return output;
+}
+
+SceneManager::SceneObjects SceneManager::CreateMergedObjects(std::span<const CustomObjectDesc> objects,
+                                                             std::size_t                       maxGeometriesPerObject)
+{
+    PROFILE_SCOPE("SceneManager::CreateMergedObjects");
+
+    // merged objects are not positioned, the vertices are moved to the world space instead
+    std::vector<std::vector<GeometryVertex>> vertices(objects.size());
+    std::vector<std::array<float, 3>>        centers(objects.size());
+
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        const CustomObjectDesc& object = objects[i];
+
+        XMVECTOR minBound = XMVectorReplicate(std::numeric_limits<float>::max());
+        XMVECTOR maxBound = XMVectorReplicate(std::numeric_limits<float>::lowest());
+
+        vertices[i].assign(object.vertices.begin(), object.vertices.end());
+        for (GeometryVertex& vertex : vertices[i])
+        {
+            const XMVECTOR position = XMVectorAdd(XMLoadFloat3(&vertex.position), XMLoadFloat3(&object.position));
+            XMStoreFloat3(&vertex.position, position);
+
+            minBound = XMVectorMin(minBound, position);
+            maxBound = XMVectorMax(maxBound, position);
+        }
+
+        XMFLOAT3 center;
+        XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(minBound, maxBound), 0.5f));
+        centers[i] = {center.x, center.y, center.z};
+    }
+
+    const std::vector<uint32_t> groups = MeshBatch::GroupByLocality(centers, maxGeometriesPerObject);
+
+    std::vector<MeshBatch::MeshDesc> meshes;
+    meshes.reserve(objects.size());
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        std::span<const uint8_t> vertexData{(const uint8_t*)vertices[i].data(), vertices[i].size() * sizeof(GeometryVertex)};
+        meshes.push_back({vertexData, sizeof(GeometryVertex), objects[i].indices});
+    }
+
+    MeshManager::MeshObjects meshObjects = _meshManager.CreateMergedObjects(
+        meshes,
+        groups,
+        [this](CommandList& cmdList) { SubmitBuild(cmdList); }
+    );
+
+    // geometries of a merged mesh keep the order of the objects, so do their materials
+    std::vector<std::vector<Material>>            materials(meshObjects.size());
+    std::vector<std::vector<BVH::Mesh::Geometry>> geometries(meshObjects.size());
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        materials[groups[i]].push_back(objects[i].material);
+        geometries[groups[i]].push_back({vertices[i], objects[i].indices});
+    }
+
+    SceneObjects output;
+    output.reserve(meshObjects.size());
+    for (std::size_t i = 0; i < meshObjects.size(); ++i)
+    {
+        AddCpuMesh(*meshObjects[i], geometries[i]);
+        output.push_back(CreateObject(meshObjects[i], std::move(materials[i])));
+    }
+
+    return output;
+}
+
+std::shared_ptr<MeshObject> SceneManager::CreateMesh(std::span<const GeometryVertex> vertices,
+                                                     std::span<const uint32_t>       indices)
+{
+    std::span<const uint8_t> vertexData{(const uint8_t*)vertices.data(), vertices.size_bytes()};
+    const std::array<MeshBatch::MeshDesc, 1> meshes = {MeshBatch::MeshDesc{vertexData, sizeof(GeometryVertex), indices}};
+
+    std::shared_ptr<MeshObject> output = _meshManager.CreateCustomObjects(
+        meshes,
+        [this](CommandList& cmdList) { SubmitBuild(cmdList); }
+    ).front();
+
+    // the mesh was just submitted, it is compacted once its build is finished
+    if (output->CanCompact())
+        _pendingCompactions.push_back({_geometryBuildValue, output});
+
+    const std::array<BVH::Mesh::Geometry, 1> geometries = {BVH::Mesh::Geometry{vertices, indices}};
+    AddCpuMesh(*output, geometries);
+
+    return output;
+}
+
+SceneManager::InstancedObjectPtr SceneManager::CreateInstancedObject(std::shared_ptr<MeshObject> meshObject,
+                                                                     Material                    material,
+                                                                     std::span<const XMMATRIX>   transforms,
+                                                                     std::span<const XMFLOAT3>   tints /*= {}*/)
+{
+    InstancedObjectPtr& object = _instancedObjects.emplace_back(
+        std::make_shared<InstancedObject>(
+            meshObject,
+            _descriptorHeap,
+            _deviceResources->GetDevice(),
+            material,
+            transforms,
+            tints
+            )
+    );
+
+    AddToTables(object->GetPrototype());
+    return object;
+}
+
+std::shared_ptr<const BVH::Scene> SceneManager::GetCpuScene() const
+{
+    std::lock_guard lock(_cpuSceneMutex);
+    return _cpuScene;
+}
+
+void SceneManager::AddCpuMesh(const MeshObject& meshObject, std::span<const BVH::Mesh::Geometry> geometries)
+{
+    _cpuMeshes[&meshObject] = std::make_shared<BVH::Mesh>(geometries);
+}
+
+std::shared_ptr<const BVH::Mesh> SceneManager::GetCpuMesh(const MeshObject& meshObject) const
+{
+    auto it = _cpuMeshes.find(&meshObject);
+    return it != _cpuMeshes.end() ? it->second : nullptr;
 }
 
 std::shared_ptr<Graphics::SphericalCamera> SceneManager::CreateSphericalCamera()
@@ -588,117 +1007,365 @@ std::shared_ptr<Graphics::WASDCamera> SceneManager::CreateWASDCamera()
 
 void SceneManager::UpdateObjects()
 {
-    void* sceneData = nullptr;
-
-    ThrowIfFailed(_viewParams->Map(0, nullptr, &sceneData));
-
-    DirectX::XMFLOAT3 camPos = _mainCamera ? _mainCamera->GetPosition() : XMFLOAT3{};
-    DirectX::XMVECTOR m      = {camPos.x, camPos.y, camPos.z, 1.0f};
-
-    DirectX::XMMATRIX viewProjMat = _mainCamera ? _mainCamera->GetViewProjMatrix() : XMMatrixIdentity();
+    PROFILE_SCOPE("SceneManager::UpdateObjects");
 
-    ((ViewParams*)sceneData)->viewPos         = m;
-    ((ViewParams*)sceneData)->inverseViewProj = DirectX::XMMatrixInverse(nullptr, viewProjMat);
-    ((ViewParams*)sceneData)->ambientColor    = DirectX::XMVECTOR({ _ambientColor[0], _ambientColor[1], _ambientColor[2], 1.0 });
+    const DirectX::XMFLOAT3 camPos      = _mainCamera ? _mainCamera->GetPosition() : XMFLOAT3{};
+    const DirectX::XMMATRIX viewProjMat = _mainCamera ? _mainCamera->GetViewProjMatrix() : XMMatrixIdentity();
 
-    ThrowIfFailed(_lightParams->Map(0, nullptr, &sceneData));
-
-    ((LightParams*)sceneData)->direction = DirectX::XMVECTOR({ _lightDir[0], _lightDir[1], _lightDir[2], 1.0});
-    ((LightParams*)sceneData)->color     = DirectX::XMVECTOR({_lightColors[0], _lightColors[1], _lightColors[2], 1.0});
+    // the samples cost GPU time, so they are scaled by the GPU time of the frame read back by the
+    // profiler; the frame period hides it behind the vsync and the CPU work, it is taken only until
+    // the first frame is read back
+    const auto now = std::chrono::high_resolution_clock::now();
+    if (_frameIndex > 0)
+    {
+        const std::optional<double> gpuMilliseconds = _gpuProfiler.GetFrameMilliseconds();
+        _rayBudget.Update(gpuMilliseconds ? (float)*gpuMilliseconds : std::chrono::duration<float, std::milli>(now - _frameStart).count());
+    }
+    _frameStart = now;
+
+    ViewParams viewParams;
+    viewParams.viewPos          = DirectX::XMVECTOR({camPos.x, camPos.y, camPos.z, 1.0f});
+    viewParams.inverseViewProj  = DirectX::XMMatrixInverse(nullptr, viewProjMat);
+    viewParams.ambientColor     = DirectX::XMVECTOR({_ambientColor[0], _ambientColor[1], _ambientColor[2], 1.0});
+    viewParams.aoRadius         = _aoRadius;
+    viewParams.aoSamples        = _rayBudget.GetSamples();
+    viewParams.frameIndex       = _frameIndex++;
+    viewParams.sampling         = _sampling;
+    viewParams.waterMinWeight   = _waterMinWeight;
+    viewParams.waterFarDistance = _waterFarDistance;
+    _viewParams                 = _frameConstants.Push(viewParams);
+
+    // the pairs alternate, the traced half of the checkerboard too
+    _outputIndex = viewParams.frameIndex & 1;
+
+    ReconstructionParams reconstructionParams;
+    reconstructionParams.inverseViewProj         = viewParams.inverseViewProj;
+    reconstructionParams.previousViewProj        = _previousViewProj;
+    reconstructionParams.previousInverseViewProj = DirectX::XMMatrixInverse(nullptr, _previousViewProj);
+    reconstructionParams.viewPos                 = viewParams.viewPos;
+    reconstructionParams.previousViewPos         = _previousViewPos;
+    reconstructionParams.width                   = _screenWidth;
+    reconstructionParams.height                  = _screenHeight;
+    reconstructionParams.frameIndex              = viewParams.frameIndex;
+    reconstructionParams.historyValid            = _historyValid ? 1 : 0;
+    _reconstructionParams                        = _frameConstants.Push(reconstructionParams);
+
+    _previousViewProj = viewProjMat;
+    _previousViewPos  = viewParams.viewPos;
+
+    LightParams lightParams;
+    lightParams.direction = DirectX::XMVECTOR({_lightDir[0], _lightDir[1], _lightDir[2], 1.0});
+    lightParams.color     = DirectX::XMVECTOR({_lightColors[0], _lightColors[1], _lightColors[2], 1.0});
+    _lightParams          = _frameConstants.Push(lightParams);
+
+    // swaps in the TLAS if its build is finished and releases the memory of finished BLAS builds
+    _asyncBuilds.Poll();
+    CompactBLASes();
 
     bool anyDirty = std::ranges::any_of(_sceneObjects.cbegin(), _sceneObjects.cend(),
         [](const SceneObjectPtr& object) { return object->IsDirty(); });
+    anyDirty |= std::ranges::any_of(_instancedObjects.cbegin(), _instancedObjects.cend(),
+        [](const InstancedObjectPtr& object) { return object->IsDirty(); });
 
-    if (anyDirty)
+    _isTlasRebuilt = (anyDirty || _isBlasesMoved) && BuildTLAS();
+    if (_isTlasRebuilt)
     {
-        BuildTLAS();
         std::ranges::for_each(_sceneObjects, [](SceneObjectPtr& object) { object->ResetDirty(); });
+        std::ranges::for_each(_instancedObjects, [](InstancedObjectPtr& object) { object->ResetDirty(); });
+        _isBlasesMoved = false;
     }
 }
 
-void SceneManager::CheckObjectsState()
+void SceneManager::CompactBLASes()
 {
-    if (!_isObjectsChanged)
+    PROFILE_SCOPE("SceneManager::CompactBLASes");
+
+    // the original structures are referenced by the front TLAS till the rebuilt one is swapped in,
+    // and by the frames in flight which still use the previous structure after that
+    for (RetiredBLAS& retired : _retiredBlases)
+    {
+        if (retired.tlasBuildValue != 0 && retired.tlasBuildValue <= _tlasFrontValue)
+            _deviceResources->ReleaseAfterFrame(std::move(retired.allocation));
+    }
+    std::erase_if(_retiredBlases, [](const RetiredBLAS& retired) { return !retired.allocation; });
+
+    std::unique_ptr<CommandList> cmdList;
+    std::size_t                  buildSize      = 0;
+    std::size_t                  compactedSize  = 0;
+    std::size_t                  compactedCount = 0;
+
+    auto it = _pendingCompactions.begin();
+    while (it != _pendingCompactions.end() && _asyncBuilds.IsCompleted(it->buildValue))
+    {
+        MeshObject& mesh = *it->mesh;
+        if (mesh.CanCompact())
+        {
+            if (!cmdList)
+                cmdList = _asyncBuilds.AcquireCommandList();
+
+            const std::size_t meshBuildSize = mesh.BLASSize();
+            if (auto original = mesh.CompactBLAS(*cmdList, *_meshManager.GetGeometryHeaps().accelerationStructures))
+            {
+                _retiredBlases.push_back({original, 0});
+                buildSize += meshBuildSize;
+                compactedSize += mesh.BLASSize();
+                compactedCount++;
+            }
+        }
+
+        ++it;
+    }
+    _pendingCompactions.erase(_pendingCompactions.begin(), it);
+
+    if (!cmdList)
         return;
 
-    CreateHitTable();
-    _isObjectsChanged = false;
+    cmdList->Close();
+    _asyncBuilds.Execute(std::move(cmdList));
+
+    // instances have to point to the compacted structures
+    _isBlasesMoved |= compactedCount > 0;
+
+    _blasBuildSize += buildSize;
+    _blasCompactedSize += compactedSize;
+
+    if (compactedCount > 0)
+    {
+        std::cout << "Compacted " << compactedCount << " BLASes: " << buildSize / 1024 << " KB -> "
+                  << compactedSize / 1024 << " KB, total saved " << (_blasBuildSize - _blasCompactedSize) / 1024
+                  << " KB of " << _blasBuildSize / 1024 << " KB" << std::endl;
+    }
 }
 
-void SceneManager::BuildTLAS()
+bool SceneManager::BuildTLAS()
 {
-    CommandList cmdList{CommandListType::Direct, _deviceResources->GetDevice() };
+    PROFILE_SCOPE("SceneManager::BuildTLAS");
 
-    size_t objectsCount = _sceneObjects.size();
+    // instances and scratch buffers are shared by the builds, so only one of them may be in flight,
+    // the objects stay dirty and the build is retried next frame
+    if (!_asyncBuilds.IsCompleted(_tlasBuildValue))
+        return false;
 
-    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC tlasDesc = {};
-    auto& inputs = tlasDesc.Inputs;
-    inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
-    inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-    inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE; // TODO (DB): check what flags we have and how we could use it
-    inputs.NumDescs = objectsCount;
-    inputs.pGeometryDescs = nullptr;
+    // the back structure and its params are overwritten only after the frames which used them as the front
+    // ones are finished, the build is retried next frame instead of waiting for them
+    if (!_deviceResources->IsFenceValueCompleted(_tlasBuffers[1 - _tlasFront].frameFenceValue))
+        return false;
 
-    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
-    _deviceResources->GetDevice()->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
-    if (prebuildInfo.ResultDataMaxSizeInBytes == 0)
-        throw std::runtime_error("Zeroed size");
+    std::size_t instancedCount = 0;
+    for (const InstancedObjectPtr& object : _instancedObjects)
+        instancedCount += object->GetInstancesCount();
+
+    const std::size_t objectsCount   = _sceneObjects.size();
+    const std::size_t instancesCount = objectsCount + instancedCount;
+    if (instancesCount == 0)
+        return true;
 
-    ComPtr<ID3D12Resource> scratchResource;
-    CreateUAVBuffer(prebuildInfo.ScratchDataSizeInBytes, &scratchResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    CreateUAVBuffer(prebuildInfo.ResultDataMaxSizeInBytes, &_tlas, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
-    _tlas->SetName(L"Top-Level Acceleration Structure");
+    if (instancesCount > maxInstancesCount)
+        throw std::runtime_error("Too many instances");
 
-    std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instancesDesc;
-    instancesDesc.reserve(objectsCount);
-    for (std::size_t idx = 0; idx < _sceneObjects.size(); idx++)
+    // the structure is refitted when only transforms are changed, any change of the instances set
+    // (or of the BLASes they point to) requires a full rebuild
+    bool rebuild = _tlasBlases.size() != instancesCount || !_tlasReady;
+    _tlasBlases.resize(instancesCount);
+
+    std::size_t instanceIdx = 0;
+    for (const SceneObjectPtr& object : _sceneObjects)
     {
-        instancesDesc.emplace_back();
+        const D3D12_GPU_VIRTUAL_ADDRESS blasAddress = object->GetMeshObject().BLASAddress();
+        rebuild |= _tlasBlases[instanceIdx] != blasAddress;
+        _tlasBlases[instanceIdx++] = blasAddress;
+    }
 
-        D3D12_RAYTRACING_INSTANCE_DESC& instanceDesc     = instancesDesc.back();
-        instanceDesc.AccelerationStructure               = _sceneObjects[idx]->GetMeshObject().BLAS()->GetGPUVirtualAddress();
-        instanceDesc.InstanceContributionToHitGroupIndex = idx;
-        instanceDesc.InstanceMask                        = 1;
+    for (const InstancedObjectPtr& object : _instancedObjects)
+    {
+        const D3D12_GPU_VIRTUAL_ADDRESS blasAddress = object->GetPrototype().GetMeshObject().BLASAddress();
+        for (std::size_t i = 0; i < object->GetInstancesCount(); ++i)
+        {
+            rebuild |= _tlasBlases[instanceIdx] != blasAddress;
+            _tlasBlases[instanceIdx++] = blasAddress;
+        }
+    }
 
-        for (int i = 0; i < 3; ++i)
-            memcpy(instanceDesc.Transform[i], &(_sceneObjects[idx]->GetWorldMatrix().r[i]), sizeof(float) * 4);
+    if (instancesCount > _tlasCapacity)
+        ReserveTLASInputs(std::max(instancesCount, _tlasCapacity * 2));
+
+    // frames keep rendering the front structure, the new one is built into the back one
+    const std::size_t backIdx = 1 - _tlasFront;
+    TLASBuffer&       back    = _tlasBuffers[backIdx];
+
+    // the previous buffers are not used by the frames any more, but they are kept till the end of the build
+    TLASBuffer retired;
+    if (back.capacity < instancesCount)
+    {
+        retired = back;
+        CreateTLASBuffer(back, std::max(instancesCount, back.capacity * 2));
     }
 
-    ComPtr<ID3D12Resource> instances;
-    size_t instancesBufferSize = sizeof(decltype(instancesDesc)::value_type) * instancesDesc.size();
-    CreateConstantBuffer(instancesBufferSize, &instances, D3D12_RESOURCE_STATE_GENERIC_READ);
-    void* instancesPtr = nullptr;
-    instances->Map(0, nullptr, &instancesPtr);
-    memcpy(instancesPtr, instancesDesc.data(), instancesBufferSize);
-    instances->Unmap(0, nullptr);
+    // the CPU scene mirrors the back structure, the previous back scene is reused unless a query still holds it
+    if (!_cpuSceneBack || _cpuSceneBack.use_count() > 1)
+        _cpuSceneBack = _cpuScene ? std::make_shared<BVH::Scene>(*_cpuScene) : std::make_shared<BVH::Scene>();
+    _cpuSceneBack->Resize(instancesCount);
 
+    // no build is in flight, so the instances are written in place, the params of the back
+    // structure are not read by the frames, so they are written in place as well
+    instanceIdx = 0;
+    for (const SceneObjectPtr& object : _sceneObjects)
     {
-        tlasDesc.Inputs.InstanceDescs             = instances->GetGPUVirtualAddress();
-        tlasDesc.ScratchAccelerationStructureData = scratchResource->GetGPUVirtualAddress();
-        tlasDesc.DestAccelerationStructureData    = _tlas->GetGPUVirtualAddress();
+        const uint32_t                  mask             = object->GetInstanceMask();
+        D3D12_RAYTRACING_INSTANCE_DESC& instanceDesc     = _tlasInstancesData[instanceIdx];
+        instanceDesc                                     = {};
+        instanceDesc.InstanceID                          = (UINT)instanceIdx;
+        instanceDesc.AccelerationStructure               = _tlasBlases[instanceIdx];
+        instanceDesc.InstanceContributionToHitGroupIndex = (UINT)object->GetHitGroupOffset();
+        instanceDesc.InstanceMask                        = mask;
+
+        for (int i = 0; i < 3; ++i)
+            memcpy(instanceDesc.Transform[i], &(object->GetWorldMatrix().r[i]), sizeof(float) * 4);
+
+        // the instances data is write-combined memory, so the transform is not read back from it
+        XMFLOAT3X4 transform;
+        XMStoreFloat3x4(&transform, XMMatrixTranspose(object->GetWorldMatrix()));
+        _cpuSceneBack->SetInstance(instanceIdx, GetCpuMesh(object->GetMeshObject()), transform, mask);
+
+        back.instanceParamsData[instanceIdx] = {{1.0f, 1.0f, 1.0f}, (uint)object->GetGeometryOffset()};
+        instanceIdx++;
     }
 
-    cmdList->BuildRaytracingAccelerationStructure(&tlasDesc, 0, nullptr);
-    cmdList.Close();
+    // the instances of an object differ by the transform and the tint only
+    for (const InstancedObjectPtr& object : _instancedObjects)
+    {
+        const SceneObject&                     prototype  = object->GetPrototype();
+        const std::span<const XMFLOAT3X4>      transforms = object->GetTransforms();
+        const std::span<const InstanceParams>  params     = object->GetInstanceParams();
+        const std::shared_ptr<const BVH::Mesh> cpuMesh    = GetCpuMesh(prototype.GetMeshObject());
+        const uint32_t                         mask       = prototype.GetInstanceMask();
+        for (std::size_t i = 0; i < transforms.size(); ++i)
+        {
+            D3D12_RAYTRACING_INSTANCE_DESC& instanceDesc     = _tlasInstancesData[instanceIdx];
+            instanceDesc                                     = {};
+            instanceDesc.InstanceID                          = (UINT)instanceIdx;
+            instanceDesc.AccelerationStructure               = _tlasBlases[instanceIdx];
+            instanceDesc.InstanceContributionToHitGroupIndex = (UINT)prototype.GetHitGroupOffset();
+            instanceDesc.InstanceMask                        = mask;
+
+            memcpy(instanceDesc.Transform, &transforms[i], sizeof(instanceDesc.Transform));
+            _cpuSceneBack->SetInstance(instanceIdx, cpuMesh, transforms[i], mask);
+
+            back.instanceParamsData[instanceIdx] = {params[i].color, (uint)prototype.GetGeometryOffset()};
+            instanceIdx++;
+        }
+    }
 
-    ExecuteCommandList(cmdList);
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC tlasDesc = {};
+    auto& inputs = tlasDesc.Inputs;
+    inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+    inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+    inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+    inputs.NumDescs = (UINT)instancesCount;
+    inputs.InstanceDescs = _tlasInstances->GetGPUVirtualAddress();
 
-    D3D12_CPU_DESCRIPTOR_HANDLE heapHandle;
-    if (_tlasIdx == ~0ULL)
+    if (!rebuild)
     {
-        auto address = _descriptorHeap.GetFreeCPUAddress();
-        _tlasIdx = address.index;
-        heapHandle = address.handle;
+        inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+        tlasDesc.SourceAccelerationStructureData = _tlasBuffers[_tlasFront].resource->GetGPUVirtualAddress();
     }
-    else
+
+    tlasDesc.ScratchAccelerationStructureData = _tlasScratch->GetGPUVirtualAddress();
+    tlasDesc.DestAccelerationStructureData    = back.resource->GetGPUVirtualAddress();
+
+    std::unique_ptr<CommandList> cmdList = _asyncBuilds.AcquireCommandList();
+    (*cmdList)->BuildRaytracingAccelerationStructure(&tlasDesc, 0, nullptr);
+
+    D3D12_RESOURCE_BARRIER uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(back.resource.Get());
+    (*cmdList)->ResourceBarrier(1, &uavBarrier);
+    cmdList->Close();
+
+    // refitted like the TLAS when only the transforms are changed
+    _cpuSceneBack->Update();
+
+    _tlasBuildValue = _asyncBuilds.Execute(std::move(cmdList), [this, backIdx, retired]() {
+        // only one build is in flight, so it is the last one
+        _tlasFront      = backIdx;
+        _tlasReady      = true;
+        _tlasFrontValue = _tlasBuildValue;
+
+        // the queries see the instances the frames trace from now on
+        std::lock_guard lock(_cpuSceneMutex);
+        std::swap(_cpuScene, _cpuSceneBack);
+    });
+
+    // replaced BLASes are not referenced by the new structure
+    if (rebuild)
     {
-        heapHandle = _descriptorHeap.GetCPUAddress(_tlasIdx);
+        for (RetiredBLAS& retired : _retiredBlases)
+        {
+            if (retired.tlasBuildValue == 0)
+                retired.tlasBuildValue = _tlasBuildValue;
+        }
     }
 
+    // there is nothing to render before the very first structure is built
+    if (!_tlasReady)
+        _asyncBuilds.WaitForCompletion(_tlasBuildValue);
+
+    return true;
+}
+
+void SceneManager::ReserveTLASInputs(std::size_t instancesCount)
+{
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
+    inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+    inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+    inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+    inputs.NumDescs = (UINT)instancesCount;
+
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
+    _deviceResources->GetDevice()->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
+    if (prebuildInfo.ResultDataMaxSizeInBytes == 0)
+        throw std::runtime_error("Zeroed size");
+
+    // scratch and instances are used by the builds only, none of them is in flight here
+    const UINT64 scratchSize = std::max(prebuildInfo.ScratchDataSizeInBytes, prebuildInfo.UpdateScratchDataSizeInBytes);
+    CreateUAVBuffer(scratchSize, &_tlasScratch, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    CreateConstantBuffer(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instancesCount, &_tlasInstances,
+                         D3D12_RESOURCE_STATE_GENERIC_READ);
+    ThrowIfFailed(_tlasInstances->Map(0, nullptr, reinterpret_cast<void**>(&_tlasInstancesData)));
+
+    _tlasCapacity = instancesCount;
+}
+
+void SceneManager::CreateTLASBuffer(TLASBuffer& buffer, std::size_t instancesCount)
+{
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
+    inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+    inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+    inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+    inputs.NumDescs = (UINT)instancesCount;
+
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
+    _deviceResources->GetDevice()->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
+    if (prebuildInfo.ResultDataMaxSizeInBytes == 0)
+        throw std::runtime_error("Zeroed size");
+
+    CreateUAVBuffer(prebuildInfo.ResultDataMaxSizeInBytes, &buffer.resource, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+    buffer.resource->SetName(L"Top-Level Acceleration Structure");
+    buffer.capacity = instancesCount;
+
+    // it is bound as a root SRV, so no descriptor is needed
+    CreateConstantBuffer(sizeof(InstanceParams) * instancesCount, &buffer.instanceParams, D3D12_RESOURCE_STATE_GENERIC_READ);
+    ThrowIfFailed(buffer.instanceParams->Map(0, nullptr, reinterpret_cast<void**>(&buffer.instanceParamsData)));
+
+    if (buffer.descriptorIdx != ~0ULL)
+        _descriptorHeap.Free(buffer.descriptorIdx);
+
+    auto address         = _descriptorHeap.GetFreeCPUAddress();
+    buffer.descriptorIdx = address.index;
+
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
-    srvDesc.RaytracingAccelerationStructure.Location = _tlas->GetGPUVirtualAddress();
+    srvDesc.RaytracingAccelerationStructure.Location = buffer.resource->GetGPUVirtualAddress();
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
-    _deviceResources->GetDevice()->CreateShaderResourceView(nullptr, &srvDesc, heapHandle);
+    _deviceResources->GetDevice()->CreateShaderResourceView(nullptr, &srvDesc, address.handle);
 }
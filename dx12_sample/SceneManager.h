@@ -5,27 +5,47 @@
 #include "DeviceResources.h"
 #include "worldgen/WorldGen.h"
 
+#include <utils/AsyncBuildQueue.h>
+#include <utils/BVHScene.h>
 #include <utils/CommandList.h>
 #include <utils/ComputePipelineState.h>
 #include <utils/DescriptorHeap.h>
+#include <utils/GpuProfiler.h>
 #include <utils/GraphicsPipelineState.h>
+#include <utils/InstancedObject.h>
 #include <utils/MeshManager.h>
+#include <utils/RayBudget.h>
 #include <utils/RenderTargetManager.h>
 #include <utils/RootSignature.h>
 #include <utils/SceneObject.h>
 #include <utils/ShaderTable.h>
 #include <utils/SphericalCamera.h>
 #include <utils/Types.h>
+#include <utils/UploadRing.h>
 #include <utils/WASDCamera.h>
 
+#include <deque>
+#include <map>
+#include <unordered_map>
+
 class WorldGen;
 
+struct CustomObjectDesc
+{
+    std::span<const GeometryVertex> vertices;
+    std::span<const uint32_t>       indices;
+    Material                        material;
+    XMFLOAT3                        position = {0.0f, 0.0f, 0.0f};
+};
+
 class SceneManager
 {
 public:
     using SceneObjectPtr = std::shared_ptr<SceneObject>;
     using SceneObjects   = std::vector<SceneObjectPtr>;
 
+    using InstancedObjectPtr = std::shared_ptr<InstancedObject>;
+
     SceneManager(std::shared_ptr<DeviceResources> deviceResources,
                  UINT                             screenWidth,
                  UINT                             screenHeight,
@@ -41,12 +61,34 @@ public:
     void DrawScene();
     void Present();
 
-    // only for texture creation!
+    // only for texture creation! it waits for the GPU
     void ExecuteCommandList(const CommandList & commandList);
+    // executes a list recorded for the current frame (e.g. UI) without waiting
+    void SubmitCommandList(const CommandList& commandList);
+    // executes geometry uploads and BLAS builds on the async queue without waiting for them
+    void SubmitBuild(const CommandList& commandList);
+    // times the passes of the direct queue, the last list of a frame resolves them
+    GpuProfiler& GetGpuProfiler();
 
     void SetLightColor(float r, float g, float b);
     void SetLightDirection(float x, float y, float z);
     void SetAmbientColor(float r, float g, float b);
+    // the occlusion rays reach the radius, their count per pixel is scaled up to maxSamples while the
+    // frames are shorter than the target
+    void SetAmbientOcclusion(float radius, float maxSamples);
+    void SetFrameTimeTarget(float milliseconds);
+    const RayBudget& GetRayBudget() const;
+    // Traces half of the pixels in a checkerboard which alternates every frame, the others are
+    // reprojected from the previous frame or interpolated from the traced neighbours
+    void SetCheckerboard(bool isEnabled);
+    bool IsCheckerboard() const;
+    // The water rays weighing less than minWeight in the pixel color aren't traced, the reflections of
+    // the water farther than farDistance are shortened. Zeros trace all the rays to their whole length.
+    void SetWaterCulling(float minWeight, float farDistance);
+    // the water rays the culling skipped in a frame, it is read back a few frames later
+    uint32_t GetSkippedWaterRays() const;
+    // the last DrawScene started a TLAS build, the frame statistics tag such frames
+    bool IsTlasRebuilt() const;
 
     std::shared_ptr<SceneObject> CreateEmptyCube();
     std::shared_ptr<SceneObject> CreateCube();
@@ -54,6 +96,25 @@ public:
     std::shared_ptr<SceneObject> CreateCustomObject(const std::vector<GeometryVertex>& vertices,
                                                     const std::vector<uint32_t>&       indices,
                                                     Material                           material);
+    // creates all the objects with a single GPU round-trip
+    SceneObjects CreateCustomObjects(std::span<const CustomObjectDesc> objects);
+    // Packs static objects into a few multi-geometry objects (one BLAS and TLAS instance each) grouping
+    // neighbouring ones together. Every object keeps its material as a hit group record of its geometry.
+    SceneObjects CreateMergedObjects(std::span<const CustomObjectDesc> objects, std::size_t maxGeometriesPerObject);
+
+    // meshes to be placed with CreateInstancedObject, they are not rendered by themselves
+    std::shared_ptr<MeshObject> CreateMesh(std::span<const GeometryVertex> vertices, std::span<const uint32_t> indices);
+    // Places the mesh many times (flora, rocks), every transform becomes a TLAS instance pointing to the
+    // mesh BLAS. The instances share a single hit group record, the tints are passed through InstanceID().
+    InstancedObjectPtr CreateInstancedObject(std::shared_ptr<MeshObject> meshObject,
+                                             Material                    material,
+                                             std::span<const XMMATRIX>   transforms,
+                                             std::span<const XMFLOAT3>   tints = {});
+
+    // CPU mirror of the instances the frames trace, hits have the same instance ids as the TLAS ones.
+    // The snapshot is not changed while it is held, so queries may run on any thread. Only meshes
+    // created from the CPU data (custom, merged ones and the CreateMesh ones) are mirrored.
+    std::shared_ptr<const BVH::Scene> GetCpuScene() const;
 
     std::shared_ptr<Graphics::SphericalCamera> CreateSphericalCamera();
     std::shared_ptr<Graphics::WASDCamera>      CreateWASDCamera();
@@ -61,22 +122,47 @@ public:
     void UpdateWindowSize(UINT screenWidth, UINT screenHeight);
 
 private:
+    struct TLASBuffer
+    {
+        ComPtr<ID3D12Resource> resource      = nullptr;
+        std::size_t            capacity      = 0;
+        std::size_t            descriptorIdx = ~0ULL;
+
+        // params of every instance indexed by InstanceID(), they change along with the structure
+        ComPtr<ID3D12Resource> instanceParams     = nullptr;
+        InstanceParams*        instanceParamsData = nullptr;
+
+        uint64_t frameFenceValue = 0;  // of the last frame which used it as the front one
+    };
+
     void CreateRaytracingPSO();
+    void CreateReconstructionPSO();
     void CreateDepthPassPSO();
     void CreateRootSignatures();
     void CreateRenderTargets();
     void CreateFrameResources();
 
-    void CreateRayGenMissTables();
-    void CreateHitTable();
+    void  CreateShaderTables();
+    void* GetShaderIdentifier(const std::wstring& exportName);
+    // returns the first record of the materials run, the run is appended to the table if it is new
+    std::size_t AddHitGroupRun(const std::vector<MaterialType>& materials);
+    // places the object geometries and materials to the bindless tables
+    void AddToTables(SceneObject& object);
+    void ReserveGeometryParams(std::size_t geometriesCount);
 
     void PopulateDepthPassCommandList();
     void PopulateCommandList();
-    void BuildTLAS();
+    bool BuildTLAS();
+    void ReserveTLASInputs(std::size_t instancesCount);
+    void CreateTLASBuffer(TLASBuffer& buffer, std::size_t instancesCount);
 
     std::shared_ptr<SceneObject> CreateObject(std::shared_ptr<MeshObject> meshObject, Material material);
+    std::shared_ptr<SceneObject> CreateObject(std::shared_ptr<MeshObject> meshObject, std::vector<Material> materials);
     void                         UpdateObjects();
-    void                         CheckObjectsState();
+    void                         CompactBLASes();
+
+    void                             AddCpuMesh(const MeshObject& meshObject, std::span<const BVH::Mesh::Geometry> geometries);
+    std::shared_ptr<const BVH::Mesh> GetCpuMesh(const MeshObject& meshObject) const;
 
     // helper methods
     void CreateConstantBuffer(size_t bufferSize, ComPtr<ID3D12Resource>* pOutBuffer, D3D12_RESOURCE_STATES initialState);
@@ -85,36 +171,97 @@ private:
     // context objects
     std::shared_ptr<DeviceResources> _deviceResources;
 
-    // command-lists
-    CommandList _cmdList;
-    CommandList _depthPassCmdList;
+    // command-lists, one per frame in flight
+    std::vector<CommandList> _cmdLists;
+    std::vector<CommandList> _depthPassCmdLists;
 
     // pipeline states for every object
-    ComPtr<ID3D12StateObject> _raytracingState = nullptr;
-    ComPtr<ID3D12StateObject> _grapthicState   = nullptr;
+    ComPtr<ID3D12StateObject>           _raytracingState = nullptr;
+    ComPtr<ID3D12StateObjectProperties> _raytracingProps = nullptr;
+    ComPtr<ID3D12StateObject>           _grapthicState   = nullptr;
 
     // root signatures
     RootSignature _globalRootSignature;
     RootSignature _depthRootSignature;
-    RootSignature _localRootSignature;
+    RootSignature _reconstructionRootSignature;
+
+    ComputePipelineState _reconstructionState;
+
+    // shader tables, the hit table has a record per material of a run, the runs are shared by the objects
+    std::unique_ptr<ShaderTable>                     _raygenTable;
+    std::unique_ptr<ShaderTable>                     _missTable;
+    std::unique_ptr<ShaderTable>                     _hitTable;
+    std::map<std::vector<MaterialType>, std::size_t> _hitGroupRuns;
+    std::unordered_map<std::wstring, void*>          _shaderIdentifiers;  // by export name
 
-    // shader tables
-    std::unique_ptr<ShaderTable> _raygenTable;
-    std::unique_ptr<ShaderTable> _missTable;
-    std::unique_ptr<ShaderTable> _hitTable;
+    // bindless geometries, the params are appended as the objects are created, the views are in the heap
+    ComPtr<ID3D12Resource> _geometryParams         = nullptr;
+    GeometryParams*        _geometryParamsData     = nullptr;
+    std::size_t            _geometryParamsCount    = 0;
+    std::size_t            _geometryParamsCapacity = 0;
 
-    // output resources
-    DescriptorHeap         _descriptorHeap;
-    ComPtr<ID3D12Resource> _raytracingOutput = nullptr;
+    // output resources, the frames alternate between the pairs, the other one is the history
+    DescriptorHeap                        _descriptorHeap;
+    std::array<ComPtr<ID3D12Resource>, 2> _raytracingOutputs;
+    std::array<ComPtr<ID3D12Resource>, 2> _gbuffers;  // the normals and the hit distances of the camera rays
 
-    // renderer resources
+    // renderer resources, a table of four UAVs per output: its own pair and the history one
     std::size_t _dispatchUavIdx = ~0ULL;
-    std::size_t _tlasIdx        = ~0ULL;
+    std::size_t _shadowDepthSrvIdx = ~0ULL;
 
-    // frame resources
-    ComPtr<ID3D12Resource> _viewParams  = nullptr;
-    ComPtr<ID3D12Resource> _lightParams = nullptr;
-    ComPtr<ID3D12Resource> _tlas        = nullptr;
+    // frame resources, the constants are written to the ring every frame
+    UploadRing                _frameConstants;
+    D3D12_GPU_VIRTUAL_ADDRESS _viewParams  = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS _lightParams = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS _reconstructionParams = 0;
+
+    // the running total of the skipped water rays, a readback slot per frame in flight
+    ComPtr<ID3D12Resource> _rayCounters           = nullptr;
+    ComPtr<ID3D12Resource> _rayCountersReadback   = nullptr;
+    uint32_t               _skippedWaterRaysTotal = 0;
+    uint32_t               _skippedWaterRays      = 0;
+
+    // acceleration structures are built on the async compute queue, frames keep rendering
+    // the front TLAS till the back one is built, all the buffers are persistent and grow geometrically
+    AsyncBuildQueue                        _asyncBuilds;
+    std::array<TLASBuffer, 2>              _tlasBuffers;
+    std::size_t                            _tlasFront          = 0;
+    bool                                   _tlasReady          = false;  // the front one is built
+    uint64_t                               _tlasBuildValue     = 0;      // fence value of the last TLAS build
+    bool                                   _isTlasRebuilt      = false;  // by the last frame
+    uint64_t                               _tlasFrontValue     = 0;      // fence value of the front TLAS build
+    uint64_t                               _geometryBuildValue = 0;      // fence value of the last mesh upload
+    ComPtr<ID3D12Resource>                 _tlasScratch        = nullptr;
+    ComPtr<ID3D12Resource>                 _tlasInstances      = nullptr;
+    D3D12_RAYTRACING_INSTANCE_DESC*        _tlasInstancesData  = nullptr;
+    std::size_t                            _tlasCapacity       = 0;
+    std::vector<D3D12_GPU_VIRTUAL_ADDRESS> _tlasBlases;  // BLASes of the last build, to detect instances changes
+
+    // CPU counterparts of the BLASes and the TLAS, the back scene is filled along with the back
+    // structure and becomes the front one once the build is finished
+    std::unordered_map<const MeshObject*, std::shared_ptr<const BVH::Mesh>> _cpuMeshes;
+    std::shared_ptr<BVH::Scene>                                             _cpuScene;
+    std::shared_ptr<BVH::Scene>                                             _cpuSceneBack;
+    mutable std::mutex                                                      _cpuSceneMutex;
+
+    // BLASes are compacted once their builds are finished
+    struct PendingCompaction
+    {
+        uint64_t                    buildValue = 0;
+        std::shared_ptr<MeshObject> mesh;
+    };
+
+    struct RetiredBLAS
+    {
+        std::shared_ptr<GeometryAllocation> allocation;
+        uint64_t                            tlasBuildValue = 0;  // the first TLAS build which doesn't reference it
+    };
+
+    std::deque<PendingCompaction> _pendingCompactions;
+    std::vector<RetiredBLAS>      _retiredBlases;
+    std::size_t                   _blasBuildSize     = 0;
+    std::size_t                   _blasCompactedSize = 0;
+    bool                          _isBlasesMoved     = false;
 
     // shadows
     ComPtr<ID3D12Resource>        _depthMapTexture = nullptr;
@@ -123,18 +270,37 @@ private:
     void*                         _cbvDepth            = nullptr;
 
     // other objects
-    UINT                          _screenWidth  = 0;
-    UINT                          _screenHeight = 0;
-    RenderTargetManager*          _rtManager    = nullptr;
-    std::shared_ptr<RenderTarget> _HDRRt        = nullptr;
-    MeshManager                   _meshManager;
-    SceneObjects                  _sceneObjects;
+    UINT                            _screenWidth  = 0;
+    UINT                            _screenHeight = 0;
+    RenderTargetManager*            _rtManager    = nullptr;
+    std::shared_ptr<RenderTarget>   _HDRRt        = nullptr;
+    MeshManager                     _meshManager;
+    SceneObjects                    _sceneObjects;
+    std::vector<InstancedObjectPtr> _instancedObjects;
 
     std::shared_ptr<Graphics::AbstractCamera> _mainCamera;
 
+    GpuProfiler _gpuProfiler;
+
     float _lightColors[3];
     float _lightDir[3];
-    float _ambientColor[3];
 
-    bool _isObjectsChanged = false;
+    // shadows and ambient occlusion
+    RayBudget                                      _rayBudget{16.6f, 4.0f};
+    float                                          _aoRadius   = 2.0f;
+    uint32_t                                       _frameIndex = 0;
+    std::chrono::high_resolution_clock::time_point _frameStart;
+
+    // checkerboard rendering, the camera of the previous frame reprojects the history
+    uint32_t    _sampling     = SAMPLING_FULL;
+    std::size_t _outputIndex  = 0;
+    bool        _historyValid = false;
+    XMMATRIX    _previousViewProj = XMMatrixIdentity();
+    XMVECTOR    _previousViewPos  = XMVectorZero();
+
+    // importance culling of the water rays
+    float _waterMinWeight   = 0.0f;
+    float _waterFarDistance = 0.0f;
+
+    float _ambientColor[3];
 };
@@ -8,6 +8,37 @@
 #include <shellapi.h>
 #include <iostream>
 
+namespace
+{
+// the sample renders up to DXGI_MAX_SWAP_CHAIN_BUFFERS frames ahead
+constexpr uint32_t frameLatencyLimit = 16;
+
+bool ParseOptions(const std::vector<std::wstring>& arguments, CommandLineOptions& options)
+{
+    for (std::size_t i = 0; i < arguments.size(); ++i)
+    {
+        if (arguments[i] == L"--island")
+        {
+            options.island = true;
+        }
+        else if (arguments[i] == L"--frame-latency" && i + 1 < arguments.size())
+        {
+            const uint32_t latency = (uint32_t)std::wcstoul(arguments[++i].c_str(), nullptr, 10);
+            if (latency == 0 || latency > frameLatencyLimit)
+                return false;
+
+            options.maxFrameLatency = latency;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+}  // namespace
+
 #ifdef _DEBUG
 int main(int argc, char * argv[])
 #else // _DEBUG
@@ -23,36 +54,31 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
     wchar_t ** argv = CommandLineToArgvW(GetCommandLine(), &argc);
 #endif
 
-    const std::map<std::wstring, optTypes> argumentToString = {};
-
-    std::set<optTypes> arguments {};
+    std::vector<std::wstring> arguments;
     for (int i = 1; i < argc; ++i)
     {
 #ifdef _DEBUG
-        auto iter = argumentToString.find(std::wstring(argv[i], argv[i] + strlen(argv[i])));
+        arguments.emplace_back(argv[i], argv[i] + strlen(argv[i]));
 #else
-        auto iter = argumentToString.find(argv[i]);
+        arguments.emplace_back(argv[i]);
 #endif
-        if (iter != argumentToString.end())
-            arguments.insert(iter->second);
-        else
-        {
-            std::wcout << L"Usage: dxr_sample <opts>" << std::endl;
-            std::wcout << L"where <opts>:" << std::endl;
-            for (auto & pair : argumentToString)
-            {
-                std::wcout << L"\t" << pair.first << std::endl;
-            }
-
-            return -1;
-        }
+    }
+
+    CommandLineOptions options;
+    if (!ParseOptions(arguments, options))
+    {
+        std::wcout << L"Usage: dxr_sample <opts>" << std::endl;
+        std::wcout << L"where <opts>:" << std::endl;
+        std::wcout << L"\t--island               the generated island instead of the test scene" << std::endl;
+        std::wcout << L"\t--frame-latency <1-16> frames recorded ahead of the GPU, 2 by default" << std::endl;
+        return -1;
     }
 
     srand(time(nullptr));
 
     try
     {
-        DX12Sample app = {1280, 720, arguments};
+        DX12Sample app = {1280, 720, options};
         return app.Run(localInstance, SW_SHOW);
     }
     catch (const ComError& e)
@@ -0,0 +1,203 @@
+#include "IslandMesh.h"
+
+#include <utils/MeshOptimizer.h>
+#include <utils/MeshSimplifier.h>
+#include <utils/Profiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+constexpr float heightMultiplier = 0.5f;
+
+// geometric error which is allowed per unit of the distance to the camera, it is about
+// a pixel for the default field of view and HD resolution
+constexpr float maxScreenSpaceError = 1e-3f;
+
+void SimplifyTile(IslandTile& tile, std::size_t lodsCount, float maxError)
+{
+    PROFILE_SCOPE("SimplifyTile");
+
+    for (std::size_t level = 1; level < lodsCount; ++level)
+    {
+        const std::vector<uint32_t>& previous = tile.lods.back();
+
+        // every level is simplified from the previous one, so its error against the first level is
+        // bounded by the sum of the errors of the steps, the step gets the rest of the level budget
+        const float levelError = maxError * (float)(1 << (level - 1));
+        if (levelError <= tile.lodErrors.back())
+            break;
+
+        MeshSimplifier::Options options;
+        options.targetTrianglesCount = previous.size() / 3 / 4;
+        options.maxError             = levelError - tile.lodErrors.back();
+        options.lockBorder           = true;  // borders of the neighbour tiles must match on any level
+
+        MeshSimplifier::Result result = MeshSimplifier::Simplify(tile.vertices, previous, options);
+        if (result.indices.size() == previous.size())
+            break;
+
+        const float error = tile.lodErrors.back() + result.error;
+        tile.lods.emplace_back(MeshOptimizer::OptimizeVertexCache(result.indices, tile.vertices.size()));
+        tile.lodErrors.push_back(error);
+    }
+}
+}  // namespace
+
+IslandMesh::IslandMesh(const WorldGen&                   worldGenerator,
+                       const std::map<uint8_t, XMUINT3>& colorsLut,
+                       std::size_t                       tileSize /* = 128*/,
+                       float                             islandWidth /* = 100.0f*/)
+    : _worldGenerator(worldGenerator)
+    , _colorsLut(colorsLut)
+    , _tileSize(tileSize)
+    , _islandWidth(islandWidth)
+{
+    PROFILE_SCOPE("IslandMesh::IslandMesh");
+
+    const int islandSize = (int)_worldGenerator.GetSideSize() - 1;
+    for (int y = 0; y < islandSize; y += (int)_tileSize)
+    {
+        for (int x = 0; x < islandSize; x += (int)_tileSize)
+        {
+            _tiles.emplace_back(GenerateTile(x, y));
+        }
+    }
+}
+
+void IslandMesh::GenerateLods(std::size_t lodsCount, float maxError)
+{
+    PROFILE_SCOPE("IslandMesh::GenerateLods");
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    std::atomic<std::size_t> nextTile = 0;
+    std::vector<std::thread> workers(std::max(1u, std::thread::hardware_concurrency()));
+    for (auto& worker : workers)
+    {
+        worker = std::thread([&]() {
+            Profiler::Get().SetThreadName("LOD worker");
+            for (std::size_t i = nextTile++; i < _tiles.size(); i = nextTile++)
+                SimplifyTile(_tiles[i], lodsCount, maxError);
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+
+    std::vector<std::size_t> levelTriangles;
+    for (const auto& tile : _tiles)
+    {
+        for (std::size_t level = 0; level < tile.lods.size(); ++level)
+        {
+            if (levelTriangles.size() <= level)
+                levelTriangles.resize(level + 1, 0);
+            levelTriangles[level] += tile.lods[level].size() / 3;
+        }
+    }
+
+    std::cout << "Island LODs generated in " << elapsed.count() << " ms, triangles per level:";
+    for (std::size_t triangles : levelTriangles)
+        std::cout << " " << triangles;
+    std::cout << std::endl;
+}
+
+std::size_t IslandMesh::SelectLod(const IslandTile& tile, float distance) const
+{
+    for (std::size_t level = tile.lods.size() - 1; level > 0; --level)
+    {
+        if (tile.lodErrors[level] <= distance * maxScreenSpaceError)
+            return level;
+    }
+
+    return 0;
+}
+
+IslandTile IslandMesh::GenerateTile(int startX, int startY) const
+{
+    PROFILE_SCOPE("IslandMesh::GenerateTile");
+
+    const int islandSize = (int)_worldGenerator.GetSideSize() - 1;
+    const int endX       = std::min(startX + (int)_tileSize, islandSize);
+    const int endY       = std::min(startY + (int)_tileSize, islandSize);
+    const int rowSize    = endX - startX + 1;
+
+    IslandTile tile{startX, startY, GetPosition((startX + endX) / 2, (startY + endY) / 2)};
+    tile.vertices.reserve(rowSize * (endY - startY + 1));
+
+    for (int y = startY; y <= endY; y++)
+    {
+        for (int x = startX; x <= endX; x++)
+        {
+            const float3 position = GetPosition(x, y);
+
+            // normals are taken from the height map instead of the tile triangles, so they match on tile borders
+            const float3 left  = GetPosition(std::max(x - 1, 0), y);
+            const float3 right = GetPosition(std::min(x + 1, islandSize), y);
+            const float3 back  = GetPosition(x, std::max(y - 1, 0));
+            const float3 front = GetPosition(x, std::min(y + 1, islandSize));
+
+            XMVECTOR dx     = XMVectorSet(right.x - left.x, right.y - left.y, right.z - left.z, 0.0f);
+            XMVECTOR dy     = XMVectorSet(front.x - back.x, front.y - back.y, front.z - back.z, 0.0f);
+            float3   normal = {};
+            XMStoreFloat3(&normal, XMVector3Normalize(XMVector3Cross(dx, dy)));
+
+            const auto     colorX = _colorsLut.lower_bound(position.z / heightMultiplier)->second;
+            const XMFLOAT3 color  = {colorX.x / 255.0f, colorX.y / 255.0f, colorX.z / 255.0f};
+            tile.vertices.emplace_back(GeometryVertex{position, normal, color});
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve((rowSize - 1) * (endY - startY) * 6);
+    for (int y = 0; y < endY - startY; y++)
+    {
+        for (int x = 0; x < rowSize - 1; x++)
+        {
+            const uint32_t i = y * rowSize + x;
+            indices.insert(indices.end(), {i, i + 1, i + rowSize, i + rowSize + 1, i + rowSize, i + 1});
+        }
+    }
+
+    MeshOptimizer::Optimize(tile.vertices, indices);
+
+    tile.lods.emplace_back(std::move(indices));
+    tile.lodErrors.push_back(0.0f);
+    return tile;
+}
+
+HeightField IslandMesh::CreateHeightField() const
+{
+    const std::size_t sideSize = _worldGenerator.GetSideSize();
+
+    std::vector<float> heights;
+    heights.reserve(sideSize * sideSize);
+    for (std::size_t y = 0; y < sideSize; ++y)
+    {
+        for (std::size_t x = 0; x < sideSize; ++x)
+            heights.push_back(GetPosition((int)x, (int)y).z);
+    }
+
+    const float3 origin = GetPosition(0, 0);
+    return HeightField{std::move(heights), sideSize, sideSize, {origin.x, origin.y}, _islandWidth / (float)(sideSize - 1)};
+}
+
+float3 IslandMesh::GetPosition(int x, int y) const
+{
+    const int islandSize = (int)_worldGenerator.GetSideSize() - 1;
+
+    // heights are intentionally truncated to whole units
+    const uint8_t height = (uint8_t)(_worldGenerator.GetHeight(x, y) * heightMultiplier);
+    return {-_islandWidth / 2 + _islandWidth * ((float)x / islandSize),
+            -_islandWidth / 2 + _islandWidth * ((float)y / islandSize),
+            (float)height};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "WorldGen.h"
+
+#include <shaders/Common.h>
+#include <utils/HeightField.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+struct IslandTile
+{
+    int    startX, startY;  // first height map cell covered by the tile
+    float3 center;
+
+    std::vector<GeometryVertex>        vertices;
+    std::vector<std::vector<uint32_t>> lods;  // index buffers of the levels, all of them use the same vertices
+    std::vector<float>                 lodErrors;
+};
+
+// This class builds a smooth height field of the island split into square tiles.
+// Each tile is a separate mesh, so it can be simplified independently of the others.
+class IslandMesh
+{
+public:
+    IslandMesh(const WorldGen&                   worldGenerator,
+               const std::map<uint8_t, DirectX::XMUINT3>& colorsLut,
+               std::size_t                       tileSize    = 128,
+               float                             islandWidth = 100.0f);
+
+    // Precomputes simplified levels for every tile in parallel. Each level has 4 times fewer triangles
+    // than the previous one until its error against the first level (a bound, the sum of the errors of
+    // the simplification steps) becomes larger than maxError * 2^(level - 1).
+    void GenerateLods(std::size_t lodsCount, float maxError);
+
+    // Returns the level to use for the given distance from the camera to the tile. The sample selects
+    // the levels once, for the starting camera: the tiles are merged into static BLASes, switching a
+    // level would rebuild the BLAS of its group.
+    std::size_t SelectLod(const IslandTile& tile, float distance) const;
+
+    const std::vector<IslandTile>& GetTiles() const
+    {
+        return _tiles;
+    }
+
+    // The full resolution surface for the CPU side queries, it matches the first level of the tiles
+    HeightField CreateHeightField() const;
+
+private:
+    IslandTile GenerateTile(int startX, int startY) const;
+    float3     GetPosition(int x, int y) const;
+
+    const WorldGen&                   _worldGenerator;
+    const std::map<uint8_t, DirectX::XMUINT3>& _colorsLut;
+    const std::size_t                 _tileSize;
+    const float                       _islandWidth;
+    std::vector<IslandTile>           _tiles;
+};
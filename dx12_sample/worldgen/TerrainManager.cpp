@@ -1,5 +1,8 @@
 #include "TerrainManager.h"
 
+#include <utils/MeshOptimizer.h>
+#include <utils/Profiler.h>
+
 #include <iostream>
 
 TerrainManager::TerrainManager(const WorldGen&                   worldGenerator,
@@ -16,6 +19,8 @@ TerrainManager::TerrainManager(const WorldGen&                   worldGenerator,
 
 void TerrainManager::GenerateChunks()
 {
+    PROFILE_SCOPE("TerrainManager::GenerateChunks");
+
     for (int x = 0; x < _worldGenerator.GetSideSize(); x += _chunkSize)
     {
         for (int y = 0; y < _worldGenerator.GetSideSize(); y += _chunkSize)
@@ -32,6 +37,47 @@ void TerrainManager::GenerateChunks()
     }
     
     std::cout << "Total indices count: " << totalIndicesCount << ", triangles = " << totalIndicesCount / 3 << std::endl;
+
+    OptimizeChunks();
+}
+
+void TerrainManager::OptimizeChunks()
+{
+    PROFILE_SCOPE("TerrainManager::OptimizeChunks");
+
+    // reorder chunks geometry for the post-transform cache and the vertex fetch before it goes to the GPU,
+    // statistics are weighted by the number of triangles to get values for the whole terrain
+    std::size_t verticesBefore   = 0;
+    std::size_t verticesAfter    = 0;
+    std::size_t transformsBefore = 0;
+    std::size_t transformsAfter  = 0;
+    std::size_t trianglesCount   = 0;
+
+    auto optimize = [&](std::vector<GeometryVertex>& vertices, std::vector<uint32_t>& indices) {
+        if (indices.empty())
+            return;
+
+        auto report = MeshOptimizer::Optimize(vertices, indices);
+        verticesBefore += report.verticesBefore;
+        verticesAfter += report.verticesAfter;
+        transformsBefore += report.before.verticesTransformed;
+        transformsAfter += report.after.verticesTransformed;
+        trianglesCount += indices.size() / 3;
+    };
+
+    for (auto& chunk : _chunks)
+    {
+        optimize(chunk.landVertices, chunk.landIndices);
+        optimize(chunk.waterVertices, chunk.waterIndices);
+    }
+
+    if (!trianglesCount)
+        return;
+
+    std::cout << "Terrain vertices: " << verticesBefore << " -> " << verticesAfter
+              << ", ACMR: " << (float)transformsBefore / trianglesCount << " -> " << (float)transformsAfter / trianglesCount
+              << ", ATVR: " << (float)transformsBefore / verticesBefore << " -> " << (float)transformsAfter / verticesAfter
+              << std::endl;
 }
 
 TerrainChunk TerrainManager::GenerateChunk(int startX, int startY)
@@ -33,6 +33,7 @@ public:
 
 private:
     void         GenerateChunks();
+    void         OptimizeChunks();
     TerrainChunk GenerateChunk(int startX, int startY);
 
     void GenerateLandCol(int                          x,
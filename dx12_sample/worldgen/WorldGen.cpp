@@ -1,5 +1,9 @@
 #include "WorldGen.h"
 
+#include <utils/Profiler.h>
+
+#include <cmath>
+
 double Length(double x, double y)
 {
     x -= 1.0;
@@ -41,6 +45,8 @@ void WorldGen::GenerateHeightMap(int    octaves,
                                  double offset,
                                  double multiplier)
 {
+    PROFILE_SCOPE("WorldGen::GenerateHeightMap");
+
     _noise.SetOctaves(octaves);
     _noise.SetPersistence(persistance);
     _noise.SetFrequency(frequency);
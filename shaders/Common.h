@@ -3,6 +3,10 @@
 #ifdef __cplusplus
 #    include <DirectXMath.h>
 
+#    include <cstdint>
+
+using uint = uint32_t;
+
 #    define float2   DirectX::XMFLOAT2
 #    define float3   DirectX::XMFLOAT3
 #    define float4   DirectX::XMVECTOR
@@ -13,11 +17,45 @@
 #    define alignas(x)
 #endif
 
+// InstanceMask of the TLAS instances, the water lets the light through, so the occlusion rays skip it
+#define INSTANCE_MASK_OPAQUE 0x1
+#define INSTANCE_MASK_WATER  0x2
+
+// the pixels traced every frame, the checkerboard ones are those with even x + y + frameIndex, the
+// rest of them is reconstructed from the previous frame
+#define SAMPLING_FULL         0
+#define SAMPLING_CHECKERBOARD 1
+
+// the primary rays which hit nothing keep the initial distance of the payload
+#define MISS_DISTANCE 3100.0
+
 struct ViewParams
 {
     float4x4 inverseViewProj;
     float4   viewPos;
     float4   ambientColor;
+    float    aoRadius;    // the occluders farther than it don't shadow the ambient light
+    float    aoSamples;   // per pixel, the fraction is the chance of one more sample
+    uint     frameIndex;  // seeds the sampling, so the noise changes every frame
+    uint     sampling;    // SAMPLING_FULL or SAMPLING_CHECKERBOARD
+    // the water rays of smaller weights in the pixel color aren't traced, 0 traces all of them
+    float    waterMinWeight;
+    // the water farther than it reflects the nearer objects only, 0 doesn't limit the reflections
+    float    waterFarDistance;
+};
+
+// the cameras of the current and of the previous frames, the reconstruction reprojects between them
+struct ReconstructionParams
+{
+    float4x4 inverseViewProj;
+    float4x4 previousViewProj;
+    float4x4 previousInverseViewProj;
+    float4   viewPos;
+    float4   previousViewPos;
+    uint     width;
+    uint     height;
+    uint     frameIndex;
+    uint     historyValid;  // 0 if the previous frame is not there or is of another size
 };
 
 struct LightParams
@@ -29,7 +67,28 @@ struct LightParams
 struct ModelParams
 {
     float4x4 worldMatrix;
-    float reflectance;
+};
+
+// static params of the materials, the transforms come from the TLAS instances
+struct MaterialParams
+{
+    float reflectance;  // the refraction index for water
+};
+
+// per-instance data indexed by InstanceID(), every TLAS instance has one
+struct InstanceParams
+{
+    float3 color;           // multiplies the vertex colors
+    uint   geometryOffset;  // of the first geometry of the instance BLAS in the geometries table
+};
+
+// per-geometry data indexed by the instance geometry offset plus GeometryIndex()
+struct GeometryParams
+{
+    uint           vertexBuffer;  // descriptor indices in the unbounded ranges
+    uint           indexBuffer;
+    uint           indexSize;  // in bytes, 2 or 4
+    MaterialParams material;
 };
 
 struct GeometryVertex
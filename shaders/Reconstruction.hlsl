@@ -0,0 +1,115 @@
+#include "Common.h"
+
+// The checkerboard frames trace half of the pixels, the other half is filled here. The pixel is taken
+// from the previous frame if its surface is still there, otherwise it is interpolated between the
+// traced neighbours. TemporalReconstruction.cpp is a line by line port of this kernel.
+
+RWTexture2D<float4> output         : register(u0); // the traced pixels of the frame
+RWTexture2D<float4> gbuffer        : register(u1); // their normals and hit distances
+RWTexture2D<float4> history        : register(u2); // the full previous frame
+RWTexture2D<float4> historyGbuffer : register(u3);
+
+ConstantBuffer<ReconstructionParams> params : register(b0);
+
+// the camera rays reaching it hit nothing
+static const float skyDistance = 3000.0;
+// the history is of the same surface if it is this close to its plane relative to the distance,
+// the interpolated normals differ a lot between the neighbours, so only the turned ones are rejected
+static const float maxPlaneDistance = 0.02;
+static const float minNormalsDot    = 0.5;
+
+float3 CameraDirection(uint2 pixel, float4x4 inverseViewProj, float3 viewPos)
+{
+    float2 screenPos = (pixel + 0.5) / float2(params.width, params.height) * 2.0 - 1.0;
+    screenPos.y = -screenPos.y;
+
+    float4 world = mul(float4(screenPos, 0, 1), inverseViewProj);
+    return normalize(world.xyz / world.w - viewPos);
+}
+
+// the neighbours past the borders are mirrored, so they are traced ones too
+uint Mirror(int coordinate, int size)
+{
+    if (coordinate < 0)
+        coordinate = -coordinate;
+    if (coordinate >= size)
+        coordinate = 2 * size - 2 - coordinate;
+    return (uint)clamp(coordinate, 0, size - 1);
+}
+
+// Searches the previous frame for the surface of the normal and the distance along the ray of the
+// pixel, false if the pixel it is reprojected to sees another one. The weight of the nearest history
+// pixel falls to 0 at its borders.
+bool Reproject(uint2 pixel, float4 surface, out uint2 historyPixel, out float weight)
+{
+    historyPixel = uint2(0, 0);
+    weight       = 0.0;
+
+    float3 position = params.viewPos.xyz + CameraDirection(pixel, params.inverseViewProj, params.viewPos.xyz) * surface.w;
+    float4 previous = mul(float4(position, 1.0), params.previousViewProj);
+    float2 previousPixel = (float2(previous.x, -previous.y) / previous.w * 0.5 + 0.5) * float2(params.width, params.height);
+    if (!(previous.w > 0.0 && all(previousPixel >= 0.0) && all(previousPixel < float2(params.width, params.height))))
+        return false;
+
+    historyPixel = uint2(previousPixel);
+    float2 offset = abs(previousPixel - historyPixel - 0.5);
+    weight = (1.0 - 2.0 * offset.x) * (1.0 - 2.0 * offset.y);
+
+    // the sky is only replaced by the sky, the surfaces by the same surfaces
+    float4 previousGbuffer = historyGbuffer[historyPixel];
+    if (surface.w >= skyDistance || previousGbuffer.w >= skyDistance)
+        return surface.w >= skyDistance && previousGbuffer.w >= skyDistance;
+
+    float3 previousDirection = CameraDirection(historyPixel, params.previousInverseViewProj, params.previousViewPos.xyz);
+    float3 previousPosition  = params.previousViewPos.xyz + previousDirection * previousGbuffer.w;
+
+    float planeDistance = abs(dot(position - previousPosition, previousGbuffer.xyz));
+    return planeDistance < maxPlaneDistance * surface.w && dot(surface.xyz, previousGbuffer.xyz) > minNormalsDot;
+}
+
+[numthreads(8, 8, 1)]
+void ReconstructCS(uint3 id : SV_DispatchThreadID)
+{
+    uint2 pixel = id.xy;
+    if (pixel.x >= params.width || pixel.y >= params.height || ((pixel.x + pixel.y + params.frameIndex) & 1) == 0)
+        return;
+
+    uint2 left  = uint2(Mirror((int)pixel.x - 1, (int)params.width), pixel.y);
+    uint2 right = uint2(Mirror((int)pixel.x + 1, (int)params.width), pixel.y);
+    uint2 up    = uint2(pixel.x, Mirror((int)pixel.y - 1, (int)params.height));
+    uint2 down  = uint2(pixel.x, Mirror((int)pixel.y + 1, (int)params.height));
+
+    // the pair with the closer distances doesn't cross an edge
+    bool  isHorizontal = abs(gbuffer[left].w - gbuffer[right].w) <= abs(gbuffer[up].w - gbuffer[down].w);
+    uint2 first        = isHorizontal ? left : up;
+    uint2 second       = isHorizontal ? right : down;
+
+    float3 normal = gbuffer[first].xyz + gbuffer[second].xyz;
+    if (dot(normal, normal) > 0.0)
+        normal = normalize(normal);
+
+    float4 surface = float4(normal, (gbuffer[first].w + gbuffer[second].w) * 0.5);
+    float4 color   = (output[first] + output[second]) * 0.5;
+
+    // the interpolated surface is wrong at the edges, the pixel likely sees the one of a neighbour there
+    float4 candidates[5] = {surface, gbuffer[left], gbuffer[right], gbuffer[up], gbuffer[down]};
+    for (uint candidate = 0; params.historyValid != 0 && candidate < 5; ++candidate)
+    {
+        uint2 historyPixel;
+        float weight;
+        if (!Reproject(pixel, candidates[candidate], historyPixel, weight))
+            continue;
+
+        // the history can't be out of the range of the neighbours, so the misses don't ghost
+        float4 minColor = min(min(output[left], output[right]), min(output[up], output[down]));
+        float4 maxColor = max(max(output[left], output[right]), max(output[up], output[down]));
+        color = lerp(color, clamp(history[historyPixel], minColor, maxColor), weight);
+
+        // the history distance is of the previous camera
+        surface = float4(historyGbuffer[historyPixel].xyz, candidates[candidate].w);
+        break;
+    }
+
+    output[pixel]  = float4(color.xyz, 1.0);
+    gbuffer[pixel] = surface;
+}
@@ -4,22 +4,41 @@ struct RayPayload
 {
     float3 color;
     float  hitDistance;
+    float3 normal;  // of the closest hit, the reconstruction compares them between the frames
 };
 
 RWTexture2D<float4>              output       : register(u0); // render target
+RWTexture2D<float4>              gbuffer      : register(u1); // the normal and the hit distance of the camera rays
+RWByteAddressBuffer              rayCounters  : register(u2); // the water rays skipped since the start
 
 ConstantBuffer<ViewParams>       sceneParams    : register(b0);
 ConstantBuffer<LightParams>      lightParams    : register(b1);
-ConstantBuffer<ModelParams>      modelParams    : register(b2);
 
-RaytracingAccelerationStructure  scene        : register(t0, space0);
-StructuredBuffer<GeometryVertex> vertexBuffer : register(t1);
-ByteAddressBuffer                indexBuffer  : register(t2);
+RaytracingAccelerationStructure  scene          : register(t0, space0);
+StructuredBuffer<InstanceParams> instanceParams : register(t3);
+StructuredBuffer<GeometryParams> geometryParams : register(t4);
+
+// bindless views of all the meshes, indexed by the geometry params
+StructuredBuffer<GeometryVertex> vertexBuffers[] : register(t0, space1);
+ByteAddressBuffer                indexBuffers[]  : register(t0, space2);
+
+// The checkerboard dispatch is half as wide as the output, every launch traces one of the two pixels
+// of its pair, the rows and the frames alternate between them.
+uint2 PixelIndex()
+{
+    uint2 index = DispatchRaysIndex().xy;
+    if (sceneParams.sampling == SAMPLING_CHECKERBOARD)
+        index.x = index.x * 2 + ((index.y + sceneParams.frameIndex) & 1);
+    return index;
+}
 
 inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 direction)
 {
+    uint2 dimensions;
+    output.GetDimensions(dimensions.x, dimensions.y);
+
     float2 xy = index + 0.5f; // center in the middle of the pixel.
-    float2 screenPos = xy / DispatchRaysDimensions().xy * 2.0 - 1.0; // [-1.0; 1.0]
+    float2 screenPos = xy / dimensions * 2.0 - 1.0; // [-1.0; 1.0]
 
     // Invert Y for DirectX-style coordinates.
     screenPos.y = -screenPos.y;
@@ -37,37 +56,143 @@ void RayGenShader()
 {
     RayPayload payload;
     payload.color = float3(0.0, 1.0, 0.0);
-    payload.hitDistance = 3100.0;
+    payload.hitDistance = MISS_DISTANCE;
+    payload.normal = float3(0.0, 0.0, 0.0);
+
+    // the last pair of an odd width has a single pixel
+    uint2 pixel = PixelIndex();
+    uint2 dimensions;
+    output.GetDimensions(dimensions.x, dimensions.y);
+    if (pixel.x >= dimensions.x)
+        return;
 
-    uint3 launchIndex = DispatchRaysIndex();
     RayDesc desc;
     desc.TMin = 0.01f;
     desc.TMax = 3000.0f;
-    GenerateCameraRay(launchIndex.xy, desc.Origin, desc.Direction);
+    GenerateCameraRay(pixel, desc.Origin, desc.Direction);
 
     TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, desc, payload);
 
-    output[launchIndex.xy] = float4(payload.color, 1.0);
+    output[pixel]  = float4(payload.color, 1.0);
+    gbuffer[pixel] = float4(payload.normal, payload.hitDistance);
 }
 
+static const float3 skyColor = float3(0.6, 0.75, 1.0);
+
 [shader("miss")]
 void MissShader(inout RayPayload ray)
 {
-    ray.color = float3(0.6, 0.75, 1.0);
+    ray.color = skyColor;
+}
+
+// PCG hash, the same integer math runs in the CPU tracer, so both take the same samples
+uint Hash(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// in [0; 1), every call advances the seed
+float Random(inout uint seed)
+{
+    seed = Hash(seed);
+    return (seed >> 8) * (1.0 / 16777216.0);
+}
+
+// differs per pixel and per frame, the secondary hits of a pixel get the same one
+uint RandomSeed()
+{
+    uint2 index = PixelIndex();
+    return Hash(index.x ^ Hash(index.y ^ Hash(sceneParams.frameIndex)));
+}
+
+// Any hit is enough and both sides of the triangles occlude. The inline queries call no shaders,
+// so they don't add to the recursion depth of the pipeline and need no records in the tables.
+bool IsOccluded(float3 origin, float3 direction, float tMax)
+{
+    RayDesc desc;
+    desc.Origin    = origin;
+    desc.Direction = direction;
+    desc.TMin      = 0.01f;
+    desc.TMax      = tMax;
+
+    RayQuery<RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_FORCE_OPAQUE | RAY_FLAG_SKIP_PROCEDURAL_PRIMITIVES> query;
+    query.TraceRayInline(scene, RAY_FLAG_NONE, INSTANCE_MASK_OPAQUE, desc);
+    query.Proceed();
+    return query.CommittedStatus() == COMMITTED_TRIANGLE_HIT;
+}
+
+// the surfaces turned away from the light shadow themselves, no ray is traced for them
+float LightVisibility(float3 position, float3 l, float NoL)
+{
+    if (NoL <= 0.0)
+        return 0.0;
+
+    return IsOccluded(position, l, 3000.0f) ? 0.0 : 1.0;
+}
+
+// The open share of the hemisphere within the radius. The directions are cosine weighted, so it
+// scales the ambient light the surface receives.
+float AmbientOcclusion(float3 position, float3 n, inout uint seed)
+{
+    uint samplesCount = (uint)sceneParams.aoSamples;
+    if (Random(seed) < frac(sceneParams.aoSamples))
+        samplesCount++;
+
+    if (samplesCount == 0)
+        return 1.0;
+
+    float3 tangent   = normalize(cross(abs(n.z) < 0.999 ? float3(0.0, 0.0, 1.0) : float3(1.0, 0.0, 0.0), n));
+    float3 bitangent = cross(n, tangent);
+
+    uint openCount = 0;
+    for (uint i = 0; i < samplesCount; ++i)
+    {
+        float u1  = Random(seed);
+        float u2  = Random(seed);
+        float r   = sqrt(u1);
+        float phi = 2.0 * 3.14159265 * u2;
+
+        float3 direction = tangent * (r * cos(phi)) + bitangent * (r * sin(phi)) + n * sqrt(1.0 - u1);
+        if (!IsOccluded(position, direction, sceneParams.aoRadius))
+            openCount++;
+    }
+
+    return (float)openCount / samplesCount;
 }
 
 float4 DirectLight(float4 normal) {
     return saturate(dot(float4(normal), lightParams.direction)) * lightParams.color;
 }
 
-uint3 LoadIndices(uint primitiveIndex)
+// the geometries of a BLAS follow each other in the table
+GeometryParams CurrentGeometry()
+{
+    return geometryParams[instanceParams[InstanceID()].geometryOffset + GeometryIndex()];
+}
+
+uint3 LoadIndices(GeometryParams geometry, uint primitiveIndex)
 {
-    uint formatSize = 4; // 4 bytes per index
+    uint formatSize = geometry.indexSize;
     uint stride = formatSize * 3; // 3 indices per triangle
     uint shift = stride * primitiveIndex;
 
+    // the index differs between the hits of a wave
+    ByteAddressBuffer indexBuffer = indexBuffers[NonUniformResourceIndex(geometry.indexBuffer)];
+    if (formatSize == 4)
+        return indexBuffer.Load3(shift);
+
+    // 16-bit indices: loads have to be 4-byte aligned, so the triangle starts either
+    // in the low or in the high half of the first loaded word
+    uint alignedShift = shift & ~3;
+    uint2 packed = indexBuffer.Load2(alignedShift);
+
     uint3 output = uint3(0, 0, 0);
-    output = indexBuffer.Load3(shift);
+    if (shift == alignedShift)
+        output = uint3(packed.x & 0xffff, packed.x >> 16, packed.y & 0xffff);
+    else
+        output = uint3(packed.x >> 16, packed.y & 0xffff, packed.y >> 16);
     return output;
 }
 
@@ -81,8 +206,12 @@ float3 Interpolate(float3 attribute1, float3 attribute2, float3 attribute3, floa
     return attribute1 * barycentrics.x + attribute2 * barycentrics.y + attribute3 * barycentrics.z;
 }
 
-GeometryVertex LoadAndInterpolate(uint3 indices, in BuiltInTriangleIntersectionAttributes attr)
+GeometryVertex LoadAndInterpolate(GeometryParams geometry, in BuiltInTriangleIntersectionAttributes attr)
 {
+    uint3 indices = LoadIndices(geometry, PrimitiveIndex());
+
+    StructuredBuffer<GeometryVertex> vertexBuffer = vertexBuffers[NonUniformResourceIndex(geometry.vertexBuffer)];
+
     GeometryVertex v1, v2, v3;
     v1 = vertexBuffer[indices.x];
     v2 = vertexBuffer[indices.y];
@@ -97,6 +226,22 @@ GeometryVertex LoadAndInterpolate(uint3 indices, in BuiltInTriangleIntersectionA
     return output;
 }
 
+// instanced objects share the geometry params and nothing holds their matrices, so the transform of the TLAS instance is used for all the objects
+float3 ToWorldPosition(float3 position)
+{
+    return mul(float4(position, 1.0), ObjectToWorld4x3());
+}
+
+float3 ToWorldNormal(float3 normal)
+{
+    return normalize(mul(normal, (float3x3)ObjectToWorld4x3()));
+}
+
+float3 InstanceColor()
+{
+    return instanceParams[InstanceID()].color;
+}
+
 float3 PhongDiffuse(float NoL, float3 lightColor, float3 albedo)
 {
     return lightColor * albedo * saturate(NoL); // / 3.14159265;
@@ -110,38 +255,46 @@ float3 PhongSpecular(float NoV, float3 lightColor, float reflectance)
 [shader("closesthit")]
 void SpecularShader(inout RayPayload payload, in BuiltInTriangleIntersectionAttributes attr)
 {
-    GeometryVertex v = LoadAndInterpolate(LoadIndices(PrimitiveIndex()), attr);
+    GeometryParams geometry = CurrentGeometry();
+    GeometryVertex v = LoadAndInterpolate(geometry, attr);
 
-    float3 n = normalize(mul(float4(v.normal, 0.0), transpose(modelParams.worldMatrix))).xyz;
+    float3 n = ToWorldNormal(v.normal);
     float3 l = -normalize(lightParams.direction.xyz);
     float NoL = dot(n, l);
-    float3 diffuseColor = PhongDiffuse(NoL, lightParams.color.xyz, v.color);
+    float3 diffuseColor = PhongDiffuse(NoL, lightParams.color.xyz, v.color * InstanceColor());
 
-    float3 currentPos = mul(float4(v.position, 1.0), transpose(modelParams.worldMatrix)).xyz;
+    float3 currentPos = ToWorldPosition(v.position);
     float3 r = reflect(normalize(currentPos - sceneParams.viewPos.xyz), n);
     float NoV = dot(r, l);
-    float3 specularColor = PhongSpecular(NoV, lightParams.color.xyz, modelParams.reflectance);
+    float3 specularColor = PhongSpecular(NoV, lightParams.color.xyz, geometry.material.reflectance);
 
-    float3 ambientColor = sceneParams.ambientColor.xyz;
+    uint   seed         = RandomSeed();
+    float  visibility   = LightVisibility(currentPos, l, NoL);
+    float3 ambientColor = sceneParams.ambientColor.xyz * AmbientOcclusion(currentPos, n, seed);
 
-    payload.color = float3(specularColor + diffuseColor + ambientColor);
+    payload.color = float3((specularColor + diffuseColor) * visibility + ambientColor);
     payload.hitDistance = min(payload.hitDistance, RayTCurrent());
+    payload.normal = n;
 }
 
 [shader("closesthit")]
 void DiffuseShader(inout RayPayload payload, in BuiltInTriangleIntersectionAttributes attr)
 {
-    GeometryVertex v = LoadAndInterpolate(LoadIndices(PrimitiveIndex()), attr);
+    GeometryVertex v = LoadAndInterpolate(CurrentGeometry(), attr);
 
-    float3 currentPos = mul(float4(v.position, 1.0), transpose(modelParams.worldMatrix)).xyz;
-    float3 n = normalize(mul(float4(v.normal, 0.0), transpose(modelParams.worldMatrix))).xyz;
+    float3 currentPos = ToWorldPosition(v.position);
+    float3 n = ToWorldNormal(v.normal);
     float3 l = -normalize(lightParams.direction.xyz);
     float NoL = dot(n, l);
-    float3 diffuseColor = PhongDiffuse(NoL, lightParams.color.xyz, v.color);
-    float3 ambientColor = sceneParams.ambientColor.xyz;
+    float3 diffuseColor = PhongDiffuse(NoL, lightParams.color.xyz, v.color * InstanceColor());
+
+    uint   seed         = RandomSeed();
+    float  visibility   = LightVisibility(currentPos, l, NoL);
+    float3 ambientColor = sceneParams.ambientColor.xyz * AmbientOcclusion(currentPos, n, seed);
 
-    payload.color = float3(diffuseColor + ambientColor);
+    payload.color = float3(diffuseColor * visibility + ambientColor);
     payload.hitDistance = min(payload.hitDistance, RayTCurrent());
+    payload.normal = n;
 }
 
 float F_Shlick(float NoV, float ior)
@@ -151,44 +304,91 @@ float F_Shlick(float NoV, float ior)
     return R0 + (1 - R0) * pow(1 - NoV, 5.0);
 }
 
+// the bottom seen through the water fades to its color at this distance along the refracted ray
+static const float  waterFadeDistance = 20.0;
+static const float3 deepWaterColor    = float3(0.0, 0.45, 0.69);
+
+// the lanes of the wave add their counts with a single atomic
+void CountSkippedRays(uint count)
+{
+    uint waveCount = WaveActiveSum(count);
+    if (WaveIsFirstLane() && waveCount > 0)
+        rayCounters.InterlockedAdd(0, waveCount);
+}
+
+// The rays of the weights below sceneParams.waterMinWeight are replaced by the colors they most
+// likely get: the deep water for the refraction and the sky for the reflection.
 [shader("closesthit")]
 void WaterShader(inout RayPayload payload, in BuiltInTriangleIntersectionAttributes attr)
 {
-    GeometryVertex v = LoadAndInterpolate(LoadIndices(PrimitiveIndex()), attr);
-    float3 n = normalize(mul(float4(v.normal, 0.0), transpose(modelParams.worldMatrix))).xyz;
-    float3 p = mul(float4(v.position, 1.0), transpose(modelParams.worldMatrix)).xyz;
+    GeometryParams geometry = CurrentGeometry();
+    GeometryVertex v = LoadAndInterpolate(geometry, attr);
+    float3 n = ToWorldNormal(v.normal);
+    float3 p = ToWorldPosition(v.position);
+
+    payload.hitDistance = min(payload.hitDistance, RayTCurrent());
+    payload.normal = n;
 
     RayDesc desc;
     desc.TMin   = 0.01f;
-    desc.TMax   = 100.0f;
     desc.Origin = p;
 
     // 1.0 is the air refractivity
-    desc.Direction = refract(WorldRayDirection(), n, 1.0 / modelParams.reflectance);
-
-    if (length(desc.Direction) < 0.1)
+    float3 refraction = refract(WorldRayDirection(), n, 1.0 / geometry.material.reflectance);
+    if (length(refraction) < 0.1)
     {
         payload.color = float3(0.0, 0.0, 0.0);
         return;
     }
 
-    RayPayload waterPayload;
-    waterPayload.color       = float3(1.0, 0.0, 0.0);
-    waterPayload.hitDistance = 3100.0;
-    TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, desc, waterPayload);
+    float NoV    = saturate(dot(n, -WorldRayDirection()));
+    float amount = F_Shlick(NoV, geometry.material.reflectance);
 
-    float hitDistance = pow(saturate(waterPayload.hitDistance / 20.0), 2.0);
-    float3 refractionColor = lerp(waterPayload.color.xyz, float3(0.0, 0.45, 0.69), hitDistance);
+    uint skippedRays = 0;
 
-    desc.TMax      = 3100.0f;
-    desc.Direction = reflect(WorldRayDirection(), n);
+    float3 refractionColor = deepWaterColor;
+    if (1.0 - amount >= sceneParams.waterMinWeight)
+    {
+        // the bottom farther than this weighs less than the minimal weight after the fade
+        desc.TMax      = waterFadeDistance * sqrt(1.0 - sceneParams.waterMinWeight);
+        desc.Direction = refraction;
 
-    RayPayload reflectionPayload;
-    reflectionPayload.color = float3(1.0, 0.0, 0.0);
-    TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, desc, reflectionPayload);
+        RayPayload waterPayload;
+        waterPayload.color       = float3(1.0, 0.0, 0.0);
+        waterPayload.hitDistance = MISS_DISTANCE;
+        TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, desc, waterPayload);
 
-    float NoV    = saturate(dot(n, -WorldRayDirection()));
-    float amount = F_Shlick(NoV, modelParams.reflectance);
+        float fade = pow(saturate(waterPayload.hitDistance / waterFadeDistance), 2.0);
+        refractionColor = lerp(waterPayload.color.xyz, deepWaterColor, fade);
+    }
+    else
+    {
+        ++skippedRays;
+    }
+
+    float3 reflectionColor = skyColor;
+    if (amount >= sceneParams.waterMinWeight)
+    {
+        // the reach falls with the distance like the size of the reflected objects on the screen does
+        float distance = length(p - sceneParams.viewPos.xyz);
+        float farDistance = sceneParams.waterFarDistance;
+
+        desc.TMax      = farDistance > 0.0 ? min(3100.0f, farDistance * farDistance / distance) : 3100.0f;
+        desc.Direction = reflect(WorldRayDirection(), n);
+
+        RayPayload reflectionPayload;
+        reflectionPayload.color = float3(1.0, 0.0, 0.0);
+        reflectionPayload.hitDistance = MISS_DISTANCE;
+        TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, desc, reflectionPayload);
+
+        reflectionColor = reflectionPayload.color;
+    }
+    else
+    {
+        ++skippedRays;
+    }
+
+    CountSkippedRays(skippedRays);
 
-    payload.color = lerp(refractionColor, reflectionPayload.color, amount);
+    payload.color = lerp(refractionColor, reflectionColor, amount);
 }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal checks for the test executables, a failed check is reported and the test goes on,
+// the result of main is non-zero if any of them failed
+namespace Check
+{
+inline int failuresCount = 0;
+
+inline int Result()
+{
+    if (failuresCount > 0)
+        std::cerr << failuresCount << " checks failed" << std::endl;
+
+    return failuresCount == 0 ? 0 : 1;
+}
+}  // namespace Check
+
+#define CHECK(condition)                                                                               \
+    do                                                                                                 \
+    {                                                                                                  \
+        if (!(condition))                                                                              \
+        {                                                                                              \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            ++Check::failuresCount;                                                                    \
+        }                                                                                              \
+    } while (false)
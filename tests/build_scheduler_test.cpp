@@ -0,0 +1,123 @@
+#include "Check.h"
+
+#include <utils/BuildScheduler.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+// the GPU progress is set by the test, waits complete the work up to the value
+class FakeQueue : public IBuildQueue
+{
+public:
+    uint64_t                 completed = 0;
+    std::vector<std::string> calls;
+
+    void Signal(uint64_t value) override
+    {
+        calls.push_back("Signal " + std::to_string(value));
+    }
+
+    uint64_t GetCompletedValue() const override
+    {
+        return completed;
+    }
+
+    void WaitForValue(uint64_t value) override
+    {
+        calls.push_back("WaitForValue " + std::to_string(value));
+        completed = std::max(completed, value);
+    }
+};
+
+void TestCompletionOrder()
+{
+    FakeQueue      queue;
+    BuildScheduler scheduler{queue};
+
+    std::vector<int> finished;
+    const uint64_t   first  = scheduler.Submit([&]() { finished.push_back(1); });
+    const uint64_t   second = scheduler.Submit([&]() { finished.push_back(2); });
+    const uint64_t   third  = scheduler.Submit([&]() { finished.push_back(3); });
+    CHECK(first == 1 && second == 2 && third == 3);
+    CHECK((queue.calls == std::vector<std::string>{"Signal 1", "Signal 2", "Signal 3"}));
+
+    CHECK(scheduler.Poll() == 0);
+    CHECK(!scheduler.IsCompleted(first));
+
+    queue.completed = 2;
+    CHECK(scheduler.IsCompleted(first) && scheduler.IsCompleted(second) && !scheduler.IsCompleted(third));
+    CHECK(scheduler.Poll() == 2);
+    CHECK((finished == std::vector<int>{1, 2}));
+    CHECK(scheduler.GetPendingCount() == 1);
+
+    // nothing is waited for when the work is done already
+    scheduler.WaitForCompletion(second);
+    CHECK(queue.calls.size() == 3);
+
+    scheduler.Flush();
+    CHECK(queue.calls.back() == "WaitForValue 3");
+    CHECK((finished == std::vector<int>{1, 2, 3}));
+    CHECK(scheduler.GetPendingCount() == 0);
+}
+
+void TestNestedSubmission()
+{
+    FakeQueue      queue;
+    BuildScheduler scheduler{queue};
+
+    // a callback may submit follow-up work, it completes with a later value
+    uint64_t followUp = 0;
+    scheduler.Submit([&]() { followUp = scheduler.Submit(); });
+
+    queue.completed = 1;
+    CHECK(scheduler.Poll() == 1);
+    CHECK(followUp == 2);
+    CHECK(!scheduler.IsCompleted(followUp));
+    CHECK(scheduler.GetPendingCount() == 1);
+}
+
+void TestWaitValue()
+{
+    FakeQueue      queue;
+    BuildScheduler scheduler{queue};
+
+    // nothing was submitted, so there is nothing to wait for
+    CHECK(scheduler.GetWaitValue(0) == 0);
+
+    const uint64_t upload = scheduler.Submit();
+    const uint64_t build  = scheduler.Submit();
+
+    // the signals are issued before the other queue is asked to wait for them
+    CHECK(scheduler.GetWaitValue(upload) == upload);
+    CHECK(scheduler.GetWaitValue(build) == build);
+    CHECK(queue.calls.size() == 2);
+
+    queue.completed = upload;
+    CHECK(scheduler.GetWaitValue(upload) == 0);
+    CHECK(scheduler.GetWaitValue(build) == build);
+
+    // a wait for a value which will never be signaled would stall the other queue
+    bool thrown = false;
+    try
+    {
+        scheduler.GetWaitValue(build + 1);
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+}  // namespace
+
+int main()
+{
+    TestCompletionOrder();
+    TestNestedSubmission();
+    TestWaitValue();
+    return Check::Result();
+}
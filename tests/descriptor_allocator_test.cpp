@@ -0,0 +1,120 @@
+#include "Check.h"
+
+#include <utils/DescriptorAllocator.h>
+
+#include <vector>
+
+// found by the lookup of the standard algorithms, so it is not in the anonymous namespace
+static bool operator==(const DescriptorAllocator::Range& left, const DescriptorAllocator::Range& right)
+{
+    return left.offset == right.offset && left.count == right.count;
+}
+
+namespace
+{
+void TestFirstFit()
+{
+    DescriptorAllocator allocator{16};
+
+    CHECK(allocator.Allocate(4) == 0u);
+    CHECK(allocator.Allocate(2) == 4u);
+    CHECK(allocator.Allocate(4) == 6u);
+    CHECK(allocator.GetAllocatedCount() == 10);
+
+    // the hole at the beginning is taken by the ranges which fit it, the larger ones go after it
+    allocator.Free(0, 4, 0);
+    allocator.Release(0);
+    CHECK(allocator.Allocate(5) == 10u);
+    CHECK(allocator.Allocate(3) == 0u);
+    CHECK(allocator.Allocate(1) == 3u);
+
+    CHECK(!allocator.Allocate(2));
+    CHECK(allocator.Allocate(1) == 15u);
+    CHECK(!allocator.Allocate(1));
+}
+
+void TestCoalescing()
+{
+    DescriptorAllocator allocator{12};
+
+    std::vector<std::size_t> offsets;
+    for (std::size_t i = 0; i < 6; ++i)
+        offsets.push_back(*allocator.Allocate(2));
+
+    // the freed neighbours merge, so a range spanning them fits
+    allocator.Free(offsets[1], 2, 1);
+    allocator.Free(offsets[3], 2, 1);
+    allocator.Free(offsets[2], 2, 1);
+    allocator.Release(1);
+
+    CHECK(allocator.Allocate(6) == offsets[1]);
+    CHECK(allocator.GetAllocatedCount() == 12);
+}
+
+void TestPendingFrees()
+{
+    DescriptorAllocator allocator{4};
+    allocator.Allocate(4);
+
+    // the frames 1 and 2 may still use the descriptors
+    allocator.Free(0, 2, 1);
+    allocator.Free(2, 2, 2);
+    CHECK(allocator.GetPendingFreesCount() == 2);
+    CHECK(allocator.GetAllocatedCount() == 4);
+
+    allocator.Release(0);
+    CHECK(!allocator.Allocate(1));
+
+    allocator.Release(1);
+    CHECK(allocator.GetPendingFreesCount() == 1);
+    CHECK(allocator.Allocate(2) == 0u);
+    CHECK(!allocator.Allocate(1));
+
+    allocator.Release(5);
+    CHECK(allocator.GetPendingFreesCount() == 0);
+    CHECK(allocator.Allocate(2) == 2u);
+}
+
+void TestDirtyRanges()
+{
+    DescriptorAllocator allocator{32};
+
+    // the allocations are dirty, adjacent ones merge
+    allocator.Allocate(4);
+    allocator.Allocate(4);
+    allocator.MarkDirty(20, 2);
+    allocator.MarkDirty(22);
+    allocator.MarkDirty(10, 4);
+    allocator.MarkDirty(12, 4);
+
+    const std::vector<DescriptorAllocator::Range> expected = {{0, 8}, {10, 6}, {20, 3}};
+    CHECK(allocator.TakeDirtyRanges() == expected);
+    CHECK(allocator.TakeDirtyRanges().empty());
+
+    // rewritten descriptors are dirty again
+    allocator.MarkDirty(2);
+    CHECK(allocator.TakeDirtyRanges() == (std::vector<DescriptorAllocator::Range>{{2, 1}}));
+}
+
+void TestGrow()
+{
+    DescriptorAllocator allocator{4};
+    allocator.Allocate(3);
+
+    // the free tail merges with the new indices
+    allocator.Grow(8);
+    CHECK(allocator.GetCapacity() == 8);
+    CHECK(allocator.Allocate(5) == 3u);
+    CHECK(!allocator.Allocate(1));
+}
+}  // namespace
+
+int main()
+{
+    TestFirstFit();
+    TestCoalescing();
+    TestPendingFrees();
+    TestDirtyRanges();
+    TestGrow();
+    return Check::Result();
+}
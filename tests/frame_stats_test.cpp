@@ -0,0 +1,135 @@
+#include "Check.h"
+
+#include <utils/FrameStats.h>
+
+#include <tuple>
+#include <vector>
+
+namespace
+{
+using Bucket = std::tuple<uint64_t, uint64_t, uint64_t>;  // the lowest and the highest values, the count
+
+std::vector<Bucket> GetBuckets(const LogHistogram& histogram)
+{
+    std::vector<Bucket> buckets;
+    histogram.ForEachBucket([&](uint64_t lowest, uint64_t highest, uint64_t count) { buckets.emplace_back(lowest, highest, count); });
+    return buckets;
+}
+
+void TestBuckets()
+{
+    // the values below 64 have buckets of their own, the next power of 2 has buckets of 2 values
+    LogHistogram histogram;
+    for (uint64_t value : {31, 32, 63, 64, 65})
+        histogram.Add(value);
+    CHECK((GetBuckets(histogram) == std::vector<Bucket>{{31, 31, 1}, {32, 32, 1}, {63, 63, 1}, {64, 65, 2}}));
+
+    // the last bucket ends at the max, the larger values are counted in it
+    histogram.Clear();
+    histogram.Add(LogHistogram::maxValue);
+    histogram.Add(LogHistogram::maxValue + 12345);
+    const uint64_t lastBucketWidth = uint64_t(1) << 34;
+    CHECK((GetBuckets(histogram) == std::vector<Bucket>{{LogHistogram::maxValue + 1 - lastBucketWidth, LogHistogram::maxValue, 2}}));
+
+    histogram.Remove(LogHistogram::maxValue);
+    CHECK(histogram.GetCount() == 1);
+}
+
+void TestPercentiles()
+{
+    LogHistogram histogram;
+    CHECK(histogram.GetPercentile(50.0) == 0);
+
+    for (uint64_t value = 1; value <= 100; ++value)
+        histogram.Add(value);
+
+    // the ranks are 50, 95 and 99 of 100, the values above 64 are reported as the highest of their buckets
+    CHECK(histogram.GetPercentile(50.0) == 50);
+    CHECK(histogram.GetPercentile(95.0) == 95);
+    CHECK(histogram.GetPercentile(99.0) == 99);
+    CHECK(histogram.GetPercentile(100.0) == 101);
+    CHECK(histogram.GetPercentile(0.0) == 1);
+}
+
+void TestWindowMax()
+{
+    FrameStats stats{3, 10};
+    for (double milliseconds : {10.0, 1.0, 2.0})
+        stats.AddFrame(FrameStats::Track::Cpu, milliseconds);
+    CHECK(stats.GetSummary(FrameStats::Track::Cpu, FrameStats::Window::Short).max == 10.0);
+
+    // the max leaves the short window with its frame, the longer ones keep it
+    stats.AddFrame(FrameStats::Track::Cpu, 3.0);
+    CHECK(stats.GetSummary(FrameStats::Track::Cpu, FrameStats::Window::Short).max == 3.0);
+    CHECK(stats.GetSummary(FrameStats::Track::Cpu, FrameStats::Window::Short).frames == 3);
+    CHECK(stats.GetSummary(FrameStats::Track::Cpu, FrameStats::Window::Long).max == 10.0);
+    CHECK(stats.GetSummary(FrameStats::Track::Cpu, FrameStats::Window::Session).max == 10.0);
+    CHECK(stats.GetRecentCount(FrameStats::Track::Cpu) == 3 && stats.GetRecentMilliseconds(FrameStats::Track::Cpu, 0) == 1.0f);
+
+    // the percentiles don't exceed the max although the bucket of the value does
+    FrameStats single{3, 10};
+    single.AddFrame(FrameStats::Track::Gpu, 10.0);
+    const FrameStats::Summary summary = single.GetSummary(FrameStats::Track::Gpu, FrameStats::Window::Short);
+    CHECK(summary.p99 == 10.0 && summary.max == 10.0);
+}
+
+void TestHitches()
+{
+    // the first 29 frames are the warm-up
+    FrameStats stats;
+    for (int frame = 0; frame < 29; ++frame)
+        stats.AddFrame(FrameStats::Track::Cpu, 10.0);
+    stats.AddFrame(FrameStats::Track::Cpu, 100.0);
+    CHECK(stats.GetHitchesCount(FrameStats::Track::Cpu) == 0);
+
+    // the median of 10 ms is the highest of its bucket, 10.239 ms, a hitch is twice as long
+    stats.AddFrame(FrameStats::Track::Cpu, 20.4);
+    CHECK(stats.GetHitchesCount(FrameStats::Track::Cpu) == 0);
+    stats.AddFrame(FrameStats::Track::Cpu, 20.5);
+    CHECK(stats.GetHitchesCount(FrameStats::Track::Cpu) == 1);
+    CHECK(stats.GetHitchesCount(FrameStats::Track::Gpu) == 0);
+
+    // the short frames need 4 ms more than the median too, the one of 1 ms is 1.007 ms
+    FrameStats fast;
+    for (int frame = 0; frame < 30; ++frame)
+        fast.AddFrame(FrameStats::Track::Gpu, 1.0);
+    fast.AddFrame(FrameStats::Track::Gpu, 5.0);
+    CHECK(fast.GetHitchesCount(FrameStats::Track::Gpu) == 0);
+    fast.AddFrame(FrameStats::Track::Gpu, 5.1);
+    CHECK(fast.GetHitchesCount(FrameStats::Track::Gpu) == 1);
+}
+
+void TestTags()
+{
+    FrameStats stats;
+    stats.AddTag("TLAS rebuild");
+    stats.AddTag("TLAS rebuild");
+
+    // the GPU frames are of the earlier CPU ones, the tag waits for the next CPU frame
+    stats.AddFrame(FrameStats::Track::Gpu, 5.0);
+    CHECK(stats.GetTags().empty());
+
+    stats.AddFrame(FrameStats::Track::Cpu, 12.0);
+    stats.AddFrame(FrameStats::Track::Cpu, 13.0);
+
+    const auto tag = stats.GetTags().find("TLAS rebuild");
+    CHECK(stats.GetTags().size() == 1 && tag != stats.GetTags().end());
+    if (tag != stats.GetTags().end())
+    {
+        CHECK(tag->second.frameTimes.GetCount() == 1);
+        CHECK(tag->second.frameTimes.GetPercentile(50.0) >= 12000 && tag->second.frameTimes.GetPercentile(50.0) < 13000);
+        CHECK(tag->second.hitches == 0);
+    }
+}
+}  // namespace
+
+int main()
+{
+    TestBuckets();
+    TestPercentiles();
+    TestWindowMax();
+    TestHitches();
+    TestTags();
+
+    return Check::Result();
+}
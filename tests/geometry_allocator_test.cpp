@@ -0,0 +1,171 @@
+#include "Check.h"
+
+#include <utils/BuddyAllocator.h>
+#include <utils/GeometryAllocator.h>
+
+#include <set>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t pageSize     = 4096;
+constexpr std::size_t minBlockSize = 256;
+
+void TestBuddyAllocation()
+{
+    BuddyAllocator allocator{pageSize, minBlockSize};
+
+    // blocks are rounded up to powers of two and aligned to their size
+    const auto small  = allocator.Allocate(100);
+    const auto medium = allocator.Allocate(600);
+    const auto large  = allocator.Allocate(2048);
+    CHECK(small && medium && large);
+    CHECK(allocator.GetBlockSize(*small) == 256);
+    CHECK(allocator.GetBlockSize(*medium) == 1024);
+    CHECK(*medium % 1024 == 0);
+    CHECK(*large % 2048 == 0);
+    CHECK(allocator.GetUsedSize() == 256 + 1024 + 2048);
+
+    CHECK(!allocator.Allocate(1024));
+    CHECK(!allocator.Allocate(pageSize * 2));
+    CHECK(!allocator.Allocate(0));
+}
+
+void TestBuddyCoalescing()
+{
+    BuddyAllocator allocator{pageSize, minBlockSize};
+
+    std::vector<std::size_t> offsets;
+    for (std::size_t i = 0; i < pageSize / minBlockSize; ++i)
+        offsets.push_back(*allocator.Allocate(minBlockSize));
+
+    CHECK(!allocator.Allocate(1));
+    CHECK(allocator.GetLargestFreeBlock() == 0);
+
+    // the freed neighbours merge back into the whole range
+    for (std::size_t i = 0; i < offsets.size(); i += 2)
+        allocator.Free(offsets[i]);
+    CHECK(allocator.GetLargestFreeBlock() == minBlockSize);
+
+    for (std::size_t i = 1; i < offsets.size(); i += 2)
+        allocator.Free(offsets[i]);
+    CHECK(allocator.GetLargestFreeBlock() == pageSize);
+    CHECK(allocator.GetUsedSize() == 0);
+    CHECK(allocator.GetAllocationsCount() == 0);
+}
+
+void TestAlignment()
+{
+    GeometryAllocator allocator{pageSize, minBlockSize};
+
+    // vertex strides are not powers of two
+    for (std::size_t alignment : {12, 24, 36, 512})
+    {
+        const GeometryAllocator::Allocation allocation = allocator.Allocate(100, alignment);
+        CHECK(allocation.offset % alignment == 0);
+        CHECK(allocation.offset >= allocation.blockOffset);
+        CHECK(allocation.offset + allocation.size <= allocation.blockOffset + 2 * std::max<std::size_t>(alignment, 128));
+    }
+}
+
+void TestDedicatedPage()
+{
+    GeometryAllocator allocator{pageSize, minBlockSize};
+
+    const GeometryAllocator::Allocation small = allocator.Allocate(100, 4);
+    const GeometryAllocator::Allocation large = allocator.Allocate(pageSize * 3, 4);
+    CHECK(large.page != small.page);
+    CHECK(allocator.GetPageSize(large.page) == pageSize * 4);
+
+    // the dedicated page goes away with its allocation, the regular one is kept
+    allocator.Free(large);
+    CHECK(!allocator.IsPageAlive(large.page));
+
+    allocator.Free(small);
+    CHECK(allocator.IsPageAlive(small.page));
+    CHECK(allocator.ReleaseEmptyPages() == std::vector<uint32_t>{small.page});
+    CHECK(allocator.GetStatistics().pagesCount == 0);
+}
+
+// fills the pages and keeps the given number of blocks in every one of them
+std::vector<GeometryAllocator::Allocation> FillPages(GeometryAllocator& allocator, std::initializer_list<std::size_t> keptBlocks)
+{
+    const std::size_t blocksPerPage = pageSize / minBlockSize;
+
+    std::vector<GeometryAllocator::Allocation> all;
+    for (std::size_t i = 0; i < keptBlocks.size() * blocksPerPage; ++i)
+        all.push_back(allocator.Allocate(minBlockSize, 4));
+
+    std::vector<GeometryAllocator::Allocation> kept;
+    for (const GeometryAllocator::Allocation& allocation : all)
+    {
+        const std::size_t blockIdx = allocation.blockOffset / minBlockSize;
+        if (blockIdx < keptBlocks.begin()[allocation.page])
+            kept.push_back(allocation);
+        else
+            allocator.Free(allocation);
+    }
+
+    return kept;
+}
+
+void TestEvacuation()
+{
+    GeometryAllocator allocator{pageSize, minBlockSize};
+    FillPages(allocator, {1, 2, 3});
+    CHECK(allocator.GetStatistics().pagesCount == 3);
+
+    // the first page moves to the second one, which is not evacuated then, the third one follows it
+    const std::vector<GeometryAllocator::Move> moves = allocator.PlanEvacuation(0.5f);
+    CHECK(moves.size() == 4);
+
+    std::set<uint32_t> destinations;
+    for (const GeometryAllocator::Move& move : moves)
+    {
+        destinations.insert(move.to.page);
+        CHECK(move.from.size == move.to.size);
+        CHECK(move.to.offset % move.to.alignment == 0);
+    }
+
+    for (const GeometryAllocator::Move& move : moves)
+        CHECK(!destinations.contains(move.from.page));
+    CHECK(destinations == std::set<uint32_t>{1});
+
+    // evacuated pages don't take new allocations
+    const GeometryAllocator::Allocation allocation = allocator.Allocate(minBlockSize, 4);
+    CHECK(allocation.page == 1);
+    allocator.Free(allocation);
+
+    for (const GeometryAllocator::Move& move : moves)
+        allocator.Free(move.from);
+
+    CHECK(allocator.ReleaseEmptyPages() == (std::vector<uint32_t>{0, 2}));
+
+    const GeometryAllocator::Statistics statistics = allocator.GetStatistics();
+    CHECK(statistics.pagesCount == 1);
+    CHECK(statistics.allocationsCount == 6);
+    CHECK(statistics.blocksSize == 6 * minBlockSize);
+}
+
+void TestEvacuationRollback()
+{
+    GeometryAllocator allocator{pageSize, minBlockSize};
+    FillPages(allocator, {6, 16});
+
+    // the full page has no room for the sparse one, nothing is moved and both pages stay usable
+    CHECK(allocator.PlanEvacuation(0.5f).empty());
+    CHECK(allocator.GetStatistics().allocationsCount == 22);
+    CHECK(allocator.Allocate(minBlockSize, 4).page == 0);
+}
+}  // namespace
+
+int main()
+{
+    TestBuddyAllocation();
+    TestBuddyCoalescing();
+    TestAlignment();
+    TestDedicatedPage();
+    TestEvacuation();
+    TestEvacuationRollback();
+    return Check::Result();
+}
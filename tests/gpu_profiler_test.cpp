@@ -0,0 +1,184 @@
+#include "Check.h"
+
+#include <utils/GpuProfiler.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+// the queries are written with the tick set by the test, the resolve makes them readable
+class FakeTimestamps : public IGpuTimestamps
+{
+public:
+    static constexpr uint64_t frequency      = 10'000'000;  // 100 ns per tick
+    static constexpr uint64_t gpuTicks       = 1200;
+    static constexpr int64_t  cpuNanoseconds = 5'000'000;
+
+    uint64_t                 now = 0;
+    std::vector<uint64_t>    queries;
+    std::vector<uint64_t>    resolved;
+    std::vector<std::string> calls;
+
+    explicit FakeTimestamps(std::size_t queriesCount)
+        : queries(queriesCount, 0)
+        , resolved(queriesCount, 0)
+    {
+    }
+
+    uint64_t GetFrequency() const override
+    {
+        return frequency;
+    }
+
+    void GetCalibration(uint64_t& ticks, int64_t& nanoseconds) const override
+    {
+        ticks       = gpuTicks;
+        nanoseconds = cpuNanoseconds;
+    }
+
+    void WriteTimestamp(ID3D12GraphicsCommandList*, uint32_t query) override
+    {
+        queries[query] = now;
+    }
+
+    void Resolve(ID3D12GraphicsCommandList*, uint32_t firstQuery, uint32_t count) override
+    {
+        calls.push_back("Resolve " + std::to_string(firstQuery) + " " + std::to_string(count));
+        std::copy_n(queries.begin() + firstQuery, count, resolved.begin() + firstQuery);
+    }
+
+    void Read(uint32_t firstQuery, std::span<uint64_t> ticks) override
+    {
+        calls.push_back("Read " + std::to_string(firstQuery) + " " + std::to_string(ticks.size()));
+        std::copy_n(resolved.begin() + firstQuery, ticks.size(), ticks.begin());
+    }
+};
+
+constexpr std::size_t framesCount = 2;
+constexpr uint32_t    maxZones    = 4;
+
+const Profiler::Frame* FindFrame(uint64_t index)
+{
+    const std::deque<Profiler::Frame>& frames = Profiler::Get().GetFrames();
+    auto frame = std::find_if(frames.begin(), frames.end(), [&](const Profiler::Frame& frame) { return frame.index == index; });
+    return frame != frames.end() ? &*frame : nullptr;
+}
+
+void TestFrames()
+{
+    Profiler& profiler = Profiler::Get();
+    profiler.SetEnabled(true);
+
+    auto            fakeTimestamps = std::make_unique<FakeTimestamps>(framesCount * maxZones * 2);
+    FakeTimestamps& timestamps     = *fakeTimestamps;
+    GpuProfiler     gpuProfiler(profiler, std::move(fakeTimestamps), framesCount, maxZones);
+
+    // a pass nested in the frame zone, the first zone starts before the calibration
+    const uint64_t firstFrame = profiler.GetFrameIndex();
+    gpuProfiler.BeginFrame(0);
+    CHECK(!gpuProfiler.GetFrameMilliseconds());
+
+    timestamps.now        = 1000;
+    const uint32_t outer  = gpuProfiler.BeginZone(nullptr, "Frame");
+    timestamps.now        = 1100;
+    const uint32_t inner  = gpuProfiler.BeginZone(nullptr, "Pass");
+    timestamps.now        = 1300;
+    gpuProfiler.EndZone(nullptr, inner);
+    timestamps.now = 1500;
+    gpuProfiler.EndZone(nullptr, outer);
+    gpuProfiler.EndFrame(nullptr);
+    profiler.EndFrame();
+    CHECK(outer == 0 && inner == 1);
+    CHECK((timestamps.calls == std::vector<std::string>{"Resolve 0 4"}));
+
+    // the second context is not resolved yet, so nothing is read
+    gpuProfiler.BeginFrame(1);
+    CHECK(!gpuProfiler.GetFrameMilliseconds());
+    {
+        timestamps.now = 2000;
+        PROFILE_GPU_SCOPE(gpuProfiler, nullptr, "Second");
+        timestamps.now = 2600;
+    }
+    gpuProfiler.EndFrame(nullptr);
+    profiler.EndFrame();
+    CHECK(timestamps.calls.size() == 2 && timestamps.calls.back() == "Resolve 8 2");
+
+    // the first frame is read once its context is reused, it is added to its own profiler frame
+    gpuProfiler.BeginFrame(2);
+    CHECK(timestamps.calls.back() == "Read 0 4");
+    CHECK(gpuProfiler.GetFrameMilliseconds() && *gpuProfiler.GetFrameMilliseconds() == 500 * 1e3 / FakeTimestamps::frequency);
+    profiler.EndFrame();
+
+    const Profiler::Frame* frame = FindFrame(firstFrame);
+    CHECK(frame && frame->hasGpuEvents);
+    if (frame)
+    {
+        std::vector<const Profiler::Event*> gpuEvents;
+        for (const Profiler::Event& event : frame->events)
+        {
+            if (event.thread == Profiler::gpuThread)
+                gpuEvents.push_back(&event);
+        }
+
+        // the ticks are 100 ns, the calibration tick 1200 is at 5 ms
+        CHECK(gpuEvents.size() == 2);
+        if (gpuEvents.size() == 2)
+        {
+            CHECK(std::string(gpuEvents[0]->name) == "Frame" && gpuEvents[0]->depth == 0);
+            CHECK(gpuEvents[0]->start == 4'980'000 && gpuEvents[0]->end == 5'030'000);
+            CHECK(std::string(gpuEvents[1]->name) == "Pass" && gpuEvents[1]->depth == 1);
+            CHECK(gpuEvents[1]->start == 4'990'000 && gpuEvents[1]->end == 5'010'000);
+        }
+    }
+
+    // the second frame comes with the next reuse of its context
+    const Profiler::Frame* second = FindFrame(firstFrame + 1);
+    CHECK(second && !second->hasGpuEvents);
+    gpuProfiler.BeginFrame(3);
+    CHECK(gpuProfiler.GetFrameMilliseconds() && *gpuProfiler.GetFrameMilliseconds() == 600 * 1e3 / FakeTimestamps::frequency);
+    CHECK(second && second->hasGpuEvents);
+}
+
+void TestZonesLimit()
+{
+    auto            fakeTimestamps = std::make_unique<FakeTimestamps>(framesCount * maxZones * 2);
+    FakeTimestamps& timestamps     = *fakeTimestamps;
+    GpuProfiler     gpuProfiler(Profiler::Get(), std::move(fakeTimestamps), framesCount, maxZones);
+
+    // the zones over the limit write no queries, the nesting goes on after them
+    gpuProfiler.BeginFrame(0);
+    std::vector<uint32_t> zones;
+    for (uint32_t i = 0; i < maxZones + 1; ++i)
+    {
+        timestamps.now = 100 + i;
+        zones.push_back(gpuProfiler.BeginZone(nullptr, "Zone"));
+    }
+    CHECK(zones.back() == GpuProfiler::invalidZone);
+    timestamps.now = 200;
+    for (auto zone = zones.rbegin(); zone != zones.rend(); ++zone)
+        gpuProfiler.EndZone(nullptr, *zone);
+    gpuProfiler.EndFrame(nullptr);
+    CHECK((timestamps.calls == std::vector<std::string>{"Resolve 0 8"}));
+
+    gpuProfiler.BeginFrame(1);
+    gpuProfiler.BeginFrame(2);
+    CHECK(gpuProfiler.GetFrameMilliseconds() && *gpuProfiler.GetFrameMilliseconds() == 100 * 1e3 / FakeTimestamps::frequency);
+
+    // a frame without zones resolves nothing and has no time
+    gpuProfiler.EndFrame(nullptr);
+    gpuProfiler.BeginFrame(3);
+    gpuProfiler.BeginFrame(4);
+    CHECK(!gpuProfiler.GetFrameMilliseconds());
+}
+}  // namespace
+
+int main()
+{
+    TestFrames();
+    TestZonesLimit();
+
+    return Check::Result();
+}
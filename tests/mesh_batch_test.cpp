@@ -0,0 +1,181 @@
+#include "Check.h"
+
+#include <utils/MeshBatch.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+// records the calls, the build sizes are taken from the test
+class RecordingDevice : public MeshBatch::IBatchDevice
+{
+public:
+    std::vector<MeshBatch::BuildSizes> buildSizes;
+    std::vector<std::string>           calls;
+    std::vector<uint8_t>               staging;
+    std::size_t                        scratchSize = 0;
+
+    uint8_t* AllocateGeometry(const MeshBatch::GeometryLayout& layout) override
+    {
+        calls.push_back("AllocateGeometry");
+        staging.assign(layout.bufferSize, 0);
+        return staging.data();
+    }
+
+    void UploadGeometry(std::size_t size) override
+    {
+        calls.push_back("UploadGeometry " + std::to_string(size));
+    }
+
+    MeshBatch::BuildSizes GetBuildSizes(std::size_t object) override
+    {
+        calls.push_back("GetBuildSizes " + std::to_string(object));
+        return buildSizes[object];
+    }
+
+    void AllocateBuilds(std::span<const MeshBatch::BuildSizes> builds, std::size_t scratch) override
+    {
+        calls.push_back("AllocateBuilds " + std::to_string(builds.size()));
+        scratchSize = scratch;
+    }
+
+    void ScratchBarrier() override
+    {
+        calls.push_back("ScratchBarrier");
+    }
+
+    void BuildBLAS(std::size_t object, std::size_t scratchOffset) override
+    {
+        calls.push_back("BuildBLAS " + std::to_string(object) + " " + std::to_string(scratchOffset));
+    }
+
+    void EmitCompactedSizes(std::size_t objectsCount) override
+    {
+        calls.push_back("EmitCompactedSizes " + std::to_string(objectsCount));
+    }
+
+    void Execute() override
+    {
+        calls.push_back("Execute");
+    }
+};
+
+struct TestMesh
+{
+    std::vector<float>    vertices;
+    std::vector<uint32_t> indices;
+
+    MeshBatch::MeshDesc GetDesc() const
+    {
+        return {{reinterpret_cast<const uint8_t*>(vertices.data()), vertices.size() * sizeof(float)}, 3 * sizeof(float), indices};
+    }
+};
+
+TestMesh CreateTriangle(float offset)
+{
+    return {{offset, 0.0f, 0.0f, offset + 1.0f, 0.0f, 0.0f, offset, 1.0f, 0.0f}, {0, 1, 2}};
+}
+
+void TestBatchOrder()
+{
+    const TestMesh                 meshes[] = {CreateTriangle(0.0f), CreateTriangle(1.0f), CreateTriangle(2.0f)};
+    const MeshBatch::MeshDesc      descs[]  = {meshes[0].GetDesc(), meshes[1].GetDesc(), meshes[2].GetDesc()};
+    const MeshBatch::GeometryLayout layout  = MeshBatch::PlanGeometry(descs);
+
+    RecordingDevice device;
+    device.buildSizes = {{1000, 300}, {1000, 200}, {1000, 100}};
+    MeshBatch::RecordBatch(descs, 3, true, 768, device);
+
+    // the third build does not fit the budget and waits for the first two
+    const std::vector<std::string> expected = {
+        "AllocateGeometry",
+        "UploadGeometry " + std::to_string(layout.bufferSize),
+        "GetBuildSizes 0",
+        "GetBuildSizes 1",
+        "GetBuildSizes 2",
+        "AllocateBuilds 3",
+        "BuildBLAS 0 0",
+        "BuildBLAS 1 512",
+        "ScratchBarrier",
+        "BuildBLAS 2 0",
+        "EmitCompactedSizes 3",
+        "Execute",
+    };
+    CHECK(device.calls == expected);
+    CHECK(device.scratchSize == 768);
+
+    // the staging memory holds the meshes at their placements, the indices are 16-bit
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        const MeshBatch::MeshPlacement& placement = layout.meshes[i];
+        CHECK(std::memcmp(device.staging.data() + placement.vertexOffset, meshes[i].vertices.data(), placement.vertexSize) == 0);
+        CHECK(placement.indexStride == sizeof(uint16_t));
+
+        const uint16_t* indices = reinterpret_cast<const uint16_t*>(device.staging.data() + placement.indexOffset);
+        CHECK(indices[0] == 0 && indices[1] == 1 && indices[2] == 2);
+    }
+}
+
+void TestMergedObjects()
+{
+    const TestMesh            meshes[] = {CreateTriangle(0.0f), CreateTriangle(1.0f), CreateTriangle(2.0f)};
+    const MeshBatch::MeshDesc descs[]  = {meshes[0].GetDesc(), meshes[1].GetDesc(), meshes[2].GetDesc()};
+
+    // the builds are per object, not per mesh
+    RecordingDevice device;
+    device.buildSizes = {{1000, 300}};
+    MeshBatch::RecordBatch(descs, 1, true, 1024, device);
+
+    CHECK(device.calls.size() == 7);
+    CHECK(device.calls[2] == "GetBuildSizes 0");
+    CHECK(device.calls[4] == "BuildBLAS 0 0");
+    CHECK(device.calls.back() == "Execute");
+}
+
+void TestWithoutBlas()
+{
+    const TestMesh            mesh    = CreateTriangle(0.0f);
+    const MeshBatch::MeshDesc descs[] = {mesh.GetDesc()};
+
+    RecordingDevice device;
+    MeshBatch::RecordBatch(descs, 1, false, 1024, device);
+
+    const std::vector<std::string> expected = {"AllocateGeometry", "UploadGeometry 44", "Execute"};
+    CHECK(device.calls == expected);
+}
+
+void TestEmptyBatch()
+{
+    RecordingDevice device;
+    MeshBatch::RecordBatch({}, 0, true, 1024, device);
+    CHECK(device.calls.empty());
+}
+
+void TestOversizedBuild()
+{
+    const TestMesh            meshes[] = {CreateTriangle(0.0f), CreateTriangle(1.0f)};
+    const MeshBatch::MeshDesc descs[]  = {meshes[0].GetDesc(), meshes[1].GetDesc()};
+
+    // a build larger than the budget gets the whole arena, which grows to fit it
+    RecordingDevice device;
+    device.buildSizes = {{1000, 100}, {1000, 4000}};
+    MeshBatch::RecordBatch(descs, 2, true, 1024, device);
+
+    CHECK(device.calls[5] == "BuildBLAS 0 0");
+    CHECK(device.calls[6] == "ScratchBarrier");
+    CHECK(device.calls[7] == "BuildBLAS 1 0");
+    CHECK(device.scratchSize == 4096);
+}
+}  // namespace
+
+int main()
+{
+    TestBatchOrder();
+    TestMergedObjects();
+    TestWithoutBlas();
+    TestEmptyBatch();
+    TestOversizedBuild();
+    return Check::Result();
+}
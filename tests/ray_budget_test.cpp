@@ -0,0 +1,116 @@
+#include "Check.h"
+
+#include <utils/RayBudget.h>
+
+#include <stdexcept>
+
+namespace
+{
+constexpr float target = 10.0f;
+
+void TestDeadBand()
+{
+    // the average stays within 5% of the target, so the samples stay too
+    RayBudget budget{target, 4.0f};
+    CHECK(budget.GetSamples() == 1.0f);
+
+    budget.Update(target * 1.04f);
+    CHECK(budget.GetSamples() == 1.0f);
+    for (int frame = 0; frame < 100; ++frame)
+        budget.Update(frame % 2 == 0 ? target * 0.96f : target * 1.04f);
+    CHECK(budget.GetSamples() == 1.0f);
+
+    // just out of it they change
+    RayBudget slower{target, 4.0f};
+    slower.Update(target * 1.06f);
+    CHECK(slower.GetSamples() < 1.0f);
+
+    RayBudget faster{target, 4.0f};
+    faster.Update(target * 0.94f);
+    CHECK(faster.GetSamples() > 1.0f);
+}
+
+void TestLongFramesClamped()
+{
+    // the error is clamped at twice the target, a loading frame drops the samples as much as that one
+    RayBudget twice{target, 4.0f};
+    twice.Update(target * 2.0f);
+
+    RayBudget longer{target, 4.0f};
+    longer.Update(target * 20.0f);
+
+    CHECK(twice.GetSamples() == 0.75f);
+    CHECK(longer.GetSamples() == twice.GetSamples());
+}
+
+void TestMaxSamples()
+{
+    RayBudget budget{target, 4.0f};
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        budget.Update(target * 0.1f);
+        CHECK(budget.GetSamples() <= 4.0f);
+    }
+    CHECK(budget.GetSamples() == 4.0f);
+
+    // lowering the limit cuts the samples right away
+    budget.SetMaxSamples(2.0f);
+    CHECK(budget.GetSamples() == 2.0f);
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        budget.Update(target * 0.1f);
+        CHECK(budget.GetSamples() <= 2.0f);
+    }
+    CHECK(budget.GetRaysCount(100, 10) == 2000);
+
+    budget.SetMaxSamples(-1.0f);
+    CHECK(budget.GetMaxSamples() == 0.0f && budget.GetSamples() == 0.0f);
+}
+
+void TestRecovery()
+{
+    RayBudget budget{target, 4.0f};
+    for (int frame = 0; frame < 100; ++frame)
+        budget.Update(target * 3.0f);
+    CHECK(budget.GetSamples() == 0.0f);
+    CHECK(budget.GetRaysCount(100, 10) == 0);
+
+    // the average has to come down first, then the samples grow by a sample's share at least
+    for (int frame = 0; frame < 100 && budget.GetSamples() == 0.0f; ++frame)
+        budget.Update(target * 0.5f);
+    CHECK(budget.GetSamples() > 0.0f);
+
+    for (int frame = 0; frame < 100; ++frame)
+        budget.Update(target * 0.5f);
+    CHECK(budget.GetSamples() == 4.0f);
+}
+
+void TestInvalidParameters()
+{
+    bool thrown = false;
+    try
+    {
+        RayBudget budget{0.0f, 4.0f};
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    RayBudget budget{target, 4.0f};
+    budget.SetTarget(-1.0f);
+    CHECK(budget.GetTarget() > 0.0f);
+}
+}  // namespace
+
+int main()
+{
+    TestDeadBand();
+    TestLongFramesClamped();
+    TestMaxSamples();
+    TestRecovery();
+    TestInvalidParameters();
+
+    return Check::Result();
+}
@@ -0,0 +1,227 @@
+#include "Check.h"
+
+#include <utils/Intersection.h>
+#include <utils/WorldQuery.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+constexpr float epsilon = 1e-4f;
+
+bool IsNear(float a, float b)
+{
+    return std::abs(a - b) < epsilon;
+}
+
+bool IsNear(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return IsNear(a.x, b.x) && IsNear(a.y, b.y) && IsNear(a.z, b.z);
+}
+
+// a right triangle in the z = 0 plane
+const XMVECTOR p0 = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
+const XMVECTOR p1 = XMVectorSet(2.0f, 0.0f, 0.0f, 0.0f);
+const XMVECTOR p2 = XMVectorSet(0.0f, 2.0f, 0.0f, 0.0f);
+
+constexpr float radius = 0.5f;
+
+std::optional<Intersection::TriangleHit> Sweep(XMFLOAT3 center, XMFLOAT3 direction, float tMax = 100.0f)
+{
+    return Intersection::SweepSphereTriangle(XMLoadFloat3(&center), XMLoadFloat3(&direction), p0, p1, p2, radius, 0.0f, tMax);
+}
+
+void TestSweepSphereTriangle()
+{
+    // the face is touched when the center is a radius above the plane
+    std::optional<Intersection::TriangleHit> hit = Sweep({0.5f, 0.5f, 3.0f}, {0.0f, 0.0f, -1.0f});
+    CHECK(hit && IsNear(hit->t, 2.5f) && IsNear(hit->barycentrics.x, 0.25f) && IsNear(hit->barycentrics.y, 0.25f));
+
+    // from below too, both sides are solid; the direction is measured in its lengths
+    hit = Sweep({0.5f, 0.5f, -3.0f}, {0.0f, 0.0f, 2.0f});
+    CHECK(hit && IsNear(hit->t, 1.25f));
+
+    // the first edge, in the plane of the triangle, is touched at its middle
+    hit = Sweep({1.0f, -1.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+    CHECK(hit && IsNear(hit->t, 0.5f) && IsNear(hit->barycentrics.x, 0.5f) && IsNear(hit->barycentrics.y, 0.0f));
+
+    // the hypotenuse seen from above its middle at 45 degrees
+    const float diagonal = std::sqrt(0.5f);
+    hit                  = Sweep({1.0f + 2.0f * diagonal, 1.0f + 2.0f * diagonal, 0.0f}, {-diagonal, -diagonal, 0.0f});
+    CHECK(hit && IsNear(hit->t, 2.0f - radius) && IsNear(hit->barycentrics.x, 0.5f) && IsNear(hit->barycentrics.y, 0.5f));
+
+    // the vertex at the origin, the edges next to it are passed by their ends
+    hit = Sweep({-1.0f, -1.0f, 0.0f}, {diagonal, diagonal, 0.0f});
+    CHECK(hit && IsNear(hit->t, std::sqrt(2.0f) - radius) && hit->barycentrics.x == 0.0f && hit->barycentrics.y == 0.0f);
+
+    // the vertex from above, out of the face
+    hit = Sweep({2.0f, 0.0f, 2.0f}, {0.0f, 0.0f, -1.0f});
+    CHECK(hit && IsNear(hit->t, 2.0f - radius) && hit->barycentrics.x == 1.0f && hit->barycentrics.y == 0.0f);
+
+    // a miss next to the vertex, and a hit beyond the distance limit
+    CHECK(!Sweep({2.6f, 0.0f, 2.0f}, {0.0f, 0.0f, -1.0f}));
+    CHECK(!Sweep({0.5f, 0.5f, 3.0f}, {0.0f, 0.0f, -1.0f}, 2.0f));
+
+    // the embedded spheres move out of the face and the edge they touch
+    CHECK(!Sweep({0.5f, 0.5f, 0.2f}, {0.0f, 0.0f, 1.0f}));
+    CHECK(!Sweep({1.0f, -0.3f, 0.0f}, {0.0f, -1.0f, 0.0f}));
+}
+
+void TestRayTriangle()
+{
+    const XMVECTOR down = XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f);
+    const XMVECTOR up   = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+
+    // the determinant of the triangle is positive for the rays going down, the culled back face is below
+    std::optional<Intersection::TriangleHit> hit =
+        Intersection::RayTriangle(XMVectorSet(0.5f, 0.5f, 1.0f, 0.0f), down, p0, p1, p2, 0.0f, 10.0f, true);
+    CHECK(hit && IsNear(hit->t, 1.0f));
+    CHECK(!Intersection::RayTriangle(XMVectorSet(0.5f, 0.5f, -1.0f, 0.0f), up, p0, p1, p2, 0.0f, 10.0f, true));
+    CHECK(Intersection::RayTriangle(XMVectorSet(0.5f, 0.5f, -1.0f, 0.0f), up, p0, p1, p2, 0.0f, 10.0f, false));
+    CHECK(!Intersection::RayTriangle(XMVectorSet(0.5f, 0.5f, 1.0f, 0.0f), down, p0, p1, p2, 0.0f, 0.9f, true));
+}
+
+// 5x5 heights of the plane z = x with a peak of 4 at (2, 2)
+HeightField CreateHeightField(bool withPeak)
+{
+    std::vector<float> heights(25);
+    for (std::size_t y = 0; y < 5; ++y)
+    {
+        for (std::size_t x = 0; x < 5; ++x)
+            heights[y * 5 + x] = withPeak ? (x == 2 && y == 2 ? 4.0f : 0.0f) : (float)x;
+    }
+
+    return HeightField(std::move(heights), 5, 5, {0.0f, 0.0f}, 1.0f);
+}
+
+BVH::Ray MakeRay(XMFLOAT3 origin, XMFLOAT3 direction)
+{
+    BVH::Ray ray;
+    ray.origin    = origin;
+    ray.direction = direction;
+    return ray;
+}
+
+void TestHeightField()
+{
+    const HeightField slope = CreateHeightField(false);
+    CHECK(slope.GetHeight(2.25f, 1.75f) && IsNear(*slope.GetHeight(2.25f, 1.75f), 2.25f));
+    CHECK(slope.GetHeight(4.0f, 4.0f) && IsNear(*slope.GetHeight(4.0f, 4.0f), 4.0f));
+    CHECK(!slope.GetHeight(-0.1f, 1.0f) && !slope.GetHeight(1.0f, 4.1f));
+
+    // the normal of the slope faces the ray
+    const float                           diagonal = std::sqrt(0.5f);
+    std::optional<HeightField::Hit> hit = slope.Raycast(MakeRay({1.5f, 1.5f, 10.0f}, {0.0f, 0.0f, -1.0f}));
+    CHECK(hit && IsNear(hit->t, 8.5f) && IsNear(hit->normal, {-diagonal, 0.0f, diagonal}));
+
+    // nothing outside of the grid, and nothing behind the ray
+    CHECK(!slope.Raycast(MakeRay({5.5f, 1.5f, 10.0f}, {0.0f, 0.0f, -1.0f})));
+    CHECK(!slope.Raycast(MakeRay({1.5f, 1.5f, 10.0f}, {0.0f, 0.0f, 1.0f})));
+
+    // a horizontal ray hits the side of the peak: in the cell (1, 1) at v = 0.9 the height is 4u - 0.4
+    const HeightField peak = CreateHeightField(true);
+    hit                    = peak.Raycast(MakeRay({-1.0f, 1.9f, 1.0f}, {1.0f, 0.0f, 0.0f}));
+    CHECK(hit && IsNear(hit->t, 2.35f));
+    CHECK(!peak.Raycast(MakeRay({-1.0f, 1.9f, 4.5f}, {1.0f, 0.0f, 0.0f})));
+
+    // the sphere lands on the top of the peak with its lowest point
+    hit = peak.SphereCast(MakeRay({2.0f, 2.0f, 10.0f}, {0.0f, 0.0f, -1.0f}), radius);
+    CHECK(hit && IsNear(hit->t, 10.0f - 4.0f - radius) && IsNear(hit->normal, {0.0f, 0.0f, 1.0f}));
+}
+
+void TestWorldQuery()
+{
+    WorldQuery query{2};
+    query.SetHeightField(std::make_shared<HeightField>(CreateHeightField(true)));
+
+    // the directions are normalized, so the distances are the world ones
+    std::optional<WorldQuery::Hit> hit = query.Raycast({0.5f, 0.5f, 10.0f}, {0.0f, 0.0f, -2.0f}, 100.0f);
+    CHECK(hit && hit->isTerrain && IsNear(hit->distance, 10.0f) && IsNear(hit->position, {0.5f, 0.5f, 0.0f}));
+    CHECK(!query.Raycast({0.5f, 0.5f, 10.0f}, {0.0f, 0.0f, -1.0f}, 9.0f));
+
+    CHECK(query.HasLineOfSight({0.5f, 0.5f, 1.0f}, {3.5f, 0.5f, 1.0f}));
+    CHECK(!query.HasLineOfSight({0.5f, 1.9f, 1.0f}, {3.5f, 1.9f, 1.0f}));
+
+    // the sphere slides along the flat ground, it keeps the radius and a small gap above it
+    const XMFLOAT3 moved = query.MoveSphere({0.5f, 0.5f, 1.0f}, {1.0f, 0.5f, 0.0f}, radius);
+    CHECK(IsNear(moved.x, 1.0f) && IsNear(moved.y, 0.5f) && moved.z >= radius && moved.z < radius + 0.01f);
+}
+
+// a noise terrain like the island one, the queries are cast from above it in random directions
+void TestBatchedQueries()
+{
+    constexpr std::size_t size          = 512;
+    constexpr std::size_t queriesCount  = 20000;
+    constexpr float       cellSize      = 0.5f;
+    constexpr float       sphereRadius  = 0.3f;
+    constexpr float       terrainHeight = 20.0f;
+
+    std::vector<float> heights(size * size);
+    for (std::size_t y = 0; y < size; ++y)
+    {
+        for (std::size_t x = 0; x < size; ++x)
+            heights[y * size + x] = terrainHeight * (0.5f + 0.25f * std::sin(x * 0.05f) + 0.25f * std::cos(y * 0.07f));
+    }
+
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> position(0.0f, (size - 1) * cellSize);
+    std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+
+    std::vector<WorldQuery::Query> rays(queriesCount);
+    for (WorldQuery::Query& ray : rays)
+    {
+        ray.origin    = {position(random), position(random), terrainHeight * 2.0f};
+        ray.direction = {spread(random), spread(random), -1.0f};
+    }
+
+    std::vector<WorldQuery::Query> spheres = rays;
+    for (WorldQuery::Query& sphere : spheres)
+        sphere.radius = sphereRadius;
+
+    WorldQuery query;
+    query.SetHeightField(std::make_shared<HeightField>(std::move(heights), size, size, XMFLOAT2{0.0f, 0.0f}, cellSize));
+
+    std::vector<std::optional<WorldQuery::Hit>> hits(queriesCount);
+    for (const auto& [name, queries] : {std::pair{"rays", &rays}, std::pair{"spheres", &spheres}})
+    {
+        const auto start = std::chrono::steady_clock::now();
+        query.Cast(*queries, hits);
+        const double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        // the batches give the same hits as the single queries
+        std::size_t hitsCount = 0;
+        std::size_t different = 0;
+        for (std::size_t i = 0; i < queriesCount; ++i)
+        {
+            const WorldQuery::Query&             single   = (*queries)[i];
+            const std::optional<WorldQuery::Hit> expected = single.radius > 0.0f ? query.SphereCast(single.origin, single.radius, single.direction, single.maxDistance)
+                                                                                 : query.Raycast(single.origin, single.direction, single.maxDistance);
+            hitsCount += hits[i] ? 1 : 0;
+            different += hits[i].has_value() != expected.has_value() || (hits[i] && hits[i]->distance != expected->distance) ? 1 : 0;
+        }
+
+        CHECK(hitsCount > queriesCount / 2);
+        CHECK(different == 0);
+        std::cout << queriesCount << " " << name << " on " << std::thread::hardware_concurrency() << " threads: "
+                  << microseconds / queriesCount << " us per query, " << hitsCount << " hits" << std::endl;
+    }
+}
+}  // namespace
+
+int main()
+{
+    TestSweepSphereTriangle();
+    TestRayTriangle();
+    TestHeightField();
+    TestWorldQuery();
+    TestBatchedQueries();
+
+    return Check::Result();
+}
@@ -36,6 +36,20 @@ public:
         return {_eyePos.x, _eyePos.y, _eyePos.z};
     }
 
+    // world space ray through a point of the screen given in pixels, the direction is normalized
+    void GetPickingRay(float x, float y, XMFLOAT3& origin, XMFLOAT3& direction) const
+    {
+        const float screenX = x / _screenWidth * 2.0f - 1.0f;
+        const float screenY = 1.0f - y / _screenHeight * 2.0f;
+
+        // the point is unprojected from the far plane, so the ray goes through the whole frustum
+        const XMMATRIX inverseViewProj = XMMatrixInverse(nullptr, GetViewProjMatrix());
+        const XMVECTOR target          = XMVector3TransformCoord(XMVectorSet(screenX, screenY, 1.0f, 1.0f), inverseViewProj);
+
+        origin = _eyePos;
+        XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSubtract(target, XMLoadFloat3(&_eyePos))));
+    }
+
 protected:
     void SetTriada(XMFLOAT3 eyePos, XMFLOAT3 lookAt, XMFLOAT3 up)
     {
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+// Platform independent, Math.h brings it to the D3D12 code too.
+namespace Math
+{
+// to the nearest multiple of the alignment, it doesn't have to be a power of two (e.g. a vertex stride)
+constexpr std::size_t AlignTo(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}  // namespace Math
@@ -0,0 +1,125 @@
+#include "stdafx.h"
+
+#include "AsyncBuildQueue.h"
+
+#include "DXSampleHelper.h"
+
+AsyncBuildQueue::AsyncBuildQueue(ComPtr<ID3D12Device5> device)
+    : _device(device)
+    , _scheduler(*this)
+{
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Type                     = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+    queueDesc.Flags                    = D3D12_COMMAND_QUEUE_FLAG_NONE;
+
+    ThrowIfFailed(_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&_queue)));
+    _queue->SetName(L"Acceleration structures builds queue");
+
+    ThrowIfFailed(_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_fence)));
+    _event = CreateEvent(NULL, FALSE, FALSE, nullptr);
+    assert(_event);
+}
+
+AsyncBuildQueue::~AsyncBuildQueue()
+{
+    Flush();
+    CloseHandle(_event);
+}
+
+std::unique_ptr<CommandList> AsyncBuildQueue::AcquireCommandList()
+{
+    if (_freeCmdLists.empty())
+        return std::make_unique<CommandList>(CommandListType::Compute, _device);
+
+    std::unique_ptr<CommandList> output = std::move(_freeCmdLists.back());
+    _freeCmdLists.pop_back();
+    output->Reset();
+
+    return output;
+}
+
+uint64_t AsyncBuildQueue::Execute(std::unique_ptr<CommandList> cmdList, BuildScheduler::Callback onCompleted)
+{
+    assert(cmdList->GetType() == CommandListType::Compute);
+
+    std::array<ID3D12CommandList*, 1> cmdListsArray = {cmdList->GetInternal().Get()};
+    _queue->ExecuteCommandLists((UINT)cmdListsArray.size(), cmdListsArray.data());
+
+    // std::function requires copyable callables, so the list is moved into a shared pointer
+    std::shared_ptr<CommandList> executed{cmdList.release()};
+    return _scheduler.Submit([this, executed, onCompleted = std::move(onCompleted)]() {
+        if (onCompleted)
+            onCompleted();
+
+        executed->ReleaseTrackedObjects();
+        _freeCmdLists.emplace_back(std::make_unique<CommandList>(std::move(*executed)));
+    });
+}
+
+uint64_t AsyncBuildQueue::Execute(const CommandList& cmdList, BuildScheduler::Callback onCompleted)
+{
+    assert(cmdList.GetType() == CommandListType::Compute);
+
+    std::array<ID3D12CommandList*, 1> cmdListsArray = {cmdList.GetInternal().Get()};
+    _queue->ExecuteCommandLists((UINT)cmdListsArray.size(), cmdListsArray.data());
+
+    // the copy shares the native list and the allocator, so they outlive the caller's object
+    return _scheduler.Submit([executed = cmdList, onCompleted = std::move(onCompleted)]() {
+        if (onCompleted)
+            onCompleted();
+    });
+}
+
+void AsyncBuildQueue::WaitForQueue(ID3D12Fence* fence, uint64_t value)
+{
+    ThrowIfFailed(_queue->Wait(fence, value));
+}
+
+void AsyncBuildQueue::InsertWait(ID3D12CommandQueue* queue, uint64_t value)
+{
+    // the signals are issued on submission, so the fence is guaranteed to reach the value
+    const uint64_t waitValue = _scheduler.GetWaitValue(value);
+    if (waitValue != 0)
+        ThrowIfFailed(queue->Wait(_fence.Get(), waitValue));
+}
+
+std::size_t AsyncBuildQueue::Poll()
+{
+    return _scheduler.Poll();
+}
+
+void AsyncBuildQueue::WaitForCompletion(uint64_t value)
+{
+    _scheduler.WaitForCompletion(value);
+}
+
+void AsyncBuildQueue::Flush()
+{
+    _scheduler.Flush();
+}
+
+bool AsyncBuildQueue::IsCompleted(uint64_t value) const
+{
+    return _scheduler.IsCompleted(value);
+}
+
+uint64_t AsyncBuildQueue::GetLastSubmitted() const
+{
+    return _scheduler.GetLastSubmitted();
+}
+
+void AsyncBuildQueue::Signal(uint64_t value)
+{
+    ThrowIfFailed(_queue->Signal(_fence.Get(), value));
+}
+
+uint64_t AsyncBuildQueue::GetCompletedValue() const
+{
+    return _fence->GetCompletedValue();
+}
+
+void AsyncBuildQueue::WaitForValue(uint64_t value)
+{
+    ThrowIfFailed(_fence->SetEventOnCompletion(value, _event));
+    WaitForSingleObject(_event, INFINITE);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "BuildScheduler.h"
+#include "CommandList.h"
+
+// Dedicated compute queue for acceleration structure builds and geometry uploads,
+// the work runs in parallel with the rendering and nobody waits for it on the CPU
+class AsyncBuildQueue : public IBuildQueue
+{
+public:
+    explicit AsyncBuildQueue(ComPtr<ID3D12Device5> device);
+    ~AsyncBuildQueue();
+
+    AsyncBuildQueue(const AsyncBuildQueue&) = delete;
+    AsyncBuildQueue& operator=(const AsyncBuildQueue&) = delete;
+
+    // command lists are recycled once the GPU is done with them
+    std::unique_ptr<CommandList> AcquireCommandList();
+
+    // the list has to be closed, objects tracked by it are kept alive till the end of the execution
+    uint64_t Execute(std::unique_ptr<CommandList> cmdList, BuildScheduler::Callback onCompleted = {});
+    uint64_t Execute(const CommandList& cmdList, BuildScheduler::Callback onCompleted = {});
+
+    // makes this queue wait (on the GPU) for the work of another one, e.g. for the frames reading a buffer
+    void WaitForQueue(ID3D12Fence* fence, uint64_t value);
+    // makes another queue wait (on the GPU) for the builds up to the value
+    void InsertWait(ID3D12CommandQueue* queue, uint64_t value);
+
+    std::size_t Poll();
+    void        WaitForCompletion(uint64_t value);
+    void        Flush();
+
+    bool     IsCompleted(uint64_t value) const;
+    uint64_t GetLastSubmitted() const;
+
+    // IBuildQueue
+    void     Signal(uint64_t value) override;
+    uint64_t GetCompletedValue() const override;
+    void     WaitForValue(uint64_t value) override;
+
+private:
+    ComPtr<ID3D12Device5>      _device;
+    ComPtr<ID3D12CommandQueue> _queue;
+    ComPtr<ID3D12Fence>        _fence;
+    HANDLE                     _event = nullptr;
+
+    BuildScheduler                            _scheduler;
+    std::vector<std::unique_ptr<CommandList>> _freeCmdLists;
+};
@@ -0,0 +1,550 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <thread>
+
+namespace
+{
+using namespace DirectX;
+
+struct Bounds
+{
+    XMVECTOR min = XMVectorReplicate(std::numeric_limits<float>::max());
+    XMVECTOR max = XMVectorReplicate(std::numeric_limits<float>::lowest());
+
+    void Grow(FXMVECTOR point)
+    {
+        min = XMVectorMin(min, point);
+        max = XMVectorMax(max, point);
+    }
+
+    void Grow(const Bounds& other)
+    {
+        min = XMVectorMin(min, other.min);
+        max = XMVectorMax(max, other.max);
+    }
+
+    float Extent(int axis) const
+    {
+        return XMVectorGetByIndex(XMVectorSubtract(max, min), axis);
+    }
+
+    float Area() const
+    {
+        XMFLOAT3 size;
+        XMStoreFloat3(&size, XMVectorSubtract(max, min));
+        if (size.x < 0.0f)
+            return 0.0f;
+
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+struct Primitive
+{
+    Bounds   bounds;
+    XMVECTOR centroid;
+};
+
+constexpr std::size_t MaxBinsCount = 64;
+
+// bounds of the primitives and of their centroids, the latter are what the bins divide
+struct RangeBounds
+{
+    Bounds bounds;
+    Bounds centroids;
+
+    void Grow(const Primitive& primitive)
+    {
+        bounds.Grow(primitive.bounds);
+        centroids.Grow(primitive.centroid);
+    }
+
+    void Grow(const RangeBounds& other)
+    {
+        bounds.Grow(other.bounds);
+        centroids.Grow(other.centroids);
+    }
+};
+
+struct Split
+{
+    int         axis      = -1;  // no split was found
+    std::size_t bin       = 0;   // the last bin of the left child
+    std::size_t binsCount = 0;
+    float       scale     = 0.0f;  // bins per unit of the centroid bounds along the axis
+    float       cost      = std::numeric_limits<float>::max();
+    RangeBounds left;
+    RangeBounds right;
+};
+
+class Builder
+{
+public:
+    Builder(std::span<const Primitive> primitives, std::span<uint32_t> order, const BVH::Options& options)
+        : _primitives(primitives)
+        , _order(order)
+        , _options(options)
+    {
+    }
+
+    RangeBounds CalculateBounds(std::size_t begin, std::size_t end) const
+    {
+        RangeBounds output;
+        for (std::size_t i = begin; i < end; ++i)
+            output.Grow(_primitives[_order[i]]);
+
+        return output;
+    }
+
+    void BuildSubtree(std::size_t begin, std::size_t end, const RangeBounds& bounds, std::vector<BVH::Node>& nodes) const
+    {
+        const std::size_t nodeIdx = nodes.size();
+        BVH::Node&        node    = nodes.emplace_back();
+        XMStoreFloat3(&node.boundsMin, bounds.bounds.min);
+        XMStoreFloat3(&node.boundsMax, bounds.bounds.max);
+
+        const std::size_t count = end - begin;
+        Split             split = count > 1 ? FindSplit(begin, end, bounds) : Split{};
+
+        const float leafCost = _options.intersectionCost * count;
+        if (count <= _options.maxLeafSize && split.cost >= leafCost)
+        {
+            nodes[nodeIdx].offset = (uint32_t)begin;
+            nodes[nodeIdx].count  = (uint32_t)count;
+            return;
+        }
+
+        const std::size_t middle = Partition(begin, end, bounds, split);
+
+        // the right subtree is built into its own nodes and appended after the left one
+        if (count >= _options.parallelThreshold)
+        {
+            std::vector<BVH::Node> rightNodes;
+            auto right = std::async(std::launch::async, [&]() { BuildSubtree(middle, end, split.right, rightNodes); });
+            BuildSubtree(begin, middle, split.left, nodes);
+            right.get();
+
+            const uint32_t rightIdx = (uint32_t)nodes.size();
+            for (BVH::Node& node : rightNodes)
+            {
+                if (node.count == 0)
+                    node.offset += rightIdx;
+            }
+
+            nodes.insert(nodes.end(), rightNodes.begin(), rightNodes.end());
+            nodes[nodeIdx].offset = rightIdx;
+        }
+        else
+        {
+            BuildSubtree(begin, middle, split.left, nodes);
+            nodes[nodeIdx].offset = (uint32_t)nodes.size();
+            BuildSubtree(middle, end, split.right, nodes);
+        }
+    }
+
+private:
+    struct Bin
+    {
+        RangeBounds bounds;
+        std::size_t count = 0;
+    };
+
+    static std::size_t BinIndex(float bin, std::size_t binsCount)
+    {
+        return std::min(binsCount - 1, (std::size_t)bin);
+    }
+
+    // the bins of the three axes follow each other
+    void BinRange(std::size_t begin, std::size_t end, FXMVECTOR origin, FXMVECTOR scale, std::size_t binsCount, Bin* bins) const
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const Primitive& primitive = _primitives[_order[i]];
+
+            XMFLOAT3 position;
+            XMStoreFloat3(&position, XMVectorMultiply(XMVectorSubtract(primitive.centroid, origin), scale));
+
+            const std::array<std::size_t, 3> binIdxs = {BinIndex(position.x, binsCount), BinIndex(position.y, binsCount),
+                                                        BinIndex(position.z, binsCount)};
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                Bin& bin = bins[axis * binsCount + binIdxs[axis]];
+                bin.bounds.Grow(primitive);
+                bin.count++;
+            }
+        }
+    }
+
+    Split FindSplit(std::size_t begin, std::size_t end, const RangeBounds& bounds) const
+    {
+        Split output;
+
+        const float area = bounds.bounds.Area();
+        if (area <= 0.0f)
+            return output;
+
+        // all three axes are binned in a single pass over the primitives, small nodes use less bins
+        const std::size_t binsCount = std::min(_options.binsCount, std::max<std::size_t>(end - begin, 2));
+
+        thread_local std::vector<Bin> binsStorage;
+        binsStorage.assign(binsCount * 3, Bin{});
+        std::array<Bin*, 3> bins = {binsStorage.data(), binsStorage.data() + binsCount, binsStorage.data() + binsCount * 2};
+
+        std::array<float, 3> scales;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float extent = bounds.centroids.Extent(axis);
+            scales[axis]       = extent > 0.0f ? binsCount / extent : 0.0f;
+        }
+
+        const XMVECTOR origin = bounds.centroids.min;
+        const XMVECTOR scale  = XMVectorSet(scales[0], scales[1], scales[2], 0.0f);
+
+        // the binning of the top nodes is most of the critical path, it is split between the tasks too
+        std::size_t chunksCount = (end - begin) / _options.parallelThreshold;
+        if (chunksCount > 1)
+            chunksCount = std::min<std::size_t>(chunksCount, std::thread::hardware_concurrency());
+
+        if (chunksCount > 1)
+        {
+            const std::size_t chunkSize = (end - begin + chunksCount - 1) / chunksCount;
+
+            std::vector<std::vector<Bin>>  chunksBins(chunksCount - 1, std::vector<Bin>(binsCount * 3));
+            std::vector<std::future<void>> chunks;
+            for (std::size_t chunk = 1; chunk < chunksCount; ++chunk)
+            {
+                const std::size_t chunkBegin = begin + chunk * chunkSize;
+                const std::size_t chunkEnd   = std::min(chunkBegin + chunkSize, end);
+                chunks.push_back(std::async(std::launch::async, [&, chunk, chunkBegin, chunkEnd]() {
+                    BinRange(chunkBegin, chunkEnd, origin, scale, binsCount, chunksBins[chunk - 1].data());
+                }));
+            }
+            BinRange(begin, begin + chunkSize, origin, scale, binsCount, binsStorage.data());
+
+            for (std::size_t chunk = 0; chunk < chunks.size(); ++chunk)
+            {
+                chunks[chunk].get();
+                for (std::size_t bin = 0; bin < binsStorage.size(); ++bin)
+                {
+                    binsStorage[bin].bounds.Grow(chunksBins[chunk][bin].bounds);
+                    binsStorage[bin].count += chunksBins[chunk][bin].count;
+                }
+            }
+        }
+        else
+        {
+            BinRange(begin, end, origin, scale, binsCount, binsStorage.data());
+        }
+
+        std::array<float, MaxBinsCount> rightCosts;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (scales[axis] == 0.0f)
+                continue;
+
+            // area times count of everything right of the split, sweeping from the last bin
+            Bounds      rightBounds;
+            std::size_t rightCount = 0;
+            for (std::size_t bin = binsCount - 1; bin > 0; --bin)
+            {
+                rightBounds.Grow(bins[axis][bin].bounds.bounds);
+                rightCount += bins[axis][bin].count;
+                rightCosts[bin - 1] = rightBounds.Area() * rightCount;
+            }
+
+            Bounds      leftBounds;
+            std::size_t leftCount = 0;
+            for (std::size_t bin = 0; bin + 1 < binsCount; ++bin)
+            {
+                leftBounds.Grow(bins[axis][bin].bounds.bounds);
+                leftCount += bins[axis][bin].count;
+                if (leftCount == 0 || leftCount == end - begin)
+                    continue;
+
+                const float cost = _options.traversalCost +
+                                   _options.intersectionCost * (leftBounds.Area() * leftCount + rightCosts[bin]) / area;
+                if (cost < output.cost)
+                {
+                    output.axis      = axis;
+                    output.bin       = bin;
+                    output.binsCount = binsCount;
+                    output.scale     = scales[axis];
+                    output.cost      = cost;
+                }
+            }
+        }
+
+        // the children get the bounds gathered by the bins, they are not computed again
+        if (output.axis >= 0)
+        {
+            for (std::size_t bin = 0; bin < binsCount; ++bin)
+                (bin <= output.bin ? output.left : output.right).Grow(bins[output.axis][bin].bounds);
+        }
+
+        return output;
+    }
+
+    std::size_t Partition(std::size_t begin, std::size_t end, const RangeBounds& bounds, Split& split) const
+    {
+        if (split.axis >= 0)
+        {
+            const float origin = XMVectorGetByIndex(bounds.centroids.min, split.axis);
+            auto        middle = std::partition(_order.begin() + begin, _order.begin() + end, [&](uint32_t primitive) {
+                const float position = XMVectorGetByIndex(_primitives[primitive].centroid, split.axis);
+                return BinIndex((position - origin) * split.scale, split.binsCount) <= split.bin;
+            });
+
+            return middle - _order.begin();
+        }
+
+        // the centroids coincide or the heuristic gave up on a big node, it is split in halves
+        int axis = 0;
+        for (int i = 1; i < 3; ++i)
+        {
+            if (bounds.centroids.Extent(i) > bounds.centroids.Extent(axis))
+                axis = i;
+        }
+
+        const std::size_t middle = (begin + end) / 2;
+        std::nth_element(_order.begin() + begin, _order.begin() + middle, _order.begin() + end, [&](uint32_t a, uint32_t b) {
+            return XMVectorGetByIndex(_primitives[a].centroid, axis) < XMVectorGetByIndex(_primitives[b].centroid, axis);
+        });
+
+        split.left  = CalculateBounds(begin, middle);
+        split.right = CalculateBounds(middle, end);
+        return middle;
+    }
+
+    std::span<const Primitive> _primitives;
+    std::span<uint32_t>        _order;
+    const BVH::Options&        _options;
+};
+
+float NodeArea(const BVH::Node& node)
+{
+    return Bounds{XMLoadFloat3(&node.boundsMin), XMLoadFloat3(&node.boundsMax)}.Area();
+}
+
+Primitive MakePrimitive(const Bounds& bounds)
+{
+    return {bounds, XMVectorScale(XMVectorAdd(bounds.min, bounds.max), 0.5f)};
+}
+
+BVH::Tree BuildTree(std::span<const Primitive> primitives, const BVH::Options& options, std::chrono::steady_clock::time_point start)
+{
+    assert(options.binsCount > 1 && options.binsCount <= MaxBinsCount);
+    assert(options.maxLeafSize > 0);
+
+    BVH::Tree output;
+    output.primitives.resize(primitives.size());
+    for (std::size_t primitive = 0; primitive < primitives.size(); ++primitive)
+        output.primitives[primitive] = (uint32_t)primitive;
+
+    if (!primitives.empty())
+    {
+        // a binary tree has less than two nodes per primitive
+        output.nodes.reserve(primitives.size() * 2);
+        Builder builder(primitives, output.primitives, options);
+        builder.BuildSubtree(0, primitives.size(), builder.CalculateBounds(0, primitives.size()), output.nodes);
+        output.nodes.shrink_to_fit();
+    }
+
+    output.stats.buildMilliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    BVH::CalculateStats(output, options);
+
+    return output;
+}
+}  // namespace
+
+namespace BVH
+{
+Tree Build(std::span<const GeometryVertex> vertices, std::span<const uint32_t> indices, const Options& options /*= {}*/)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const std::size_t trianglesCount = indices.empty() ? vertices.size() / 3 : indices.size() / 3;
+
+    std::vector<Primitive> primitives(trianglesCount);
+    for (std::size_t triangle = 0; triangle < trianglesCount; ++triangle)
+    {
+        Bounds bounds;
+        for (std::size_t corner = 0; corner < 3; ++corner)
+        {
+            const std::size_t vertex = indices.empty() ? triangle * 3 + corner : indices[triangle * 3 + corner];
+            bounds.Grow(XMLoadFloat3(&vertices[vertex].position));
+        }
+
+        primitives[triangle] = MakePrimitive(bounds);
+    }
+
+    return BuildTree(primitives, options, start);
+}
+
+Tree Build(std::span<const Box> boxes, const Options& options /*= {}*/)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<Primitive> primitives(boxes.size());
+    for (std::size_t box = 0; box < boxes.size(); ++box)
+        primitives[box] = MakePrimitive({XMLoadFloat3(&boxes[box].min), XMLoadFloat3(&boxes[box].max)});
+
+    return BuildTree(primitives, options, start);
+}
+
+void Refit(Tree& tree, std::span<const Box> boxes)
+{
+    // children are stored after their parents, so a reverse walk visits them first
+    for (std::size_t nodeIdx = tree.nodes.size(); nodeIdx-- > 0;)
+    {
+        Node&  node = tree.nodes[nodeIdx];
+        Bounds bounds;
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                const Box& box = boxes[tree.primitives[i]];
+                bounds.Grow({XMLoadFloat3(&box.min), XMLoadFloat3(&box.max)});
+            }
+        }
+        else
+        {
+            for (const Node* child : {&tree.nodes[nodeIdx + 1], &tree.nodes[node.offset]})
+                bounds.Grow({XMLoadFloat3(&child->boundsMin), XMLoadFloat3(&child->boundsMax)});
+        }
+
+        XMStoreFloat3(&node.boundsMin, bounds.min);
+        XMStoreFloat3(&node.boundsMax, bounds.max);
+    }
+}
+
+WideTree Collapse(const Tree& tree)
+{
+    WideTree output;
+    output.primitives = tree.primitives;
+    output.stats      = tree.stats;
+
+    if (tree.nodes.empty())
+        return output;
+
+    // wide nodes waiting for their children, the binary node which they replace is given
+    std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 0}};
+    output.nodes.reserve(tree.nodes.size() / 2 + 1);
+    output.nodes.emplace_back();
+
+    while (!stack.empty())
+    {
+        const auto [nodeIdx, wideIdx] = stack.back();
+        stack.pop_back();
+
+        // interior children are opened till there are enough of them, the biggest ones go first
+        // as they are hit the most; a leaf root stays a single leaf child
+        std::array<uint32_t, WideNode::Width> children = {nodeIdx};
+        std::size_t                           count    = 1;
+        while (count < WideNode::Width)
+        {
+            std::size_t biggest     = count;
+            float       biggestArea = -1.0f;
+            for (std::size_t child = 0; child < count; ++child)
+            {
+                const Node& node = tree.nodes[children[child]];
+                if (node.count == 0 && NodeArea(node) > biggestArea)
+                {
+                    biggest     = child;
+                    biggestArea = NodeArea(node);
+                }
+            }
+
+            if (biggest == count)
+                break;
+
+            // the first child follows its parent
+            const Node& node  = tree.nodes[children[biggest]];
+            children[count++] = node.offset;
+            children[biggest] = children[biggest] + 1;
+        }
+
+        for (std::size_t slot = 0; slot < WideNode::Width; ++slot)
+        {
+            WideNode& wideNode = output.nodes[wideIdx];
+            if (slot >= count)
+            {
+                // never hit, the traversal masks the empty slots out
+                wideNode.boundsMinX[slot] = wideNode.boundsMinY[slot] = wideNode.boundsMinZ[slot] = 0.0f;
+                wideNode.boundsMaxX[slot] = wideNode.boundsMaxY[slot] = wideNode.boundsMaxZ[slot] = 0.0f;
+                wideNode.offsets[slot]    = WideNode::InvalidNode;
+                wideNode.counts[slot]     = 0;
+                continue;
+            }
+
+            const Node& child         = tree.nodes[children[slot]];
+            wideNode.boundsMinX[slot] = child.boundsMin.x;
+            wideNode.boundsMinY[slot] = child.boundsMin.y;
+            wideNode.boundsMinZ[slot] = child.boundsMin.z;
+            wideNode.boundsMaxX[slot] = child.boundsMax.x;
+            wideNode.boundsMaxY[slot] = child.boundsMax.y;
+            wideNode.boundsMaxZ[slot] = child.boundsMax.z;
+            wideNode.counts[slot]     = child.count;
+
+            if (child.count > 0)
+            {
+                wideNode.offsets[slot] = child.offset;
+            }
+            else
+            {
+                wideNode.offsets[slot] = (uint32_t)output.nodes.size();
+                stack.push_back({children[slot], (uint32_t)output.nodes.size()});
+                output.nodes.emplace_back();
+            }
+        }
+    }
+
+    return output;
+}
+
+void CalculateStats(Tree& tree, const Options& options /*= {}*/)
+{
+    Stats& stats          = tree.stats;
+    stats.nodesCount      = tree.nodes.size();
+    stats.leavesCount     = 0;
+    stats.maxDepth        = 0;
+    stats.averageLeafSize = 0.0f;
+    stats.sahCost         = 0.0f;
+
+    if (tree.nodes.empty())
+        return;
+
+    const float rootArea = NodeArea(tree.nodes[0]);
+
+    std::vector<std::pair<uint32_t, std::size_t>> stack = {{0, 1}};
+    while (!stack.empty())
+    {
+        const auto [nodeIdx, depth] = stack.back();
+        stack.pop_back();
+
+        const Node& node        = tree.nodes[nodeIdx];
+        const float probability = rootArea > 0.0f ? NodeArea(node) / rootArea : 1.0f;
+        stats.maxDepth          = std::max(stats.maxDepth, depth);
+
+        if (node.count > 0)
+        {
+            stats.leavesCount++;
+            stats.sahCost += probability * node.count * options.intersectionCost;
+        }
+        else
+        {
+            stats.sahCost += probability * options.traversalCost;
+            stack.push_back({nodeIdx + 1, depth + 1});
+            stack.push_back({node.offset, depth + 1});
+        }
+    }
+
+    stats.averageLeafSize = (float)tree.primitives.size() / stats.leavesCount;
+}
+}  // namespace BVH
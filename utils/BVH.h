@@ -0,0 +1,102 @@
+#pragma once
+
+#include <shaders/Common.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Bounding volume hierarchy over the triangles of a mesh (or over boxes, e.g. instances) for the
+// CPU side queries (picking, collisions, validation of the GPU results). It takes the same inputs
+// as MeshObject and has no D3D12 dependencies. Nodes are split by the binned surface area
+// heuristic, big subtrees are built and big nodes are binned in parallel.
+namespace BVH
+{
+// nodes are stored depth-first, the first child of an interior node follows it
+struct Node
+{
+    DirectX::XMFLOAT3 boundsMin;
+    uint32_t          offset;  // leaf: the first of its primitives, interior: the second child
+    DirectX::XMFLOAT3 boundsMax;
+    uint32_t          count;  // primitives of a leaf, 0 for interior nodes
+};
+
+static_assert(sizeof(Node) == 32);
+
+// Four children per node for the traversal, their bounds are stored by components, so a ray is
+// tested against all of them at once with SIMD. It is collapsed from a binary tree.
+struct WideNode
+{
+    static constexpr std::size_t Width       = 4;
+    static constexpr uint32_t    InvalidNode = ~0u;  // offset of the empty slots
+
+    float    boundsMinX[Width];
+    float    boundsMinY[Width];
+    float    boundsMinZ[Width];
+    float    boundsMaxX[Width];
+    float    boundsMaxY[Width];
+    float    boundsMaxZ[Width];
+    uint32_t offsets[Width];  // leaf: the first of its primitives, interior: the child node
+    uint32_t counts[Width];   // primitives of a leaf, 0 for interior children
+};
+
+static_assert(sizeof(WideNode) == 128);
+
+struct Box
+{
+    DirectX::XMFLOAT3 min;
+    DirectX::XMFLOAT3 max;
+};
+
+struct Options
+{
+    std::size_t binsCount        = 16;
+    std::size_t maxLeafSize      = 4;  // bigger leaves are split even if the heuristic says otherwise
+    float       traversalCost    = 1.0f;
+    float       intersectionCost = 1.0f;
+
+    // subtrees with less primitives are built by the thread which has split their parent, nodes
+    // with several times more are binned in chunks of at least this size
+    std::size_t parallelThreshold = 64 * 1024;
+};
+
+struct Stats
+{
+    double      buildMilliseconds = 0.0;
+    std::size_t nodesCount        = 0;
+    std::size_t leavesCount       = 0;
+    std::size_t maxDepth          = 0;
+    float       averageLeafSize   = 0.0f;
+    float       sahCost           = 0.0f;  // expected cost of a random ray hitting the root, lower is better
+};
+
+struct Tree
+{
+    std::vector<Node>     nodes;
+    std::vector<uint32_t> primitives;  // triangle (or box) indices referenced by the leaves
+    Stats                 stats;
+};
+
+// the root is the first node, the leaves refer to the same primitives as the binary ones
+struct WideTree
+{
+    std::vector<WideNode> nodes;
+    std::vector<uint32_t> primitives;
+    Stats                 stats;  // of the binary tree
+};
+
+// meshes without indices take every three vertices as a triangle
+Tree Build(std::span<const GeometryVertex> vertices, std::span<const uint32_t> indices, const Options& options = {});
+Tree Build(std::span<const Box> boxes, const Options& options = {});
+
+// updates the node bounds to the moved boxes keeping the topology, the quality degrades
+// with the motion, so the tree should be rebuilt once the boxes are changed a lot
+void Refit(Tree& tree, std::span<const Box> boxes);
+
+// every wide node takes the biggest (by the surface) descendants of a binary one, so the traversal
+// visits about half as many nodes; the tree is not changed and may be refitted and collapsed again
+WideTree Collapse(const Tree& tree);
+
+// recomputes the quality metrics of the nodes, the build time is not changed
+void CalculateStats(Tree& tree, const Options& options = {});
+}  // namespace BVH
@@ -0,0 +1,503 @@
+#include "BVHScene.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace
+{
+using namespace DirectX;
+
+using BVH::WideNode;
+
+struct RayData
+{
+    XMFLOAT3 origin;
+    XMFLOAT3 direction;
+    XMFLOAT3 inverseDirection;
+    float    tMin;
+    bool     cullBackFaces;
+};
+
+RayData MakeRayData(const BVH::Ray& ray)
+{
+    RayData output;
+    output.origin           = ray.origin;
+    output.direction        = ray.direction;
+    output.inverseDirection = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    output.tMin             = ray.tMin;
+    output.cullBackFaces    = ray.cullBackFaces;
+    return output;
+}
+
+XMVECTOR LoadLanes(const float* values)
+{
+    return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(values));
+}
+
+float GetLane(FXMVECTOR vector, std::size_t lane)
+{
+    return XMVectorGetByIndex(vector, lane);
+}
+
+uint32_t GetLaneInt(FXMVECTOR vector, std::size_t lane)
+{
+    return XMVectorGetIntByIndex(vector, lane);
+}
+
+bool AnyLane(FXMVECTOR mask)
+{
+    return XMVector4NotEqualInt(mask, XMVectorZero());
+}
+
+bool IntersectTriangle(const RayData& ray, const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, float tMax, BVH::Hit& hit)
+{
+    const std::optional<Intersection::TriangleHit> output = Intersection::RayTriangle(XMLoadFloat3(&ray.origin),
+                                                                                      XMLoadFloat3(&ray.direction),
+                                                                                      XMLoadFloat3(&p0),
+                                                                                      XMLoadFloat3(&p1),
+                                                                                      XMLoadFloat3(&p2),
+                                                                                      ray.tMin,
+                                                                                      tMax,
+                                                                                      ray.cullBackFaces);
+    if (!output)
+        return false;
+
+    hit.t            = output->t;
+    hit.barycentrics = output->barycentrics;
+    return true;
+}
+
+struct StackEntry
+{
+    uint32_t offset;  // a node or the first primitive of a leaf
+    uint32_t count;   // primitives of a leaf, 0 for nodes
+    float    tEntry;
+};
+
+// a node replaces itself with at most four children, so the stack grows by three per level
+class TraversalStack
+{
+public:
+    explicit TraversalStack(const BVH::WideTree& tree)
+    {
+        const std::size_t capacity = tree.stats.maxDepth * (WideNode::Width - 1) + 1;
+        if (capacity > _localStack.size())
+        {
+            _heapStack.resize(capacity);
+            _stack = _heapStack.data();
+        }
+    }
+
+    bool IsEmpty() const
+    {
+        return _size == 0;
+    }
+
+    void Push(const StackEntry& entry)
+    {
+        _stack[_size++] = entry;
+    }
+
+    StackEntry Pop()
+    {
+        return _stack[--_size];
+    }
+
+    // the children are pushed from the farthest, so the closest one is visited first
+    void PushSorted(StackEntry* children, std::size_t count)
+    {
+        // an insertion sort, there are at most four of them
+        for (std::size_t child = 1; child < count; ++child)
+        {
+            const StackEntry entry = children[child];
+            std::size_t      slot  = child;
+            for (; slot > 0 && children[slot - 1].tEntry < entry.tEntry; --slot)
+                children[slot] = children[slot - 1];
+            children[slot] = entry;
+        }
+        for (std::size_t child = 0; child < count; ++child)
+            Push(children[child]);
+    }
+
+private:
+    std::array<StackEntry, 192> _localStack;
+    std::vector<StackEntry>     _heapStack;
+    StackEntry*                 _stack = _localStack.data();
+    std::size_t                 _size  = 0;
+};
+
+// Visits the leaves hit by the ray front to back, the boxes are grown by the margin for the sweeps.
+// The callback gets a primitive and the current distance limit, which it shrinks on hits, and
+// returns true to finish the traversal.
+template <typename Callback>
+void Traverse(const BVH::WideTree& tree, const RayData& ray, float tMax, float margin, Callback&& callback)
+{
+    if (tree.nodes.empty())
+        return;
+
+    // the children of a node are tested at once, a lane per child; the origin is moved against the
+    // box planes instead of growing the boxes
+    const XMVECTOR minOriginX = XMVectorReplicate(ray.origin.x + margin);
+    const XMVECTOR minOriginY = XMVectorReplicate(ray.origin.y + margin);
+    const XMVECTOR minOriginZ = XMVectorReplicate(ray.origin.z + margin);
+    const XMVECTOR maxOriginX = XMVectorReplicate(ray.origin.x - margin);
+    const XMVECTOR maxOriginY = XMVectorReplicate(ray.origin.y - margin);
+    const XMVECTOR maxOriginZ = XMVectorReplicate(ray.origin.z - margin);
+    const XMVECTOR inverseX   = XMVectorReplicate(ray.inverseDirection.x);
+    const XMVECTOR inverseY   = XMVectorReplicate(ray.inverseDirection.y);
+    const XMVECTOR inverseZ   = XMVectorReplicate(ray.inverseDirection.z);
+    const XMVECTOR tMin       = XMVectorReplicate(ray.tMin);
+    const XMVECTOR invalid    = XMVectorReplicateInt(WideNode::InvalidNode);
+
+    TraversalStack stack(tree);
+    stack.Push({0, 0, ray.tMin});
+    while (!stack.IsEmpty())
+    {
+        // the nodes behind the closest hit found so far are skipped
+        const StackEntry entry = stack.Pop();
+        if (entry.tEntry > tMax)
+            continue;
+
+        if (entry.count > 0)
+        {
+            for (uint32_t i = entry.offset; i < entry.offset + entry.count; ++i)
+            {
+                if (callback(tree.primitives[i], tMax))
+                    return;
+            }
+            continue;
+        }
+
+        // slabs test
+        const WideNode& node = tree.nodes[entry.offset];
+        const XMVECTOR  x0   = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.boundsMinX), minOriginX), inverseX);
+        const XMVECTOR  x1   = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.boundsMaxX), maxOriginX), inverseX);
+        const XMVECTOR  y0   = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.boundsMinY), minOriginY), inverseY);
+        const XMVECTOR  y1   = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.boundsMaxY), maxOriginY), inverseY);
+        const XMVECTOR  z0   = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.boundsMinZ), minOriginZ), inverseZ);
+        const XMVECTOR  z1   = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.boundsMaxZ), maxOriginZ), inverseZ);
+
+        const XMVECTOR tEntry = XMVectorMax(XMVectorMax(XMVectorMin(x0, x1), XMVectorMin(y0, y1)), XMVectorMax(XMVectorMin(z0, z1), tMin));
+        const XMVECTOR tExit  = XMVectorMin(XMVectorMin(XMVectorMax(x0, x1), XMVectorMax(y0, y1)), XMVectorMin(XMVectorMax(z0, z1), XMVectorReplicate(tMax)));
+        const XMVECTOR isHit  = XMVectorAndInt(XMVectorLessOrEqual(tEntry, tExit), XMVectorNotEqualInt(XMLoadInt4(node.offsets), invalid));
+        if (!AnyLane(isHit))
+            continue;
+
+        StackEntry  children[WideNode::Width];
+        std::size_t count = 0;
+        for (std::size_t slot = 0; slot < WideNode::Width; ++slot)
+        {
+            if (GetLaneInt(isHit, slot))
+                children[count++] = {node.offsets[slot], node.counts[slot], GetLane(tEntry, slot)};
+        }
+
+        stack.PushSorted(children, count);
+    }
+}
+
+BVH::Box TransformBox(const BVH::Box& box, const XMMATRIX& transform)
+{
+    XMVECTOR minBound = XMVectorReplicate(std::numeric_limits<float>::max());
+    XMVECTOR maxBound = XMVectorReplicate(std::numeric_limits<float>::lowest());
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const XMVECTOR point = XMVectorSet(corner & 1 ? box.max.x : box.min.x,
+                                           corner & 2 ? box.max.y : box.min.y,
+                                           corner & 4 ? box.max.z : box.min.z,
+                                           1.0f);
+        const XMVECTOR transformed = XMVector3Transform(point, transform);
+
+        minBound = XMVectorMin(minBound, transformed);
+        maxBound = XMVectorMax(maxBound, transformed);
+    }
+
+    BVH::Box output;
+    XMStoreFloat3(&output.min, minBound);
+    XMStoreFloat3(&output.max, maxBound);
+    return output;
+}
+
+}  // namespace
+
+namespace BVH
+{
+////////////////////////////////////////////////////////////////////////////////
+// Mesh
+
+Mesh::Mesh(std::span<const Geometry> geometries, const Options& options /*= {}*/)
+{
+    for (const Geometry& geometry : geometries)
+    {
+        const uint32_t firstVertex = (uint32_t)_positions.size();
+        _geometryOffsets.push_back((uint32_t)(_indices.size() / 3));
+
+        for (const GeometryVertex& vertex : geometry.vertices)
+            _positions.push_back(vertex.position);
+
+        // meshes without indices take every three vertices as a triangle
+        if (geometry.indices.empty())
+        {
+            for (std::size_t i = 0; i < geometry.vertices.size() / 3 * 3; ++i)
+                _indices.push_back(firstVertex + (uint32_t)i);
+        }
+        else
+        {
+            for (uint32_t index : geometry.indices)
+                _indices.push_back(firstVertex + index);
+        }
+    }
+
+    std::vector<Box> boxes(_indices.size() / 3);
+    for (std::size_t triangle = 0; triangle < boxes.size(); ++triangle)
+    {
+        const XMVECTOR p0 = XMLoadFloat3(&_positions[_indices[triangle * 3]]);
+        const XMVECTOR p1 = XMLoadFloat3(&_positions[_indices[triangle * 3 + 1]]);
+        const XMVECTOR p2 = XMLoadFloat3(&_positions[_indices[triangle * 3 + 2]]);
+
+        XMStoreFloat3(&boxes[triangle].min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+        XMStoreFloat3(&boxes[triangle].max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+    }
+
+    const Tree tree = Build(boxes, options);
+    if (!tree.nodes.empty())
+        _bounds = {tree.nodes[0].boundsMin, tree.nodes[0].boundsMax};
+
+    _tree = Collapse(tree);
+}
+
+Mesh::Mesh(std::span<const GeometryVertex> vertices, std::span<const uint32_t> indices, const Options& options /*= {}*/)
+    : Mesh(std::array<Geometry, 1>{Geometry{vertices, indices}}, options)
+{
+}
+
+std::optional<Hit> Mesh::Intersect(const Ray& ray, bool anyHit /*= false*/) const
+{
+    const RayData rayData = MakeRayData(ray);
+
+    std::optional<Hit> output;
+    Traverse(_tree, rayData, ray.tMax, 0.0f, [&](uint32_t triangle, float& tMax) {
+        const uint32_t* indices = &_indices[triangle * 3];
+
+        Hit hit;
+        if (!IntersectTriangle(rayData, _positions[indices[0]], _positions[indices[1]], _positions[indices[2]], tMax, hit))
+            return false;
+
+        hit.triangle = triangle;
+        output       = hit;
+        tMax         = hit.t;
+        return anyHit;
+    });
+
+    if (output)
+        ResolveGeometry(*output);
+
+    return output;
+}
+
+std::optional<Hit> Mesh::SphereCast(const Ray& ray, float radius) const
+{
+    const RayData  rayData   = MakeRayData(ray);
+    const XMVECTOR origin    = XMLoadFloat3(&ray.origin);
+    const XMVECTOR direction = XMLoadFloat3(&ray.direction);
+
+    std::optional<Hit> output;
+    Traverse(_tree, rayData, ray.tMax, radius, [&](uint32_t triangle, float& tMax) {
+        const uint32_t* indices = &_indices[triangle * 3];
+
+        const std::optional<Intersection::TriangleHit> hit = Intersection::SweepSphereTriangle(origin,
+                                                                                               direction,
+                                                                                               XMLoadFloat3(&_positions[indices[0]]),
+                                                                                               XMLoadFloat3(&_positions[indices[1]]),
+                                                                                               XMLoadFloat3(&_positions[indices[2]]),
+                                                                                               radius,
+                                                                                               ray.tMin,
+                                                                                               tMax);
+        if (!hit)
+            return false;
+
+        output               = Hit{};
+        output->t            = hit->t;
+        output->triangle     = triangle;
+        output->barycentrics = hit->barycentrics;
+        tMax                 = hit->t;
+        return false;
+    });
+
+    if (output)
+        ResolveGeometry(*output);
+
+    return output;
+}
+
+std::array<XMFLOAT3, 3> Mesh::GetTriangle(uint32_t geometry, uint32_t triangle) const
+{
+    const uint32_t* indices = &_indices[(_geometryOffsets[geometry] + triangle) * 3];
+    return {_positions[indices[0]], _positions[indices[1]], _positions[indices[2]]};
+}
+
+Box Mesh::GetBounds() const
+{
+    return _bounds;
+}
+
+const Stats& Mesh::GetStats() const
+{
+    return _tree.stats;
+}
+
+// triangles are numbered per geometry, like PrimitiveIndex() is
+void Mesh::ResolveGeometry(Hit& hit) const
+{
+    const auto geometry = std::upper_bound(_geometryOffsets.begin(), _geometryOffsets.end(), hit.triangle) - 1;
+    hit.geometry        = (uint32_t)(geometry - _geometryOffsets.begin());
+    hit.triangle -= *geometry;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Scene
+
+void Scene::Resize(std::size_t instancesCount)
+{
+    if (_instances.size() == instancesCount)
+        return;
+
+    _instances.resize(instancesCount, {nullptr, XMMatrixIdentity(), XMMatrixIdentity(), {}, 1.0f, 0xff});
+    _rebuild = true;
+}
+
+void Scene::SetInstance(std::size_t instance, std::shared_ptr<const Mesh> mesh, const XMFLOAT3X4& transform, uint32_t mask /*= 0xff*/)
+{
+    Instance& output = _instances[instance];
+    output.mask      = mask;
+
+    // like the TLAS, the tree is rebuilt once an instance points to another mesh
+    _rebuild |= output.mesh != mesh;
+    output.mesh = std::move(mesh);
+
+    if (!output.mesh)
+        return;
+
+    output.objectToWorld = XMLoadFloat3x4(&transform);
+    output.worldToObject = XMMatrixInverse(nullptr, output.objectToWorld);
+    output.bounds        = TransformBox(output.mesh->GetBounds(), output.objectToWorld);
+
+    // the largest one, so a sphere is never smaller than its image
+    output.worldToObjectScale = 0.0f;
+    for (int row = 0; row < 3; ++row)
+        output.worldToObjectScale = std::max(output.worldToObjectScale, XMVectorGetX(XMVector3Length(output.worldToObject.r[row])));
+}
+
+void Scene::Update()
+{
+    if (_rebuild)
+    {
+        _treeInstances.clear();
+        for (std::size_t instance = 0; instance < _instances.size(); ++instance)
+        {
+            if (_instances[instance].mesh)
+                _treeInstances.push_back((uint32_t)instance);
+        }
+    }
+
+    std::vector<Box> boxes(_treeInstances.size());
+    for (std::size_t i = 0; i < _treeInstances.size(); ++i)
+        boxes[i] = _instances[_treeInstances[i]].bounds;
+
+    if (_rebuild)
+        _tree = Build(boxes);
+    else
+        Refit(_tree, boxes);
+
+    _wideTree = Collapse(_tree);
+    _rebuild  = false;
+}
+
+std::optional<Hit> Scene::Raycast(const Ray& ray) const
+{
+    return Intersect(ray, false, 0.0f);
+}
+
+bool Scene::HasLineOfSight(XMFLOAT3 from, XMFLOAT3 to) const
+{
+    Ray ray;
+    ray.origin    = from;
+    ray.direction = {to.x - from.x, to.y - from.y, to.z - from.z};
+    ray.tMax      = 1.0f;
+
+    return !IsOccluded(ray);
+}
+
+bool Scene::IsOccluded(const Ray& ray) const
+{
+    return Intersect(ray, true, 0.0f).has_value();
+}
+
+std::optional<Hit> Scene::SphereCast(const Ray& ray, float radius) const
+{
+    return Intersect(ray, false, radius);
+}
+
+std::size_t Scene::GetInstancesCount() const
+{
+    return _instances.size();
+}
+
+const Stats& Scene::GetStats() const
+{
+    return _tree.stats;
+}
+
+const XMMATRIX& Scene::GetObjectToWorld(std::size_t instance) const
+{
+    return _instances[instance].objectToWorld;
+}
+
+std::array<XMFLOAT3, 3> Scene::GetTriangle(const Hit& hit) const
+{
+    const Instance&         instance = _instances[hit.instance];
+    std::array<XMFLOAT3, 3> output   = instance.mesh->GetTriangle(hit.geometry, hit.triangle);
+    for (XMFLOAT3& position : output)
+        XMStoreFloat3(&position, XMVector3Transform(XMLoadFloat3(&position), instance.objectToWorld));
+
+    return output;
+}
+
+std::optional<Hit> Scene::Intersect(const Ray& ray, bool anyHit, float radius) const
+{
+    assert(!_rebuild);
+
+    const RayData rayData = MakeRayData(ray);
+
+    std::optional<Hit> output;
+    Traverse(_wideTree, rayData, ray.tMax, radius, [&](uint32_t treeInstance, float& tMax) {
+        const uint32_t  instanceIdx = _treeInstances[treeInstance];
+        const Instance& instance    = _instances[instanceIdx];
+        if ((instance.mask & ray.instanceMask) == 0)
+            return false;
+
+        // the direction is not normalized in the object space, so the distances stay the same
+        Ray objectRay;
+        XMStoreFloat3(&objectRay.origin, XMVector3Transform(XMLoadFloat3(&ray.origin), instance.worldToObject));
+        XMStoreFloat3(&objectRay.direction, XMVector3TransformNormal(XMLoadFloat3(&ray.direction), instance.worldToObject));
+        objectRay.tMin          = ray.tMin;
+        objectRay.tMax          = tMax;
+        objectRay.cullBackFaces = ray.cullBackFaces;
+
+        // the instances are expected to be scaled uniformly, so the spheres stay spheres
+        std::optional<Hit> hit = radius > 0.0f ? instance.mesh->SphereCast(objectRay, radius * instance.worldToObjectScale)
+                                               : instance.mesh->Intersect(objectRay, anyHit);
+        if (!hit)
+            return false;
+
+        hit->instance = instanceIdx;
+        output        = hit;
+        tMax          = hit->t;
+        return anyHit;
+    });
+
+    return output;
+}
+}  // namespace BVH
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "BVH.h"
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <optional>
+
+// CPU counterpart of the TLAS/BLAS pair: meshes play the role of BLASes, the scene is a top level
+// tree over their instances. Queries are const and may run on any number of threads, while the
+// scene itself is changed by a single one which makes sure nobody queries it meanwhile.
+namespace BVH
+{
+struct Ray
+{
+    DirectX::XMFLOAT3 origin;
+    DirectX::XMFLOAT3 direction;  // distances are measured in its lengths, it is not normalized
+    float             tMin          = 0.0f;
+    float             tMax          = std::numeric_limits<float>::max();
+    bool              cullBackFaces = false;  // like RAY_FLAG_CULL_BACK_FACING_TRIANGLES
+    uint32_t          instanceMask  = 0xff;   // like InstanceInclusionMask, it is and-ed with the instance ones
+};
+
+// the same ids the hit shaders get
+struct Hit
+{
+    float             t        = 0.0f;
+    uint32_t          instance = 0;  // InstanceID()
+    uint32_t          geometry = 0;  // GeometryIndex()
+    uint32_t          triangle = 0;  // PrimitiveIndex()
+    DirectX::XMFLOAT2 barycentrics;
+};
+
+class Mesh
+{
+public:
+    struct Geometry
+    {
+        std::span<const GeometryVertex> vertices;
+        std::span<const uint32_t>       indices;
+    };
+
+    // the positions are copied, geometries are indexed like the ones of a merged MeshObject
+    explicit Mesh(std::span<const Geometry> geometries, const Options& options = {});
+    Mesh(std::span<const GeometryVertex> vertices, std::span<const uint32_t> indices, const Options& options = {});
+
+    // in the object space, the instance of the hit is not set, any hit finishes the search if asked
+    std::optional<Hit> Intersect(const Ray& ray, bool anyHit = false) const;
+    // the first contact of a sphere moving along the ray with both sides of the triangles, the
+    // barycentrics are of the contact point
+    std::optional<Hit> SphereCast(const Ray& ray, float radius) const;
+
+    // the vertex positions of a triangle of the geometry, in the object space
+    std::array<DirectX::XMFLOAT3, 3> GetTriangle(uint32_t geometry, uint32_t triangle) const;
+
+    Box          GetBounds() const;
+    const Stats& GetStats() const;
+
+private:
+    // the triangle index of the mesh is split into the geometry and its triangle
+    void ResolveGeometry(Hit& hit) const;
+
+    std::vector<DirectX::XMFLOAT3> _positions;
+    std::vector<uint32_t>          _indices;          // of the positions, geometries are concatenated
+    std::vector<uint32_t>          _geometryOffsets;  // the first triangle of every geometry
+    WideTree                       _tree;
+    Box                            _bounds;
+};
+
+class Scene
+{
+public:
+    // instances are indexed like the TLAS ones, so the hits are mapped to the objects the same way;
+    // the ones without a mesh (not mirrored on the CPU) are never hit
+    void Resize(std::size_t instancesCount);
+    void SetInstance(std::size_t instance, std::shared_ptr<const Mesh> mesh, const DirectX::XMFLOAT3X4& transform, uint32_t mask = 0xff);
+
+    // the top level tree is refitted when only the transforms are changed, like the TLAS is
+    void Update();
+
+    std::optional<Hit> Raycast(const Ray& ray) const;
+    // true if nothing is hit between the points
+    bool HasLineOfSight(DirectX::XMFLOAT3 from, DirectX::XMFLOAT3 to) const;
+    // any hit finishes the search, like RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH does
+    bool IsOccluded(const Ray& ray) const;
+    // the ray is the path of the sphere center, the back faces are never culled
+    std::optional<Hit> SphereCast(const Ray& ray, float radius) const;
+
+    std::size_t  GetInstancesCount() const;
+    const Stats& GetStats() const;
+
+    // ObjectToWorld4x3() of the instance, in the row vector convention of DirectXMath
+    const DirectX::XMMATRIX& GetObjectToWorld(std::size_t instance) const;
+    // the vertex positions of the hit triangle, in the world space
+    std::array<DirectX::XMFLOAT3, 3> GetTriangle(const Hit& hit) const;
+
+private:
+    struct Instance
+    {
+        std::shared_ptr<const Mesh> mesh;
+        DirectX::XMMATRIX           objectToWorld;
+        DirectX::XMMATRIX           worldToObject;
+        Box                         bounds;              // in the world space
+        float                       worldToObjectScale;  // of the sphere radii
+        uint32_t                    mask;                // InstanceMask of the TLAS instance
+    };
+
+    // the rays are swept spheres if the radius is not 0
+    std::optional<Hit> Intersect(const Ray& ray, bool anyHit, float radius) const;
+
+    std::vector<Instance> _instances;
+    std::vector<uint32_t> _treeInstances;  // instances with meshes, the tree leaves refer to them
+    Tree                  _tree;           // kept for the refits
+    WideTree              _wideTree;       // collapsed after every update for the traversal
+    bool                  _rebuild = true;
+};
+}  // namespace BVH
@@ -0,0 +1,116 @@
+#include "BuddyAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+BuddyAllocator::BuddyAllocator(std::size_t capacity, std::size_t minBlockSize)
+    : _capacity(std::bit_ceil(capacity))
+    , _minBlockSize(std::bit_ceil(minBlockSize))
+{
+    assert(_capacity >= _minBlockSize);
+
+    const uint32_t maxOrder = GetOrder(_capacity);
+    _freeBlocks.resize(maxOrder + 1);
+    _freeBlocks[maxOrder].insert(0);
+}
+
+std::optional<std::size_t> BuddyAllocator::Allocate(std::size_t size)
+{
+    if (size == 0 || size > _capacity)
+        return std::nullopt;
+
+    const uint32_t order = GetOrder(size);
+
+    // the smallest free block which is large enough
+    uint32_t freeOrder = order;
+    while (freeOrder < _freeBlocks.size() && _freeBlocks[freeOrder].empty())
+        freeOrder++;
+
+    if (freeOrder == _freeBlocks.size())
+        return std::nullopt;
+
+    const std::size_t offset = *_freeBlocks[freeOrder].begin();
+    _freeBlocks[freeOrder].erase(_freeBlocks[freeOrder].begin());
+
+    // split it until it has the requested order, the upper halves become free
+    while (freeOrder > order)
+    {
+        freeOrder--;
+        _freeBlocks[freeOrder].insert(offset + GetOrderSize(freeOrder));
+    }
+
+    _allocated[offset] = order;
+    _usedSize += GetOrderSize(order);
+    return offset;
+}
+
+void BuddyAllocator::Free(std::size_t offset)
+{
+    auto it = _allocated.find(offset);
+    assert(it != _allocated.end());
+
+    uint32_t order = it->second;
+    _allocated.erase(it);
+    _usedSize -= GetOrderSize(order);
+
+    // merge with the buddy while it is free
+    while (order + 1 < _freeBlocks.size())
+    {
+        const std::size_t buddy = offset ^ GetOrderSize(order);
+
+        auto buddyIt = _freeBlocks[order].find(buddy);
+        if (buddyIt == _freeBlocks[order].end())
+            break;
+
+        _freeBlocks[order].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+
+    _freeBlocks[order].insert(offset);
+}
+
+std::size_t BuddyAllocator::GetBlockSize(std::size_t offset) const
+{
+    auto it = _allocated.find(offset);
+    assert(it != _allocated.end());
+    return GetOrderSize(it->second);
+}
+
+std::size_t BuddyAllocator::GetCapacity() const
+{
+    return _capacity;
+}
+
+std::size_t BuddyAllocator::GetUsedSize() const
+{
+    return _usedSize;
+}
+
+std::size_t BuddyAllocator::GetLargestFreeBlock() const
+{
+    for (std::size_t order = _freeBlocks.size(); order > 0; --order)
+    {
+        if (!_freeBlocks[order - 1].empty())
+            return GetOrderSize((uint32_t)order - 1);
+    }
+
+    return 0;
+}
+
+std::size_t BuddyAllocator::GetAllocationsCount() const
+{
+    return _allocated.size();
+}
+
+uint32_t BuddyAllocator::GetOrder(std::size_t size) const
+{
+    const std::size_t blocks = (std::max(size, _minBlockSize) + _minBlockSize - 1) / _minBlockSize;
+    return (uint32_t)std::bit_width(std::bit_ceil(blocks)) - 1;
+}
+
+std::size_t BuddyAllocator::GetOrderSize(uint32_t order) const
+{
+    return _minBlockSize << order;
+}
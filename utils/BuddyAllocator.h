@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Binary buddy allocator over an abstract range of memory, it only hands out offsets.
+// Every block is aligned to its own size, so power-of-two alignments up to the block
+// size come for free. Freed blocks are merged with their buddies immediately.
+class BuddyAllocator
+{
+public:
+    // capacity and minBlockSize are rounded up to powers of two
+    BuddyAllocator(std::size_t capacity, std::size_t minBlockSize);
+
+    // returns the offset of a block of at least the given size
+    std::optional<std::size_t> Allocate(std::size_t size);
+    void                       Free(std::size_t offset);
+
+    std::size_t GetBlockSize(std::size_t offset) const;
+    std::size_t GetCapacity() const;
+    std::size_t GetUsedSize() const;
+    std::size_t GetLargestFreeBlock() const;
+    std::size_t GetAllocationsCount() const;
+
+private:
+    uint32_t    GetOrder(std::size_t size) const;
+    std::size_t GetOrderSize(uint32_t order) const;
+
+    std::size_t _capacity     = 0;
+    std::size_t _minBlockSize = 0;
+    std::size_t _usedSize     = 0;
+
+    std::vector<std::set<std::size_t>>        _freeBlocks;  // offsets of free blocks for every order
+    std::unordered_map<std::size_t, uint32_t> _allocated;   // offset -> order
+};
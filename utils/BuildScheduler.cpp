@@ -0,0 +1,76 @@
+#include "BuildScheduler.h"
+
+#include <cassert>
+#include <stdexcept>
+
+BuildScheduler::BuildScheduler(IBuildQueue& queue)
+    : _queue(queue)
+{
+}
+
+uint64_t BuildScheduler::Submit(Callback onCompleted)
+{
+    const uint64_t value = ++_lastSubmitted;
+    _queue.Signal(value);
+    _pending.push_back({value, std::move(onCompleted)});
+
+    return value;
+}
+
+std::size_t BuildScheduler::Poll()
+{
+    const uint64_t completed = _queue.GetCompletedValue();
+
+    std::size_t finished = 0;
+    while (!_pending.empty() && _pending.front().value <= completed)
+    {
+        // callbacks may submit new work, so the submission is removed before the call
+        Callback onCompleted = std::move(_pending.front().onCompleted);
+        _pending.pop_front();
+
+        if (onCompleted)
+            onCompleted();
+
+        finished++;
+    }
+
+    return finished;
+}
+
+void BuildScheduler::WaitForCompletion(uint64_t value)
+{
+    assert(value <= _lastSubmitted);
+
+    if (_queue.GetCompletedValue() < value)
+        _queue.WaitForValue(value);
+
+    Poll();
+}
+
+void BuildScheduler::Flush()
+{
+    WaitForCompletion(_lastSubmitted);
+}
+
+bool BuildScheduler::IsCompleted(uint64_t value) const
+{
+    return _queue.GetCompletedValue() >= value;
+}
+
+uint64_t BuildScheduler::GetWaitValue(uint64_t value) const
+{
+    if (value > _lastSubmitted)
+        throw std::runtime_error("BuildScheduler: waiting for the work which was not submitted");
+
+    return IsCompleted(value) ? 0 : value;
+}
+
+uint64_t BuildScheduler::GetLastSubmitted() const
+{
+    return _lastSubmitted;
+}
+
+std::size_t BuildScheduler::GetPendingCount() const
+{
+    return _pending.size();
+}
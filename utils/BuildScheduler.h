@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Queue with a monotonic fence, implemented over a D3D12 command queue in AsyncBuildQueue
+// and easily mocked, so the scheduling doesn't need a device.
+class IBuildQueue
+{
+public:
+    virtual ~IBuildQueue() = default;
+
+    // signals the fence with the value once all the previously submitted work is done
+    virtual void     Signal(uint64_t value) = 0;
+    virtual uint64_t GetCompletedValue() const = 0;
+    // blocks the calling thread till the fence reaches the value
+    virtual void     WaitForValue(uint64_t value) = 0;
+};
+
+// Tracks the work submitted to a queue and runs completion callbacks (releasing the memory
+// used by the builds, swapping the results in) once the fence has passed. It never waits
+// for the GPU unless explicitly asked to.
+class BuildScheduler
+{
+public:
+    using Callback = std::function<void()>;
+
+    explicit BuildScheduler(IBuildQueue& queue);
+
+    // to be called right after the work is submitted to the queue, returns the fence value of the work
+    uint64_t Submit(Callback onCompleted = {});
+
+    // runs callbacks of the completed submissions in the submission order, returns their number
+    std::size_t Poll();
+    void        WaitForCompletion(uint64_t value);
+    void        Flush();
+
+    bool        IsCompleted(uint64_t value) const;
+    uint64_t    GetLastSubmitted() const;
+    std::size_t GetPendingCount() const;
+
+    // The value another queue has to wait for (on the GPU) before it reads the results of the work,
+    // 0 if the work is completed already. Values which were not submitted yet would stall it forever.
+    uint64_t GetWaitValue(uint64_t value) const;
+
+private:
+    struct Submission
+    {
+        uint64_t value = 0;
+        Callback onCompleted;
+    };
+
+    IBuildQueue&           _queue;
+    uint64_t               _lastSubmitted = 0;  // the fence starts at 0, so the first submission gets 1
+    std::deque<Submission> _pending;
+};
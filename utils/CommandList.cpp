@@ -28,6 +28,7 @@ CommandList::CommandList(CommandListType type, ComPtr<ID3D12Device> pDevice, Com
 
 void CommandList::Reset()
 {
+    ReleaseTrackedObjects();
     ThrowIfFailed(_allocator->Reset());
     ThrowIfFailed(_commandList->Reset(_allocator.Get(), _initialState.Get()));
 }
@@ -37,6 +38,16 @@ void CommandList::Close()
     ThrowIfFailed(_commandList->Close());
 }
 
+void CommandList::TrackObject(std::shared_ptr<void> object)
+{
+    _trackedObjects.push_back(std::move(object));
+}
+
+void CommandList::ReleaseTrackedObjects()
+{
+    _trackedObjects.clear();
+}
+
 CommandListType CommandList::GetType() const
 {
     return _type;
@@ -19,6 +19,11 @@ public:
     void Reset();
     void Close();
 
+    // keeps the object (e.g. an upload buffer) alive while the list may be executed,
+    // the objects are released on Reset
+    void TrackObject(std::shared_ptr<void> object);
+    void ReleaseTrackedObjects();
+
     CommandListType                    GetType() const;
     ComPtr<ID3D12GraphicsCommandList4> GetInternal() const;
 
@@ -33,4 +38,6 @@ private:
     ComPtr<ID3D12Device>               _device       = nullptr;
     ComPtr<ID3D12PipelineState>        _initialState = nullptr;
     CommandListType                    _type         = CommandListType::Direct;
+
+    std::vector<std::shared_ptr<void>> _trackedObjects;
 };
@@ -22,6 +22,11 @@ void ComputePipelineState::SetShaderCode(ComPtr<ID3DBlob> pShaderCode)
     _description.CS = {pShaderCode->GetBufferPointer(), pShaderCode->GetBufferSize()};
 }
 
+void ComputePipelineState::SetShaderCode(const void* pBytecode, std::size_t size)
+{
+    _description.CS = {pBytecode, size};
+}
+
 ComPtr<ID3D12PipelineState> ComputePipelineState::GetPSO()
 {
     assert(_pso);
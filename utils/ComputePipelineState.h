@@ -12,6 +12,8 @@ public:
 
     void SetRootSignature(const RootSignature &pRootSignature);
     void SetShaderCode(ComPtr<ID3DBlob> pShaderCode);
+    // compiled offline (.cso), the code is referenced till Finalize
+    void SetShaderCode(const void* pBytecode, std::size_t size);
 
     ComPtr<ID3D12PipelineState> GetPSO();
     void Finalize(ComPtr<ID3D12Device> pDevice);
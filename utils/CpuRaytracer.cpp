@@ -0,0 +1,536 @@
+#include "CpuRaytracer.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+using namespace DirectX;
+
+// the pipeline is created with MaxTraceRecursionDepth = 2, the water rays are the second level
+constexpr uint32_t maxRecursionDepth = 2;
+
+// the launches of a tile run in pixel blocks, like the ones of the DispatchRays thread groups
+constexpr uint32_t    blockWidth  = 4;
+constexpr uint32_t    blockHeight = 2;
+constexpr std::size_t blockSize   = blockWidth * blockHeight;
+
+// the rays of a tile, the skipped ones are the water rays of too small weights
+struct RayCounters
+{
+    uint64_t traced  = 0;
+    uint64_t skipped = 0;
+};
+
+struct RayPayload
+{
+    XMVECTOR color;
+    float    hitDistance;
+    XMVECTOR normal;
+};
+
+// interpolated vertex of a hit, the position and the normal are in the object space
+struct HitVertex
+{
+    XMVECTOR position;
+    XMVECTOR normal;
+    XMVECTOR color;
+};
+
+// HLSL pow() of scalars, it is undefined for the negative ones there
+float Pow(float x, float y)
+{
+    return std::pow(std::max(x, 0.0f), y);
+}
+
+float Saturate(float x)
+{
+    return std::clamp(x, 0.0f, 1.0f);
+}
+
+// the colors of Sample.hlsl, the skipped water rays are replaced by them
+const XMVECTOR skyColor       = XMVectorSet(0.6f, 0.75f, 1.0f, 0.0f);
+const XMVECTOR deepWaterColor = XMVectorSet(0.0f, 0.45f, 0.69f, 0.0f);
+
+// the bottom seen through the water fades to its color at this distance along the refracted ray
+constexpr float waterFadeDistance = 20.0f;
+
+float F_Shlick(float NoV, float ior)
+{
+    const float k  = (1.0f - ior) / (1.0f + ior);
+    const float R0 = k * k;
+    return R0 + (1 - R0) * Pow(1 - NoV, 5.0f);
+}
+
+// PCG hash, the integer math is the same as the HLSL one, so both take the same samples
+uint32_t Hash(uint32_t value)
+{
+    const uint32_t state = value * 747796405u + 2891336453u;
+    const uint32_t word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// in [0; 1), every call advances the seed
+float Random(uint32_t& seed)
+{
+    seed = Hash(seed);
+    return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+// The shaders of Sample.hlsl, every function is a line by line port of its HLSL counterpart,
+// so the images match the GPU ones up to the floating point differences.
+class Pipeline
+{
+public:
+    Pipeline(const CpuRaytracer::SceneDesc& scene, const ViewParams& viewParams, const LightParams& lightParams)
+        : _scene(scene)
+        , _viewParams(viewParams)
+        , _lightParams(lightParams)
+    {
+    }
+
+    // the ray generation shader of the launches of a block, at most blockSize of them
+    void RayGenShader(uint32_t            startX,
+                      uint32_t            startY,
+                      uint32_t            endX,
+                      uint32_t            endY,
+                      uint32_t            width,
+                      uint32_t            height,
+                      std::span<XMFLOAT4> output,
+                      std::span<XMFLOAT4> gbuffer,
+                      RayCounters&        raysCount) const
+    {
+        std::array<BVH::Ray, blockSize> rays;
+        std::array<XMUINT2, blockSize>  launches;
+
+        // the last pair of an odd width has a single pixel
+        std::size_t count = 0;
+        for (uint32_t y = startY; y < endY; ++y)
+        {
+            for (uint32_t x = startX; x < endX; ++x)
+            {
+                const XMUINT2 pixel = PixelIndex({x, y});
+                if (pixel.x >= width)
+                    continue;
+
+                XMVECTOR origin, direction;
+                GenerateCameraRay(pixel.x, pixel.y, width, height, origin, direction);
+                launches[count] = {x, y};
+                rays[count++]   = MakeRay(origin, direction, 0.01f, 3000.0f);
+            }
+        }
+
+        raysCount.traced += count;
+        for (std::size_t ray = 0; ray < count; ++ray)
+        {
+            RayPayload payload;
+            payload.color       = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+            payload.hitDistance = MISS_DISTANCE;
+            payload.normal      = XMVectorZero();
+
+            CallShader(_scene.scene->Raycast(rays[ray]), XMLoadFloat3(&rays[ray].direction), payload, 1, launches[ray], raysCount);
+
+            const XMUINT2     pixel = PixelIndex(launches[ray]);
+            const std::size_t index = (std::size_t)pixel.y * width + pixel.x;
+            XMStoreFloat4(&output[index], XMVectorSetW(payload.color, 1.0f));
+            if (!gbuffer.empty())
+                XMStoreFloat4(&gbuffer[index], XMVectorSetW(payload.normal, payload.hitDistance));
+        }
+    }
+
+private:
+    // the checkerboard launches trace one pixel of a horizontal pair, the rows and the frames alternate
+    XMUINT2 PixelIndex(const XMUINT2& launchIndex) const
+    {
+        XMUINT2 index = launchIndex;
+        if (_viewParams.sampling == SAMPLING_CHECKERBOARD)
+            index.x = index.x * 2 + ((index.y + _viewParams.frameIndex) & 1);
+        return index;
+    }
+
+    void GenerateCameraRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height, XMVECTOR& origin, XMVECTOR& direction) const
+    {
+        // center in the middle of the pixel, y is inverted for DirectX-style coordinates
+        const float screenX = (x + 0.5f) / width * 2.0f - 1.0f;
+        const float screenY = -((y + 0.5f) / height * 2.0f - 1.0f);
+
+        // unproject the pixel coordinate into a ray
+        XMVECTOR world = XMVector4Transform(XMVectorSet(screenX, screenY, 0.0f, 1.0f), _viewParams.inverseViewProj);
+        world          = XMVectorDivide(world, XMVectorSplatW(world));
+
+        origin    = _viewParams.viewPos;
+        direction = XMVector3Normalize(XMVectorSubtract(world, origin));
+    }
+
+    // TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ...) calling the closest hit or the miss shader,
+    // the launch index is the DispatchRaysIndex() of the pixel
+    void TraceRay(FXMVECTOR      origin,
+                  FXMVECTOR      direction,
+                  float          tMin,
+                  float          tMax,
+                  RayPayload&    payload,
+                  uint32_t       depth,
+                  const XMUINT2& launchIndex,
+                  RayCounters&   raysCount) const
+    {
+        ++raysCount.traced;
+        CallShader(_scene.scene->Raycast(MakeRay(origin, direction, tMin, tMax)), direction, payload, depth, launchIndex, raysCount);
+    }
+
+    // the inline query of both sides of the triangles which accepts the first hit
+    bool IsOccluded(FXMVECTOR origin, FXMVECTOR direction, float tMax, RayCounters& raysCount) const
+    {
+        ++raysCount.traced;
+
+        BVH::Ray ray      = MakeRay(origin, direction, 0.01f, tMax);
+        ray.cullBackFaces = false;
+        ray.instanceMask  = INSTANCE_MASK_OPAQUE;
+        return _scene.scene->IsOccluded(ray);
+    }
+
+    BVH::Ray MakeRay(FXMVECTOR origin, FXMVECTOR direction, float tMin, float tMax) const
+    {
+        BVH::Ray ray;
+        XMStoreFloat3(&ray.origin, origin);
+        XMStoreFloat3(&ray.direction, direction);
+        ray.tMin          = tMin;
+        ray.tMax          = tMax;
+        ray.cullBackFaces = true;
+        return ray;
+    }
+
+    // the closest hit or the miss shader of a traced ray
+    void CallShader(const std::optional<BVH::Hit>& hit,
+                    FXMVECTOR                      direction,
+                    RayPayload&                    payload,
+                    uint32_t                       depth,
+                    const XMUINT2&                 launchIndex,
+                    RayCounters&                   raysCount) const
+    {
+        if (!hit)
+        {
+            MissShader(payload);
+            return;
+        }
+
+        const InstanceParams&         instance  = _scene.instances[hit->instance];
+        const CpuRaytracer::Geometry& geometry  = _scene.geometries[instance.geometryOffset + hit->geometry];
+        const XMMATRIX&               transform = _scene.scene->GetObjectToWorld(hit->instance);
+        const HitVertex               v         = LoadAndInterpolate(geometry, *hit);
+
+        switch (geometry.shader)
+        {
+        case CpuRaytracer::HitShader::Diffuse:
+            DiffuseShader(payload, instance, transform, v, hit->t, launchIndex, raysCount);
+            break;
+        case CpuRaytracer::HitShader::Specular:
+            SpecularShader(payload, instance, geometry, transform, v, hit->t, launchIndex, raysCount);
+            break;
+        case CpuRaytracer::HitShader::Water:
+            WaterShader(payload, geometry, transform, v, hit->t, direction, depth, launchIndex, raysCount);
+            break;
+        }
+    }
+
+    void MissShader(RayPayload& payload) const
+    {
+        payload.color = skyColor;
+    }
+
+    HitVertex LoadAndInterpolate(const CpuRaytracer::Geometry& geometry, const BVH::Hit& hit) const
+    {
+        uint32_t indices[3] = {hit.triangle * 3, hit.triangle * 3 + 1, hit.triangle * 3 + 2};
+        if (!geometry.indices.empty())
+        {
+            for (uint32_t& index : indices)
+                index = geometry.indices[index];
+        }
+
+        const GeometryVertex& v1 = geometry.vertices[indices[0]];
+        const GeometryVertex& v2 = geometry.vertices[indices[1]];
+        const GeometryVertex& v3 = geometry.vertices[indices[2]];
+
+        const float barycentrics[3] = {1.0f - hit.barycentrics.x - hit.barycentrics.y, hit.barycentrics.x, hit.barycentrics.y};
+
+        const auto interpolate = [&](const XMFLOAT3& attribute1, const XMFLOAT3& attribute2, const XMFLOAT3& attribute3) {
+            XMVECTOR output = XMVectorScale(XMLoadFloat3(&attribute1), barycentrics[0]);
+            output          = XMVectorAdd(output, XMVectorScale(XMLoadFloat3(&attribute2), barycentrics[1]));
+            return XMVectorAdd(output, XMVectorScale(XMLoadFloat3(&attribute3), barycentrics[2]));
+        };
+
+        HitVertex output;
+        output.position = interpolate(v1.position, v2.position, v3.position);
+        output.normal   = interpolate(v1.normal, v2.normal, v3.normal);
+        output.color    = XMLoadFloat3(&v1.color);
+        return output;
+    }
+
+    XMVECTOR ToWorldPosition(FXMVECTOR position, const XMMATRIX& transform) const
+    {
+        return XMVector3Transform(position, transform);
+    }
+
+    XMVECTOR ToWorldNormal(FXMVECTOR normal, const XMMATRIX& transform) const
+    {
+        return XMVector3Normalize(XMVector3TransformNormal(normal, transform));
+    }
+
+    XMVECTOR LightVector() const
+    {
+        return XMVectorNegate(XMVector3Normalize(_lightParams.direction));
+    }
+
+    XMVECTOR PhongDiffuse(float NoL, FXMVECTOR lightColor, FXMVECTOR albedo) const
+    {
+        return XMVectorScale(XMVectorMultiply(lightColor, albedo), Saturate(NoL));
+    }
+
+    XMVECTOR PhongSpecular(float NoV, FXMVECTOR lightColor, float reflectance) const
+    {
+        return XMVectorScale(lightColor, Pow(Saturate(NoV), reflectance));
+    }
+
+    uint32_t RandomSeed(const XMUINT2& launchIndex) const
+    {
+        const XMUINT2 index = PixelIndex(launchIndex);
+        return Hash(index.x ^ Hash(index.y ^ Hash(_viewParams.frameIndex)));
+    }
+
+    float LightVisibility(FXMVECTOR position, FXMVECTOR l, float NoL, RayCounters& raysCount) const
+    {
+        if (NoL <= 0.0f)
+            return 0.0f;
+
+        return IsOccluded(position, l, 3000.0f, raysCount) ? 0.0f : 1.0f;
+    }
+
+    float AmbientOcclusion(FXMVECTOR position, FXMVECTOR n, uint32_t& seed, RayCounters& raysCount) const
+    {
+        uint32_t samplesCount = (uint32_t)_viewParams.aoSamples;
+        if (Random(seed) < _viewParams.aoSamples - std::floor(_viewParams.aoSamples))
+            samplesCount++;
+
+        if (samplesCount == 0)
+            return 1.0f;
+
+        const XMVECTOR up        = std::abs(XMVectorGetZ(n)) < 0.999f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+        const XMVECTOR tangent   = XMVector3Normalize(XMVector3Cross(up, n));
+        const XMVECTOR bitangent = XMVector3Cross(n, tangent);
+
+        uint32_t openCount = 0;
+        for (uint32_t i = 0; i < samplesCount; ++i)
+        {
+            const float u1  = Random(seed);
+            const float u2  = Random(seed);
+            const float r   = std::sqrt(u1);
+            const float phi = 2.0f * XM_PI * u2;
+
+            XMVECTOR direction = XMVectorScale(tangent, r * std::cos(phi));
+            direction          = XMVectorAdd(direction, XMVectorScale(bitangent, r * std::sin(phi)));
+            direction          = XMVectorAdd(direction, XMVectorScale(n, std::sqrt(1.0f - u1)));
+            if (!IsOccluded(position, direction, _viewParams.aoRadius, raysCount))
+                openCount++;
+        }
+
+        return (float)openCount / samplesCount;
+    }
+
+    void SpecularShader(RayPayload&                   payload,
+                        const InstanceParams&         instance,
+                        const CpuRaytracer::Geometry& geometry,
+                        const XMMATRIX&               transform,
+                        const HitVertex&              v,
+                        float                         t,
+                        const XMUINT2&                launchIndex,
+                        RayCounters&                  raysCount) const
+    {
+        const XMVECTOR n            = ToWorldNormal(v.normal, transform);
+        const XMVECTOR l            = LightVector();
+        const float    NoL          = XMVectorGetX(XMVector3Dot(n, l));
+        const XMVECTOR albedo       = XMVectorMultiply(v.color, XMLoadFloat3(&instance.color));
+        const XMVECTOR diffuseColor = PhongDiffuse(NoL, _lightParams.color, albedo);
+
+        const XMVECTOR currentPos    = ToWorldPosition(v.position, transform);
+        const XMVECTOR r             = XMVector3Reflect(XMVector3Normalize(XMVectorSubtract(currentPos, _viewParams.viewPos)), n);
+        const float    NoV           = XMVectorGetX(XMVector3Dot(r, l));
+        const XMVECTOR specularColor = PhongSpecular(NoV, _lightParams.color, geometry.material.reflectance);
+
+        uint32_t       seed         = RandomSeed(launchIndex);
+        const float    visibility   = LightVisibility(currentPos, l, NoL, raysCount);
+        const XMVECTOR ambientColor = XMVectorScale(_viewParams.ambientColor, AmbientOcclusion(currentPos, n, seed, raysCount));
+
+        payload.color       = XMVectorMultiplyAdd(XMVectorAdd(specularColor, diffuseColor), XMVectorReplicate(visibility), ambientColor);
+        payload.hitDistance = std::min(payload.hitDistance, t);
+        payload.normal      = n;
+    }
+
+    void DiffuseShader(RayPayload&           payload,
+                       const InstanceParams& instance,
+                       const XMMATRIX&       transform,
+                       const HitVertex&      v,
+                       float                 t,
+                       const XMUINT2&        launchIndex,
+                       RayCounters&          raysCount) const
+    {
+        const XMVECTOR currentPos   = ToWorldPosition(v.position, transform);
+        const XMVECTOR n            = ToWorldNormal(v.normal, transform);
+        const XMVECTOR l            = LightVector();
+        const float    NoL          = XMVectorGetX(XMVector3Dot(n, l));
+        const XMVECTOR albedo       = XMVectorMultiply(v.color, XMLoadFloat3(&instance.color));
+        const XMVECTOR diffuseColor = PhongDiffuse(NoL, _lightParams.color, albedo);
+
+        uint32_t       seed         = RandomSeed(launchIndex);
+        const float    visibility   = LightVisibility(currentPos, l, NoL, raysCount);
+        const XMVECTOR ambientColor = XMVectorScale(_viewParams.ambientColor, AmbientOcclusion(currentPos, n, seed, raysCount));
+
+        payload.color       = XMVectorMultiplyAdd(diffuseColor, XMVectorReplicate(visibility), ambientColor);
+        payload.hitDistance = std::min(payload.hitDistance, t);
+        payload.normal      = n;
+    }
+
+    // Recursing past the pipeline limit removes the device on the GPU. Here the water hit by a
+    // water ray traces nothing instead and uses the initial payloads, so such pixels are defined.
+    void WaterShader(RayPayload&                   payload,
+                     const CpuRaytracer::Geometry& geometry,
+                     const XMMATRIX&               transform,
+                     const HitVertex&              v,
+                     float                         t,
+                     FXMVECTOR                     rayDirection,
+                     uint32_t                      depth,
+                     const XMUINT2&                launchIndex,
+                     RayCounters&                  raysCount) const
+    {
+        const XMVECTOR n   = ToWorldNormal(v.normal, transform);
+        const XMVECTOR p   = ToWorldPosition(v.position, transform);
+        const float    ior = geometry.material.reflectance;
+
+        payload.hitDistance = std::min(payload.hitDistance, t);
+        payload.normal      = n;
+
+        // 1.0 is the air refractivity
+        const XMVECTOR refraction = XMVector3Refract(rayDirection, n, 1.0f / ior);
+        if (XMVectorGetX(XMVector3Length(refraction)) < 0.1f)
+        {
+            payload.color = XMVectorZero();
+            return;
+        }
+
+        const float NoV    = Saturate(XMVectorGetX(XMVector3Dot(n, XMVectorNegate(rayDirection))));
+        const float amount = F_Shlick(NoV, ior);
+
+        const bool  canTrace  = depth < maxRecursionDepth;
+        const float minWeight = _viewParams.waterMinWeight;
+
+        XMVECTOR refractionColor = deepWaterColor;
+        if (1.0f - amount >= minWeight)
+        {
+            RayPayload waterPayload;
+            waterPayload.color       = XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+            waterPayload.hitDistance = MISS_DISTANCE;
+            waterPayload.normal      = XMVectorZero();
+            // the bottom farther than this weighs less than the minimal weight after the fade
+            if (canTrace)
+                TraceRay(p, refraction, 0.01f, waterFadeDistance * std::sqrt(1.0f - minWeight), waterPayload, depth + 1, launchIndex, raysCount);
+
+            const float fade = Pow(Saturate(waterPayload.hitDistance / waterFadeDistance), 2.0f);
+            refractionColor  = XMVectorLerp(waterPayload.color, deepWaterColor, fade);
+        }
+        else
+        {
+            ++raysCount.skipped;
+        }
+
+        XMVECTOR reflectionColor = skyColor;
+        if (amount >= minWeight)
+        {
+            // the reach falls with the distance like the size of the reflected objects on the screen does
+            const float distance    = XMVectorGetX(XMVector3Length(XMVectorSubtract(p, _viewParams.viewPos)));
+            const float farDistance = _viewParams.waterFarDistance;
+            const float tMax        = farDistance > 0.0f ? std::min(3100.0f, farDistance * farDistance / distance) : 3100.0f;
+
+            RayPayload reflectionPayload;
+            reflectionPayload.color       = XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+            reflectionPayload.hitDistance = MISS_DISTANCE;
+            reflectionPayload.normal      = XMVectorZero();
+            if (canTrace)
+                TraceRay(p, XMVector3Reflect(rayDirection, n), 0.01f, tMax, reflectionPayload, depth + 1, launchIndex, raysCount);
+
+            reflectionColor = reflectionPayload.color;
+        }
+        else
+        {
+            ++raysCount.skipped;
+        }
+
+        payload.color = XMVectorLerp(refractionColor, reflectionColor, amount);
+    }
+
+    const CpuRaytracer::SceneDesc& _scene;
+    const ViewParams&              _viewParams;
+    const LightParams&             _lightParams;
+};
+}  // namespace
+
+CpuRaytracer::CpuRaytracer(std::size_t threadsCount /*= std::thread::hardware_concurrency()*/, uint32_t tileSize /*= 16*/)
+    : _pool(threadsCount)
+    , _tileSize(std::max(tileSize, 1u))
+{
+}
+
+CpuRaytracer::Stats CpuRaytracer::Render(const SceneDesc&    scene,
+                                         const ViewParams&   viewParams,
+                                         const LightParams&  lightParams,
+                                         uint32_t            width,
+                                         uint32_t            height,
+                                         std::span<XMFLOAT4> output,
+                                         std::span<XMFLOAT4> gbuffer /*= {}*/)
+{
+    PROFILE_SCOPE("CpuRaytracer::Render");
+
+    if (!scene.scene)
+        throw std::runtime_error("CpuRaytracer: the scene is not set");
+    if (output.size() < (std::size_t)width * height)
+        throw std::runtime_error("CpuRaytracer: the output is smaller than the image");
+    if (!gbuffer.empty() && gbuffer.size() < (std::size_t)width * height)
+        throw std::runtime_error("CpuRaytracer: the gbuffer is smaller than the image");
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const Pipeline pipeline(scene, viewParams, lightParams);
+
+    // the tiles are of the launches, a checkerboard one is half as wide as the image
+    const uint32_t launchWidth = viewParams.sampling == SAMPLING_CHECKERBOARD ? (width + 1) / 2 : width;
+    const uint32_t tilesX      = (launchWidth + _tileSize - 1) / _tileSize;
+    const uint32_t tilesY      = (height + _tileSize - 1) / _tileSize;
+
+    std::atomic<uint64_t> raysCount        = 0;
+    std::atomic<uint64_t> skippedRaysCount = 0;
+    _pool.ParallelFor((std::size_t)tilesX * tilesY, [&](std::size_t tile, std::size_t) {
+        const uint32_t startX = (uint32_t)(tile % tilesX) * _tileSize;
+        const uint32_t startY = (uint32_t)(tile / tilesX) * _tileSize;
+        const uint32_t endX   = std::min(startX + _tileSize, launchWidth);
+        const uint32_t endY   = std::min(startY + _tileSize, height);
+
+        RayCounters tileRays;
+        for (uint32_t y = startY; y < endY; y += blockHeight)
+        {
+            for (uint32_t x = startX; x < endX; x += blockWidth)
+                pipeline.RayGenShader(x, y, std::min(x + blockWidth, endX), std::min(y + blockHeight, endY), width, height, output, gbuffer, tileRays);
+        }
+
+        raysCount += tileRays.traced;
+        skippedRaysCount += tileRays.skipped;
+    });
+
+    Stats stats;
+    stats.milliseconds      = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    stats.raysCount         = raysCount;
+    stats.skippedRaysCount  = skippedRaysCount;
+    stats.megaraysPerSecond = stats.milliseconds > 0.0 ? stats.raysCount / (stats.milliseconds * 1000.0) : 0.0;
+    return stats;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "BVHScene.h"
+#include "WorkStealingPool.h"
+
+#include <cstdint>
+#include <span>
+
+// Headless counterpart of the Sample.hlsl pipeline: the ray generation, miss and hit shaders run on
+// the CPU over the BVH mirror of the instances. The image is split into tiles which are rendered
+// by a work stealing pool, so no GPU is needed to get the reference images of a scene.
+class CpuRaytracer
+{
+public:
+    // hit groups of the pipeline
+    enum class HitShader
+    {
+        Diffuse,
+        Specular,
+        Water
+    };
+
+    // the CPU side of a GeometryParams record
+    struct Geometry
+    {
+        std::span<const GeometryVertex> vertices;
+        std::span<const uint32_t>       indices;  // every three vertices are a triangle if empty
+        HitShader                       shader   = HitShader::Diffuse;
+        MaterialParams                  material = {};
+    };
+
+    // the tables are indexed the same way as the GPU ones, by InstanceID() and by the instance
+    // geometry offset plus GeometryIndex()
+    struct SceneDesc
+    {
+        const BVH::Scene*               scene = nullptr;
+        std::span<const InstanceParams> instances;
+        std::span<const Geometry>       geometries;
+    };
+
+    struct Stats
+    {
+        double   milliseconds      = 0.0;
+        uint64_t raysCount         = 0;  // all the traced ones, the shadow and the occlusion ones too
+        uint64_t skippedRaysCount  = 0;  // the water ones of the weights below ViewParams::waterMinWeight
+        double   megaraysPerSecond = 0.0;
+    };
+
+    explicit CpuRaytracer(std::size_t threadsCount = std::thread::hardware_concurrency(), uint32_t tileSize = 16);
+
+    // The output is row-major like the raytracing output texture, the alpha is 1. The gbuffer gets the
+    // normals and the hit distances of the camera rays if it is given. The checkerboard sampling of
+    // the view params writes the traced half of the pixels only.
+    Stats Render(const SceneDesc&             scene,
+                 const ViewParams&            viewParams,
+                 const LightParams&           lightParams,
+                 uint32_t                     width,
+                 uint32_t                     height,
+                 std::span<DirectX::XMFLOAT4> output,
+                 std::span<DirectX::XMFLOAT4> gbuffer = {});
+
+private:
+    WorkStealingPool _pool;
+    const uint32_t   _tileSize;
+};
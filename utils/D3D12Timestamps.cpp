@@ -0,0 +1,87 @@
+#include "stdafx.h"
+
+#include "D3D12Timestamps.h"
+
+#include "DXSampleHelper.h"
+
+#include <algorithm>
+
+D3D12Timestamps::D3D12Timestamps(ComPtr<ID3D12Device> device, ComPtr<ID3D12CommandQueue> queue, uint32_t queriesCount)
+    : _queue(queue)
+    , _queriesCount(queriesCount)
+{
+    assert(device);
+    assert(queue);
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type                  = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count                 = queriesCount;
+    ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&_queryHeap)));
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width               = sizeof(uint64_t) * queriesCount;
+    bufferDesc.Height              = 1;
+    bufferDesc.MipLevels           = 1;
+    bufferDesc.SampleDesc.Count    = 1;
+    bufferDesc.DepthOrArraySize    = 1;
+    bufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    D3D12_HEAP_PROPERTIES heapProp = {D3D12_HEAP_TYPE_READBACK};
+    ThrowIfFailed(device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                  D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&_readback)));
+    _readback->SetName(L"Timestamps readback");
+
+    // the parts are read only after the GPU is done with them, so the buffer may stay mapped
+    ThrowIfFailed(_readback->Map(0, nullptr, reinterpret_cast<void**>(&_ticks)));
+
+    ThrowIfFailed(_queue->GetTimestampFrequency(&_frequency));
+
+    LARGE_INTEGER cpuFrequency;
+    QueryPerformanceFrequency(&cpuFrequency);
+    _cpuFrequency = (uint64_t)cpuFrequency.QuadPart;
+}
+
+D3D12Timestamps::~D3D12Timestamps()
+{
+    const D3D12_RANGE written = {0, 0};
+    _readback->Unmap(0, &written);
+}
+
+uint64_t D3D12Timestamps::GetFrequency() const
+{
+    return _frequency;
+}
+
+void D3D12Timestamps::GetCalibration(uint64_t& gpuTicks, int64_t& cpuNanoseconds) const
+{
+    uint64_t cpuTicks = 0;
+    ThrowIfFailed(_queue->GetClockCalibration(&gpuTicks, &cpuTicks));
+
+    // the calibration is of QueryPerformanceCounter, it is moved to the profiler clock by the time passed since
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    const int64_t profilerNow = Profiler::Now();
+    const int64_t passed      = (int64_t)(((double)now.QuadPart - (double)cpuTicks) * 1e9 / _cpuFrequency);
+
+    cpuNanoseconds = profilerNow - passed;
+}
+
+void D3D12Timestamps::WriteTimestamp(ID3D12GraphicsCommandList* cmdList, uint32_t query)
+{
+    assert(query < _queriesCount);
+    cmdList->EndQuery(_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, query);
+}
+
+void D3D12Timestamps::Resolve(ID3D12GraphicsCommandList* cmdList, uint32_t firstQuery, uint32_t count)
+{
+    assert(firstQuery + count <= _queriesCount);
+    cmdList->ResolveQueryData(_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, count, _readback.Get(),
+                              sizeof(uint64_t) * firstQuery);
+}
+
+void D3D12Timestamps::Read(uint32_t firstQuery, std::span<uint64_t> ticks)
+{
+    assert(firstQuery + ticks.size() <= _queriesCount);
+    std::copy(_ticks + firstQuery, _ticks + firstQuery + ticks.size(), ticks.begin());
+}
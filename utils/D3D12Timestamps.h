@@ -0,0 +1,32 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "GpuProfiler.h"
+
+// The timestamp queries of a queue resolved to a persistently mapped readback buffer
+class D3D12Timestamps : public IGpuTimestamps
+{
+public:
+    D3D12Timestamps(ComPtr<ID3D12Device> device, ComPtr<ID3D12CommandQueue> queue, uint32_t queriesCount);
+    ~D3D12Timestamps();
+
+    D3D12Timestamps(const D3D12Timestamps&) = delete;
+    D3D12Timestamps& operator=(const D3D12Timestamps&) = delete;
+
+    // IGpuTimestamps
+    uint64_t GetFrequency() const override;
+    void     GetCalibration(uint64_t& gpuTicks, int64_t& cpuNanoseconds) const override;
+    void     WriteTimestamp(ID3D12GraphicsCommandList* cmdList, uint32_t query) override;
+    void     Resolve(ID3D12GraphicsCommandList* cmdList, uint32_t firstQuery, uint32_t count) override;
+    void     Read(uint32_t firstQuery, std::span<uint64_t> ticks) override;
+
+private:
+    ComPtr<ID3D12CommandQueue> _queue        = nullptr;
+    ComPtr<ID3D12QueryHeap>    _queryHeap    = nullptr;
+    ComPtr<ID3D12Resource>     _readback     = nullptr;
+    uint64_t*                  _ticks        = nullptr;
+    uint32_t                   _queriesCount = 0;
+    uint64_t                   _frequency    = 0;
+    uint64_t                   _cpuFrequency = 0;  // of QueryPerformanceCounter
+};
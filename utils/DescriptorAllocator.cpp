@@ -0,0 +1,119 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace
+{
+// inserts the range merging it with the overlapping and adjacent ones
+void InsertRange(std::map<std::size_t, std::size_t>& ranges, std::size_t offset, std::size_t count)
+{
+    std::size_t begin = offset;
+    std::size_t end   = offset + count;
+
+    auto it = ranges.upper_bound(begin);
+    if (it != ranges.begin())
+    {
+        auto previous = std::prev(it);
+        if (previous->first + previous->second >= begin)
+            it = previous;
+    }
+
+    while (it != ranges.end() && it->first <= end)
+    {
+        begin = std::min(begin, it->first);
+        end   = std::max(end, it->first + it->second);
+        it    = ranges.erase(it);
+    }
+
+    ranges[begin] = end - begin;
+}
+}  // namespace
+
+DescriptorAllocator::DescriptorAllocator(std::size_t capacity)
+{
+    Grow(capacity);
+}
+
+std::optional<std::size_t> DescriptorAllocator::Allocate(std::size_t count /*= 1*/)
+{
+    assert(count > 0);
+
+    // first fit keeps the used descriptors at the beginning of the heap
+    auto it = std::ranges::find_if(_freeRanges, [count](const auto& range) { return range.second >= count; });
+    if (it == _freeRanges.end())
+        return std::nullopt;
+
+    const auto [offset, freeCount] = *it;
+    _freeRanges.erase(it);
+    if (freeCount > count)
+        _freeRanges[offset + count] = freeCount - count;
+
+    _allocatedCount += count;
+    MarkDirty(offset, count);
+
+    return offset;
+}
+
+void DescriptorAllocator::Free(std::size_t offset, std::size_t count, uint64_t fenceValue)
+{
+    assert(offset + count <= _capacity);
+    assert(_pendingFrees.empty() || _pendingFrees.back().fenceValue <= fenceValue);
+
+    _pendingFrees.push_back({fenceValue, {offset, count}});
+}
+
+void DescriptorAllocator::Release(uint64_t completedValue)
+{
+    while (!_pendingFrees.empty() && _pendingFrees.front().fenceValue <= completedValue)
+    {
+        const Range& range = _pendingFrees.front().range;
+        InsertRange(_freeRanges, range.offset, range.count);
+        _allocatedCount -= range.count;
+
+        _pendingFrees.pop_front();
+    }
+}
+
+void DescriptorAllocator::Grow(std::size_t capacity)
+{
+    assert(capacity >= _capacity);
+
+    if (capacity > _capacity)
+        InsertRange(_freeRanges, _capacity, capacity - _capacity);
+
+    _capacity = capacity;
+}
+
+void DescriptorAllocator::MarkDirty(std::size_t offset, std::size_t count /*= 1*/)
+{
+    assert(offset + count <= _capacity);
+    InsertRange(_dirtyRanges, offset, count);
+}
+
+std::vector<DescriptorAllocator::Range> DescriptorAllocator::TakeDirtyRanges()
+{
+    std::vector<Range> output;
+    output.reserve(_dirtyRanges.size());
+    for (const auto& [offset, count] : _dirtyRanges)
+        output.push_back({offset, count});
+
+    _dirtyRanges.clear();
+    return output;
+}
+
+std::size_t DescriptorAllocator::GetCapacity() const
+{
+    return _capacity;
+}
+
+std::size_t DescriptorAllocator::GetAllocatedCount() const
+{
+    return _allocatedCount;
+}
+
+std::size_t DescriptorAllocator::GetPendingFreesCount() const
+{
+    return _pendingFrees.size();
+}
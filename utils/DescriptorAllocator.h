@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <vector>
+
+// Allocates ranges of descriptor indices, the heaps themselves are managed by DescriptorHeap.
+// Freed ranges are reused only after the frames which may still reference them are finished.
+// Written ranges are tracked, so only they are copied to the shader visible heap.
+class DescriptorAllocator
+{
+public:
+    struct Range
+    {
+        std::size_t offset = 0;
+        std::size_t count  = 0;
+    };
+
+    explicit DescriptorAllocator(std::size_t capacity);
+
+    // returns the first index of a contiguous range, the range is marked dirty since it is going to be written
+    std::optional<std::size_t> Allocate(std::size_t count = 1);
+    // the range is reused once the fence reaches the value
+    void Free(std::size_t offset, std::size_t count, uint64_t fenceValue);
+    void Release(uint64_t completedValue);
+
+    // new indices are appended to the end and are free
+    void Grow(std::size_t capacity);
+
+    void MarkDirty(std::size_t offset, std::size_t count = 1);
+    // returns the dirty ranges merged and sorted, they are clean after that
+    std::vector<Range> TakeDirtyRanges();
+
+    std::size_t GetCapacity() const;
+    std::size_t GetAllocatedCount() const;  // including the pending frees
+    std::size_t GetPendingFreesCount() const;
+
+private:
+    struct PendingFree
+    {
+        uint64_t fenceValue = 0;
+        Range    range;
+    };
+
+    std::size_t _capacity       = 0;
+    std::size_t _allocatedCount = 0;
+
+    std::map<std::size_t, std::size_t> _freeRanges;   // offset -> count, adjacent ones are merged
+    std::map<std::size_t, std::size_t> _dirtyRanges;  // offset -> count, adjacent ones are merged
+    std::deque<PendingFree>            _pendingFrees;
+};
@@ -2,16 +2,15 @@
 
 #include "DescriptorHeap.h"
 
-DescriptorHeap::DescriptorHeap(ComPtr<ID3D12Device> device, D3D12_DESCRIPTOR_HEAP_TYPE type, std::size_t initialDescriptorsCount)
-    : _capacity(0)
-    , _device(device)
+DescriptorHeap::DescriptorHeap(ComPtr<ID3D12Device> device, D3D12_DESCRIPTOR_HEAP_TYPE type, std::size_t descriptorsCount)
+    : _device(device)
+    , _allocator(descriptorsCount ? descriptorsCount : 32)
     , _incrementSize(device->GetDescriptorHandleIncrementSize(type))
     , _type(type)
 {
-    if (!initialDescriptorsCount)
-        initialDescriptorsCount = 32;
-
-    Reallocate(initialDescriptorsCount);
+    _cpuHeap = CreateHeap(_allocator.GetCapacity(), false);
+    if (IsShaderVisible())
+        _gpuHeap = CreateHeap(_allocator.GetCapacity(), true);
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetCPUAddress(std::size_t index) const
@@ -23,81 +22,100 @@ D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetCPUAddress(std::size_t index) con
 
 D3D12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GetGPUAddress(std::size_t index) const
 {
-    auto heapStart = _cpuHeap->GetGPUDescriptorHandleForHeapStart();
+    assert(IsShaderVisible());
+
+    auto heapStart = _gpuHeap->GetGPUDescriptorHandleForHeapStart();
     heapStart.ptr += _incrementSize * index;
     return heapStart;
 }
 
-FreeAddress<D3D12_CPU_DESCRIPTOR_HANDLE> DescriptorHeap::GetFreeCPUAddress()
+FreeAddress<D3D12_CPU_DESCRIPTOR_HANDLE> DescriptorHeap::GetFreeCPUAddress(std::size_t count /*= 1*/)
 {
-    _dirty = true;
-
-    if (_size == _capacity)
-        Reallocate(_size + _size / 3);  // add 33% of the size
+    const std::size_t index = Allocate(count);
+    return {index, GetCPUAddress(index)};
+}
 
-    auto heapStart = _cpuHeap->GetCPUDescriptorHandleForHeapStart();
-    heapStart.ptr += _size * _incrementSize;
-    ++_size;
-    return {_size - 1, heapStart};
+FreeAddress<D3D12_GPU_DESCRIPTOR_HANDLE> DescriptorHeap::GetFreeGPUAddress(std::size_t count /*= 1*/)
+{
+    const std::size_t index = Allocate(count);
+    return {index, GetGPUAddress(index)};
 }
 
-FreeAddress<D3D12_GPU_DESCRIPTOR_HANDLE> DescriptorHeap::GetFreeGPUAddress()
+void DescriptorHeap::Free(std::size_t index, std::size_t count /*= 1*/)
 {
-    _dirty = true;
+    _allocator.Free(index, count, _frameFenceValue);
 
-    if (_size == _capacity)
-        Reallocate(_size + _size / 3);  // add 33% of the size
+    // RTVs and DSVs are read when the commands are recorded, the frames in flight don't refer to them
+    if (!IsShaderVisible())
+        _allocator.Release(_frameFenceValue);
+}
 
-    ++_size;
-    auto heapStart = _cpuHeap->GetGPUDescriptorHandleForHeapStart();
-    heapStart.ptr += _size * _incrementSize;
-    return {_size - 1, heapStart};
+void DescriptorHeap::BeginFrame(uint64_t frameFenceValue, uint64_t completedValue)
+{
+    _frameFenceValue = frameFenceValue;
+    _allocator.Release(completedValue);
 }
 
 std::size_t DescriptorHeap::GetNumDescriptors() const
 {
-    return _size;
+    return _allocator.GetAllocatedCount();
 }
 
 ComPtr<ID3D12DescriptorHeap> DescriptorHeap::GetResource()
 {
-    if (IsDirty())
-    {
-        // Mirror descriptors
-        Mirror();
-    }
+    if (!IsShaderVisible())
+        return _cpuHeap;
 
+    Mirror();
     return _gpuHeap;
 }
 
-bool DescriptorHeap::IsDirty() const
+bool DescriptorHeap::IsShaderVisible() const
 {
-    return _dirty;
+    return _type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV || _type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
 }
 
 void DescriptorHeap::Mirror()
 {
-    if (_size)
+    // the dirty ranges are either new or freed after the frames using them, so the
+    // frames in flight never read the descriptors being copied
+    for (const DescriptorAllocator::Range& range : _allocator.TakeDirtyRanges())
     {
-        _device->CopyDescriptorsSimple(_size, _gpuHeap->GetCPUDescriptorHandleForHeapStart(),
-                                       _cpuHeap->GetCPUDescriptorHandleForHeapStart(), _type);
+        auto destination = _gpuHeap->GetCPUDescriptorHandleForHeapStart();
+        destination.ptr += _incrementSize * range.offset;
+
+        _device->CopyDescriptorsSimple(static_cast<UINT>(range.count), destination, GetCPUAddress(range.offset), _type);
     }
 }
 
-void DescriptorHeap::Reallocate(std::size_t newSize)
+std::size_t DescriptorHeap::Allocate(std::size_t count)
 {
-    assert(newSize > _capacity);
-    auto newHeap = CreateHeap(newSize, false);
+    std::optional<std::size_t> index = _allocator.Allocate(count);
+    if (!index && !IsShaderVisible())
+    {
+        // the views are copied when they are bound, so nothing refers to the old heap
+        const std::size_t capacity = _allocator.GetCapacity();
+        Reallocate(capacity + std::max(capacity / 3, count));  // add 33% of the size
+        index = _allocator.Allocate(count);
+    }
+
+    if (!index)
+        throw std::runtime_error("Descriptor heap is full");
 
-    if (_size)
-        _device->CopyDescriptorsSimple(_size, newHeap->GetCPUDescriptorHandleForHeapStart(),
-                                       _cpuHeap->GetCPUDescriptorHandleForHeapStart(), _type);
+    return *index;
+}
 
-    const bool visible = _type == D3D12_DESCRIPTOR_HEAP_TYPE_DSV || _type == D3D12_DESCRIPTOR_HEAP_TYPE_RTV ? false : true;
+void DescriptorHeap::Reallocate(std::size_t newSize)
+{
+    const std::size_t oldSize = _allocator.GetCapacity();
+    assert(newSize > oldSize);
+
+    auto newHeap = CreateHeap(newSize, false);
+    _device->CopyDescriptorsSimple(static_cast<UINT>(oldSize), newHeap->GetCPUDescriptorHandleForHeapStart(),
+                                   _cpuHeap->GetCPUDescriptorHandleForHeapStart(), _type);
 
-    _cpuHeap  = newHeap;
-    _gpuHeap  = CreateHeap(newSize, visible);
-    _capacity = newSize;
+    _cpuHeap = newHeap;
+    _allocator.Grow(newSize);
 }
 
 ComPtr<ID3D12DescriptorHeap> DescriptorHeap::CreateHeap(std::size_t size, bool visible)
@@ -2,6 +2,8 @@
 
 #include "stdafx.h"
 
+#include "DescriptorAllocator.h"
+
 template<typename T>
 struct FreeAddress
 {
@@ -10,31 +12,41 @@ struct FreeAddress
 };
 
 // This class wraps ID3D12DescriptorHeap and manages allocations
-// of individual descriptors. It works similar to std::vector
-// but provides address to write to instead of push_back method.
+// of descriptors and contiguous ranges of them. Descriptors are written
+// to the CPU heap, only the written ranges are mirrored to the shader
+// visible one. The shader visible heap is never replaced, so the GPU
+// handles recorded in command lists and shader tables stay valid.
 class DescriptorHeap
 {
 public:
-    DescriptorHeap(ComPtr<ID3D12Device> device, D3D12_DESCRIPTOR_HEAP_TYPE type, std::size_t initialDescriptorsCount);
+    DescriptorHeap(ComPtr<ID3D12Device> device, D3D12_DESCRIPTOR_HEAP_TYPE type, std::size_t descriptorsCount);
 
     // Returns address of descriptor in the heap
     D3D12_CPU_DESCRIPTOR_HANDLE GetCPUAddress(std::size_t index) const;
     D3D12_GPU_DESCRIPTOR_HANDLE GetGPUAddress(std::size_t index) const;
 
-    // Returns address of a free descriptor in the heap and reallocates heap if needed
-    FreeAddress<D3D12_CPU_DESCRIPTOR_HANDLE> GetFreeCPUAddress();
-    FreeAddress<D3D12_GPU_DESCRIPTOR_HANDLE> GetFreeGPUAddress();
+    // Returns address of the first descriptor of a free contiguous range, the range is
+    // expected to be written. Only the heaps of RTVs and DSVs grow, the shader visible ones throw when full.
+    FreeAddress<D3D12_CPU_DESCRIPTOR_HANDLE> GetFreeCPUAddress(std::size_t count = 1);
+    FreeAddress<D3D12_GPU_DESCRIPTOR_HANDLE> GetFreeGPUAddress(std::size_t count = 1);
+
+    // The range is reused once the frames recorded before the call are finished,
+    // the ranges of RTVs and DSVs right away
+    void Free(std::size_t index, std::size_t count = 1);
+    // The fence value of the frame being recorded and the completed one, only the shader visible heaps need it
+    void BeginFrame(uint64_t frameFenceValue, uint64_t completedValue);
 
-    // Returns number of descriptors in the heap
+    // Returns number of allocated descriptors in the heap
     std::size_t GetNumDescriptors() const;
 
     // Returns raw resource
     ComPtr<ID3D12DescriptorHeap> GetResource();
 
 private:
-    bool IsDirty() const;
+    bool IsShaderVisible() const;
     void Mirror();
 
+    std::size_t                  Allocate(std::size_t count);
     void                         Reallocate(std::size_t newSize);
     ComPtr<ID3D12DescriptorHeap> CreateHeap(std::size_t size, bool visible);
 
@@ -42,9 +54,8 @@ private:
     ComPtr<ID3D12DescriptorHeap> _gpuHeap;
     ComPtr<ID3D12DescriptorHeap> _cpuHeap;
 
-    std::size_t _capacity;
-    std::size_t _size  = 0;
-    bool        _dirty = true;
+    DescriptorAllocator _allocator;
+    uint64_t            _frameFenceValue = 0;
 
     const std::size_t          _incrementSize;
     D3D12_DESCRIPTOR_HEAP_TYPE _type;
@@ -0,0 +1,272 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+// the frame is a hitch if it is this many times longer than the median of the long window,
+// and longer than it by the absolute threshold too, so the fast frames jitter without hitches
+constexpr double   hitchFactor       = 2.0;
+constexpr uint64_t hitchMicroseconds = 4000;
+// the median of the first frames is not reliable
+constexpr std::size_t minHitchFrames = 30;
+
+uint64_t ToMicroseconds(double milliseconds)
+{
+    return (uint64_t)std::llround(std::max(milliseconds, 0.0) * 1000.0);
+}
+
+double ToMilliseconds(uint64_t microseconds)
+{
+    return microseconds / 1000.0;
+}
+
+const char* GetTrackName(FrameStats::Track track)
+{
+    return track == FrameStats::Track::Cpu ? "CPU" : "GPU";
+}
+}  // namespace
+
+void LogHistogram::Add(uint64_t value)
+{
+    const std::size_t index = GetIndex(value);
+    if (index >= _counts.size())
+        _counts.resize(index + 1, 0);
+
+    ++_counts[index];
+    ++_count;
+}
+
+void LogHistogram::Remove(uint64_t value)
+{
+    const std::size_t index = GetIndex(value);
+    if (index >= _counts.size() || _counts[index] == 0)
+        throw std::runtime_error("LogHistogram: the value was not added");
+
+    --_counts[index];
+    --_count;
+}
+
+void LogHistogram::Clear()
+{
+    _counts.clear();
+    _count = 0;
+}
+
+uint64_t LogHistogram::GetCount() const
+{
+    return _count;
+}
+
+uint64_t LogHistogram::GetPercentile(double percentile) const
+{
+    if (_count == 0)
+        return 0;
+
+    const uint64_t rank = std::max<uint64_t>((uint64_t)std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * _count), 1);
+
+    uint64_t counted = 0;
+    for (std::size_t i = 0; i < _counts.size(); ++i)
+    {
+        counted += _counts[i];
+        if (counted >= rank)
+            return GetHighest(i);
+    }
+
+    return GetHighest(_counts.size() - 1);
+}
+
+std::size_t LogHistogram::GetIndex(uint64_t value)
+{
+    value = std::min(value, maxValue);
+    if (value < subBucketsCount)
+        return (std::size_t)value;
+
+    // the value is in [32, 64) shifted by the power, its top bits select the sub-bucket
+    const uint32_t power = (uint32_t)std::bit_width(value) - (subBucketsBits + 1);
+    return (std::size_t)power * subBucketsCount + (std::size_t)(value >> power);
+}
+
+uint64_t LogHistogram::GetLowest(std::size_t index)
+{
+    const uint32_t power = index < subBucketsCount ? 0 : (uint32_t)(index / subBucketsCount) - 1;
+    return (uint64_t)(index - (std::size_t)power * subBucketsCount) << power;
+}
+
+uint64_t LogHistogram::GetHighest(std::size_t index)
+{
+    const uint32_t power = index < subBucketsCount ? 0 : (uint32_t)(index / subBucketsCount) - 1;
+    return GetLowest(index) + (uint64_t(1) << power) - 1;
+}
+
+FrameStats::SlidingWindow::SlidingWindow(std::size_t capacity)
+    : _capacity(std::max<std::size_t>(capacity, 1))
+{
+}
+
+void FrameStats::SlidingWindow::Add(uint64_t value)
+{
+    if (_values.size() == _capacity)
+    {
+        _histogram.Remove(_values.front());
+        _values.pop_front();
+
+        // the frame leaving the window
+        if (_maxima.front().first + _capacity == _framesCount)
+            _maxima.pop_front();
+    }
+
+    _values.push_back(value);
+    _histogram.Add(value);
+
+    // the smaller values leave the window before this one, so they are never the max
+    while (!_maxima.empty() && _maxima.back().second <= value)
+        _maxima.pop_back();
+    _maxima.emplace_back(_framesCount++, value);
+}
+
+const LogHistogram& FrameStats::SlidingWindow::GetHistogram() const
+{
+    return _histogram;
+}
+
+const std::deque<uint64_t>& FrameStats::SlidingWindow::GetValues() const
+{
+    return _values;
+}
+
+uint64_t FrameStats::SlidingWindow::GetMax() const
+{
+    return _maxima.empty() ? 0 : _maxima.front().second;
+}
+
+FrameStats::FrameStats(std::size_t shortWindow /* = 120*/, std::size_t longWindow /* = 1200*/)
+    : _tracks{TrackStats{SlidingWindow(shortWindow), SlidingWindow(longWindow), {}},
+              TrackStats{SlidingWindow(shortWindow), SlidingWindow(longWindow), {}}}
+{
+}
+
+void FrameStats::AddTag(const char* tag)
+{
+    if (std::find(_pendingTags.begin(), _pendingTags.end(), tag) == _pendingTags.end())
+        _pendingTags.push_back(tag);
+}
+
+void FrameStats::AddFrame(Track track, double milliseconds)
+{
+    TrackStats&    stats   = _tracks[(std::size_t)track];
+    const uint64_t value   = ToMicroseconds(milliseconds);
+    const bool     isHitch = IsHitch(stats, value);
+
+    stats.shortWindow.Add(value);
+    stats.longWindow.Add(value);
+    stats.session.Add(value);
+    stats.sessionMax = std::max(stats.sessionMax, value);
+    stats.hitches += isHitch ? 1 : 0;
+
+    // the GPU times arrive a few frames later, so the tags are of the CPU frames only
+    if (track != Track::Cpu)
+        return;
+
+    for (const char* tag : _pendingTags)
+    {
+        TagStats& tagStats = _tags[tag];
+        tagStats.frameTimes.Add(value);
+        tagStats.hitches += isHitch ? 1 : 0;
+    }
+    _pendingTags.clear();
+}
+
+FrameStats::Summary FrameStats::GetSummary(Track track, Window window) const
+{
+    const TrackStats& stats = _tracks[(std::size_t)track];
+
+    const LogHistogram* histogram = &stats.session;
+    uint64_t            max       = stats.sessionMax;
+    if (window != Window::Session)
+    {
+        const SlidingWindow& sliding = window == Window::Short ? stats.shortWindow : stats.longWindow;
+        histogram                    = &sliding.GetHistogram();
+        max                          = sliding.GetMax();
+    }
+
+    // the buckets are wider than the values, the max is exact
+    Summary summary;
+    summary.frames = histogram->GetCount();
+    summary.p50    = ToMilliseconds(std::min(histogram->GetPercentile(50.0), max));
+    summary.p95    = ToMilliseconds(std::min(histogram->GetPercentile(95.0), max));
+    summary.p99    = ToMilliseconds(std::min(histogram->GetPercentile(99.0), max));
+    summary.max    = ToMilliseconds(max);
+    return summary;
+}
+
+uint64_t FrameStats::GetHitchesCount(Track track) const
+{
+    return _tracks[(std::size_t)track].hitches;
+}
+
+std::size_t FrameStats::GetRecentCount(Track track) const
+{
+    return _tracks[(std::size_t)track].shortWindow.GetValues().size();
+}
+
+float FrameStats::GetRecentMilliseconds(Track track, std::size_t index) const
+{
+    return (float)ToMilliseconds(_tracks[(std::size_t)track].shortWindow.GetValues()[index]);
+}
+
+const std::map<std::string, FrameStats::TagStats>& FrameStats::GetTags() const
+{
+    return _tags;
+}
+
+void FrameStats::Print(std::ostream& output) const
+{
+    const auto flags     = output.flags();
+    const auto precision = output.precision();
+    output.setf(std::ios::fixed);
+    output.precision(3);
+
+    const char* windowNames[] = {"short", "long", "session"};
+    for (std::size_t track = 0; track < (std::size_t)Track::Count; ++track)
+    {
+        output << GetTrackName((Track)track) << " frame times, ms, " << _tracks[track].hitches << " hitches" << std::endl;
+        for (std::size_t window = 0; window < (std::size_t)Window::Count; ++window)
+        {
+            const Summary summary = GetSummary((Track)track, (Window)window);
+            output << "  " << windowNames[window] << ": " << summary.frames << " frames, p50 " << summary.p50 << ", p95 " << summary.p95
+                   << ", p99 " << summary.p99 << ", max " << summary.max << std::endl;
+        }
+    }
+
+    for (const auto& [tag, stats] : _tags)
+    {
+        output << "Tag \"" << tag << "\": " << stats.frameTimes.GetCount() << " frames, " << stats.hitches << " hitches, p50 "
+               << ToMilliseconds(stats.frameTimes.GetPercentile(50.0)) << ", p99 " << ToMilliseconds(stats.frameTimes.GetPercentile(99.0))
+               << std::endl;
+    }
+
+    for (std::size_t track = 0; track < (std::size_t)Track::Count; ++track)
+    {
+        output << GetTrackName((Track)track) << " session histogram, ms:" << std::endl;
+        _tracks[track].session.ForEachBucket([&](uint64_t lowest, uint64_t highest, uint64_t count) {
+            output << "  " << ToMilliseconds(lowest) << " - " << ToMilliseconds(highest) << ": " << count << std::endl;
+        });
+    }
+
+    output.flags(flags);
+    output.precision(precision);
+}
+
+bool FrameStats::IsHitch(const TrackStats& stats, uint64_t value) const
+{
+    const LogHistogram& histogram = stats.longWindow.GetHistogram();
+    if (histogram.GetCount() < minHitchFrames)
+        return false;
+
+    const uint64_t median = std::min(histogram.GetPercentile(50.0), stats.longWindow.GetMax());
+    return value > median * hitchFactor && value > median + hitchMicroseconds;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Counts of the values in buckets of the same relative width, like HdrHistogram does. The values
+// below 32 have buckets of their own, every power of 2 above is split into 32 buckets, so the
+// percentiles are within 1/32 of the recorded values.
+class LogHistogram
+{
+public:
+    static constexpr uint32_t subBucketsBits  = 5;
+    static constexpr uint32_t subBucketsCount = 1 << subBucketsBits;
+    // the larger values are counted as this one
+    static constexpr uint64_t maxValue = (uint64_t(1) << 40) - 1;
+
+    void Add(uint64_t value);
+    // the value has to be added before
+    void Remove(uint64_t value);
+    void Clear();
+
+    uint64_t GetCount() const;
+    // the highest value of the bucket the percentile (0 - 100) falls into
+    uint64_t GetPercentile(double percentile) const;
+
+    // the non-empty buckets, their lowest and highest values and counts
+    template <typename Callback>
+    void ForEachBucket(Callback&& callback) const
+    {
+        for (std::size_t i = 0; i < _counts.size(); ++i)
+        {
+            if (_counts[i] > 0)
+                callback(GetLowest(i), GetHighest(i), _counts[i]);
+        }
+    }
+
+private:
+    static std::size_t GetIndex(uint64_t value);
+    static uint64_t    GetLowest(std::size_t index);
+    static uint64_t    GetHighest(std::size_t index);
+
+    std::vector<uint64_t> _counts;  // grows to the largest value
+    uint64_t              _count = 0;
+};
+
+// The frame time statistics of the CPU and of the GPU. Every track keeps the percentiles of the
+// last frames and of the whole session, and counts the hitches, the frames much longer than the
+// usual ones. The tags of a frame (a TLAS rebuild or the terrain generation) get statistics of
+// their own, so the stutter they cause is measurable.
+class FrameStats
+{
+public:
+    enum class Track
+    {
+        Cpu,
+        Gpu,
+        Count
+    };
+
+    enum class Window
+    {
+        Short,  // a couple of seconds
+        Long,
+        Session,
+        Count
+    };
+
+    // of the frame times in milliseconds
+    struct Summary
+    {
+        uint64_t frames = 0;
+        double   p50    = 0.0;
+        double   p95    = 0.0;
+        double   p99    = 0.0;
+        double   max    = 0.0;
+    };
+
+    struct TagStats
+    {
+        uint64_t     hitches = 0;
+        LogHistogram frameTimes;  // in microseconds
+    };
+
+    // the windows are in frames
+    explicit FrameStats(std::size_t shortWindow = 120, std::size_t longWindow = 1200);
+
+    // the tags apply to the next CPU frame, the literals are expected
+    void AddTag(const char* tag);
+    void AddFrame(Track track, double milliseconds);
+
+    Summary  GetSummary(Track track, Window window) const;
+    uint64_t GetHitchesCount(Track track) const;
+    // of the short window, the oldest first
+    std::size_t GetRecentCount(Track track) const;
+    float       GetRecentMilliseconds(Track track, std::size_t index) const;
+
+    const std::map<std::string, TagStats>& GetTags() const;
+
+    // the summaries, the tags and the session histograms
+    void Print(std::ostream& output) const;
+
+private:
+    // the values of the last frames, the max is of a monotonic queue
+    class SlidingWindow
+    {
+    public:
+        explicit SlidingWindow(std::size_t capacity);
+
+        void Add(uint64_t value);
+
+        const LogHistogram&         GetHistogram() const;
+        const std::deque<uint64_t>& GetValues() const;
+        uint64_t                    GetMax() const;
+
+    private:
+        const std::size_t                         _capacity;
+        std::deque<uint64_t>                      _values;
+        std::deque<std::pair<uint64_t, uint64_t>> _maxima;  // of the frame numbers and the values
+        uint64_t                                  _framesCount = 0;
+        LogHistogram                              _histogram;
+    };
+
+    struct TrackStats
+    {
+        SlidingWindow shortWindow;
+        SlidingWindow longWindow;
+        LogHistogram  session;
+        uint64_t      sessionMax = 0;
+        uint64_t      hitches    = 0;
+    };
+
+    bool IsHitch(const TrackStats& stats, uint64_t value) const;
+
+    std::array<TrackStats, (std::size_t)Track::Count> _tracks;
+    std::vector<const char*>                          _pendingTags;
+    std::map<std::string, TagStats>                   _tags;
+};
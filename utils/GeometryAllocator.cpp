@@ -0,0 +1,211 @@
+#include "GeometryAllocator.h"
+#include "Align.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <set>
+
+GeometryAllocator::GeometryAllocator(std::size_t pageSize, std::size_t minBlockSize)
+    : _pageSize(std::bit_ceil(pageSize))
+    , _minBlockSize(std::bit_ceil(minBlockSize))
+{
+}
+
+GeometryAllocator::Allocation GeometryAllocator::Allocate(std::size_t size, std::size_t alignment)
+{
+    assert(size > 0);
+    assert(alignment > 0);
+
+    for (uint32_t page = 0; page < _pages.size(); ++page)
+    {
+        if (!_pages[page] || _pages[page]->evacuating)
+            continue;
+
+        if (auto allocation = TryAllocate(page, size, alignment))
+            return *allocation;
+    }
+
+    // worst case of the alignment padding is reserved for non power-of-two values
+    const std::size_t paddedSize = std::has_single_bit(alignment) ? std::max(size, alignment) : size + alignment - 1;
+
+    const uint32_t page       = AddPage(std::max(_pageSize, std::bit_ceil(paddedSize)));
+    auto           allocation = TryAllocate(page, size, alignment);
+    assert(allocation);
+
+    return *allocation;
+}
+
+void GeometryAllocator::Free(const Allocation& allocation)
+{
+    assert(IsPageAlive(allocation.page));
+
+    Page& page = *_pages[allocation.page];
+    page.allocator.Free(allocation.blockOffset);
+    page.allocations.erase(allocation.blockOffset);
+
+    // dedicated pages of large allocations are not reused
+    if (page.allocations.empty() && page.allocator.GetCapacity() > _pageSize)
+        _pages[allocation.page].reset();
+}
+
+std::vector<GeometryAllocator::Move> GeometryAllocator::PlanEvacuation(float maxPageUsage)
+{
+    std::vector<uint32_t> candidates;
+    for (uint32_t page = 0; page < _pages.size(); ++page)
+    {
+        if (!_pages[page] || _pages[page]->allocations.empty())
+            continue;
+
+        const BuddyAllocator& allocator = _pages[page]->allocator;
+        if ((float)allocator.GetUsedSize() <= maxPageUsage * (float)allocator.GetCapacity())
+            candidates.push_back(page);
+    }
+
+    // the emptiest pages are the cheapest to evacuate
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t left, uint32_t right) {
+        return _pages[left]->allocator.GetUsedSize() < _pages[right]->allocator.GetUsedSize();
+    });
+
+    // pages which received data in this pass are kept, their new allocations are not copied yet
+    std::set<uint32_t> destinations;
+
+    std::vector<Move> moves;
+    for (uint32_t candidate : candidates)
+    {
+        if (destinations.contains(candidate))
+            continue;
+
+        Page& source      = *_pages[candidate];
+        source.evacuating = true;
+
+        std::vector<Move> pageMoves;
+        bool              fits = true;
+        for (const auto& [blockOffset, allocation] : source.allocations)
+        {
+            std::optional<Allocation> target;
+            for (uint32_t page = 0; page < _pages.size() && !target; ++page)
+            {
+                if (_pages[page] && !_pages[page]->evacuating)
+                    target = TryAllocate(page, allocation.size, allocation.alignment);
+            }
+
+            if (!target)
+            {
+                fits = false;
+                break;
+            }
+
+            pageMoves.push_back({allocation, *target});
+        }
+
+        if (!fits)
+        {
+            // a partially evacuated page does not save anything, roll it back
+            for (const Move& move : pageMoves)
+                Free(move.to);
+
+            source.evacuating = false;
+            continue;
+        }
+
+        for (const Move& move : pageMoves)
+            destinations.insert(move.to.page);
+
+        moves.insert(moves.end(), pageMoves.begin(), pageMoves.end());
+    }
+
+    return moves;
+}
+
+std::vector<uint32_t> GeometryAllocator::ReleaseEmptyPages()
+{
+    std::vector<uint32_t> released;
+    for (uint32_t page = 0; page < _pages.size(); ++page)
+    {
+        if (_pages[page] && _pages[page]->allocations.empty())
+        {
+            _pages[page].reset();
+            released.push_back(page);
+        }
+    }
+
+    return released;
+}
+
+std::size_t GeometryAllocator::GetPagesCount() const
+{
+    return _pages.size();
+}
+
+bool GeometryAllocator::IsPageAlive(uint32_t page) const
+{
+    return page < _pages.size() && _pages[page].has_value();
+}
+
+std::size_t GeometryAllocator::GetPageSize(uint32_t page) const
+{
+    assert(IsPageAlive(page));
+    return _pages[page]->allocator.GetCapacity();
+}
+
+GeometryAllocator::Statistics GeometryAllocator::GetStatistics() const
+{
+    Statistics statistics;
+    for (const auto& page : _pages)
+    {
+        if (!page)
+            continue;
+
+        statistics.pagesCount++;
+        statistics.allocationsCount += page->allocations.size();
+        statistics.reservedSize += page->allocator.GetCapacity();
+        statistics.blocksSize += page->allocator.GetUsedSize();
+
+        for (const auto& [blockOffset, allocation] : page->allocations)
+            statistics.requestedSize += allocation.size;
+    }
+
+    return statistics;
+}
+
+std::optional<GeometryAllocator::Allocation> GeometryAllocator::TryAllocate(uint32_t    pageIdx,
+                                                                            std::size_t size,
+                                                                            std::size_t alignment)
+{
+    Page& page = *_pages[pageIdx];
+
+    // blocks are aligned to their size, so a power of two alignment only needs a large enough block
+    const bool        powerOfTwo = std::has_single_bit(alignment);
+    const std::size_t blockSize  = powerOfTwo ? std::max(size, alignment) : size + alignment - 1;
+
+    const std::optional<std::size_t> blockOffset = page.allocator.Allocate(blockSize);
+    if (!blockOffset)
+        return std::nullopt;
+
+    Allocation allocation;
+    allocation.page        = pageIdx;
+    allocation.offset      = powerOfTwo ? *blockOffset : Math::AlignTo(*blockOffset, alignment);
+    allocation.blockOffset = *blockOffset;
+    allocation.size        = size;
+    allocation.alignment   = alignment;
+
+    page.allocations[*blockOffset] = allocation;
+    return allocation;
+}
+
+uint32_t GeometryAllocator::AddPage(std::size_t size)
+{
+    Page page{BuddyAllocator{size, _minBlockSize}, {}, false};
+
+    // slots of released pages are reused first
+    auto it = std::find_if(_pages.begin(), _pages.end(), [](const auto& page) { return !page.has_value(); });
+    if (it != _pages.end())
+    {
+        it->emplace(std::move(page));
+        return (uint32_t)(it - _pages.begin());
+    }
+
+    _pages.emplace_back(std::move(page));
+    return (uint32_t)(_pages.size() - 1);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BuddyAllocator.h"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <vector>
+
+// Page based suballocator: every page is a buddy allocator over one large GPU heap.
+// It only deals with offsets, the owner creates and releases the heaps of the pages,
+// so the allocation policy can be checked and benchmarked without a device.
+class GeometryAllocator
+{
+public:
+    struct Allocation
+    {
+        uint32_t    page        = 0;
+        std::size_t offset      = 0;  // aligned offset of the data in the page
+        std::size_t blockOffset = 0;  // offset of the buddy block which contains it
+        std::size_t size        = 0;
+        std::size_t alignment   = 1;
+    };
+
+    struct Move
+    {
+        Allocation from;
+        Allocation to;
+    };
+
+    struct Statistics
+    {
+        std::size_t pagesCount       = 0;
+        std::size_t allocationsCount = 0;
+        std::size_t reservedSize     = 0;  // size of all the pages
+        std::size_t blocksSize       = 0;  // size of the allocated buddy blocks
+        std::size_t requestedSize    = 0;  // size which was actually requested
+    };
+
+    GeometryAllocator(std::size_t pageSize, std::size_t minBlockSize);
+
+    // Alignment may be any value, not only a power of two (e.g. a vertex stride). A new page
+    // is added when no existing one has enough space, larger allocations get a dedicated page
+    // which is released together with the allocation.
+    Allocation Allocate(std::size_t size, std::size_t alignment);
+    void       Free(const Allocation& allocation);
+
+    // Plans moving all the allocations out of pages which are used less than maxPageUsage
+    // into the free space of other pages. Targets are allocated right away, the caller copies
+    // the data, frees the sources once the copies are done and then releases empty pages.
+    // A page which receives data is not evacuated in the same pass, so no move reads a target.
+    std::vector<Move> PlanEvacuation(float maxPageUsage);
+
+    // returns indices of the released pages, their heaps can be destroyed
+    std::vector<uint32_t> ReleaseEmptyPages();
+
+    std::size_t GetPagesCount() const;  // including released slots
+    bool        IsPageAlive(uint32_t page) const;
+    std::size_t GetPageSize(uint32_t page) const;
+    Statistics  GetStatistics() const;
+
+private:
+    struct Page
+    {
+        BuddyAllocator                     allocator;
+        std::map<std::size_t, Allocation> allocations;  // by block offset
+        bool                               evacuating = false;
+    };
+
+    std::optional<Allocation> TryAllocate(uint32_t page, std::size_t size, std::size_t alignment);
+    uint32_t                  AddPage(std::size_t size);
+
+    std::size_t _pageSize     = 0;
+    std::size_t _minBlockSize = 0;
+
+    std::vector<std::optional<Page>> _pages;
+};
@@ -0,0 +1,160 @@
+#include "stdafx.h"
+
+#include "GeometryHeap.h"
+
+namespace
+{
+// acceleration structures and their scratch memory have to be aligned to 256 bytes,
+// it is the smallest block for all the heaps, so the alignment is never violated
+constexpr std::size_t minBlockSize = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+
+D3D12_HEAP_TYPE GetHeapType(GeometryHeapType type)
+{
+    return type == GeometryHeapType::Upload ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT;
+}
+
+D3D12_RESOURCE_STATES GetInitialState(GeometryHeapType type)
+{
+    switch (type)
+    {
+    case GeometryHeapType::Upload:
+        return D3D12_RESOURCE_STATE_GENERIC_READ;
+    case GeometryHeapType::AccelerationStructure:
+        return D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
+    case GeometryHeapType::Scratch:
+        return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    default:
+        // buffers are promoted from the common state implicitly and decay back after every submission
+        return D3D12_RESOURCE_STATE_COMMON;
+    }
+}
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+GeometryAllocation::GeometryAllocation(std::shared_ptr<GeometryHeap> heap, GeometryAllocator::Allocation allocation)
+    : _heap(heap)
+    , _allocation(allocation)
+{
+}
+
+GeometryAllocation::~GeometryAllocation()
+{
+    _heap->Free(*this);
+}
+
+const ComPtr<ID3D12Resource>& GeometryAllocation::GetResource() const
+{
+    return _heap->GetPage(_allocation.page).buffer;
+}
+
+std::size_t GeometryAllocation::GetOffset() const
+{
+    return _allocation.offset;
+}
+
+std::size_t GeometryAllocation::GetSize() const
+{
+    return _allocation.size;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS GeometryAllocation::GetGPUAddress() const
+{
+    return GetResource()->GetGPUVirtualAddress() + _allocation.offset;
+}
+
+uint8_t* GeometryAllocation::GetCPUAddress() const
+{
+    uint8_t* cpuAddress = _heap->GetPage(_allocation.page).cpuAddress;
+    assert(cpuAddress);
+    return cpuAddress + _allocation.offset;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GeometryHeap::GeometryHeap(ComPtr<ID3D12Device5> device, GeometryHeapType type, std::size_t pageSize)
+    : _device(device)
+    , _type(type)
+    , _allocator(pageSize, minBlockSize)
+{
+}
+
+std::shared_ptr<GeometryAllocation> GeometryHeap::Allocate(std::size_t size, std::size_t alignment)
+{
+    std::lock_guard lock{_mutex};
+
+    const GeometryAllocator::Allocation allocation = _allocator.Allocate(size, alignment);
+    if (allocation.page >= _pages.size() || !_pages[allocation.page].buffer)
+        CreatePage(allocation.page);
+
+    return std::make_shared<GeometryAllocation>(shared_from_this(), allocation);
+}
+
+GeometryAllocator::Statistics GeometryHeap::GetStatistics() const
+{
+    std::lock_guard lock{_mutex};
+    return _allocator.GetStatistics();
+}
+
+void GeometryHeap::Free(const GeometryAllocation& allocation)
+{
+    std::lock_guard lock{_mutex};
+
+    _allocator.Free(allocation._allocation);
+
+    if (!_allocator.IsPageAlive(allocation._allocation.page))
+        _pages[allocation._allocation.page] = {};
+}
+
+void GeometryHeap::CreatePage(uint32_t page)
+{
+    if (_pages.size() <= page)
+        _pages.resize(page + 1);
+
+    const std::size_t pageSize = _allocator.GetPageSize(page);
+
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes     = pageSize;
+    heapDesc.Properties      = {GetHeapType(_type)};
+    heapDesc.Alignment       = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heapDesc.Flags           = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+    Page& output = _pages[page];
+    ThrowIfFailed(_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&output.heap)));
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width               = pageSize;
+    bufferDesc.Height              = 1;
+    bufferDesc.MipLevels           = 1;
+    bufferDesc.SampleDesc.Count    = 1;
+    bufferDesc.DepthOrArraySize    = 1;
+    bufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    if (_type == GeometryHeapType::AccelerationStructure || _type == GeometryHeapType::Scratch)
+        bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+    // the whole heap is covered by one buffer, allocations are just offsets in it
+    ThrowIfFailed(_device->CreatePlacedResource(output.heap.Get(), 0, &bufferDesc, GetInitialState(_type), nullptr,
+                                                IID_PPV_ARGS(&output.buffer)));
+    output.buffer->SetName(L"Geometry heap page");
+
+    if (_type == GeometryHeapType::Upload)
+        ThrowIfFailed(output.buffer->Map(0, nullptr, reinterpret_cast<void**>(&output.cpuAddress)));
+}
+
+const GeometryHeap::Page& GeometryHeap::GetPage(uint32_t page) const
+{
+    assert(page < _pages.size() && _pages[page].buffer);
+    return _pages[page];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GeometryHeaps::GeometryHeaps(ComPtr<ID3D12Device5> device)
+    : upload(std::make_shared<GeometryHeap>(device, GeometryHeapType::Upload, 16 * 1024 * 1024))
+    , geometry(std::make_shared<GeometryHeap>(device, GeometryHeapType::Geometry, 64 * 1024 * 1024))
+    , accelerationStructures(std::make_shared<GeometryHeap>(device, GeometryHeapType::AccelerationStructure, 32 * 1024 * 1024))
+    , scratch(std::make_shared<GeometryHeap>(device, GeometryHeapType::Scratch, 32 * 1024 * 1024))
+{
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "GeometryAllocator.h"
+
+enum class GeometryHeapType
+{
+    Upload,                 // CPU writable staging memory, persistently mapped
+    Geometry,               // vertex and index buffers
+    AccelerationStructure,  // BLAS storage
+    Scratch                 // temporary memory of acceleration structure builds
+};
+
+class GeometryHeap;
+
+// Range of a large placed buffer, it is returned to the heap when destroyed
+class GeometryAllocation
+{
+public:
+    GeometryAllocation(std::shared_ptr<GeometryHeap> heap, GeometryAllocator::Allocation allocation);
+    ~GeometryAllocation();
+
+    GeometryAllocation(const GeometryAllocation&) = delete;
+    GeometryAllocation& operator=(const GeometryAllocation&) = delete;
+
+    const ComPtr<ID3D12Resource>& GetResource() const;
+    std::size_t                   GetOffset() const;
+    std::size_t                   GetSize() const;
+    D3D12_GPU_VIRTUAL_ADDRESS     GetGPUAddress() const;
+    uint8_t*                      GetCPUAddress() const;  // upload heap only
+
+private:
+    friend class GeometryHeap;
+
+    std::shared_ptr<GeometryHeap> _heap;
+    GeometryAllocator::Allocation _allocation;
+};
+
+// Suballocates buffers of one kind from large placed heaps, so many small meshes do not
+// pay the overhead and 64KB granularity of separate committed resources
+class GeometryHeap : public std::enable_shared_from_this<GeometryHeap>
+{
+public:
+    GeometryHeap(ComPtr<ID3D12Device5> device, GeometryHeapType type, std::size_t pageSize);
+
+    std::shared_ptr<GeometryAllocation> Allocate(std::size_t size, std::size_t alignment);
+
+    GeometryAllocator::Statistics GetStatistics() const;
+
+private:
+    friend class GeometryAllocation;
+
+    struct Page
+    {
+        ComPtr<ID3D12Heap>     heap;
+        ComPtr<ID3D12Resource> buffer;
+        uint8_t*               cpuAddress = nullptr;
+    };
+
+    void        Free(const GeometryAllocation& allocation);
+    void        CreatePage(uint32_t page);
+    const Page& GetPage(uint32_t page) const;
+
+    ComPtr<ID3D12Device5> _device;
+    GeometryHeapType      _type;
+    GeometryAllocator     _allocator;
+    std::vector<Page>     _pages;
+
+    mutable std::mutex _mutex;
+};
+
+// heaps used by the meshes
+struct GeometryHeaps
+{
+    explicit GeometryHeaps(ComPtr<ID3D12Device5> device);
+
+    std::shared_ptr<GeometryHeap> upload;
+    std::shared_ptr<GeometryHeap> geometry;
+    std::shared_ptr<GeometryHeap> accelerationStructures;
+    std::shared_ptr<GeometryHeap> scratch;
+};
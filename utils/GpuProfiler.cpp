@@ -0,0 +1,108 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+GpuProfiler::Scope::Scope(GpuProfiler& profiler, ID3D12GraphicsCommandList* cmdList, const char* name)
+    : _profiler(profiler)
+    , _cmdList(cmdList)
+    , _zone(profiler.BeginZone(cmdList, name))
+{
+}
+
+GpuProfiler::Scope::~Scope()
+{
+    _profiler.EndZone(_cmdList, _zone);
+}
+
+GpuProfiler::GpuProfiler(Profiler& profiler, std::unique_ptr<IGpuTimestamps> timestamps, std::size_t framesCount, uint32_t maxZones)
+    : _profiler(profiler)
+    , _timestamps(std::move(timestamps))
+    , _maxZones(maxZones)
+    , _frames(framesCount)
+{
+    if (!_timestamps || framesCount == 0 || maxZones == 0)
+        throw std::runtime_error("GpuProfiler: the timestamps, the frames and the zones are required");
+}
+
+void GpuProfiler::BeginFrame(std::size_t frameContext)
+{
+    _frameContext       = frameContext % _frames.size();
+    FrameContext& frame = _frames[_frameContext];
+
+    _frameMilliseconds.reset();
+    if (frame.isResolved && !frame.zones.empty())
+    {
+        _ticks.resize(frame.zones.size() * 2);
+        _timestamps->Read(GetFirstQuery(_frameContext), _ticks);
+
+        // the calibration is taken every frame, so the clocks don't drift apart
+        uint64_t gpuTicks       = 0;
+        int64_t  cpuNanoseconds = 0;
+        _timestamps->GetCalibration(gpuTicks, cpuNanoseconds);
+
+        const double nanosecondsPerTick = 1e9 / _timestamps->GetFrequency();
+        const auto   toCpu              = [&](uint64_t ticks) {
+            return cpuNanoseconds + (int64_t)((int64_t)(ticks - gpuTicks) * nanosecondsPerTick);
+        };
+
+        _events.clear();
+        for (std::size_t i = 0; i < frame.zones.size(); ++i)
+        {
+            const Zone& zone = frame.zones[i];
+            _events.push_back({zone.name, toCpu(_ticks[i * 2]), toCpu(_ticks[i * 2 + 1]), Profiler::gpuThread, zone.depth});
+        }
+
+        const auto [first, last] = std::minmax_element(_ticks.begin(), _ticks.end());
+        _frameMilliseconds       = (*last - *first) * 1e3 / _timestamps->GetFrequency();
+
+        if (_profiler.IsEnabled())
+            _profiler.AddGpuEvents(frame.frameIndex, _events);
+    }
+
+    frame.frameIndex = _profiler.GetFrameIndex();
+    frame.zones.clear();
+    frame.isResolved = false;
+    _depth           = 0;
+}
+
+uint32_t GpuProfiler::BeginZone(ID3D12GraphicsCommandList* cmdList, const char* name)
+{
+    FrameContext& frame = _frames[_frameContext];
+    if (frame.zones.size() == _maxZones)
+        return invalidZone;
+
+    const uint32_t zone = (uint32_t)frame.zones.size();
+    frame.zones.push_back({name, _depth++});
+    _timestamps->WriteTimestamp(cmdList, GetFirstQuery(_frameContext) + zone * 2);
+    return zone;
+}
+
+void GpuProfiler::EndZone(ID3D12GraphicsCommandList* cmdList, uint32_t zone)
+{
+    if (zone == invalidZone)
+        return;
+
+    --_depth;
+    _timestamps->WriteTimestamp(cmdList, GetFirstQuery(_frameContext) + zone * 2 + 1);
+}
+
+void GpuProfiler::EndFrame(ID3D12GraphicsCommandList* cmdList)
+{
+    FrameContext& frame = _frames[_frameContext];
+    if (frame.zones.empty())
+        return;
+
+    _timestamps->Resolve(cmdList, GetFirstQuery(_frameContext), (uint32_t)frame.zones.size() * 2);
+    frame.isResolved = true;
+}
+
+std::optional<double> GpuProfiler::GetFrameMilliseconds() const
+{
+    return _frameMilliseconds;
+}
+
+uint32_t GpuProfiler::GetFirstQuery(std::size_t frameContext) const
+{
+    return (uint32_t)frameContext * _maxZones * 2;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+struct ID3D12GraphicsCommandList;
+
+// The timestamp queries of a queue, D3D12Timestamps in the sample. A mock may stand in for it, the
+// lists are only passed through, so they may be null then.
+class IGpuTimestamps
+{
+public:
+    virtual ~IGpuTimestamps() = default;
+
+    // ticks per second
+    virtual uint64_t GetFrequency() const = 0;
+    // the GPU ticks and Profiler::Now() of the same moment, the GPU timeline is aligned with them
+    virtual void GetCalibration(uint64_t& gpuTicks, int64_t& cpuNanoseconds) const = 0;
+
+    virtual void WriteTimestamp(ID3D12GraphicsCommandList* cmdList, uint32_t query) = 0;
+    // the resolved queries are read once the GPU finishes the list
+    virtual void Resolve(ID3D12GraphicsCommandList* cmdList, uint32_t firstQuery, uint32_t count) = 0;
+    virtual void Read(uint32_t firstQuery, std::span<uint64_t> ticks) = 0;
+};
+
+// Zones of the GPU work of the frames in flight. Every frame context has its own queries, its zones are
+// read once the context is reused, so the profiler gets them a few frames later. The zones are
+// recorded by a single thread in the order of the execution of their lists. They are timed while the
+// profiler is disabled too, the frame time statistics need them.
+class GpuProfiler
+{
+public:
+    static constexpr uint32_t invalidZone = UINT32_MAX;
+
+    class Scope
+    {
+    public:
+        Scope(GpuProfiler& profiler, ID3D12GraphicsCommandList* cmdList, const char* name);
+        ~Scope();
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuProfiler&               _profiler;
+        ID3D12GraphicsCommandList* _cmdList;
+        uint32_t                   _zone;
+    };
+
+    // the timestamps need 2 * framesCount * maxZones queries
+    GpuProfiler(Profiler& profiler, std::unique_ptr<IGpuTimestamps> timestamps, std::size_t framesCount, uint32_t maxZones);
+
+    // the GPU has to be done with the previous frame of the context
+    void BeginFrame(std::size_t frameContext);
+    // the zones over the limit are invalid, they record nothing
+    uint32_t BeginZone(ID3D12GraphicsCommandList* cmdList, const char* name);
+    void     EndZone(ID3D12GraphicsCommandList* cmdList, uint32_t zone);
+    // the list has to be executed after all the zones of the frame
+    void EndFrame(ID3D12GraphicsCommandList* cmdList);
+
+    // of the frame read by the last BeginFrame, from the start of its first zone to the end of the last one
+    std::optional<double> GetFrameMilliseconds() const;
+
+private:
+    struct Zone
+    {
+        const char* name;
+        uint32_t    depth;
+    };
+
+    struct FrameContext
+    {
+        uint64_t          frameIndex = 0;  // of the profiler
+        std::vector<Zone> zones;
+        bool              isResolved = false;
+    };
+
+    uint32_t GetFirstQuery(std::size_t frameContext) const;
+
+    Profiler&                       _profiler;
+    std::unique_ptr<IGpuTimestamps> _timestamps;
+    const uint32_t                  _maxZones;
+
+    std::vector<FrameContext> _frames;
+    std::size_t               _frameContext = 0;
+    uint32_t                  _depth        = 0;
+
+    std::vector<uint64_t>        _ticks;
+    std::vector<Profiler::Event> _events;
+    std::optional<double>        _frameMilliseconds;
+};
+
+// times the GPU work recorded to the list in the rest of the enclosing scope
+#define PROFILE_GPU_SCOPE(profiler, cmdList, name) GpuProfiler::Scope PROFILE_CONCAT(profileGpuScope, __LINE__)(profiler, cmdList, name)
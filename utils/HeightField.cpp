@@ -0,0 +1,227 @@
+#include "HeightField.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace
+{
+using namespace DirectX;
+
+struct StackEntry
+{
+    std::size_t level;
+    std::size_t x;
+    std::size_t y;
+    float       tEntry;
+};
+
+// the slabs test, the NaNs of the rays lying in a plane are ignored by the min and max
+bool IntersectBox(const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, float tMin, float tMax, float& tEntry)
+{
+    const float origins[3]  = {origin.x, origin.y, origin.z};
+    const float inverses[3] = {inverseDirection.x, inverseDirection.y, inverseDirection.z};
+    const float mins[3]     = {boxMin.x, boxMin.y, boxMin.z};
+    const float maxs[3]     = {boxMax.x, boxMax.y, boxMax.z};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float t0 = (mins[axis] - origins[axis]) * inverses[axis];
+        float t1 = (maxs[axis] - origins[axis]) * inverses[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+    }
+
+    tEntry = tMin;
+    return tMin <= tMax;
+}
+}  // namespace
+
+HeightField::HeightField(std::vector<float> heights, std::size_t sizeX, std::size_t sizeY, XMFLOAT2 origin, float cellSize)
+    : _heights(std::move(heights))
+    , _sizeX(sizeX)
+    , _sizeY(sizeY)
+    , _origin(origin)
+    , _cellSize(cellSize)
+{
+    if (sizeX < 2 || sizeY < 2 || _heights.size() != sizeX * sizeY)
+        throw std::runtime_error("HeightField: the heights don't make a grid of cells");
+
+    Level cells{sizeX - 1, sizeY - 1};
+    cells.ranges.reserve(cells.sizeX * cells.sizeY);
+    for (std::size_t y = 0; y < cells.sizeY; ++y)
+    {
+        for (std::size_t x = 0; x < cells.sizeX; ++x)
+        {
+            const float corners[4] = {_heights[y * sizeX + x], _heights[y * sizeX + x + 1], _heights[(y + 1) * sizeX + x], _heights[(y + 1) * sizeX + x + 1]};
+            cells.ranges.push_back({*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4)});
+        }
+    }
+    _levels.push_back(std::move(cells));
+
+    // every block of the next level covers 2x2 blocks of the previous one
+    while (_levels.back().sizeX > 1 || _levels.back().sizeY > 1)
+    {
+        const Level& previous = _levels.back();
+
+        Level level{(previous.sizeX + 1) / 2, (previous.sizeY + 1) / 2};
+        level.ranges.resize(level.sizeX * level.sizeY, {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()});
+        for (std::size_t y = 0; y < previous.sizeY; ++y)
+        {
+            for (std::size_t x = 0; x < previous.sizeX; ++x)
+            {
+                const Range& child = previous.ranges[y * previous.sizeX + x];
+                Range&       range = level.ranges[(y / 2) * level.sizeX + x / 2];
+
+                range.min = std::min(range.min, child.min);
+                range.max = std::max(range.max, child.max);
+            }
+        }
+
+        _levels.push_back(std::move(level));
+    }
+}
+
+std::optional<float> HeightField::GetHeight(float x, float y) const
+{
+    const float cellX = (x - _origin.x) / _cellSize;
+    const float cellY = (y - _origin.y) / _cellSize;
+    if (!(cellX >= 0.0f && cellY >= 0.0f && cellX <= _sizeX - 1 && cellY <= _sizeY - 1))
+        return std::nullopt;
+
+    // the last row and column belong to the cells before them
+    const std::size_t column = std::min((std::size_t)cellX, _sizeX - 2);
+    const std::size_t row    = std::min((std::size_t)cellY, _sizeY - 2);
+    const float       u      = cellX - column;
+    const float       v      = cellY - row;
+
+    const float h00 = _heights[row * _sizeX + column];
+    const float h10 = _heights[row * _sizeX + column + 1];
+    const float h01 = _heights[(row + 1) * _sizeX + column];
+    const float h11 = _heights[(row + 1) * _sizeX + column + 1];
+
+    if (u + v <= 1.0f)
+        return h00 + u * (h10 - h00) + v * (h01 - h00);
+
+    return h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+}
+
+std::optional<HeightField::Hit> HeightField::Raycast(const BVH::Ray& ray) const
+{
+    const XMVECTOR origin    = XMLoadFloat3(&ray.origin);
+    const XMVECTOR direction = XMLoadFloat3(&ray.direction);
+
+    std::optional<Hit> output;
+    Traverse(ray, 0.0f, [&](FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2, float& tMax) {
+        const std::optional<Intersection::TriangleHit> hit = Intersection::RayTriangle(origin, direction, p0, p1, p2, ray.tMin, tMax, ray.cullBackFaces);
+        if (!hit)
+            return;
+
+        // the surface normal turned to the ray
+        XMVECTOR normal = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+        if (XMVectorGetX(XMVector3Dot(normal, direction)) > 0.0f)
+            normal = XMVectorNegate(normal);
+
+        output = Hit{hit->t};
+        tMax   = hit->t;
+        XMStoreFloat3(&output->normal, normal);
+    });
+
+    return output;
+}
+
+std::optional<HeightField::Hit> HeightField::SphereCast(const BVH::Ray& ray, float radius) const
+{
+    const XMVECTOR origin    = XMLoadFloat3(&ray.origin);
+    const XMVECTOR direction = XMLoadFloat3(&ray.direction);
+
+    std::optional<Hit> output;
+    Traverse(ray, radius, [&](FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2, float& tMax) {
+        const std::optional<Intersection::TriangleHit> hit = Intersection::SweepSphereTriangle(origin, direction, p0, p1, p2, radius, ray.tMin, tMax);
+        if (!hit)
+            return;
+
+        // the sphere is pushed away from the contact point
+        const float    weights[3] = {1.0f - hit->barycentrics.x - hit->barycentrics.y, hit->barycentrics.x, hit->barycentrics.y};
+        const XMVECTOR contact    = XMVectorAdd(XMVectorAdd(XMVectorScale(p0, weights[0]), XMVectorScale(p1, weights[1])), XMVectorScale(p2, weights[2]));
+        const XMVECTOR center     = XMVectorMultiplyAdd(direction, XMVectorReplicate(hit->t), origin);
+
+        output = Hit{hit->t};
+        tMax   = hit->t;
+        XMStoreFloat3(&output->normal, XMVector3Normalize(XMVectorSubtract(center, contact)));
+    });
+
+    return output;
+}
+
+// Visits the cells under the ray (the swept sphere) front to back, the callback gets their triangles
+// one by one and shrinks the distance limit on hits.
+template <typename Callback>
+void HeightField::Traverse(const BVH::Ray& ray, float radius, Callback&& callback) const
+{
+    const XMFLOAT3 inverseDirection = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+
+    // a block replaces itself with at most four others, so the stack grows by three per level
+    std::array<StackEntry, 128> stack;
+    std::size_t                 stackSize = 0;
+    assert(_levels.size() * 3 + 1 <= stack.size());
+
+    float tMax         = ray.tMax;
+    stack[stackSize++] = {_levels.size() - 1, 0, 0, ray.tMin};
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+        if (entry.tEntry > tMax)
+            continue;
+
+        if (entry.level == 0)
+        {
+            const XMVECTOR c00 = GetCorner(entry.x, entry.y);
+            const XMVECTOR c10 = GetCorner(entry.x + 1, entry.y);
+            const XMVECTOR c01 = GetCorner(entry.x, entry.y + 1);
+            const XMVECTOR c11 = GetCorner(entry.x + 1, entry.y + 1);
+
+            callback(c00, c10, c01, tMax);
+            callback(c11, c01, c10, tMax);
+            continue;
+        }
+
+        const Level&      children      = _levels[entry.level - 1];
+        const Level&      cells         = _levels.front();
+        const std::size_t cellsPerChild = std::size_t(1) << (entry.level - 1);
+
+        StackEntry  hits[4];
+        std::size_t count = 0;
+        for (std::size_t y = entry.y * 2; y < std::min(entry.y * 2 + 2, children.sizeY); ++y)
+        {
+            for (std::size_t x = entry.x * 2; x < std::min(entry.x * 2 + 2, children.sizeX); ++x)
+            {
+                const Range&      range = children.ranges[y * children.sizeX + x];
+                const std::size_t endX  = std::min((x + 1) * cellsPerChild, cells.sizeX);
+                const std::size_t endY  = std::min((y + 1) * cellsPerChild, cells.sizeY);
+
+                const XMFLOAT3 boxMin = {_origin.x + x * cellsPerChild * _cellSize - radius, _origin.y + y * cellsPerChild * _cellSize - radius, range.min - radius};
+                const XMFLOAT3 boxMax = {_origin.x + endX * _cellSize + radius, _origin.y + endY * _cellSize + radius, range.max + radius};
+
+                float tEntry;
+                if (IntersectBox(ray.origin, inverseDirection, boxMin, boxMax, ray.tMin, tMax, tEntry))
+                    hits[count++] = {entry.level - 1, x, y, tEntry};
+            }
+        }
+
+        // the farthest are pushed first, so the closest one is visited first
+        std::sort(hits, hits + count, [](const StackEntry& left, const StackEntry& right) { return left.tEntry > right.tEntry; });
+        for (std::size_t i = 0; i < count; ++i)
+            stack[stackSize++] = hits[i];
+    }
+}
+
+XMVECTOR HeightField::GetCorner(std::size_t x, std::size_t y) const
+{
+    return XMVectorSet(_origin.x + x * _cellSize, _origin.y + y * _cellSize, _heights[y * _sizeX + x], 0.0f);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "BVHScene.h"
+
+#include <optional>
+#include <vector>
+
+// Terrain heights on a regular grid for the CPU side queries. Every cell is the two triangles the
+// island tiles are made of, split by the diagonal from its (x + 1, y) corner to the (x, y + 1) one.
+// A pyramid of the cells height ranges lets the queries skip the areas they pass over.
+class HeightField
+{
+public:
+    struct Hit
+    {
+        float             t = 0.0f;
+        DirectX::XMFLOAT3 normal;  // of the surface at the contact, it faces the query
+    };
+
+    // the heights are row-major, heights[y * sizeX + x] is at origin + (x, y) * cellSize
+    HeightField(std::vector<float> heights, std::size_t sizeX, std::size_t sizeY, DirectX::XMFLOAT2 origin, float cellSize);
+
+    // of the surface, there is nothing outside of the grid
+    std::optional<float> GetHeight(float x, float y) const;
+
+    // the same distances and culling as the BVH::Scene queries have
+    std::optional<Hit> Raycast(const BVH::Ray& ray) const;
+    std::optional<Hit> SphereCast(const BVH::Ray& ray, float radius) const;
+
+private:
+    // the height range of a block of cells, the first level is the cells themselves
+    struct Range
+    {
+        float min;
+        float max;
+    };
+
+    struct Level
+    {
+        std::size_t        sizeX;
+        std::size_t        sizeY;
+        std::vector<Range> ranges;
+    };
+
+    template <typename Callback>
+    void Traverse(const BVH::Ray& ray, float radius, Callback&& callback) const;
+
+    DirectX::XMVECTOR GetCorner(std::size_t x, std::size_t y) const;
+
+    std::vector<float> _heights;
+    std::size_t        _sizeX;
+    std::size_t        _sizeY;
+    DirectX::XMFLOAT2  _origin;
+    float              _cellSize;
+    std::vector<Level> _levels;  // from the cells to a single block
+};
@@ -0,0 +1,240 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+using namespace DirectX;
+
+void AppendBigEndian(std::vector<uint8_t>& output, uint32_t value)
+{
+    output.insert(output.end(), {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value});
+}
+
+template <typename T>
+void AppendLittleEndian(std::vector<uint8_t>& output, T value)
+{
+    static_assert(sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8);
+
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    for (std::size_t byte = 0; byte < sizeof(T); ++byte)
+        output.push_back((uint8_t)(bits >> (byte * 8)));
+}
+
+void AppendString(std::vector<uint8_t>& output, const char* value)
+{
+    output.insert(output.end(), value, value + std::strlen(value) + 1);
+}
+
+uint32_t Crc32(const uint8_t* data, std::size_t size)
+{
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> output;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit)
+                value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+            output[i] = value;
+        }
+        return output;
+    }();
+
+    uint32_t crc = 0xffffffffu;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+uint32_t Adler32(const std::vector<uint8_t>& data)
+{
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (uint8_t value : data)
+    {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+void AppendChunk(std::vector<uint8_t>& output, const char* type, const std::vector<uint8_t>& data)
+{
+    AppendBigEndian(output, (uint32_t)data.size());
+
+    // the type is a part of the checksum
+    const std::size_t start = output.size();
+    output.insert(output.end(), type, type + 4);
+    output.insert(output.end(), data.begin(), data.end());
+    AppendBigEndian(output, Crc32(output.data() + start, output.size() - start));
+}
+
+// zlib stream of stored deflate blocks, the images are small enough to skip the compression
+std::vector<uint8_t> StoreZlib(const std::vector<uint8_t>& data)
+{
+    constexpr std::size_t maxBlockSize = 65535;
+
+    std::vector<uint8_t> output = {0x78, 0x01};
+    std::size_t          offset = 0;
+    do
+    {
+        const std::size_t size   = std::min(maxBlockSize, data.size() - offset);
+        const bool        isLast = offset + size == data.size();
+
+        // the final block flag, the stored type and the little endian size along with its complement
+        output.insert(output.end(), {(uint8_t)isLast, (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)~size, (uint8_t)(~size >> 8)});
+        output.insert(output.end(), data.begin() + offset, data.begin() + offset + size);
+
+        offset += size;
+    } while (offset < data.size());
+
+    AppendBigEndian(output, Adler32(data));
+    return output;
+}
+
+void WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("ImageWriter: failed to open " + path.string());
+
+    file.write((const char*)data.data(), data.size());
+    if (!file)
+        throw std::runtime_error("ImageWriter: failed to write " + path.string());
+}
+
+void ValidateSize(uint32_t width, uint32_t height, std::span<const XMFLOAT4> pixels)
+{
+    if (width == 0 || height == 0 || pixels.size() < (std::size_t)width * height)
+        throw std::runtime_error("ImageWriter: the pixels don't match the image size");
+}
+}  // namespace
+
+namespace ImageWriter
+{
+void WritePNG(const std::filesystem::path& path, uint32_t width, uint32_t height, std::span<const XMFLOAT4> pixels)
+{
+    ValidateSize(width, height, pixels);
+
+    const auto toByte = [](float value) { return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+
+    // every row starts with its filter type, 0 is none
+    std::vector<uint8_t> rows;
+    rows.reserve((std::size_t)(width * 3 + 1) * height);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        rows.push_back(0);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const XMFLOAT4& pixel = pixels[(std::size_t)y * width + x];
+            rows.insert(rows.end(), {toByte(pixel.x), toByte(pixel.y), toByte(pixel.z)});
+        }
+    }
+
+    std::vector<uint8_t> header;
+    AppendBigEndian(header, width);
+    AppendBigEndian(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});  // 8 bits per channel, RGB, deflate, no filters, no interlace
+
+    std::vector<uint8_t> output = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    AppendChunk(output, "IHDR", header);
+    AppendChunk(output, "IDAT", StoreZlib(rows));
+    AppendChunk(output, "IEND", {});
+
+    WriteFile(path, output);
+}
+
+void WriteEXR(const std::filesystem::path& path, uint32_t width, uint32_t height, std::span<const XMFLOAT4> pixels)
+{
+    ValidateSize(width, height, pixels);
+
+    constexpr int32_t floatType = 2;
+
+    std::vector<uint8_t> output;
+    AppendLittleEndian<uint32_t>(output, 20000630);  // magic number
+    AppendLittleEndian<uint32_t>(output, 2);         // version, single part scanline image
+
+    const auto appendAttribute = [&](const char* name, const char* type, const std::vector<uint8_t>& value) {
+        AppendString(output, name);
+        AppendString(output, type);
+        AppendLittleEndian<int32_t>(output, (int32_t)value.size());
+        output.insert(output.end(), value.begin(), value.end());
+    };
+
+    // the channels are sorted by their names, so are the scanline values
+    std::vector<uint8_t> channels;
+    for (const char* name : {"B", "G", "R"})
+    {
+        AppendString(channels, name);
+        AppendLittleEndian<int32_t>(channels, floatType);
+        channels.insert(channels.end(), {0, 0, 0, 0});  // pLinear and the reserved bytes
+        AppendLittleEndian<int32_t>(channels, 1);       // x and y sampling
+        AppendLittleEndian<int32_t>(channels, 1);
+    }
+    channels.push_back(0);
+
+    std::vector<uint8_t> window;
+    for (int32_t value : {0, 0, (int32_t)width - 1, (int32_t)height - 1})
+        AppendLittleEndian<int32_t>(window, value);
+
+    std::vector<uint8_t> one;
+    AppendLittleEndian<float>(one, 1.0f);
+
+    std::vector<uint8_t> center;
+    AppendLittleEndian<float>(center, 0.0f);
+    AppendLittleEndian<float>(center, 0.0f);
+
+    appendAttribute("channels", "chlist", channels);
+    appendAttribute("compression", "compression", {0});  // NO_COMPRESSION
+    appendAttribute("dataWindow", "box2i", window);
+    appendAttribute("displayWindow", "box2i", window);
+    appendAttribute("lineOrder", "lineOrder", {0});  // INCREASING_Y
+    appendAttribute("pixelAspectRatio", "float", one);
+    appendAttribute("screenWindowCenter", "v2f", center);
+    appendAttribute("screenWindowWidth", "float", one);
+    output.push_back(0);
+
+    // a block per scanline: its y, the size of the data and the channels one after another
+    const std::size_t blockSize   = 4 + 4 + (std::size_t)width * 3 * sizeof(float);
+    const std::size_t firstOffset = output.size() + (std::size_t)height * sizeof(uint64_t);
+    for (uint32_t y = 0; y < height; ++y)
+        AppendLittleEndian<uint64_t>(output, firstOffset + y * blockSize);
+
+    output.reserve(firstOffset + height * blockSize);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        AppendLittleEndian<int32_t>(output, (int32_t)y);
+        AppendLittleEndian<int32_t>(output, (int32_t)(blockSize - 8));
+
+        const XMFLOAT4* row = &pixels[(std::size_t)y * width];
+        for (float XMFLOAT4::*channel : {&XMFLOAT4::z, &XMFLOAT4::y, &XMFLOAT4::x})
+        {
+            for (uint32_t x = 0; x < width; ++x)
+                AppendLittleEndian<float>(output, row[x].*channel);
+        }
+    }
+
+    WriteFile(path, output);
+}
+
+void Write(const std::filesystem::path& path, uint32_t width, uint32_t height, std::span<const XMFLOAT4> pixels)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower(c); });
+
+    if (extension == ".png")
+        WritePNG(path, width, height, pixels);
+    else if (extension == ".exr")
+        WriteEXR(path, width, height, pixels);
+    else
+        throw std::runtime_error("ImageWriter: unknown image format " + path.string());
+}
+}  // namespace ImageWriter
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+// Minimal writers of the linear RGBA float images (e.g. the raytracing output), they have no
+// dependencies, so the images can be saved on any platform. The alpha is not written.
+namespace ImageWriter
+{
+// 8-bit RGB, the values are clamped to [0, 1] and stored as they are, without the sRGB curve
+void WritePNG(const std::filesystem::path& path, uint32_t width, uint32_t height, std::span<const DirectX::XMFLOAT4> pixels);
+
+// 32-bit float RGB scanlines without compression, keeps the values out of [0, 1]
+void WriteEXR(const std::filesystem::path& path, uint32_t width, uint32_t height, std::span<const DirectX::XMFLOAT4> pixels);
+
+// picks the format by the extension (.png or .exr)
+void Write(const std::filesystem::path& path, uint32_t width, uint32_t height, std::span<const DirectX::XMFLOAT4> pixels);
+}  // namespace ImageWriter
@@ -0,0 +1,72 @@
+#include "stdafx.h"
+
+#include "InstancedObject.h"
+
+InstancedObject::InstancedObject(std::shared_ptr<MeshObject> meshObject,
+                                 DescriptorHeap&             heap,
+                                 ComPtr<ID3D12Device>        device,
+                                 Material                    material,
+                                 std::span<const XMMATRIX>   transforms,
+                                 std::span<const XMFLOAT3>   tints /*= {}*/)
+    : _prototype(meshObject, heap, device, material)
+    , _transforms(transforms.size())
+    , _params(transforms.size())
+{
+    assert(tints.empty() || tints.size() == transforms.size());
+
+    for (std::size_t instance = 0; instance < transforms.size(); ++instance)
+    {
+        // the 3x4 store transposes the matrix, it is the row-major layout of the instance descs
+        XMStoreFloat3x4(&_transforms[instance], transforms[instance]);
+
+        // the geometry offset is assigned by the TLAS build
+        _params[instance].color = tints.empty() ? XMFLOAT3{1.0f, 1.0f, 1.0f} : tints[instance];
+    }
+}
+
+void InstancedObject::SetTransform(std::size_t instance, const XMMATRIX& transform)
+{
+    XMStoreFloat3x4(&_transforms[instance], transform);
+    _dirty = true;
+}
+
+void InstancedObject::SetTint(std::size_t instance, XMFLOAT3 tint)
+{
+    _params[instance].color = tint;
+    _dirty                  = true;
+}
+
+SceneObject& InstancedObject::GetPrototype()
+{
+    return _prototype;
+}
+
+const SceneObject& InstancedObject::GetPrototype() const
+{
+    return _prototype;
+}
+
+std::size_t InstancedObject::GetInstancesCount() const
+{
+    return _transforms.size();
+}
+
+std::span<const XMFLOAT3X4> InstancedObject::GetTransforms() const
+{
+    return _transforms;
+}
+
+std::span<const InstanceParams> InstancedObject::GetInstanceParams() const
+{
+    return _params;
+}
+
+bool InstancedObject::IsDirty() const
+{
+    return _dirty;
+}
+
+void InstancedObject::ResetDirty()
+{
+    _dirty = false;
+}
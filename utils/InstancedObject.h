@@ -0,0 +1,48 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <utils/SceneObject.h>
+
+#include <shaders/Common.h>
+
+#include <span>
+
+// A mesh placed many times (flora, rocks). The instances share the BLAS, the descriptors and the
+// geometry params of the prototype, only their transforms and per-instance params are stored, so
+// the memory grows with the number of unique meshes.
+class InstancedObject
+{
+public:
+    // transforms are object to world matrices, tints multiply the vertex colors (white if empty)
+    InstancedObject(std::shared_ptr<MeshObject> meshObject,
+                    DescriptorHeap&             heap,
+                    ComPtr<ID3D12Device>        pDevice,
+                    Material                    material,
+                    std::span<const XMMATRIX>   transforms,
+                    std::span<const XMFLOAT3>   tints = {});
+
+    InstancedObject(const InstancedObject&) = delete;
+    InstancedObject& operator=(const InstancedObject&) = delete;
+
+    void SetTransform(std::size_t instance, const XMMATRIX& transform);
+    void SetTint(std::size_t instance, XMFLOAT3 tint);
+
+    // the prototype provides the geometry params and the materials, its own transform is not used
+    SceneObject&       GetPrototype();
+    const SceneObject& GetPrototype() const;
+
+    std::size_t                     GetInstancesCount() const;
+    std::span<const XMFLOAT3X4>     GetTransforms() const;  // in the TLAS instance layout
+    std::span<const InstanceParams> GetInstanceParams() const;
+
+    bool IsDirty() const;
+    void ResetDirty();
+
+private:
+    SceneObject                 _prototype;
+    std::vector<XMFLOAT3X4>     _transforms;
+    std::vector<InstanceParams> _params;
+
+    bool _dirty = true;
+};
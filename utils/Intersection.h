@@ -0,0 +1,163 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+// Exact tests of the moving primitives against a triangle, shared by the CPU side structures. The
+// directions are not normalized, the distances are measured in their lengths.
+namespace Intersection
+{
+struct TriangleHit
+{
+    float             t = 0.0f;
+    DirectX::XMFLOAT2 barycentrics;  // of the contact, the weights of the second and the third vertices
+};
+
+// Moller-Trumbore, the back faces are culled if asked to, the determinant is positive for the
+// triangles D3D takes as front facing ones
+inline std::optional<TriangleHit> RayTriangle(DirectX::FXMVECTOR origin,
+                                              DirectX::FXMVECTOR direction,
+                                              DirectX::FXMVECTOR p0,
+                                              DirectX::GXMVECTOR p1,
+                                              DirectX::HXMVECTOR p2,
+                                              float              tMin,
+                                              float              tMax,
+                                              bool               cullBackFaces)
+{
+    using namespace DirectX;
+
+    const XMVECTOR edge1 = XMVectorSubtract(p1, p0);
+    const XMVECTOR edge2 = XMVectorSubtract(p2, p0);
+
+    const XMVECTOR p           = XMVector3Cross(direction, edge2);
+    const float    determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+    if (determinant == 0.0f || (cullBackFaces && determinant < 0.0f))
+        return std::nullopt;
+
+    const float    inverseDeterminant = 1.0f / determinant;
+    const XMVECTOR s                  = XMVectorSubtract(origin, p0);
+
+    const float u = XMVectorGetX(XMVector3Dot(s, p)) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f)
+        return std::nullopt;
+
+    const XMVECTOR q = XMVector3Cross(s, edge1);
+    const float    v = XMVectorGetX(XMVector3Dot(direction, q)) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f)
+        return std::nullopt;
+
+    const float t = XMVectorGetX(XMVector3Dot(edge2, q)) * inverseDeterminant;
+    if (t < tMin || t > tMax)
+        return std::nullopt;
+
+    return TriangleHit{t, {u, v}};
+}
+
+// The first contact of a sphere moving along the direction with both sides of the triangle: its
+// face, then its edges and vertices. The ones the sphere is in touch with at the start are not
+// hit, so an embedded sphere may always move out.
+inline std::optional<TriangleHit> SweepSphereTriangle(DirectX::FXMVECTOR center,
+                                                      DirectX::FXMVECTOR direction,
+                                                      DirectX::FXMVECTOR p0,
+                                                      DirectX::GXMVECTOR p1,
+                                                      DirectX::HXMVECTOR p2,
+                                                      float              radius,
+                                                      float              tMin,
+                                                      float              tMax)
+{
+    using namespace DirectX;
+
+    const XMVECTOR edge1  = XMVectorSubtract(p1, p0);
+    const XMVECTOR edge2  = XMVectorSubtract(p2, p0);
+    const XMVECTOR normal = XMVector3Normalize(XMVector3Cross(edge1, edge2));
+
+    const float d00 = XMVectorGetX(XMVector3Dot(edge1, edge1));
+    const float d01 = XMVectorGetX(XMVector3Dot(edge1, edge2));
+    const float d11 = XMVectorGetX(XMVector3Dot(edge2, edge2));
+    const float area = d00 * d11 - d01 * d01;
+
+    // the face is touched first if the sphere reaches its plane inside of it
+    const float distance    = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, p0), normal));
+    const float approaching = XMVectorGetX(XMVector3Dot(direction, normal));
+    const float side        = distance < 0.0f ? -1.0f : 1.0f;
+    if (area > 0.0f && std::abs(distance) > radius && approaching * side < 0.0f)
+    {
+        const float t = (side * radius - distance) / approaching;
+        if (t >= tMin && t <= tMax)
+        {
+            const XMVECTOR contact = XMVectorSubtract(XMVectorMultiplyAdd(direction, XMVectorReplicate(t), center), XMVectorScale(normal, side * radius));
+            const XMVECTOR offset  = XMVectorSubtract(contact, p0);
+
+            const float d20 = XMVectorGetX(XMVector3Dot(offset, edge1));
+            const float d21 = XMVectorGetX(XMVector3Dot(offset, edge2));
+            const float u   = (d11 * d20 - d01 * d21) / area;
+            const float v   = (d00 * d21 - d01 * d20) / area;
+            if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f)
+                return TriangleHit{t, {u, v}};
+        }
+    }
+
+    std::optional<TriangleHit> output;
+    const auto                 accept = [&](float t, float u, float v) {
+        if (t >= tMin && t <= (output ? output->t : tMax))
+            output = TriangleHit{t, {u, v}};
+    };
+
+    // the smaller root of a*t^2 + b*t + c = 0, the sphere enters the primitive there
+    const auto solve = [](float a, float b, float c, float& t) {
+        const float discriminant = b * b - 4.0f * a * c;
+        if (a <= 0.0f || discriminant < 0.0f)
+            return false;
+
+        t = (-b - std::sqrt(discriminant)) / (2.0f * a);
+        return true;
+    };
+
+    const float directionSq = XMVectorGetX(XMVector3Dot(direction, direction));
+
+    const XMVECTOR vertices[3]        = {p0, p1, p2};
+    const float    vertexWeights[3][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}};
+    for (int vertex = 0; vertex < 3; ++vertex)
+    {
+        const XMVECTOR m = XMVectorSubtract(center, vertices[vertex]);
+
+        float t;
+        if (solve(directionSq, 2.0f * XMVectorGetX(XMVector3Dot(direction, m)), XMVectorGetX(XMVector3Dot(m, m)) - radius * radius, t))
+            accept(t, vertexWeights[vertex][0], vertexWeights[vertex][1]);
+    }
+
+    // the edges are cylinders, a contact counts if it is between the vertices
+    for (int edge = 0; edge < 3; ++edge)
+    {
+        const int      next = (edge + 1) % 3;
+        const XMVECTOR e    = XMVectorSubtract(vertices[next], vertices[edge]);
+        const XMVECTOR m    = XMVectorSubtract(center, vertices[edge]);
+
+        const float edgeSq = XMVectorGetX(XMVector3Dot(e, e));
+        const float ed     = XMVectorGetX(XMVector3Dot(e, direction));
+        const float em     = XMVectorGetX(XMVector3Dot(e, m));
+
+        const float a = edgeSq * directionSq - ed * ed;
+        const float b = 2.0f * (edgeSq * XMVectorGetX(XMVector3Dot(direction, m)) - ed * em);
+        const float c = edgeSq * (XMVectorGetX(XMVector3Dot(m, m)) - radius * radius) - em * em;
+
+        float t;
+        if (!solve(a, b, c, t))
+            continue;
+
+        const float f = (ed * t + em) / edgeSq;
+        if (f < 0.0f || f > 1.0f)
+            continue;
+
+        const float weights[3] = {edge == 0 ? 1.0f - f : edge == 2 ? f : 0.0f,
+                                  edge == 0 ? f : edge == 1 ? 1.0f - f : 0.0f,
+                                  edge == 1 ? f : edge == 2 ? 1.0f - f : 0.0f};
+        accept(t, weights[1], weights[2]);
+    }
+
+    return output;
+}
+}  // namespace Intersection
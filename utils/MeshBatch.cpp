@@ -0,0 +1,204 @@
+#include "MeshBatch.h"
+#include "Align.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace MeshBatch
+{
+namespace
+{
+// spreads 10 bits of the value to every third bit
+uint32_t SpreadBits(uint32_t value)
+{
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+}  // namespace
+
+std::size_t IndexStride(std::size_t verticesCount)
+{
+    return verticesCount <= std::numeric_limits<uint16_t>::max() + 1 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void CopyIndices(std::span<const uint32_t> indices, std::size_t indexStride, uint8_t* destination)
+{
+    if (indexStride == sizeof(uint32_t))
+    {
+        std::memcpy(destination, indices.data(), indices.size_bytes());
+        return;
+    }
+
+    assert(indexStride == sizeof(uint16_t));
+    uint16_t* shortIndices = reinterpret_cast<uint16_t*>(destination);
+    for (std::size_t i = 0; i < indices.size(); ++i)
+        shortIndices[i] = (uint16_t)indices[i];
+}
+
+GeometryLayout PlanGeometry(std::span<const MeshDesc> meshes)
+{
+    GeometryLayout layout;
+    layout.meshes.resize(meshes.size());
+
+    // vertex blocks go first, they have the strictest alignment
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        const MeshDesc& mesh = meshes[i];
+        assert(mesh.stride > 0);
+
+        // the block has to start on a whole element and on a 4-byte boundary for the BLAS build
+        offset = Math::AlignTo(offset, mesh.stride);
+        while (offset % sizeof(uint32_t) != 0)
+            offset += mesh.stride;
+
+        layout.alignment              = std::lcm(layout.alignment, mesh.stride);
+        layout.meshes[i].vertexOffset = offset;
+        layout.meshes[i].vertexSize   = mesh.vertexData.size();
+        offset += mesh.vertexData.size();
+    }
+
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        const MeshDesc& mesh = meshes[i];
+        if (mesh.indexData.empty())
+            continue;
+
+        MeshPlacement& placement = layout.meshes[i];
+        offset                   = Math::AlignTo(offset, sizeof(uint32_t));
+        placement.indexStride    = IndexStride(mesh.vertexData.size() / mesh.stride);
+        placement.indexOffset    = offset;
+        placement.indexSize      = mesh.indexData.size() * placement.indexStride;
+        offset += placement.indexSize;
+    }
+
+    layout.bufferSize = Math::AlignTo(offset, sizeof(uint32_t));
+    return layout;
+}
+
+void WriteGeometry(std::span<const MeshDesc> meshes, const GeometryLayout& layout, uint8_t* destination)
+{
+    assert(meshes.size() == layout.meshes.size());
+
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        const MeshPlacement& placement = layout.meshes[i];
+        std::memcpy(destination + placement.vertexOffset, meshes[i].vertexData.data(), placement.vertexSize);
+
+        if (placement.indexStride != 0)
+            CopyIndices(meshes[i].indexData, placement.indexStride, destination + placement.indexOffset);
+    }
+}
+
+BuildSchedule PlanBuilds(std::span<const BuildSizes> builds, std::size_t scratchBudget)
+{
+    BuildSchedule schedule;
+    schedule.steps.reserve(builds.size());
+
+    std::size_t offset = 0;
+    for (const BuildSizes& build : builds)
+    {
+        const std::size_t scratchSize = Math::AlignTo(build.scratchSize, accelerationStructureAlignment);
+
+        BuildStep step;
+        if (offset > 0 && offset + scratchSize > scratchBudget)
+        {
+            step.barrierBefore = true;
+            schedule.barriersCount++;
+            offset = 0;
+        }
+
+        step.scratchOffset = offset;
+        offset += scratchSize;
+
+        schedule.scratchSize = std::max(schedule.scratchSize, offset);
+        schedule.steps.push_back(step);
+    }
+
+    return schedule;
+}
+
+void RecordBatch(std::span<const MeshDesc> meshes,
+                 std::size_t               objectsCount,
+                 bool                      createBlas,
+                 std::size_t               scratchBudget,
+                 IBatchDevice&             device)
+{
+    if (meshes.empty())
+        return;
+
+    const GeometryLayout layout = PlanGeometry(meshes);
+    WriteGeometry(meshes, layout, device.AllocateGeometry(layout));
+    device.UploadGeometry(layout.bufferSize);
+
+    if (createBlas)
+    {
+        std::vector<BuildSizes> builds(objectsCount);
+        for (std::size_t i = 0; i < objectsCount; ++i)
+            builds[i] = device.GetBuildSizes(i);
+
+        const BuildSchedule schedule = PlanBuilds(builds, scratchBudget);
+        device.AllocateBuilds(builds, schedule.scratchSize);
+
+        for (std::size_t i = 0; i < objectsCount; ++i)
+        {
+            if (schedule.steps[i].barrierBefore)
+                device.ScratchBarrier();
+
+            device.BuildBLAS(i, schedule.steps[i].scratchOffset);
+        }
+
+        device.EmitCompactedSizes(objectsCount);
+    }
+
+    device.Execute();
+}
+
+std::vector<uint32_t> GroupByLocality(std::span<const std::array<float, 3>> centers, std::size_t maxGroupSize)
+{
+    assert(maxGroupSize > 0);
+
+    std::array<float, 3> minBound = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                                     std::numeric_limits<float>::max()};
+    std::array<float, 3> maxBound = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                                     std::numeric_limits<float>::lowest()};
+
+    for (const std::array<float, 3>& center : centers)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minBound[axis] = std::min(minBound[axis], center[axis]);
+            maxBound[axis] = std::max(maxBound[axis], center[axis]);
+        }
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> codes;  // morton code, mesh index
+    codes.reserve(centers.size());
+    for (std::size_t i = 0; i < centers.size(); ++i)
+    {
+        uint32_t code = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float extent = maxBound[axis] - minBound[axis];
+            const float t      = extent > 0.0f ? (centers[i][axis] - minBound[axis]) / extent : 0.0f;
+            code |= SpreadBits((uint32_t)std::clamp(t * 1023.0f, 0.0f, 1023.0f)) << axis;
+        }
+
+        codes.emplace_back(code, (uint32_t)i);
+    }
+
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<uint32_t> groups(centers.size());
+    for (std::size_t i = 0; i < codes.size(); ++i)
+        groups[codes[i].second] = (uint32_t)(i / maxGroupSize);
+
+    return groups;
+}
+}  // namespace MeshBatch
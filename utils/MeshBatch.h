@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Planning part of the batched mesh creation: placement of many meshes in one geometry
+// buffer and scheduling of their BLAS builds over a shared scratch arena. It has no
+// D3D12 dependencies, so layouts and schedules can be checked without a device.
+// RecordBatch drives the creation through IBatchDevice, MeshObject implements it with D3D12.
+namespace MeshBatch
+{
+// BLAS scratch and result addresses have to be aligned to 256 bytes
+constexpr std::size_t accelerationStructureAlignment = 256;
+
+struct MeshDesc
+{
+    std::span<const uint8_t>  vertexData;
+    std::size_t               stride = 0;
+    std::span<const uint32_t> indexData;
+};
+
+struct MeshPlacement
+{
+    std::size_t vertexOffset = 0;  // multiple of the stride, so it can be used as the first element of a structured view
+    std::size_t vertexSize   = 0;
+    std::size_t indexOffset  = 0;  // multiple of 4 bytes, raw views address the buffer by words
+    std::size_t indexSize    = 0;
+    std::size_t indexStride  = 0;  // 2 or 4 bytes, 0 for meshes without indices
+};
+
+struct GeometryLayout
+{
+    std::vector<MeshPlacement> meshes;
+    std::size_t                bufferSize = 0;
+    std::size_t                alignment  = 4;  // the buffer has to start at a multiple of it to keep the placements valid
+};
+
+struct BuildSizes
+{
+    std::size_t resultSize  = 0;
+    std::size_t scratchSize = 0;
+};
+
+struct BuildStep
+{
+    std::size_t scratchOffset = 0;
+    bool        barrierBefore = false;  // the scratch range is reused, previous builds have to be finished
+};
+
+struct BuildSchedule
+{
+    std::vector<BuildStep> steps;
+    std::size_t            scratchSize   = 0;
+    std::size_t            barriersCount = 0;
+};
+
+// 16-bit indices are used when every vertex is addressable by them
+std::size_t IndexStride(std::size_t verticesCount);
+void        CopyIndices(std::span<const uint32_t> indices, std::size_t indexStride, uint8_t* destination);
+
+GeometryLayout PlanGeometry(std::span<const MeshDesc> meshes);
+void           WriteGeometry(std::span<const MeshDesc> meshes, const GeometryLayout& layout, uint8_t* destination);
+
+// Builds get consecutive scratch ranges until the budget is exhausted, then the arena is reused
+// after a barrier. A build larger than the budget gets the whole arena, which grows to fit it.
+BuildSchedule PlanBuilds(std::span<const BuildSizes> builds, std::size_t scratchBudget);
+
+// Device side of the batch creation, the calls are made in the order of the command list
+class IBatchDevice
+{
+public:
+    virtual ~IBatchDevice() = default;
+
+    // allocates the geometry and the staging memory, returns the CPU address of the staging memory
+    virtual uint8_t* AllocateGeometry(const GeometryLayout& layout) = 0;
+    // copies the staging memory to the geometry and makes it readable by the builds
+    virtual void UploadGeometry(std::size_t size) = 0;
+
+    virtual BuildSizes GetBuildSizes(std::size_t object) = 0;
+    virtual void       AllocateBuilds(std::span<const BuildSizes> builds, std::size_t scratchSize) = 0;
+    virtual void       ScratchBarrier() = 0;
+    virtual void       BuildBLAS(std::size_t object, std::size_t scratchOffset) = 0;
+    // waits for all the builds and reads back their compacted sizes
+    virtual void EmitCompactedSizes(std::size_t objectsCount) = 0;
+
+    // closes the list and hands it to the executor, called once per batch
+    virtual void Execute() = 0;
+};
+
+// Uploads the meshes and builds BLASes of the objects in one command list. Objects are described
+// by the device, the meshes are mapped to them by the caller.
+void RecordBatch(std::span<const MeshDesc> meshes,
+                 std::size_t               objectsCount,
+                 bool                      createBlas,
+                 std::size_t               scratchBudget,
+                 IBatchDevice&             device);
+
+// Splits meshes into groups of at most maxGroupSize following a Morton curve through their centers,
+// so every group covers a compact region. Returns the group index of every mesh.
+std::vector<uint32_t> GroupByLocality(std::span<const std::array<float, 3>> centers, std::size_t maxGroupSize);
+}  // namespace MeshBatch
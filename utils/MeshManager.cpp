@@ -85,6 +85,7 @@ static const std::vector<GeometryVertex> cubeVertices =
 
 MeshManager::MeshManager(ComPtr<ID3D12Device5> device)
     : _device(device)
+    , _geometryHeaps(device)
 {
 }
 
@@ -120,6 +121,7 @@ std::shared_ptr<MeshObject> MeshManager::CreateCube(std::function<void(CommandLi
         sizeof(GeometryVertex),
         indices,
         _device,
+        _geometryHeaps,
         true,
         cmdListExecutor);
 
@@ -157,7 +159,7 @@ std::shared_ptr<MeshObject> MeshManager::CreateEmptyCube(std::function<void(Comm
 
     _emptyCube = std::make_shared<MeshObject>(
         std::vector<uint8_t>{(uint8_t*)cubeVertices.data(), (uint8_t*)(cubeVertices.data() + cubeVertices.size())},
-        sizeof(GeometryVertex), indices, _device, true, cmdListExecutor);
+        sizeof(GeometryVertex), indices, _device, _geometryHeaps, true, cmdListExecutor);
 
     return _emptyCube;
 }
@@ -183,7 +185,7 @@ std::shared_ptr<MeshObject> MeshManager::CreatePlane(std::function<void(CommandL
 
     _plane = std::make_shared<MeshObject>(
         std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-        sizeof(GeometryVertex), indices, _device, true, cmdListExecutor);
+        sizeof(GeometryVertex), indices, _device, _geometryHeaps, true, cmdListExecutor);
 
     return _plane;
 }
@@ -223,12 +225,12 @@ std::shared_ptr<MeshObject> MeshManager::CreateAxes(std::function<void(CommandLi
 
     _axes = std::make_shared<MeshObject>(
         std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-        sizeof(GeometryVertex), indices, _device, true, cmdListExecutor);
+        sizeof(GeometryVertex), indices, _device, _geometryHeaps, true, cmdListExecutor);
 
     return _axes;
 }
 
-std::shared_ptr<MeshObject> MeshManager::CreateScreenQuad()
+std::shared_ptr<MeshObject> MeshManager::CreateScreenQuad(std::function<void(CommandList&)> cmdListExecutor)
 {
     if (_screenQuad)
         return _screenQuad;
@@ -246,7 +248,7 @@ std::shared_ptr<MeshObject> MeshManager::CreateScreenQuad()
     _screenQuad = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)sqVertices.data(), (uint8_t*)(sqVertices.data() + sqVertices.size())},
                                                sizeof(screenQuadVertex),
                                                std::vector<uint32_t>{},
-                                               _device, false);
+                                               _device, _geometryHeaps, false, cmdListExecutor);
 
     return _screenQuad;
 }
@@ -257,7 +259,31 @@ std::shared_ptr<MeshObject> MeshManager::CreateCustomObject(const std::vector<Ge
 {
     _customObjects.emplace_back(std::make_shared<MeshObject>(
         std::span<const uint8_t>{(uint8_t*)vertices.data(), vertices.size() * sizeof(GeometryVertex)},
-        sizeof(GeometryVertex), indices, _device, true, cmdListExecutor));
+        sizeof(GeometryVertex), indices, _device, _geometryHeaps, true, cmdListExecutor));
 
     return _customObjects.back();
 }
+
+MeshManager::MeshObjects MeshManager::CreateCustomObjects(std::span<const MeshBatch::MeshDesc> meshes,
+                                                          std::function<void(CommandList&)>    cmdListExecutor)
+{
+    MeshObjects output = MeshObject::CreateBatch(meshes, _device, _geometryHeaps, cmdListExecutor);
+    _customObjects.insert(_customObjects.end(), output.begin(), output.end());
+
+    return output;
+}
+
+MeshManager::MeshObjects MeshManager::CreateMergedObjects(std::span<const MeshBatch::MeshDesc> meshes,
+                                                          std::span<const uint32_t>            groups,
+                                                          std::function<void(CommandList&)>    cmdListExecutor)
+{
+    MeshObjects output = MeshObject::CreateMerged(meshes, groups, _device, _geometryHeaps, cmdListExecutor);
+    _customObjects.insert(_customObjects.end(), output.begin(), output.end());
+
+    return output;
+}
+
+GeometryHeaps& MeshManager::GetGeometryHeaps()
+{
+    return _geometryHeaps;
+}
@@ -16,14 +16,26 @@ public:
     std::shared_ptr<MeshObject> CreateEmptyCube(std::function<void(CommandList&)> cmdListExecutor);
     std::shared_ptr<MeshObject> CreatePlane(std::function<void(CommandList&)> cmdListExecutor);
     std::shared_ptr<MeshObject> CreateAxes(std::function<void(CommandList&)> cmdListExecutor);
-    std::shared_ptr<MeshObject> CreateScreenQuad();
+    std::shared_ptr<MeshObject> CreateScreenQuad(std::function<void(CommandList&)> cmdListExecutor);
 
     std::shared_ptr<MeshObject> CreateCustomObject(const std::vector<GeometryVertex>& vertices,
                                                    const std::vector<uint32_t>&       indices,
                                                    std::function<void(CommandList&)>  cmdListExecutor);
 
+    // all the meshes share one geometry buffer and one BLAS submission
+    MeshObjects CreateCustomObjects(std::span<const MeshBatch::MeshDesc> meshes,
+                                    std::function<void(CommandList&)>    cmdListExecutor);
+
+    // meshes with the same group index are merged into one multi-geometry object
+    MeshObjects CreateMergedObjects(std::span<const MeshBatch::MeshDesc> meshes,
+                                    std::span<const uint32_t>            groups,
+                                    std::function<void(CommandList&)>    cmdListExecutor);
+
+    GeometryHeaps& GetGeometryHeaps();
+
 private:
     ComPtr<ID3D12Device5> _device = nullptr;
+    GeometryHeaps         _geometryHeaps;
 
     std::vector<std::shared_ptr<MeshObject>> _meshes;
 
@@ -2,163 +2,431 @@
 
 #include "MeshObject.h"
 
-void CreateUAVBuffer(ComPtr<ID3D12Device5> device, size_t bufferSize, ComPtr<ID3D12Resource>* pOutBuffer, D3D12_RESOURCE_STATES initialState)
-{
-    D3D12_RESOURCE_DESC bufferDesc = {};
-    bufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
-    bufferDesc.Width               = bufferSize;
-    bufferDesc.Height              = 1;
-    bufferDesc.MipLevels           = 1;
-    bufferDesc.SampleDesc.Count    = 1;
-    bufferDesc.DepthOrArraySize    = 1;
-    bufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-    bufferDesc.Flags               = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+#include "MeshBatch.h"
 
-    D3D12_HEAP_PROPERTIES heapProp = {D3D12_HEAP_TYPE_DEFAULT};
-    ThrowIfFailed(device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &bufferDesc, initialState, nullptr,
-                                                  IID_PPV_ARGS(&(*pOutBuffer))));
-}
+namespace
+{
+// scratch memory shared by the builds of one batch, larger batches reuse it after a barrier
+constexpr std::size_t batchScratchBudget = 32 * 1024 * 1024;
+}  // namespace
 
 MeshObject::MeshObject(std::span<const uint8_t>          vertexData,
                        std::size_t                       stride,
                        std::span<const uint32_t>         indexData,
                        ComPtr<ID3D12Device5>             device,
+                       GeometryHeaps&                    heaps,
                        bool                              createBlas,
                        std::function<void(CommandList&)> cmdListExecutor)
-    : _indicesCount(indexData.size())
-    , _verticesCount(vertexData.size() / stride)
+    : MeshObject(std::move(Create(std::array{MeshBatch::MeshDesc{vertexData, stride, indexData}}, {}, device, heaps,
+                                  createBlas, cmdListExecutor)
+                               .front()))
 {
-    D3D12_HEAP_PROPERTIES heapProp = { D3D12_HEAP_TYPE_UPLOAD };
+}
 
-    D3D12_RESOURCE_DESC vertexBufferDesc = {};
-    vertexBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    vertexBufferDesc.Width = vertexData.size();
-    vertexBufferDesc.Height = 1;
-    vertexBufferDesc.MipLevels = 1;
-    vertexBufferDesc.SampleDesc.Count = 1;
-    vertexBufferDesc.DepthOrArraySize = 1;
-    vertexBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+std::vector<std::shared_ptr<MeshObject>> MeshObject::CreateBatch(std::span<const MeshBatch::MeshDesc> meshes,
+                                                                 ComPtr<ID3D12Device5>                device,
+                                                                 GeometryHeaps&                       heaps,
+                                                                 std::function<void(CommandList&)>    cmdListExecutor)
+{
+    return ToShared(Create(meshes, {}, device, heaps, true, cmdListExecutor));
+}
 
-    ThrowIfFailed(device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &vertexBufferDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_vertexBuffer)));
+std::vector<std::shared_ptr<MeshObject>> MeshObject::CreateMerged(std::span<const MeshBatch::MeshDesc> meshes,
+                                                                  std::span<const uint32_t>            groups,
+                                                                  ComPtr<ID3D12Device5>                device,
+                                                                  GeometryHeaps&                       heaps,
+                                                                  std::function<void(CommandList&)>    cmdListExecutor)
+{
+    assert(groups.size() == meshes.size());
+    return ToShared(Create(meshes, groups, device, heaps, true, cmdListExecutor));
+}
 
-    void* bufPtr = nullptr;
-    ThrowIfFailed(_vertexBuffer->Map(0, nullptr, &bufPtr));
-    std::memcpy(bufPtr, vertexData.data(), vertexData.size());
-    _vertexBuffer->Unmap(0, nullptr);
+std::vector<std::shared_ptr<MeshObject>> MeshObject::ToShared(std::vector<MeshObject>&& meshes)
+{
+    std::vector<std::shared_ptr<MeshObject>> output;
+    output.reserve(meshes.size());
+    for (MeshObject& mesh : meshes)
+        output.emplace_back(std::make_shared<MeshObject>(std::move(mesh)));
 
-    // creating view describing how to use vertex buffer for GPU
-    _vertexBufferView.BufferLocation = _vertexBuffer->GetGPUVirtualAddress();
-    _vertexBufferView.SizeInBytes    = (UINT)vertexData.size();
-    _vertexBufferView.StrideInBytes  = (UINT)stride;
+    return output;
+}
+
+class MeshObject::BatchDevice : public MeshBatch::IBatchDevice
+{
+public:
+    BatchDevice(std::span<const MeshBatch::MeshDesc> meshes,
+                std::span<const uint32_t>            groups,
+                ComPtr<ID3D12Device5>                device,
+                GeometryHeaps&                       heaps,
+                std::function<void(CommandList&)>    cmdListExecutor)
+        : _meshes(meshes)
+        , _groups(groups)
+        , _device(device)
+        , _heaps(heaps)
+        , _cmdListExecutor(std::move(cmdListExecutor))
+        , _cmdList(CommandListType::Compute, device)
+    {
+    }
 
-    if (!indexData.empty())
+    std::size_t GetObjectsCount() const
     {
-        D3D12_RESOURCE_DESC indexBufferDesc = {};
-        indexBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        indexBufferDesc.Width = indexData.size() * sizeof(uint32_t);
-        indexBufferDesc.Height = 1;
-        indexBufferDesc.MipLevels = 1;
-        indexBufferDesc.SampleDesc.Count = 1;
-        indexBufferDesc.DepthOrArraySize = 1;
-        indexBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-        ThrowIfFailed(device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &indexBufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_indexBuffer)));
-
-        ThrowIfFailed(_indexBuffer->Map(0, nullptr, reinterpret_cast<void**>(&bufPtr)));
-        std::memcpy(bufPtr, indexData.data(), indexData.size() * sizeof(uint32_t));
-        _indexBuffer->Unmap(0, nullptr);
-
-        // creating view describing how to use vertex buffer for GPU
-        _indexBufferView.BufferLocation = _indexBuffer->GetGPUVirtualAddress();
-        _indexBufferView.SizeInBytes    = (UINT)(indexData.size() * sizeof(uint32_t));
-        _indexBufferView.Format         = DXGI_FORMAT_R32_UINT;
+        return _groups.empty() ? _meshes.size() : *std::max_element(_groups.begin(), _groups.end()) + 1;
     }
 
-    //////////////////////////////////////////////////////////////////////////
+    std::vector<MeshObject> TakeObjects()
+    {
+        return std::move(_output);
+    }
+
+    uint8_t* AllocateGeometry(const MeshBatch::GeometryLayout& layout) override
+    {
+        // all the meshes are placed in one allocation of the geometry heap and share it,
+        // the data goes through the staging memory since the geometry heap is not CPU visible
+        _staging  = _heaps.upload->Allocate(layout.bufferSize, sizeof(uint32_t));
+        _geometry = _heaps.geometry->Allocate(layout.bufferSize, layout.alignment);
+        _cmdList.TrackObject(_staging);
 
-    if (!createBlas)
-        return;
+        const std::size_t objectsCount = GetObjectsCount();
+        _output.reserve(objectsCount);
+        for (std::size_t i = 0; i < objectsCount; ++i)
+            _output.emplace_back(MeshObject{})._geometry = _geometry;
 
+        for (std::size_t i = 0; i < _meshes.size(); ++i)
+        {
+            const MeshBatch::MeshPlacement& placement = layout.meshes[i];
+
+            Geometry mesh;
+            mesh.verticesCount = placement.vertexSize / _meshes[i].stride;
+            mesh.indicesCount  = _meshes[i].indexData.size();
+            mesh.stride        = _meshes[i].stride;
+            mesh.vertexOffset  = placement.vertexOffset;
+            mesh.indexOffset   = placement.indexOffset;
+
+            if (placement.indexStride != 0)
+                mesh.indexFormat = placement.indexStride == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+            _output[_groups.empty() ? i : _groups[i]]._geometries.push_back(mesh);
+        }
+
+        assert(std::ranges::none_of(_output, [](const MeshObject& mesh) { return mesh._geometries.empty(); }));
+
+        return _staging->GetCPUAddress();
+    }
+
+    void UploadGeometry(std::size_t size) override
+    {
+        _cmdList->CopyBufferRegion(_geometry->GetResource().Get(), _geometry->GetOffset(), _staging->GetResource().Get(),
+                                   _staging->GetOffset(), size);
+
+        // buffers decay to the common state after the execution, so the transition does not have to be reverted
+        D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(_geometry->GetResource().Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        _cmdList->ResourceBarrier(1, &barrier);
+    }
+
+    MeshBatch::BuildSizes GetBuildSizes(std::size_t object) override
+    {
+        if (_geoDescs.empty())
+            _geoDescs.resize(_output.size());
+
+        _geoDescs[object] = _output[object].GetGeometryDescs();
+
+        const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = GetBLASInputs(_geoDescs[object]);
+
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
+        _device->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
+        if (prebuildInfo.ResultDataMaxSizeInBytes == 0)
+            throw std::runtime_error("Zeroed size");
+
+        return {prebuildInfo.ResultDataMaxSizeInBytes, prebuildInfo.ScratchDataSizeInBytes};
+    }
+
+    void AllocateBuilds(std::span<const MeshBatch::BuildSizes> builds, std::size_t scratchSize) override
+    {
+        _scratch = _heaps.scratch->Allocate(scratchSize, MeshBatch::accelerationStructureAlignment);
+        _cmdList.TrackObject(_scratch);
+
+        for (std::size_t i = 0; i < _output.size(); ++i)
+        {
+            _output[i]._blas = _heaps.accelerationStructures->Allocate(builds[i].resultSize,
+                                                                       MeshBatch::accelerationStructureAlignment);
+            _output[i]._blasBuildSize = builds[i].resultSize;
+        }
+    }
+
+    void ScratchBarrier() override
+    {
+        D3D12_RESOURCE_BARRIER uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(_scratch->GetResource().Get());
+        _cmdList->ResourceBarrier(1, &uavBarrier);
+    }
+
+    void BuildBLAS(std::size_t object, std::size_t scratchOffset) override
+    {
+        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC blasDesc = {};
+        blasDesc.Inputs = GetBLASInputs(_geoDescs[object]);
+        blasDesc.ScratchAccelerationStructureData = _scratch->GetGPUAddress() + scratchOffset;
+        blasDesc.DestAccelerationStructureData = _output[object]._blas->GetGPUAddress();
+
+        _cmdList->BuildRaytracingAccelerationStructure(&blasDesc, 0, nullptr);
+    }
+
+    void EmitCompactedSizes(std::size_t objectsCount) override
+    {
+        assert(objectsCount == _output.size());
+        MeshObject::EmitCompactedSizes(_cmdList, _device, _heaps, _output);
+    }
+
+    void Execute() override
+    {
+        _cmdList.Close();
+
+        // the executor may return before the GPU is done, the staging and scratch memory are tracked by the list
+        _cmdListExecutor(_cmdList);
+    }
+
+private:
+    std::span<const MeshBatch::MeshDesc> _meshes;
+    std::span<const uint32_t>            _groups;
+    ComPtr<ID3D12Device5>                _device;
+    GeometryHeaps&                       _heaps;
+    std::function<void(CommandList&)>    _cmdListExecutor;
+    CommandList                          _cmdList;  // the builds don't need the graphics pipeline, it may run on the async compute queue
+
+    std::shared_ptr<GeometryAllocation> _staging;
+    std::shared_ptr<GeometryAllocation> _geometry;
+    std::shared_ptr<GeometryAllocation> _scratch;
+
+    std::vector<MeshObject>                                  _output;
+    std::vector<std::vector<D3D12_RAYTRACING_GEOMETRY_DESC>> _geoDescs;
+};
+
+std::vector<MeshObject> MeshObject::Create(std::span<const MeshBatch::MeshDesc> meshes,
+                                           std::span<const uint32_t>            groups,
+                                           ComPtr<ID3D12Device5>                device,
+                                           GeometryHeaps&                       heaps,
+                                           bool                                 createBlas,
+                                           std::function<void(CommandList&)>    cmdListExecutor)
+{
     assert(cmdListExecutor);
 
-    CommandList cmdList{ CommandListType::Direct, device };
+    if (meshes.empty())
+        return {};
 
-    D3D12_RAYTRACING_GEOMETRY_DESC geoDesc = {};
-    geoDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-    geoDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-    geoDesc.Triangles.VertexBuffer.StartAddress = _vertexBuffer->GetGPUVirtualAddress();
-    geoDesc.Triangles.VertexBuffer.StrideInBytes = (UINT)stride;
-    geoDesc.Triangles.VertexCount = _verticesCount;
-    geoDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;  // TODO (DB): understand what it is
-    geoDesc.Triangles.IndexBuffer = _indexBuffer->GetGPUVirtualAddress();
-    geoDesc.Triangles.IndexCount = _indicesCount;
-    geoDesc.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
+    BatchDevice batchDevice{meshes, groups, device, heaps, std::move(cmdListExecutor)};
+    MeshBatch::RecordBatch(meshes, batchDevice.GetObjectsCount(), createBlas, batchScratchBudget, batchDevice);
+    return batchDevice.TakeObjects();
+}
 
-    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC blasDesc = {};
-    auto& inputs = blasDesc.Inputs;
+void MeshObject::EmitCompactedSizes(CommandList&             cmdList,
+                                    ComPtr<ID3D12Device5>    device,
+                                    GeometryHeaps&           heaps,
+                                    std::vector<MeshObject>& meshes)
+{
+    const std::size_t querySize = sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC) * meshes.size();
 
-    inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
-    inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-    // TODO (DB): check what flags we have and how we could use it
-    inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
-    inputs.NumDescs = 1;
-    inputs.pGeometryDescs = &geoDesc;
-
-    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
-    device->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
-    if (prebuildInfo.ResultDataMaxSizeInBytes == 0)
-        throw std::runtime_error("Zeroed size");
-
-    ComPtr<ID3D12Resource> scratchResource;
-    CreateUAVBuffer(device, prebuildInfo.ScratchDataSizeInBytes, &scratchResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    CreateUAVBuffer(device, prebuildInfo.ResultDataMaxSizeInBytes, &_blas,
-        D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
-    _blas->SetName(L"Bottom-Level Acceleration Structure");
+    // postbuild info can be written to UAVs only, the scratch heap is in this state already
+    std::shared_ptr<GeometryAllocation> postbuild = heaps.scratch->Allocate(querySize, sizeof(uint64_t));
+    cmdList.TrackObject(postbuild);
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width               = querySize;
+    bufferDesc.Height              = 1;
+    bufferDesc.MipLevels           = 1;
+    bufferDesc.SampleDesc.Count    = 1;
+    bufferDesc.DepthOrArraySize    = 1;
+    bufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    ComPtr<ID3D12Resource> readback;
+    D3D12_HEAP_PROPERTIES  heapProp = {D3D12_HEAP_TYPE_READBACK};
+    ThrowIfFailed(device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                  D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&readback)));
+
+    std::vector<D3D12_GPU_VIRTUAL_ADDRESS> blases;
+    blases.reserve(meshes.size());
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        blases.push_back(meshes[i].BLASAddress());
+        meshes[i]._compactionQuery    = readback;
+        meshes[i]._compactionQueryIdx = i;
+    }
+
+    // all the builds have to be finished before their sizes are known
+    D3D12_RESOURCE_BARRIER uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+    cmdList->ResourceBarrier(1, &uavBarrier);
+
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildDesc = {};
+    postbuildDesc.DestBuffer = postbuild->GetGPUAddress();
+    postbuildDesc.InfoType   = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+    cmdList->EmitRaytracingAccelerationStructurePostbuildInfo(&postbuildDesc, (UINT)blases.size(), blases.data());
+
+    D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(postbuild->GetResource().Get(),
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    cmdList->ResourceBarrier(1, &barrier);
+
+    cmdList->CopyBufferRegion(readback.Get(), 0, postbuild->GetResource().Get(), postbuild->GetOffset(), querySize);
+
+    // other users of the scratch heap expect it to stay in the UAV state
+    barrier = CD3DX12_RESOURCE_BARRIER::Transition(postbuild->GetResource().Get(),
+        D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    cmdList->ResourceBarrier(1, &barrier);
+}
+
+bool MeshObject::CanCompact() const
+{
+    return _compactionQuery != nullptr;
+}
+
+std::shared_ptr<GeometryAllocation> MeshObject::CompactBLAS(CommandList& cmdList, GeometryHeap& heap)
+{
+    assert(CanCompact());
+
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC compactedSize = {};
+
+    const std::size_t querySize = sizeof(compactedSize);
+    D3D12_RANGE       readRange = {_compactionQueryIdx * querySize, (_compactionQueryIdx + 1) * querySize};
+    D3D12_RANGE       noWrite   = {0, 0};
+
+    uint8_t* mapped = nullptr;
+    ThrowIfFailed(_compactionQuery->Map(0, &readRange, reinterpret_cast<void**>(&mapped)));
+    memcpy(&compactedSize, mapped + readRange.Begin, querySize);
+    _compactionQuery->Unmap(0, &noWrite);
+
+    // the query is shared by the meshes of the batch, it is released with the last of them
+    _compactionQuery = nullptr;
+
+    if (compactedSize.CompactedSizeInBytes == 0 || compactedSize.CompactedSizeInBytes >= _blas->GetSize())
+        return nullptr;
+
+    std::shared_ptr<GeometryAllocation> compacted =
+        heap.Allocate(compactedSize.CompactedSizeInBytes, MeshBatch::accelerationStructureAlignment);
+
+    cmdList->CopyRaytracingAccelerationStructure(compacted->GetGPUAddress(), _blas->GetGPUAddress(),
+                                                 D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
 
+    std::swap(_blas, compacted);
+    return compacted;
+}
+
+std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> MeshObject::GetGeometryDescs() const
+{
+    std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> output;
+    output.reserve(_geometries.size());
+
+    for (const Geometry& geometry : _geometries)
     {
-        blasDesc.ScratchAccelerationStructureData = scratchResource->GetGPUVirtualAddress();
-        blasDesc.DestAccelerationStructureData = _blas->GetGPUVirtualAddress();
+        D3D12_RAYTRACING_GEOMETRY_DESC& geoDesc = output.emplace_back();
+        geoDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+        geoDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+        geoDesc.Triangles.VertexBuffer.StartAddress = _geometry->GetGPUAddress() + geometry.vertexOffset;
+        geoDesc.Triangles.VertexBuffer.StrideInBytes = (UINT)geometry.stride;
+        geoDesc.Triangles.VertexCount = (UINT)geometry.verticesCount;
+        geoDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;  // TODO (DB): understand what it is
+
+        if (geometry.indicesCount > 0)
+        {
+            geoDesc.Triangles.IndexBuffer = _geometry->GetGPUAddress() + geometry.indexOffset;
+            geoDesc.Triangles.IndexCount = (UINT)geometry.indicesCount;
+            geoDesc.Triangles.IndexFormat = geometry.indexFormat;
+        }
     }
 
-    cmdList->BuildRaytracingAccelerationStructure(&blasDesc, 0, nullptr);
-    cmdList.Close();
+    return output;
+}
 
-    cmdListExecutor(cmdList);
+D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS MeshObject::GetBLASInputs(std::span<const D3D12_RAYTRACING_GEOMETRY_DESC> geoDescs)
+{
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
+    inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+    inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+    // meshes are static, so the build may take longer for a faster and smaller structure
+    inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE |
+                   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
+    inputs.NumDescs = (UINT)geoDescs.size();
+    inputs.pGeometryDescs = geoDescs.data();
+    return inputs;
+}
+
+size_t MeshObject::GeometriesCount() const
+{
+    return _geometries.size();
 }
 
 const Microsoft::WRL::ComPtr<ID3D12Resource>& MeshObject::VertexBuffer() const
 {
-    return _vertexBuffer;
+    return _geometry->GetResource();
+}
+
+const Microsoft::WRL::ComPtr<ID3D12Resource>& MeshObject::IndexBuffer(size_t geometry /*= 0*/) const
+{
+    static const ComPtr<ID3D12Resource> noBuffer;
+    return _geometries[geometry].indicesCount > 0 ? _geometry->GetResource() : noBuffer;
+}
+
+D3D12_VERTEX_BUFFER_VIEW MeshObject::VertexBufferView(size_t geometry /*= 0*/) const
+{
+    const Geometry& mesh = _geometries[geometry];
+
+    // creating view describing how to use vertex buffer for GPU
+    D3D12_VERTEX_BUFFER_VIEW view = {};
+    view.BufferLocation           = _geometry->GetGPUAddress() + mesh.vertexOffset;
+    view.SizeInBytes              = (UINT)(mesh.verticesCount * mesh.stride);
+    view.StrideInBytes            = (UINT)mesh.stride;
+    return view;
+}
+
+D3D12_INDEX_BUFFER_VIEW MeshObject::IndexBufferView(size_t geometry /*= 0*/) const
+{
+    const Geometry& mesh = _geometries[geometry];
+
+    D3D12_INDEX_BUFFER_VIEW view = {};
+    view.BufferLocation          = _geometry->GetGPUAddress() + mesh.indexOffset;
+    view.SizeInBytes             = (UINT)(mesh.indicesCount * IndexSize(geometry));
+    view.Format                  = mesh.indexFormat;
+    return view;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS MeshObject::BLASAddress() const
+{
+    return _blas ? _blas->GetGPUAddress() : 0;
+}
+
+size_t MeshObject::BLASSize() const
+{
+    return _blas ? _blas->GetSize() : 0;
+}
+
+size_t MeshObject::BLASBuildSize() const
+{
+    return _blasBuildSize;
 }
 
-const Microsoft::WRL::ComPtr<ID3D12Resource>& MeshObject::IndexBuffer() const
+size_t MeshObject::VerticesCount(size_t geometry /*= 0*/) const
 {
-    return _indexBuffer;
+    return _geometries[geometry].verticesCount;
 }
 
-const D3D12_VERTEX_BUFFER_VIEW& MeshObject::VertexBufferView() const
+size_t MeshObject::IndicesCount(size_t geometry /*= 0*/) const
 {
-    return _vertexBufferView;
+    return _geometries[geometry].indicesCount;
 }
 
-const D3D12_INDEX_BUFFER_VIEW& MeshObject::IndexBufferView() const
+size_t MeshObject::VertexBufferOffset(size_t geometry /*= 0*/) const
 {
-    return _indexBufferView;
+    return _geometry->GetOffset() + _geometries[geometry].vertexOffset;
 }
 
-const ComPtr<ID3D12Resource>& MeshObject::BLAS() const
+size_t MeshObject::IndexBufferOffset(size_t geometry /*= 0*/) const
 {
-    return _blas;
+    return _geometry->GetOffset() + _geometries[geometry].indexOffset;
 }
 
-size_t MeshObject::VerticesCount() const
+DXGI_FORMAT MeshObject::IndexFormat(size_t geometry /*= 0*/) const
 {
-    return _verticesCount;
+    return _geometries[geometry].indexFormat;
 }
 
-size_t MeshObject::IndicesCount() const
+size_t MeshObject::IndexSize(size_t geometry /*= 0*/) const
 {
-    return _indicesCount;
+    return _geometries[geometry].indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t);
 }
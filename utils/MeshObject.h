@@ -3,6 +3,8 @@
 #include "stdafx.h"
 
 #include "CommandList.h"
+#include "GeometryHeap.h"
+#include "MeshBatch.h"
 
 class MeshObject
 {
@@ -11,29 +13,97 @@ public:
                std::size_t                       stride,
                std::span<const uint32_t>         indexData,
                ComPtr<ID3D12Device5>             device,
-               bool                              createBlas      = true,
-               std::function<void(CommandList&)> cmdListExecutor = {});
+               GeometryHeaps&                    heaps,
+               bool                              createBlas,
+               std::function<void(CommandList&)> cmdListExecutor);
 
     MeshObject(MeshObject&& right) noexcept = default;
     MeshObject& operator=(MeshObject&& right) noexcept = default;
 
-    const ComPtr<ID3D12Resource>&   VertexBuffer() const;
-    const ComPtr<ID3D12Resource>&   IndexBuffer() const;
-    const D3D12_VERTEX_BUFFER_VIEW& VertexBufferView() const;
-    const D3D12_INDEX_BUFFER_VIEW&  IndexBufferView() const;
-    const ComPtr<ID3D12Resource>&   BLAS() const;
+    // Creates meshes sharing one geometry buffer, BLASes of all of them are built
+    // in one compute command list, so the executor is called once
+    static std::vector<std::shared_ptr<MeshObject>> CreateBatch(std::span<const MeshBatch::MeshDesc> meshes,
+                                                                ComPtr<ID3D12Device5>                device,
+                                                                GeometryHeaps&                       heaps,
+                                                                std::function<void(CommandList&)>    cmdListExecutor);
 
-    size_t VerticesCount() const;
-    size_t IndicesCount() const;
+    // Meshes with the same group index become geometries of one object with a single multi-geometry
+    // BLAS, the geometries keep the order of the meshes. Group indices have to be contiguous.
+    static std::vector<std::shared_ptr<MeshObject>> CreateMerged(std::span<const MeshBatch::MeshDesc> meshes,
+                                                                 std::span<const uint32_t>            groups,
+                                                                 ComPtr<ID3D12Device5>                device,
+                                                                 GeometryHeaps&                       heaps,
+                                                                 std::function<void(CommandList&)>    cmdListExecutor);
+
+    size_t GeometriesCount() const;
+
+    // buffers are shared with other meshes, the views and addresses include the offsets
+    const ComPtr<ID3D12Resource>& VertexBuffer() const;
+    const ComPtr<ID3D12Resource>& IndexBuffer(size_t geometry = 0) const;
+    D3D12_VERTEX_BUFFER_VIEW      VertexBufferView(size_t geometry = 0) const;
+    D3D12_INDEX_BUFFER_VIEW       IndexBufferView(size_t geometry = 0) const;
+    D3D12_GPU_VIRTUAL_ADDRESS     BLASAddress() const;
+
+    // BLASes are built with ALLOW_COMPACTION and their compacted sizes are read back, once the build
+    // is finished the structure is copied into a tightly sized allocation. The previous allocation is
+    // returned (nullptr if nothing was saved), it has to live while a TLAS may reference it.
+    bool                                CanCompact() const;
+    std::shared_ptr<GeometryAllocation> CompactBLAS(CommandList& cmdList, GeometryHeap& heap);
+
+    size_t BLASSize() const;
+    size_t BLASBuildSize() const;  // conservative size of the structure before the compaction
+
+    size_t VerticesCount(size_t geometry = 0) const;
+    size_t IndicesCount(size_t geometry = 0) const;
+
+    // offsets of the mesh data in the shared buffers
+    size_t VertexBufferOffset(size_t geometry = 0) const;
+    size_t IndexBufferOffset(size_t geometry = 0) const;
+
+    // R16_UINT is chosen automatically when all the vertices are addressable by 16-bit indices
+    DXGI_FORMAT IndexFormat(size_t geometry = 0) const;
+    size_t      IndexSize(size_t geometry = 0) const;
 
 private:
-    size_t _verticesCount = 0;
-    size_t _indicesCount  = 0;
+    MeshObject() = default;
+
+    struct Geometry
+    {
+        size_t      verticesCount = 0;
+        size_t      indicesCount  = 0;
+        size_t      stride        = 0;
+        size_t      vertexOffset  = 0;  // relative to the geometry allocation
+        size_t      indexOffset   = 0;
+        DXGI_FORMAT indexFormat   = DXGI_FORMAT_UNKNOWN;
+    };
+
+    // records the batch into a compute command list
+    class BatchDevice;
+
+    // every mesh becomes an object of its own when there are no groups
+    static std::vector<MeshObject> Create(std::span<const MeshBatch::MeshDesc> meshes,
+                                          std::span<const uint32_t>            groups,
+                                          ComPtr<ID3D12Device5>                device,
+                                          GeometryHeaps&                       heaps,
+                                          bool                                 createBlas,
+                                          std::function<void(CommandList&)>    cmdListExecutor);
+
+    static void EmitCompactedSizes(CommandList&             cmdList,
+                                   ComPtr<ID3D12Device5>    device,
+                                   GeometryHeaps&           heaps,
+                                   std::vector<MeshObject>& meshes);
+
+    static std::vector<std::shared_ptr<MeshObject>> ToShared(std::vector<MeshObject>&& meshes);
+
+    std::vector<D3D12_RAYTRACING_GEOMETRY_DESC>                 GetGeometryDescs() const;
+    static D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS GetBLASInputs(std::span<const D3D12_RAYTRACING_GEOMETRY_DESC> geoDescs);
+
+    std::vector<Geometry> _geometries;
 
-    D3D12_VERTEX_BUFFER_VIEW _vertexBufferView = {};
-    D3D12_INDEX_BUFFER_VIEW  _indexBufferView  = {};
+    std::shared_ptr<GeometryAllocation> _geometry;  // vertices and indices, shared by the meshes of a batch
+    std::shared_ptr<GeometryAllocation> _blas;
+    size_t                              _blasBuildSize = 0;
 
-    ComPtr<ID3D12Resource> _vertexBuffer = nullptr;
-    ComPtr<ID3D12Resource> _indexBuffer  = nullptr;
-    ComPtr<ID3D12Resource> _blas;
+    ComPtr<ID3D12Resource> _compactionQuery    = nullptr;  // readback of the compacted sizes of the batch
+    size_t                 _compactionQueryIdx = 0;
 };
@@ -0,0 +1,556 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace MeshOptimizer
+{
+namespace
+{
+constexpr uint32_t invalidIndex = ~0u;
+
+// vertex -> triangles lookup, triangles of the vertex v are stored
+// in triangles[offsets[v]; offsets[v] + counts[v])
+struct Adjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> triangles;
+};
+
+Adjacency BuildAdjacency(std::span<const uint32_t> indices, std::size_t verticesCount)
+{
+    Adjacency adjacency;
+    adjacency.offsets.resize(verticesCount, 0);
+    adjacency.counts.resize(verticesCount, 0);
+    adjacency.triangles.resize(indices.size());
+
+    for (uint32_t index : indices)
+        adjacency.counts[index]++;
+
+    uint32_t offset = 0;
+    for (std::size_t v = 0; v < verticesCount; ++v)
+    {
+        adjacency.offsets[v] = offset;
+        offset += adjacency.counts[v];
+    }
+
+    std::vector<uint32_t> filled(verticesCount, 0);
+    for (std::size_t i = 0; i < indices.size(); ++i)
+    {
+        const uint32_t v = indices[i];
+        adjacency.triangles[adjacency.offsets[v] + filled[v]++] = (uint32_t)(i / 3);
+    }
+
+    return adjacency;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tipsify, see "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", Sander et al.
+
+std::vector<uint32_t> OptimizeTipsify(std::span<const uint32_t> indices, std::size_t verticesCount, std::size_t cacheSize)
+{
+    const std::size_t trianglesCount = indices.size() / 3;
+    const Adjacency   adjacency      = BuildAdjacency(indices, verticesCount);
+
+    std::vector<uint32_t>    live = adjacency.counts;
+    std::vector<std::size_t> cacheTime(verticesCount, 0);
+    std::vector<bool>        emitted(trianglesCount, false);
+    std::vector<uint32_t>    deadEnd;
+    std::vector<uint32_t>    candidates;
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    std::size_t timestamp = cacheSize + 1;
+    std::size_t cursor    = 1;
+    uint32_t    fanning   = verticesCount ? 0 : invalidIndex;
+
+    auto getNextVertex = [&]() -> uint32_t {
+        uint32_t    best         = invalidIndex;
+        std::size_t bestPriority = 0;
+
+        for (uint32_t v : candidates)
+        {
+            if (!live[v])
+                continue;
+
+            // vertices which will still be in cache after all their triangles are emitted are preferred,
+            // the oldest one is taken to not lose it
+            std::size_t priority = 0;
+            if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = timestamp - cacheTime[v];
+
+            if (best == invalidIndex || priority > bestPriority)
+            {
+                best         = v;
+                bestPriority = priority;
+            }
+        }
+
+        if (best != invalidIndex)
+            return best;
+
+        while (!deadEnd.empty())
+        {
+            const uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v])
+                return v;
+        }
+
+        while (cursor < verticesCount)
+        {
+            if (live[cursor])
+                return (uint32_t)cursor;
+            cursor++;
+        }
+
+        return invalidIndex;
+    };
+
+    while (fanning != invalidIndex)
+    {
+        candidates.clear();
+
+        const uint32_t begin = adjacency.offsets[fanning];
+        const uint32_t end   = begin + adjacency.counts[fanning];
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const uint32_t triangle = adjacency.triangles[i];
+            if (emitted[triangle])
+                continue;
+
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                const uint32_t v = indices[triangle * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if (timestamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+
+            emitted[triangle] = true;
+        }
+
+        fanning = getNextVertex();
+    }
+
+    return output;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Forsyth, see "Linear-Speed Vertex Cache Optimisation", Tom Forsyth
+
+float ForsythVertexScore(int cachePosition, uint32_t liveTriangles, std::size_t cacheSize)
+{
+    if (!liveTriangles)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+        {
+            // the last triangle vertices are penalized a bit to not use the same edge all the time
+            score = 0.75f;
+        }
+        else
+        {
+            const float scaler = 1.0f / (cacheSize - 3);
+            score              = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+        }
+    }
+
+    // boost vertices with few triangles left to get rid of them quickly
+    score += 2.0f * std::pow((float)liveTriangles, -0.5f);
+    return score;
+}
+
+std::vector<uint32_t> OptimizeForsyth(std::span<const uint32_t> indices, std::size_t verticesCount, std::size_t cacheSize)
+{
+    // the last triangle takes 3 entries, the score decays over the rest
+    cacheSize = std::max<std::size_t>(cacheSize, 4);
+
+    const std::size_t trianglesCount = indices.size() / 3;
+    Adjacency         adjacency      = BuildAdjacency(indices, verticesCount);
+
+    // adjacency counts are decremented when triangles are emitted, so they hold live triangles count
+    std::vector<uint32_t>& live = adjacency.counts;
+    std::vector<int>       cachePosition(verticesCount, -1);
+    std::vector<float>     vertexScore(verticesCount);
+    std::vector<float>     triangleScore(trianglesCount, 0.0f);
+    std::vector<bool>      emitted(trianglesCount, false);
+
+    for (std::size_t v = 0; v < verticesCount; ++v)
+        vertexScore[v] = ForsythVertexScore(-1, live[v], cacheSize);
+
+    for (std::size_t t = 0; t < trianglesCount; ++t)
+    {
+        for (std::size_t k = 0; k < 3; ++k)
+            triangleScore[t] += vertexScore[indices[t * 3 + k]];
+    }
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(cacheSize + 3);
+    newCache.reserve(cacheSize + 3);
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    std::size_t cursor       = 0;
+    uint32_t    bestTriangle = invalidIndex;
+
+    for (std::size_t emittedCount = 0; emittedCount < trianglesCount; ++emittedCount)
+    {
+        if (bestTriangle == invalidIndex)
+        {
+            // nothing is connected to the cache, continue with the next triangle in the original order
+            while (emitted[cursor])
+                cursor++;
+            bestTriangle = (uint32_t)cursor;
+        }
+
+        const uint32_t triangle = bestTriangle;
+        emitted[triangle]       = true;
+
+        newCache.clear();
+        for (std::size_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = indices[triangle * 3 + k];
+            output.push_back(v);
+
+            // remove the triangle from the vertex adjacency list
+            uint32_t* begin = adjacency.triangles.data() + adjacency.offsets[v];
+            uint32_t* end   = begin + live[v];
+            uint32_t* it    = std::find(begin, end, triangle);
+            assert(it != end);
+            std::swap(*it, *(end - 1));
+            live[v]--;
+
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+        }
+
+        for (uint32_t v : cache)
+        {
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+        }
+
+        for (std::size_t i = 0; i < newCache.size(); ++i)
+            cachePosition[newCache[i]] = i < cacheSize ? (int)i : -1;
+
+        // update scores of the vertices touched by the cache and their triangles
+        for (uint32_t v : newCache)
+        {
+            const float score = ForsythVertexScore(cachePosition[v], live[v], cacheSize);
+            const float diff  = score - vertexScore[v];
+            vertexScore[v]    = score;
+
+            const uint32_t begin = adjacency.offsets[v];
+            for (uint32_t i = begin; i < begin + live[v]; ++i)
+                triangleScore[adjacency.triangles[i]] += diff;
+        }
+
+        bestTriangle    = invalidIndex;
+        float bestScore = -1.0f;
+        for (std::size_t i = 0; i < newCache.size() && i < cacheSize; ++i)
+        {
+            const uint32_t v     = newCache[i];
+            const uint32_t begin = adjacency.offsets[v];
+            for (uint32_t j = begin; j < begin + live[v]; ++j)
+            {
+                const uint32_t t = adjacency.triangles[j];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore    = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (newCache.size() > cacheSize)
+            newCache.resize(cacheSize);
+        std::swap(cache, newCache);
+    }
+
+    return output;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+float3 Subtract(const float3& a, const float3& b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+float3 Cross(const float3& a, const float3& b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float Dot(const float3& a, const float3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float Length(const float3& a)
+{
+    return std::sqrt(Dot(a, a));
+}
+
+MeshletBounds CalculateBounds(std::span<const GeometryVertex> vertices, const Meshlets& meshlets, const Meshlet& meshlet)
+{
+    MeshletBounds bounds;
+
+    float3 minPos = vertices[meshlets.vertices[meshlet.vertexOffset]].position;
+    float3 maxPos = minPos;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        const float3& p = vertices[meshlets.vertices[meshlet.vertexOffset + i]].position;
+        minPos          = {std::min(minPos.x, p.x), std::min(minPos.y, p.y), std::min(minPos.z, p.z)};
+        maxPos          = {std::max(maxPos.x, p.x), std::max(maxPos.y, p.y), std::max(maxPos.z, p.z)};
+    }
+
+    bounds.center = {(minPos.x + maxPos.x) * 0.5f, (minPos.y + maxPos.y) * 0.5f, (minPos.z + maxPos.z) * 0.5f};
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        const float3& p = vertices[meshlets.vertices[meshlet.vertexOffset + i]].position;
+        bounds.radius   = std::max(bounds.radius, Length(Subtract(p, bounds.center)));
+    }
+
+    // normal cone of all meshlet triangles
+    std::vector<float3> normals;
+    normals.reserve(meshlet.triangleCount);
+    float3 axis = {0.0f, 0.0f, 0.0f};
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+    {
+        const uint8_t* local = &meshlets.triangles[meshlet.triangleOffset + t * 3];
+        const float3&  a     = vertices[meshlets.vertices[meshlet.vertexOffset + local[0]]].position;
+        const float3&  b     = vertices[meshlets.vertices[meshlet.vertexOffset + local[1]]].position;
+        const float3&  c     = vertices[meshlets.vertices[meshlet.vertexOffset + local[2]]].position;
+
+        float3      normal = Cross(Subtract(b, a), Subtract(c, a));
+        const float length = Length(normal);
+        if (length == 0.0f)
+            continue;
+
+        normal = {normal.x / length, normal.y / length, normal.z / length};
+        normals.push_back(normal);
+        axis = {axis.x + normal.x, axis.y + normal.y, axis.z + normal.z};
+    }
+
+    const float axisLength = Length(axis);
+    if (normals.empty() || axisLength == 0.0f)
+    {
+        bounds.coneCutoff = 2.0f;  // cone can't be used for culling
+        return bounds;
+    }
+
+    bounds.coneAxis = {axis.x / axisLength, axis.y / axisLength, axis.z / axisLength};
+
+    float minDot = 1.0f;
+    for (const float3& normal : normals)
+        minDot = std::min(minDot, Dot(normal, bounds.coneAxis));
+
+    // all triangles are backfacing when the angle between the view direction and the axis
+    // is less than 90 degrees minus the cone half angle
+    bounds.coneCutoff = minDot <= 0.0f ? 2.0f : std::sqrt(1.0f - minDot * minDot);
+    return bounds;
+}
+}  // namespace
+
+VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> indices, std::size_t verticesCount, std::size_t cacheSize)
+{
+    VertexCacheStatistics statistics;
+
+    std::vector<std::size_t> cacheTime(verticesCount, 0);
+    std::vector<bool>        used(verticesCount, false);
+    std::size_t              timestamp = cacheSize + 1;
+
+    for (uint32_t index : indices)
+    {
+        if (timestamp - cacheTime[index] > cacheSize)
+        {
+            cacheTime[index] = timestamp++;
+            statistics.verticesTransformed++;
+        }
+
+        used[index] = true;
+    }
+
+    const std::size_t trianglesCount = indices.size() / 3;
+    const std::size_t usedCount      = std::count(used.begin(), used.end(), true);
+
+    statistics.acmr = trianglesCount ? (float)statistics.verticesTransformed / trianglesCount : 0.0f;
+    statistics.atvr = usedCount ? (float)statistics.verticesTransformed / usedCount : 0.0f;
+    return statistics;
+}
+
+std::vector<uint32_t> OptimizeVertexCache(std::span<const uint32_t> indices,
+                                          std::size_t               verticesCount,
+                                          VertexCacheAlgorithm      algorithm,
+                                          std::size_t               cacheSize)
+{
+    assert(indices.size() % 3 == 0);
+
+    switch (algorithm)
+    {
+    case VertexCacheAlgorithm::Tipsify:
+        return OptimizeTipsify(indices, verticesCount, cacheSize);
+    case VertexCacheAlgorithm::Forsyth:
+        return OptimizeForsyth(indices, verticesCount, cacheSize);
+    default:
+        assert(false);
+        return {indices.begin(), indices.end()};
+    }
+}
+
+void RemoveDuplicateVertices(std::vector<GeometryVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    const GeometryVertex* data = vertices.data();
+
+    auto hasher = [data](uint32_t idx) {
+        // FNV-1a over the vertex bytes
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data + idx);
+        std::size_t    hash  = 14695981039346656037ull;
+        for (std::size_t i = 0; i < sizeof(GeometryVertex); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    };
+
+    auto equal = [data](uint32_t left, uint32_t right) {
+        return std::memcmp(data + left, data + right, sizeof(GeometryVertex)) == 0;
+    };
+
+    std::unordered_map<uint32_t, uint32_t, decltype(hasher), decltype(equal)> unique(vertices.size(), hasher, equal);
+
+    std::vector<uint32_t>       remap(vertices.size());
+    std::vector<GeometryVertex> output;
+    output.reserve(vertices.size());
+
+    for (uint32_t i = 0; i < (uint32_t)vertices.size(); ++i)
+    {
+        auto [it, inserted] = unique.try_emplace(i, (uint32_t)output.size());
+        if (inserted)
+            output.push_back(vertices[i]);
+        remap[i] = it->second;
+    }
+
+    for (uint32_t& index : indices)
+        index = remap[index];
+
+    vertices.swap(output);
+}
+
+void OptimizeVertexFetch(std::vector<GeometryVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t>       remap(vertices.size(), invalidIndex);
+    std::vector<GeometryVertex> output;
+    output.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == invalidIndex)
+        {
+            remap[index] = (uint32_t)output.size();
+            output.push_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    vertices.swap(output);
+}
+
+Meshlets BuildMeshlets(std::span<const GeometryVertex> vertices,
+                       std::span<const uint32_t>       indices,
+                       std::size_t                     maxVertices,
+                       std::size_t                     maxTriangles)
+{
+    // local indices are stored as bytes
+    assert(maxVertices >= 3 && maxVertices <= 255);
+    assert(maxTriangles > 0);
+
+    Meshlets output;
+    output.vertices.reserve(indices.size());
+    output.triangles.reserve(indices.size());
+
+    std::vector<uint8_t> localIndex(vertices.size(), 0xff);
+    Meshlet              current;
+
+    auto finishMeshlet = [&]() {
+        if (!current.triangleCount)
+            return;
+
+        output.meshlets.push_back(current);
+        output.bounds.push_back(CalculateBounds(vertices, output, current));
+
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+            localIndex[output.vertices[current.vertexOffset + i]] = 0xff;
+
+        current                = {};
+        current.vertexOffset   = (uint32_t)output.vertices.size();
+        current.triangleOffset = (uint32_t)output.triangles.size();
+    };
+
+    for (std::size_t t = 0; t < indices.size() / 3; ++t)
+    {
+        const uint32_t* triangle = &indices[t * 3];
+
+        uint32_t newVertices = 0;
+        for (std::size_t k = 0; k < 3; ++k)
+        {
+            const bool duplicate = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            if (localIndex[triangle[k]] == 0xff && !duplicate)
+                newVertices++;
+        }
+
+        if (current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles)
+            finishMeshlet();
+
+        for (std::size_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = triangle[k];
+            if (localIndex[v] == 0xff)
+            {
+                localIndex[v] = (uint8_t)current.vertexCount++;
+                output.vertices.push_back(v);
+            }
+
+            output.triangles.push_back(localIndex[v]);
+        }
+
+        current.triangleCount++;
+    }
+
+    finishMeshlet();
+    return output;
+}
+
+OptimizationReport Optimize(std::vector<GeometryVertex>& vertices, std::vector<uint32_t>& indices, VertexCacheAlgorithm algorithm)
+{
+    OptimizationReport report;
+    report.verticesBefore = vertices.size();
+    report.before         = AnalyzeVertexCache(indices, vertices.size());
+
+    RemoveDuplicateVertices(vertices, indices);
+    indices = OptimizeVertexCache(indices, vertices.size(), algorithm);
+    OptimizeVertexFetch(vertices, indices);
+
+    report.verticesAfter = vertices.size();
+    report.after         = AnalyzeVertexCache(indices, vertices.size());
+    return report;
+}
+}  // namespace MeshOptimizer
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <shaders/Common.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Set of index/vertex reordering passes applied to generated meshes before
+// they are uploaded to the GPU. Nothing here depends on D3D12, so the passes
+// can be run and measured on any platform.
+namespace MeshOptimizer
+{
+enum class VertexCacheAlgorithm
+{
+    Tipsify,  // Sander et al. 2007, fast, close to optimal for FIFO caches
+    Forsyth   // Forsyth 2006, slower, targets LRU caches
+};
+
+struct VertexCacheStatistics
+{
+    std::size_t verticesTransformed = 0;
+    float       acmr                = 0.0f;  // transformed vertices per triangle, 0.5 is the best possible value
+    float       atvr                = 0.0f;  // transformed vertices per used vertex, 1.0 is the best possible value
+};
+
+struct OptimizationReport
+{
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+    std::size_t           verticesBefore = 0;
+    std::size_t           verticesAfter  = 0;
+};
+
+struct Meshlet
+{
+    uint32_t vertexOffset   = 0;  // offset in Meshlets::vertices
+    uint32_t vertexCount    = 0;
+    uint32_t triangleOffset = 0;  // offset in Meshlets::triangles, 3 local indices per triangle
+    uint32_t triangleCount  = 0;
+};
+
+struct MeshletBounds
+{
+    float3 center     = {0.0f, 0.0f, 0.0f};
+    float  radius     = 0.0f;
+    float3 coneAxis   = {0.0f, 0.0f, 1.0f};
+    float  coneCutoff = 1.0f;  // the meshlet is backfacing if dot(viewDir, coneAxis) >= coneCutoff
+};
+
+struct Meshlets
+{
+    std::vector<Meshlet>       meshlets;
+    std::vector<MeshletBounds> bounds;
+    std::vector<uint32_t>      vertices;   // indices into the source vertex buffer
+    std::vector<uint8_t>       triangles;  // indices into the meshlet vertex list
+};
+
+constexpr std::size_t defaultCacheSize = 16;
+
+// Simulates a FIFO post-transform cache of the given size
+VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> indices,
+                                         std::size_t               verticesCount,
+                                         std::size_t               cacheSize = defaultCacheSize);
+
+// Returns reordered triangle list, vertices are not touched. The cache is a FIFO one for Tipsify and
+// an LRU one for Forsyth.
+std::vector<uint32_t> OptimizeVertexCache(std::span<const uint32_t> indices,
+                                          std::size_t               verticesCount,
+                                          VertexCacheAlgorithm      algorithm = VertexCacheAlgorithm::Tipsify,
+                                          std::size_t               cacheSize = defaultCacheSize);
+
+// Merges bitwise identical vertices and remaps indices
+void RemoveDuplicateVertices(std::vector<GeometryVertex>& vertices, std::vector<uint32_t>& indices);
+
+// Reorders vertices in the order of the first use by the index buffer and drops unused ones
+void OptimizeVertexFetch(std::vector<GeometryVertex>& vertices, std::vector<uint32_t>& indices);
+
+// Splits a triangle list into clusters of limited size, triangles are taken in the index buffer order,
+// so the index buffer should be optimized for the vertex cache first to get compact meshlets
+Meshlets BuildMeshlets(std::span<const GeometryVertex> vertices,
+                       std::span<const uint32_t>       indices,
+                       std::size_t                     maxVertices  = 64,
+                       std::size_t                     maxTriangles = 124);
+
+// Runs all passes in the recommended order: duplicates removal, vertex cache and vertex fetch optimizations
+OptimizationReport Optimize(std::vector<GeometryVertex>& vertices,
+                            std::vector<uint32_t>&       indices,
+                            VertexCacheAlgorithm         algorithm = VertexCacheAlgorithm::Tipsify);
+}  // namespace MeshOptimizer
@@ -0,0 +1,303 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+namespace MeshSimplifier
+{
+namespace
+{
+// symmetric 4x4 matrix of the squared distance to a set of planes
+struct Quadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c  = 0.0;
+
+    static Quadric FromPlane(double nx, double ny, double nz, double d)
+    {
+        return {nx * nx, nx * ny, nx * nz, ny * ny, ny * nz, nz * nz, nx * d, ny * d, nz * d, d * d};
+    }
+
+    void Add(const Quadric& other)
+    {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+    }
+
+    double Evaluate(const float3& p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        const double result = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + a11 * y * y + 2.0 * a12 * y * z +
+                              a22 * z * z + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(result, 0.0);
+    }
+};
+
+struct Collapse
+{
+    double   cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+
+    bool operator>(const Collapse& other) const
+    {
+        return cost > other.cost;
+    }
+};
+
+struct Vector
+{
+    double x, y, z;
+};
+
+Vector TriangleNormal(const float3& a, const float3& b, const float3& c)
+{
+    const Vector e1 = {(double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z};
+    const Vector e2 = {(double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z};
+    return {e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x};
+}
+
+double Dot(const Vector& a, const Vector& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+}  // namespace
+
+Result Simplify(std::span<const GeometryVertex> vertices, std::span<const uint32_t> indices, const Options& options)
+{
+    using Triangle = std::array<uint32_t, 3>;
+
+    const std::size_t verticesCount  = vertices.size();
+    const std::size_t trianglesCount = indices.size() / 3;
+
+    std::vector<Triangle>              triangles(trianglesCount);
+    std::vector<bool>                  removedTriangles(trianglesCount, false);
+    std::vector<std::vector<uint32_t>> vertexTriangles(verticesCount);
+    std::vector<Quadric>               quadrics(verticesCount);
+    std::vector<bool>                  removedVertices(verticesCount, false);
+    std::vector<bool>                  lockedVertices(verticesCount, false);
+    std::vector<uint32_t>              versions(verticesCount, 0);
+
+    for (std::size_t t = 0; t < trianglesCount; ++t)
+    {
+        Triangle& triangle = triangles[t];
+        triangle           = {indices[t * 3 + 0], indices[t * 3 + 1], indices[t * 3 + 2]};
+
+        for (uint32_t v : triangle)
+            vertexTriangles[v].push_back((uint32_t)t);
+
+        const float3& p0     = vertices[triangle[0]].position;
+        const Vector  normal = TriangleNormal(p0, vertices[triangle[1]].position, vertices[triangle[2]].position);
+        const double  length = std::sqrt(Dot(normal, normal));
+        if (length == 0.0)
+            continue;
+
+        const double  nx      = normal.x / length;
+        const double  ny      = normal.y / length;
+        const double  nz      = normal.z / length;
+        const Quadric quadric = Quadric::FromPlane(nx, ny, nz, -(nx * p0.x + ny * p0.y + nz * p0.z));
+        for (uint32_t v : triangle)
+            quadrics[v].Add(quadric);
+    }
+
+    if (options.lockBorder)
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUsage;
+        edgeUsage.reserve(indices.size());
+        for (const Triangle& triangle : triangles)
+        {
+            for (std::size_t k = 0; k < 3; ++k)
+                edgeUsage[EdgeKey(triangle[k], triangle[(k + 1) % 3])]++;
+        }
+
+        for (const auto& [edge, usage] : edgeUsage)
+        {
+            if (usage != 1)
+                continue;
+
+            lockedVertices[edge >> 32]        = true;
+            lockedVertices[edge & 0xffffffff] = true;
+        }
+    }
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+    auto pushEdge = [&](uint32_t a, uint32_t b) {
+        Quadric quadric = quadrics[a];
+        quadric.Add(quadrics[b]);
+
+        // a vertex is moved into the position of the other one, pick the cheapest allowed direction
+        Collapse collapse = {std::numeric_limits<double>::max(), 0, 0, versions[a], versions[b]};
+        if (!lockedVertices[a])
+            collapse = {quadric.Evaluate(vertices[b].position), a, b, versions[a], versions[b]};
+
+        if (!lockedVertices[b])
+        {
+            const double cost = quadric.Evaluate(vertices[a].position);
+            if (cost < collapse.cost)
+                collapse = {cost, b, a, versions[b], versions[a]};
+        }
+
+        if (collapse.cost != std::numeric_limits<double>::max())
+            queue.push(collapse);
+    };
+
+    for (const Triangle& triangle : triangles)
+    {
+        for (std::size_t k = 0; k < 3; ++k)
+        {
+            // every interior edge is visited twice, it is cheaper than deduplication
+            if (triangle[k] != triangle[(k + 1) % 3])
+                pushEdge(triangle[k], triangle[(k + 1) % 3]);
+        }
+    }
+
+    // checks that the collapse keeps the mesh manifold and does not flip any triangle
+    auto isCollapseValid = [&](uint32_t from, uint32_t to) {
+        std::vector<uint32_t> fromNeighbours;
+        std::vector<uint32_t> toNeighbours;
+        std::size_t           sharedTriangles = 0;
+
+        for (uint32_t t : vertexTriangles[to])
+        {
+            if (removedTriangles[t])
+                continue;
+
+            for (uint32_t v : triangles[t])
+                toNeighbours.push_back(v);
+        }
+
+        for (uint32_t t : vertexTriangles[from])
+        {
+            if (removedTriangles[t])
+                continue;
+
+            const Triangle& triangle = triangles[t];
+            if (std::find(triangle.begin(), triangle.end(), to) != triangle.end())
+            {
+                sharedTriangles++;
+                continue;
+            }
+
+            for (uint32_t v : triangle)
+                fromNeighbours.push_back(v);
+
+            Triangle moved = triangle;
+            std::replace(moved.begin(), moved.end(), from, to);
+
+            // triangles made of border vertices only are slivers standing on the border
+            if (lockedVertices[moved[0]] && lockedVertices[moved[1]] && lockedVertices[moved[2]])
+                return false;
+
+            const Vector before = TriangleNormal(vertices[triangle[0]].position, vertices[triangle[1]].position,
+                                                 vertices[triangle[2]].position);
+            const Vector after  = TriangleNormal(vertices[moved[0]].position, vertices[moved[1]].position,
+                                                vertices[moved[2]].position);
+            // rotations close to 90 degrees are rejected as well, they produce slivers standing on the edge
+            if (Dot(before, after) <= 0.25 * std::sqrt(Dot(before, before) * Dot(after, after)))
+                return false;
+        }
+
+        std::sort(fromNeighbours.begin(), fromNeighbours.end());
+        fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+        std::sort(toNeighbours.begin(), toNeighbours.end());
+        toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+
+        std::vector<uint32_t> common;
+        std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(),
+                              std::back_inserter(common));
+        std::erase(common, from);
+        std::erase(common, to);
+
+        // link condition: only vertices opposite to the collapsed edge can be shared
+        return common.size() <= sharedTriangles;
+    };
+
+    const double maxCost = (double)options.maxError * options.maxError;
+    double       maxDone = 0.0;
+
+    std::size_t activeTriangles = trianglesCount;
+    while (activeTriangles > options.targetTrianglesCount && !queue.empty())
+    {
+        const Collapse collapse = queue.top();
+        queue.pop();
+
+        if (removedVertices[collapse.from] || removedVertices[collapse.to])
+            continue;
+
+        // quadric of one of the vertices was changed after the collapse was pushed
+        if (versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion)
+            continue;
+
+        if (collapse.cost > maxCost)
+            break;
+
+        if (!isCollapseValid(collapse.from, collapse.to))
+            continue;
+
+        for (uint32_t t : vertexTriangles[collapse.from])
+        {
+            if (removedTriangles[t])
+                continue;
+
+            Triangle& triangle = triangles[t];
+            if (std::find(triangle.begin(), triangle.end(), collapse.to) != triangle.end())
+            {
+                removedTriangles[t] = true;
+                activeTriangles--;
+                continue;
+            }
+
+            std::replace(triangle.begin(), triangle.end(), collapse.from, collapse.to);
+            vertexTriangles[collapse.to].push_back(t);
+        }
+
+        quadrics[collapse.to].Add(quadrics[collapse.from]);
+        removedVertices[collapse.from] = true;
+        vertexTriangles[collapse.from].clear();
+        versions[collapse.to]++;
+        maxDone = std::max(maxDone, collapse.cost);
+
+        std::erase_if(vertexTriangles[collapse.to], [&](uint32_t t) { return removedTriangles[t]; });
+
+        for (uint32_t t : vertexTriangles[collapse.to])
+        {
+            for (uint32_t v : triangles[t])
+            {
+                if (v != collapse.to)
+                    pushEdge(collapse.to, v);
+            }
+        }
+    }
+
+    Result result;
+    result.error = (float)std::sqrt(maxDone);
+    result.indices.reserve(activeTriangles * 3);
+    for (std::size_t t = 0; t < trianglesCount; ++t)
+    {
+        if (!removedTriangles[t])
+            result.indices.insert(result.indices.end(), triangles[t].begin(), triangles[t].end());
+    }
+
+    return result;
+}
+}  // namespace MeshSimplifier
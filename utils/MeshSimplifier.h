@@ -0,0 +1,34 @@
+#pragma once
+
+#include <shaders/Common.h>
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert 1997). Edges are collapsed into
+// one of their endpoints, so no vertices are created and every simplified level can share
+// the vertex buffer of the source mesh, only index buffers differ.
+namespace MeshSimplifier
+{
+struct Options
+{
+    // simplification stops when the mesh has this amount of triangles or less
+    std::size_t targetTrianglesCount = 0;
+
+    // simplification stops when a collapse would move the surface further than this distance (in world units)
+    float maxError = std::numeric_limits<float>::max();
+
+    // vertices on open edges are never moved, two meshes sharing a border stay watertight after simplification
+    bool lockBorder = true;
+};
+
+struct Result
+{
+    std::vector<uint32_t> indices;
+    float                 error = 0.0f;  // the largest error of performed collapses, in world units
+};
+
+Result Simplify(std::span<const GeometryVertex> vertices, std::span<const uint32_t> indices, const Options& options);
+}  // namespace MeshSimplifier
@@ -0,0 +1,371 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+
+namespace
+{
+constexpr std::size_t keptFramesCount = 300;
+constexpr std::size_t ringCapacity    = 4096;
+
+std::string EscapeJSON(std::string_view text)
+{
+    std::string output;
+    output.reserve(text.size());
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            output += '\\';
+        output += (unsigned char)c < 0x20 ? ' ' : c;
+    }
+    return output;
+}
+
+std::string EscapeCSV(std::string_view text)
+{
+    std::string output = "\"";
+    for (char c : text)
+    {
+        if (c == '"')
+            output += '"';
+        output += c;
+    }
+    return output + "\"";
+}
+
+std::ofstream OpenOutput(const std::filesystem::path& path)
+{
+    std::ofstream output(path, std::ios::trunc);
+    if (!output)
+        throw std::runtime_error("Profiler: can't open " + path.string());
+    return output;
+}
+}  // namespace
+
+// Single producer (the owner thread) and single consumer (EndFrame) queue of the finished scopes,
+// the full ring drops the new events instead of waiting
+class Profiler::ThreadRing
+{
+public:
+    ThreadRing(uint32_t thread, std::size_t capacity)
+        : _thread(thread)
+        , _events(capacity)
+    {
+    }
+
+    uint32_t GetThread() const
+    {
+        return _thread;
+    }
+
+    bool Push(const Event& event)
+    {
+        const uint64_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == _events.size())
+            return false;
+
+        _events[head % _events.size()] = event;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void Drain(std::vector<Event>& events)
+    {
+        const uint64_t tail = _tail.load(std::memory_order_relaxed);
+        const uint64_t head = _head.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; ++i)
+            events.push_back(_events[i % _events.size()]);
+        _tail.store(head, std::memory_order_release);
+    }
+
+    void Retire()
+    {
+        _isRetired.store(true, std::memory_order_release);
+    }
+
+    bool IsRetired() const
+    {
+        return _isRetired.load(std::memory_order_acquire);
+    }
+
+    uint32_t depth = 0;  // of the open scopes, the owner thread only
+
+private:
+    const uint32_t        _thread;
+    std::vector<Event>    _events;
+    std::atomic<uint64_t> _head      = 0;
+    std::atomic<uint64_t> _tail      = 0;
+    std::atomic<bool>     _isRetired = false;
+};
+
+Profiler::Scope::Scope(const char* name)
+    : _name(name)
+{
+    Profiler& profiler = Get();
+    if (!profiler.IsEnabled())
+        return;
+
+    ++profiler.GetThreadRing().depth;
+    _start = Now();
+}
+
+Profiler::Scope::~Scope()
+{
+    if (_start < 0)
+        return;
+
+    const int64_t end      = Now();
+    Profiler&     profiler = Get();
+    ThreadRing&   ring     = profiler.GetThreadRing();
+
+    --ring.depth;
+    if (!ring.Push({_name, _start, end, ring.GetThread(), ring.depth}))
+        profiler._droppedEventsCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+Profiler& Profiler::Get()
+{
+    static Profiler profiler(keptFramesCount, ringCapacity);
+    return profiler;
+}
+
+int64_t Profiler::Now()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+Profiler::Profiler(std::size_t keptFramesCount, std::size_t ringCapacity)
+    : _keptFramesCount(keptFramesCount)
+    , _ringCapacity(ringCapacity)
+    , _frameStart(Now())
+{
+}
+
+Profiler::ThreadRing& Profiler::GetThreadRing()
+{
+    // the ring outlives its thread, it is retired on the exit and removed once it is drained
+    struct Holder
+    {
+        std::shared_ptr<ThreadRing> ring;
+
+        ~Holder()
+        {
+            if (ring)
+                ring->Retire();
+        }
+    };
+
+    thread_local Holder holder;
+    if (!holder.ring)
+    {
+        std::lock_guard lock(_ringsMutex);
+        holder.ring = std::make_shared<ThreadRing>((uint32_t)_threadNames.size(), _ringCapacity);
+        _threadNames.push_back("Thread " + std::to_string(_threadNames.size()));
+        _rings.push_back(holder.ring);
+    }
+
+    return *holder.ring;
+}
+
+void Profiler::SetEnabled(bool isEnabled)
+{
+    _isEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled() const
+{
+    return _isEnabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const std::string& name)
+{
+    const uint32_t thread = GetThreadRing().GetThread();
+
+    std::lock_guard lock(_ringsMutex);
+    _threadNames[thread] = name;
+}
+
+void Profiler::EndFrame()
+{
+    Frame frame;
+    frame.index = _frameIndex.load(std::memory_order_relaxed);
+    frame.start = _frameStart;
+    frame.end   = Now();
+
+    {
+        std::lock_guard lock(_ringsMutex);
+        std::erase_if(_rings, [&](const std::shared_ptr<ThreadRing>& ring) {
+            // nothing is pushed after the retirement, so the drained retired ring is empty for good
+            const bool isRetired = ring->IsRetired();
+            ring->Drain(frame.events);
+            return isRetired;
+        });
+    }
+
+    _frameStart = frame.end;
+    _frameIndex.fetch_add(1, std::memory_order_relaxed);
+
+    // the events of the scopes which were open while the profiler was disabled are dropped too
+    if (!IsEnabled())
+        return;
+
+    _frames.push_back(std::move(frame));
+    while (_frames.size() > _keptFramesCount)
+        _frames.pop_front();
+}
+
+uint64_t Profiler::GetFrameIndex() const
+{
+    return _frameIndex.load(std::memory_order_relaxed);
+}
+
+void Profiler::AddGpuEvents(uint64_t frameIndex, std::span<const Event> events)
+{
+    auto frame = std::find_if(_frames.rbegin(), _frames.rend(), [&](const Frame& frame) { return frame.index == frameIndex; });
+    if (frame == _frames.rend())
+        return;
+
+    frame->events.insert(frame->events.end(), events.begin(), events.end());
+    frame->hasGpuEvents = true;
+}
+
+const std::deque<Profiler::Frame>& Profiler::GetFrames() const
+{
+    return _frames;
+}
+
+std::string Profiler::GetThreadName(uint32_t thread) const
+{
+    if (thread == gpuThread)
+        return "GPU";
+
+    std::lock_guard lock(_ringsMutex);
+    return thread < _threadNames.size() ? _threadNames[thread] : "Thread " + std::to_string(thread);
+}
+
+uint64_t Profiler::GetDroppedEventsCount() const
+{
+    return _droppedEventsCount.load(std::memory_order_relaxed);
+}
+
+std::vector<Profiler::ScopeStats> Profiler::Summarize(std::size_t framesCount) const
+{
+    framesCount = std::min(framesCount, _frames.size());
+
+    std::vector<ScopeStats>                                                stats;
+    std::map<std::tuple<uint32_t, uint32_t, std::string_view>, std::size_t> indices;
+
+    std::vector<Event>  events;
+    std::vector<double> frameMilliseconds;
+    std::size_t         gpuFramesCount = 0;
+    for (auto frame = _frames.end() - framesCount; frame != _frames.end(); ++frame)
+    {
+        gpuFramesCount += frame->hasGpuEvents ? 1 : 0;
+
+        // the parents start before their children
+        events = frame->events;
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return std::tie(a.thread, a.start, a.depth) < std::tie(b.thread, b.start, b.depth);
+        });
+
+        frameMilliseconds.assign(stats.size(), 0.0);
+        for (const Event& event : events)
+        {
+            const auto [index, isInserted] = indices.try_emplace({event.thread, event.depth, event.name}, stats.size());
+            if (isInserted)
+            {
+                stats.push_back({event.name, event.thread, event.depth});
+                frameMilliseconds.push_back(0.0);
+            }
+
+            stats[index->second].calls += 1.0;
+            frameMilliseconds[index->second] += (event.end - event.start) / 1e6;
+        }
+
+        for (std::size_t i = 0; i < stats.size(); ++i)
+        {
+            stats[i].averageMilliseconds += frameMilliseconds[i];
+            stats[i].maxMilliseconds = std::max(stats[i].maxMilliseconds, frameMilliseconds[i]);
+        }
+    }
+
+    // the last frames don't have their GPU passes yet
+    for (ScopeStats& scope : stats)
+    {
+        const std::size_t count = scope.thread == gpuThread ? gpuFramesCount : framesCount;
+        scope.calls /= count;
+        scope.averageMilliseconds /= count;
+    }
+
+    return stats;
+}
+
+void Profiler::ExportChromeTrace(const std::filesystem::path& path) const
+{
+    std::ofstream output = OpenOutput(path);
+
+    // the GPU is a process of its own, so its timeline is not mixed with the CPU threads
+    std::vector<uint32_t> threads;
+    for (const Frame& frame : _frames)
+    {
+        for (const Event& event : frame.events)
+            threads.push_back(event.thread);
+    }
+    std::sort(threads.begin(), threads.end());
+    threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+    const auto processId = [](uint32_t thread) { return thread == gpuThread ? 1 : 0; };
+    const auto threadId  = [](uint32_t thread) { return thread == gpuThread ? 0u : thread; };
+
+    output << "{\"traceEvents\":[\n";
+    output << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+    output << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+    for (uint32_t thread : threads)
+    {
+        output << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId(thread) << ",\"tid\":" << threadId(thread)
+               << ",\"args\":{\"name\":\"" << EscapeJSON(GetThreadName(thread)) << "\"}}";
+    }
+
+    output.precision(3);
+    output << std::fixed;
+    for (const Frame& frame : _frames)
+    {
+        output << ",\n{\"name\":\"Frame " << frame.index << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":" << frame.start / 1e3 << "}";
+        for (const Event& event : frame.events)
+        {
+            output << ",\n{\"name\":\"" << EscapeJSON(event.name) << "\",\"cat\":\"" << (event.thread == gpuThread ? "gpu" : "cpu")
+                   << "\",\"ph\":\"X\",\"pid\":" << processId(event.thread) << ",\"tid\":" << threadId(event.thread)
+                   << ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << (event.end - event.start) / 1e3 << "}";
+        }
+    }
+    output << "\n]}\n";
+
+    if (!output)
+        throw std::runtime_error("Profiler: can't write " + path.string());
+}
+
+void Profiler::ExportCSV(const std::filesystem::path& path) const
+{
+    std::ofstream output = OpenOutput(path);
+
+    output << "frame,thread,depth,name,start_ms,duration_ms\n";
+    output.precision(6);
+    output << std::fixed;
+    for (const Frame& frame : _frames)
+    {
+        for (const Event& event : frame.events)
+        {
+            output << frame.index << "," << EscapeCSV(GetThreadName(event.thread)) << "," << event.depth << "," << EscapeCSV(event.name) << ","
+                   << event.start / 1e6 << "," << (event.end - event.start) / 1e6 << "\n";
+        }
+    }
+
+    if (!output)
+        throw std::runtime_error("Profiler: can't write " + path.string());
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+// Hierarchical timings of the CPU scopes and of the GPU passes. Every thread records its scopes to
+// its own ring without locks, the rings are drained by EndFrame, so the recording threads never wait
+// for the main one. The last frames are kept for the UI and the export, they are accessed by the
+// main thread only (the one calling EndFrame). The GPU passes arrive a few frames later, they are
+// added to the frames they were recorded in by GpuProfiler.
+class Profiler
+{
+public:
+    // the GPU passes are a thread of their own in the frames
+    static constexpr uint32_t gpuThread = UINT32_MAX;
+
+    struct Event
+    {
+        const char* name   = nullptr;  // a literal, only the pointer is kept
+        int64_t     start  = 0;        // nanoseconds of Now()
+        int64_t     end    = 0;
+        uint32_t    thread = 0;        // the index of the recording thread or gpuThread
+        uint32_t    depth  = 0;        // of the scopes nesting on the thread
+    };
+
+    struct Frame
+    {
+        uint64_t           index        = 0;
+        int64_t            start        = 0;
+        int64_t            end          = 0;
+        std::vector<Event> events;  // in the order of their ends per thread
+        bool               hasGpuEvents = false;
+    };
+
+    // a scope of the frames, the times are per frame
+    struct ScopeStats
+    {
+        const char* name                = nullptr;
+        uint32_t    thread              = 0;
+        uint32_t    depth               = 0;
+        double      calls               = 0.0;  // on average
+        double      averageMilliseconds = 0.0;
+        double      maxMilliseconds     = 0.0;
+    };
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name);
+        ~Scope();
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* _name;
+        int64_t     _start = -1;  // the disabled profiler records nothing
+    };
+
+    static Profiler& Get();
+    // nanoseconds since the first call, the clock of all the events
+    static int64_t Now();
+
+    Profiler(const Profiler&)            = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // nothing is recorded while it is disabled, the kept frames stay
+    void SetEnabled(bool isEnabled);
+    bool IsEnabled() const;
+    // of the calling thread, it is shown in the UI and in the traces
+    void SetThreadName(const std::string& name);
+
+    // the frame being recorded becomes a kept one, it gets the scopes finished since the previous call
+    void     EndFrame();
+    uint64_t GetFrameIndex() const;
+
+    // the events of a frame which is not kept any more are dropped
+    void AddGpuEvents(uint64_t frameIndex, std::span<const Event> events);
+
+    const std::deque<Frame>& GetFrames() const;
+    std::string              GetThreadName(uint32_t thread) const;
+    // the events which didn't fit the rings, the ring of a thread holds the scopes of a frame or so
+    uint64_t GetDroppedEventsCount() const;
+
+    // of the last framesCount frames, ordered like the first frame which has them
+    std::vector<ScopeStats> Summarize(std::size_t framesCount) const;
+
+    // the trace opens in chrome://tracing and in Perfetto, the CSV has a row per event
+    void ExportChromeTrace(const std::filesystem::path& path) const;
+    void ExportCSV(const std::filesystem::path& path) const;
+
+private:
+    class ThreadRing;
+
+    Profiler(std::size_t keptFramesCount, std::size_t ringCapacity);
+
+    ThreadRing& GetThreadRing();
+
+    const std::size_t _keptFramesCount;
+    const std::size_t _ringCapacity;
+
+    std::atomic<bool>     _isEnabled          = true;
+    std::atomic<uint64_t> _frameIndex         = 0;
+    std::atomic<uint64_t> _droppedEventsCount = 0;
+    int64_t               _frameStart         = 0;
+    std::deque<Frame>     _frames;
+
+    // the rings of the exited threads are removed once they are drained
+    mutable std::mutex                       _ringsMutex;
+    std::vector<std::shared_ptr<ThreadRing>> _rings;
+    std::vector<std::string>                 _threadNames;  // by the thread index
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b)      PROFILE_CONCAT_IMPL(a, b)
+
+// times the rest of the enclosing scope, the name has to be a literal
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
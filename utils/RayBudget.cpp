@@ -0,0 +1,68 @@
+#include "RayBudget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+// the share of the last frame in the average frame time
+constexpr float averageWeight = 0.1f;
+// the relative error of the average which changes nothing
+constexpr float tolerance = 0.05f;
+// the samples change by this share of the relative error every frame, at least by a sample's share
+constexpr float gain = 0.25f;
+}  // namespace
+
+RayBudget::RayBudget(float targetMilliseconds, float maxSamples)
+    : _targetMilliseconds(targetMilliseconds)
+    , _maxSamples(maxSamples)
+    , _samples(std::min(1.0f, maxSamples))
+{
+    if (targetMilliseconds <= 0.0f || maxSamples < 0.0f)
+        throw std::runtime_error("RayBudget: the target has to be positive and the samples can't be negative");
+}
+
+void RayBudget::SetTarget(float targetMilliseconds)
+{
+    _targetMilliseconds = std::max(targetMilliseconds, 0.1f);
+}
+
+void RayBudget::SetMaxSamples(float maxSamples)
+{
+    _maxSamples = std::max(maxSamples, 0.0f);
+    _samples    = std::min(_samples, _maxSamples);
+}
+
+void RayBudget::Update(float frameMilliseconds)
+{
+    _averageMilliseconds = _averageMilliseconds > 0.0f ? _averageMilliseconds + (frameMilliseconds - _averageMilliseconds) * averageWeight
+                                                       : frameMilliseconds;
+
+    // the frames longer than twice the target (e.g. loading ones) don't make it drop faster
+    const float error = std::clamp((_targetMilliseconds - _averageMilliseconds) / _targetMilliseconds, -1.0f, 1.0f);
+    if (std::abs(error) < tolerance)
+        return;
+
+    _samples = std::clamp(_samples + gain * error * std::max(_samples, 1.0f), 0.0f, _maxSamples);
+}
+
+float RayBudget::GetTarget() const
+{
+    return _targetMilliseconds;
+}
+
+float RayBudget::GetMaxSamples() const
+{
+    return _maxSamples;
+}
+
+float RayBudget::GetSamples() const
+{
+    return _samples;
+}
+
+uint64_t RayBudget::GetRaysCount(uint32_t width, uint32_t height) const
+{
+    return (uint64_t)std::llround((double)width * height * _samples);
+}
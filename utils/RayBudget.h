@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Scales the ambient occlusion samples per pixel to hold the frame time. The samples are fractional,
+// the shaders take one more of them with the chance of the fraction, so the rays per frame change
+// smoothly. The frame time is averaged over a few frames and the frames within a tolerance of the
+// target change nothing, so the samples don't chase the noise.
+class RayBudget
+{
+public:
+    RayBudget(float targetMilliseconds, float maxSamples);
+
+    void SetTarget(float targetMilliseconds);
+    void SetMaxSamples(float maxSamples);
+
+    // the duration of a recent frame, the average hides that it may be traced with older samples
+    void Update(float frameMilliseconds);
+
+    float GetTarget() const;
+    float GetMaxSamples() const;
+    // per pixel
+    float GetSamples() const;
+    // the occlusion rays of a frame if every pixel hits a surface
+    uint64_t GetRaysCount(uint32_t width, uint32_t height) const;
+
+private:
+    float _targetMilliseconds;
+    float _maxSamples;
+    float _samples;
+    float _averageMilliseconds = 0.0f;
+};
@@ -0,0 +1,79 @@
+#include "RingAllocator.h"
+#include "Align.h"
+
+#include <cassert>
+
+RingAllocator::RingAllocator(std::size_t capacity)
+    : _capacity(capacity)
+{
+    assert(_capacity > 0);
+}
+
+std::optional<std::size_t> RingAllocator::Allocate(std::size_t size, std::size_t alignment)
+{
+    assert(alignment > 0);
+
+    if (size == 0 || size > _capacity)
+        return std::nullopt;
+
+    // the ring is empty, so the allocations may start from the beginning again
+    if (_usedSize == 0)
+        _head = 0;
+
+    std::size_t offset = Math::AlignTo(_head, alignment);
+    std::size_t consumed;
+    if (offset + size <= _capacity)
+    {
+        consumed = offset + size - _head;
+    }
+    else
+    {
+        // the tail of the ring is skipped, it is released along with the allocation
+        offset   = 0;
+        consumed = _capacity - _head + size;
+    }
+
+    if (_usedSize + consumed > _capacity)
+        return std::nullopt;
+
+    _head = offset + size;
+    _usedSize += consumed;
+    _frameSize += consumed;
+
+    return offset;
+}
+
+void RingAllocator::FinishFrame(uint64_t fenceValue)
+{
+    assert(_frames.empty() || _frames.back().fenceValue <= fenceValue);
+
+    if (_frameSize == 0)
+        return;
+
+    _frames.push_back({fenceValue, _frameSize});
+    _frameSize = 0;
+}
+
+void RingAllocator::Release(uint64_t completedValue)
+{
+    while (!_frames.empty() && _frames.front().fenceValue <= completedValue)
+    {
+        _usedSize -= _frames.front().size;
+        _frames.pop_front();
+    }
+}
+
+uint64_t RingAllocator::GetOldestFrameValue() const
+{
+    return _frames.empty() ? 0 : _frames.front().fenceValue;
+}
+
+std::size_t RingAllocator::GetCapacity() const
+{
+    return _capacity;
+}
+
+std::size_t RingAllocator::GetUsedSize() const
+{
+    return _usedSize;
+}
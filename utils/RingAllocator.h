@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+// Linear allocator over a ring of memory for the data living for a single frame, it only hands
+// out offsets. Allocations of a frame are released together once the GPU fence passes the value
+// the frame was finished with, so the ring holds the data of all the frames in flight.
+class RingAllocator
+{
+public:
+    explicit RingAllocator(std::size_t capacity);
+
+    // allocations never wrap around the end of the ring, nullopt when the frames in flight use it all
+    std::optional<std::size_t> Allocate(std::size_t size, std::size_t alignment);
+
+    // closes the allocations made since the previous call, they are released once the fence reaches the value
+    void FinishFrame(uint64_t fenceValue);
+    void Release(uint64_t completedValue);
+
+    // the fence value to be reached to release the oldest frame, 0 if all the frames are released
+    uint64_t GetOldestFrameValue() const;
+
+    std::size_t GetCapacity() const;
+    std::size_t GetUsedSize() const;
+
+private:
+    struct Frame
+    {
+        uint64_t    fenceValue = 0;
+        std::size_t size       = 0;  // including the padding and the wasted end of the ring
+    };
+
+    std::size_t _capacity  = 0;
+    std::size_t _head      = 0;  // the next allocation starts here
+    std::size_t _usedSize  = 0;
+    std::size_t _frameSize = 0;  // of the frame being recorded
+
+    std::deque<Frame> _frames;  // finished frames in flight, the oldest first
+};
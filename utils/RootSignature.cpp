@@ -45,7 +45,12 @@ void RootParameter::InitAsDescriptorsTable(UINT numRanges, D3D12_SHADER_VISIBILI
     _parameter.DescriptorTable.pDescriptorRanges = _ranges.get();
 }
 
-void RootParameter::InitTableRange(UINT rangeNumber, UINT baseRegister, UINT descriptorsCount, D3D12_DESCRIPTOR_RANGE_TYPE rangeType)
+void RootParameter::InitTableRange(UINT                        rangeNumber,
+                                   UINT                        baseRegister,
+                                   UINT                        descriptorsCount,
+                                   D3D12_DESCRIPTOR_RANGE_TYPE rangeType,
+                                   UINT                        registerSpace /*= 0*/,
+                                   UINT                        offset /*= D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND*/)
 {
     if (!_ranges || _parameter.DescriptorTable.NumDescriptorRanges <= rangeNumber)
     {
@@ -56,8 +61,8 @@ void RootParameter::InitTableRange(UINT rangeNumber, UINT baseRegister, UINT des
     _ranges[rangeNumber].RangeType = rangeType;
     _ranges[rangeNumber].BaseShaderRegister = baseRegister;
     _ranges[rangeNumber].NumDescriptors = descriptorsCount;
-    _ranges[rangeNumber].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-    _ranges[rangeNumber].RegisterSpace = 0;
+    _ranges[rangeNumber].OffsetInDescriptorsFromTableStart = offset;
+    _ranges[rangeNumber].RegisterSpace = registerSpace;
 }
 
 RootParameter::operator D3D12_ROOT_PARAMETER&()
@@ -20,7 +20,9 @@ public:
 
     void InitAsDescriptorsTable(UINT numRanges, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
 
-    void InitTableRange(UINT rangeNumber, UINT baseRegister, UINT descriptorsCount, D3D12_DESCRIPTOR_RANGE_TYPE rangeType);
+    // unbounded ranges take UINT_MAX descriptors, ranges of different spaces may share the offset
+    void InitTableRange(UINT rangeNumber, UINT baseRegister, UINT descriptorsCount, D3D12_DESCRIPTOR_RANGE_TYPE rangeType,
+                        UINT registerSpace = 0, UINT offset = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND);
 
     operator D3D12_ROOT_PARAMETER&();
     operator const D3D12_ROOT_PARAMETER&() const;
@@ -2,6 +2,7 @@
 
 #include "SceneObject.h"
 
+#include "Math.h"
 #include "Types.h"
 
 #include <shaders/Common.h>
@@ -10,31 +11,45 @@ SceneObject::SceneObject(std::shared_ptr<MeshObject> meshObject,
                          DescriptorHeap&             heap,
                          ComPtr<ID3D12Device>        device,
                          Material                    material /*= Material(MaterialType::Diffuse)*/)
+    : SceneObject(meshObject, heap, device, std::vector<Material>(meshObject->GeometriesCount(), material))
+{
+}
+
+SceneObject::SceneObject(std::shared_ptr<MeshObject> meshObject,
+                         DescriptorHeap&             heap,
+                         ComPtr<ID3D12Device>        device,
+                         std::vector<Material>       materials)
     : _meshObject(meshObject)
     , _device(device)
-    , _material(material)
+    , _materials(std::move(materials))
 {
     assert(device);
     assert(meshObject);
+    assert(_materials.size() == meshObject->GeometriesCount());
 
     CreateBufferSRVs(heap);
-    CreateCBV();
     CalculateWorldMatrix();
 }
 
 void SceneObject::Draw(const ComPtr<ID3D12GraphicsCommandList>& pCmdList)
 {
     pCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    pCmdList->IASetVertexBuffers(0, 1, &_meshObject->VertexBufferView());
 
-    if (_meshObject->IndexBuffer())
-    {
-        pCmdList->IASetIndexBuffer(&_meshObject->IndexBufferView());
-        pCmdList->DrawIndexedInstanced((UINT)_meshObject->IndicesCount(), 1, 0, 0, 0);
-    }
-    else
+    for (std::size_t geometry = 0; geometry < _meshObject->GeometriesCount(); ++geometry)
     {
-        pCmdList->DrawInstanced((UINT)_meshObject->VerticesCount(), 1, 0, 0);
+        const D3D12_VERTEX_BUFFER_VIEW vertexBufferView = _meshObject->VertexBufferView(geometry);
+        pCmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+
+        if (_meshObject->IndexBuffer(geometry))
+        {
+            const D3D12_INDEX_BUFFER_VIEW indexBufferView = _meshObject->IndexBufferView(geometry);
+            pCmdList->IASetIndexBuffer(&indexBufferView);
+            pCmdList->DrawIndexedInstanced((UINT)_meshObject->IndicesCount(geometry), 1, 0, 0, 0);
+        }
+        else
+        {
+            pCmdList->DrawInstanced((UINT)_meshObject->VerticesCount(geometry), 1, 0, 0);
+        }
     }
 }
 
@@ -58,14 +73,62 @@ const MeshObject& SceneObject::GetMeshObject() const
     return *_meshObject;
 }
 
-Material& SceneObject::GetMaterial()
+Material& SceneObject::GetMaterial(std::size_t geometry /*= 0*/)
 {
-    return _material;
+    return _materials[geometry];
 }
 
-std::size_t SceneObject::GetDescriptorIdx() const
+std::size_t SceneObject::GetGeometriesCount() const
 {
-    return _descriptorIdx;
+    return _materials.size();
+}
+
+std::size_t SceneObject::GetDescriptorIdx(std::size_t geometry /*= 0*/) const
+{
+    return _descriptorIdxs[geometry];
+}
+
+GeometryParams SceneObject::GetGeometryParams(std::size_t geometry /*= 0*/) const
+{
+    GeometryParams params = {};
+    params.vertexBuffer   = (uint)_descriptorIdxs[geometry];
+    params.indexBuffer    = (uint)_descriptorIdxs[geometry] + 1;
+    params.indexSize      = (uint)_meshObject->IndexSize(geometry);
+
+    const Material& material = _materials[geometry];
+    if (material.GetType() == MaterialType::Specular)
+    {
+        params.material.reflectance = std::get<SpecularMaterial>(material.GetParams()).reflectance;
+    }
+    else if (material.GetType() == MaterialType::Water)
+    {
+        // this is not actually a reflectance, but our material system does not allow to use a separate buffer yet
+        params.material.reflectance = std::get<WaterMaterial>(material.GetParams()).n;
+    }
+
+    return params;
+}
+
+void SceneObject::SetTablesOffsets(std::size_t geometryOffset, std::size_t hitGroupOffset)
+{
+    _geometryOffset = geometryOffset;
+    _hitGroupOffset = hitGroupOffset;
+}
+
+std::size_t SceneObject::GetGeometryOffset() const
+{
+    return _geometryOffset;
+}
+
+std::size_t SceneObject::GetHitGroupOffset() const
+{
+    return _hitGroupOffset;
+}
+
+uint32_t SceneObject::GetInstanceMask() const
+{
+    const bool isWater = std::ranges::all_of(_materials, [](const Material& material) { return material.GetType() == MaterialType::Water; });
+    return isWater ? INSTANCE_MASK_WATER : INSTANCE_MASK_OPAQUE;
 }
 
 DirectX::XMFLOAT3 SceneObject::Position() const
@@ -104,53 +167,39 @@ void SceneObject::Rotation(float val)
     CalculateWorldMatrix();
 }
 
-ComPtr<ID3D12Resource> SceneObject::GetConstantBuffer() const
-{
-    return _constantBuffer;
-}
-
 void SceneObject::CreateBufferSRVs(DescriptorHeap& heap)
 {
-    D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
-    // common properties
-    viewDesc.ViewDimension           = D3D12_SRV_DIMENSION_BUFFER;
-    viewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    viewDesc.Buffer.FirstElement     = 0;
-
-    // vertex buffer SRV
-    viewDesc.Format                     = DXGI_FORMAT_UNKNOWN;
-    viewDesc.Buffer.Flags               = D3D12_BUFFER_SRV_FLAG_NONE;
-    viewDesc.Buffer.StructureByteStride = sizeof(GeometryVertex);
-    viewDesc.Buffer.NumElements         = _meshObject->VerticesCount();
-
-    auto freeAddress = heap.GetFreeCPUAddress();
-    _descriptorIdx   = freeAddress.index;
-    _device->CreateShaderResourceView(_meshObject->VertexBuffer().Get(), &viewDesc, freeAddress.handle);
-
-    // index buffer SRV
-    viewDesc.Format                     = DXGI_FORMAT_R32_TYPELESS;
-    viewDesc.Buffer.Flags               = D3D12_BUFFER_SRV_FLAG_RAW;
-    viewDesc.Buffer.StructureByteStride = 0;
-    viewDesc.Buffer.NumElements         = _meshObject->IndicesCount();
-
-    freeAddress = heap.GetFreeCPUAddress();
-    _device->CreateShaderResourceView(_meshObject->IndexBuffer().Get(), &viewDesc, freeAddress.handle);
-}
-
-void SceneObject::CreateCBV()
-{
-    D3D12_RESOURCE_DESC constantBufferDesc = {};
-    constantBufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
-    constantBufferDesc.Width               = sizeof(ModelParams);
-    constantBufferDesc.Height              = 1;
-    constantBufferDesc.MipLevels           = 1;
-    constantBufferDesc.SampleDesc.Count    = 1;
-    constantBufferDesc.DepthOrArraySize    = 1;
-    constantBufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-    D3D12_HEAP_PROPERTIES heapProp = {D3D12_HEAP_TYPE_UPLOAD};
-    _device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &constantBufferDesc,
-                                     D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_constantBuffer));
+    for (std::size_t geometry = 0; geometry < _meshObject->GeometriesCount(); ++geometry)
+    {
+        D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+        // common properties
+        viewDesc.ViewDimension           = D3D12_SRV_DIMENSION_BUFFER;
+        viewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+        // vertex buffer SRV, batched meshes are placed in a shared buffer
+        viewDesc.Format                     = DXGI_FORMAT_UNKNOWN;
+        viewDesc.Buffer.FirstElement        = _meshObject->VertexBufferOffset(geometry) / sizeof(GeometryVertex);
+        viewDesc.Buffer.Flags               = D3D12_BUFFER_SRV_FLAG_NONE;
+        viewDesc.Buffer.StructureByteStride = sizeof(GeometryVertex);
+        viewDesc.Buffer.NumElements         = _meshObject->VerticesCount(geometry);
+
+        // the views are bound as a single table, so the pair has to be contiguous
+        auto freeAddress = heap.GetFreeCPUAddress(2);
+        _descriptorIdxs.push_back(freeAddress.index);
+        _device->CreateShaderResourceView(_meshObject->VertexBuffer().Get(), &viewDesc, freeAddress.handle);
+
+        // index buffer SRV, raw views count elements in 32-bit words regardless of the index format
+        const std::size_t indicesSize = _meshObject->IndicesCount(geometry) * _meshObject->IndexSize(geometry);
+
+        viewDesc.Format                     = DXGI_FORMAT_R32_TYPELESS;
+        viewDesc.Buffer.Flags               = D3D12_BUFFER_SRV_FLAG_RAW;
+        viewDesc.Buffer.StructureByteStride = 0;
+        viewDesc.Buffer.FirstElement        = _meshObject->IndexBufferOffset(geometry) / sizeof(uint32_t);
+        viewDesc.Buffer.NumElements         = (UINT)(Math::AlignTo(indicesSize, sizeof(uint32_t)) / sizeof(uint32_t));
+
+        _device->CreateShaderResourceView(_meshObject->IndexBuffer(geometry).Get(), &viewDesc,
+                                          heap.GetCPUAddress(freeAddress.index + 1));
+    }
 }
 
 void SceneObject::CalculateWorldMatrix()
@@ -163,30 +212,4 @@ void SceneObject::CalculateWorldMatrix()
     // TODO(DB): it is not needed here, transposing is only required for TLAS building
     // remove it and make transposing in TLAS building only, it reduces performance
     _worldMatrix = XMMatrixTranspose(_worldMatrix);
-
-    ModelParams params;
-    params.worldMatrix = _worldMatrix;
-
-    if (_material.GetType() == MaterialType::Specular)
-    {
-        SpecularMaterial mtl   = std::get<SpecularMaterial>(_material.GetParams());
-        auto             color = mtl.color;
-        params.reflectance     = mtl.reflectance;
-    }
-    else if (_material.GetType() == MaterialType::Diffuse)
-    {
-        // no params yet
-    }
-    else if (_material.GetType() == MaterialType::Water)
-    {
-        WaterMaterial mtl = std::get<WaterMaterial>(_material.GetParams());
-
-        // this is not actually a reflectance, but our material system does not allow to use a separate buffer yet
-        params.reflectance = mtl.n;
-    }
-
-    ModelParams* bufPtr = nullptr;
-    ThrowIfFailed(_constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&bufPtr)));
-    memcpy(bufPtr, &params, sizeof(ModelParams));
-    _constantBuffer->Unmap(0, nullptr);
 }
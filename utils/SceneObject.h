@@ -5,6 +5,8 @@
 #include <utils/DescriptorHeap.h>
 #include <utils/MeshManager.h>
 
+#include <shaders/Common.h>
+
 #include <variant>
 
 enum class MaterialType
@@ -59,6 +61,11 @@ public:
         return _params;
     }
 
+    const auto& GetParams() const
+    {
+        return _params;
+    }
+
     MaterialType GetType() const
     {
         return _type;
@@ -77,6 +84,12 @@ public:
                 ComPtr<ID3D12Device>        pDevice,
                 Material                    material = Material(MaterialType::Diffuse));
 
+    // merged meshes have a material per geometry, hit groups are selected per geometry
+    SceneObject(std::shared_ptr<MeshObject> meshObject,
+                DescriptorHeap&             heap,
+                ComPtr<ID3D12Device>        pDevice,
+                std::vector<Material>       materials);
+
     void Draw(const ComPtr<ID3D12GraphicsCommandList>& pCmdList);
 
     DirectX::XMFLOAT3 Position() const;
@@ -88,19 +101,27 @@ public:
     float Rotation() const;
     void  Rotation(float val);
 
-    ComPtr<ID3D12Resource> GetConstantBuffer() const;
-    const XMMATRIX&        GetWorldMatrix() const;
-    const MeshObject&      GetMeshObject() const;
-    Material&              GetMaterial();
+    const XMMATRIX&   GetWorldMatrix() const;
+    const MeshObject& GetMeshObject() const;
+    Material&         GetMaterial(std::size_t geometry = 0);
+    // what the hit shaders read for the geometry through the geometries table
+    GeometryParams GetGeometryParams(std::size_t geometry = 0) const;
 
     bool IsDirty() const;
     void ResetDirty();
 
-    std::size_t GetDescriptorIdx() const;
+    std::size_t GetGeometriesCount() const;
+    std::size_t GetDescriptorIdx(std::size_t geometry = 0) const;
+
+    // assigned by the scene, the first entries of the object in the geometries and hit group tables
+    void        SetTablesOffsets(std::size_t geometryOffset, std::size_t hitGroupOffset);
+    std::size_t GetGeometryOffset() const;
+    std::size_t GetHitGroupOffset() const;
+    // the InstanceMask of its TLAS instances, the objects made of water only don't occlude the light
+    uint32_t GetInstanceMask() const;
 
 private:
     void CreateBufferSRVs(DescriptorHeap& heap);
-    void CreateCBV();
     void CalculateWorldMatrix();
 
     std::shared_ptr<MeshObject> _meshObject = nullptr;
@@ -109,13 +130,14 @@ private:
     XMFLOAT3 _scale    = {1.0f, 1.0f, 1.0f};
     float    _rotation = 0.0f;
 
-    XMMATRIX _worldMatrix = XMMatrixIdentity();
-    Material _material;
+    XMMATRIX              _worldMatrix = XMMatrixIdentity();
+    std::vector<Material> _materials;  // per geometry
 
-    ComPtr<ID3D12Resource> _constantBuffer = nullptr;
-    ComPtr<ID3D12Resource> _blas           = nullptr;
-    ComPtr<ID3D12Device>   _device         = nullptr;
+    ComPtr<ID3D12Resource> _blas   = nullptr;
+    ComPtr<ID3D12Device>   _device = nullptr;
 
-    bool        _transformDirty = true;
-    std::size_t _descriptorIdx;
+    bool                     _transformDirty = true;
+    std::vector<std::size_t> _descriptorIdxs;  // VB/IB views pair per geometry
+    std::size_t              _geometryOffset = 0;
+    std::size_t              _hitGroupOffset = 0;
 };
@@ -6,54 +6,78 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
-ShaderTable::ShaderTable(std::size_t entriesCount, std::size_t dataSize, ComPtr<ID3D12Device> device)
-    : _entriesCount(entriesCount)
+ShaderTable::ShaderTable(std::size_t dataSize, std::size_t framesCount, ComPtr<ID3D12Device> device)
+    : _frameBuffers(framesCount)
+    , _device(device)
 {
     // dataSize may be null if no local data is used
-    assert(entriesCount > 0);
+    assert(framesCount > 0);
 
-    _stride                         = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + dataSize;
-    _stride                         = Math::AlignTo(_stride, 32);
-    D3D12_HEAP_PROPERTIES heapProps = {D3D12_HEAP_TYPE_UPLOAD};
+    _stride = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + dataSize;
+    _stride = Math::AlignTo(_stride, 32);
+}
 
-    D3D12_RESOURCE_DESC bufferDesc = {};
-    bufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
-    bufferDesc.Width               = _entriesCount * _stride;
-    bufferDesc.Height              = 1;
-    bufferDesc.MipLevels           = 1;
-    bufferDesc.SampleDesc.Count    = 1;
-    bufferDesc.DepthOrArraySize    = 1;
-    bufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+std::size_t ShaderTable::AddEntry(ShaderEntry entry)
+{
+    if (_freeRecords.empty())
+        return AddEntries({&entry, 1});
+
+    const std::size_t idx = _freeRecords.back();
+    _freeRecords.pop_back();
 
-    ThrowIfFailed(device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
-                                                  D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_buffer)));
+    WriteEntry(idx, entry);
+    return idx;
 }
 
-void ShaderTable::AddEntry(std::size_t idx, ShaderEntry entry)
+std::size_t ShaderTable::AddEntries(std::span<const ShaderEntry> entries)
 {
-    assert(idx < _entriesCount);
-    assert(entry.shaderIdentifier);
+    const std::size_t firstIdx = _entriesCount;
 
-    // check if we do not overrun allocated memory
-    assert(idx * _stride <= GetSize());
+    _entriesCount += entries.size();
+    _records.resize(_entriesCount * _stride);
 
-    void* data = nullptr;
-    _buffer->Map(0, nullptr, reinterpret_cast<void**>(&data));
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        WriteEntry(firstIdx + i, entries[i]);
 
-    uint8_t* ptr = reinterpret_cast<uint8_t*>(data);
-    ptr += _stride * idx;
+    return firstIdx;
+}
 
-    std::memcpy(ptr, entry.shaderIdentifier, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-    ptr += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+void ShaderTable::UpdateEntry(std::size_t idx, ShaderEntry entry)
+{
+    assert(idx < _entriesCount);
+    WriteEntry(idx, entry);
+}
 
-    std::memcpy(ptr, entry.data, entry.dataSize);
+void ShaderTable::RemoveEntry(std::size_t idx)
+{
+    assert(idx < _entriesCount);
 
-    _buffer->Unmap(0, nullptr);
+    std::memset(_records.data() + _stride * idx, 0, _stride);
+    for (FrameBuffer& buffer : _frameBuffers)
+        buffer.pendingRecords.push_back(idx);
+
+    _freeRecords.push_back(idx);
 }
 
-ComPtr<ID3D12Resource> ShaderTable::GetResource() const
+D3D12_GPU_VIRTUAL_ADDRESS ShaderTable::Commit(std::size_t frameIndex)
 {
-    return _buffer;
+    FrameBuffer& buffer = _frameBuffers[frameIndex];
+    if (_entriesCount == 0)
+        return 0;
+
+    // the previous buffer of the frame is not read by the GPU any more, the new one receives all the records
+    if (buffer.capacity < _entriesCount)
+    {
+        CreateBuffer(buffer, std::max(_entriesCount, buffer.capacity * 2));
+        std::memcpy(buffer.data, _records.data(), _entriesCount * _stride);
+        buffer.pendingRecords.clear();
+    }
+
+    for (std::size_t idx : buffer.pendingRecords)
+        std::memcpy(buffer.data + _stride * idx, _records.data() + _stride * idx, _stride);
+    buffer.pendingRecords.clear();
+
+    return buffer.resource->GetGPUVirtualAddress();
 }
 
 std::size_t ShaderTable::GetStride() const
@@ -65,3 +89,41 @@ std::size_t ShaderTable::GetSize() const
 {
     return _entriesCount * _stride;
 }
+
+void ShaderTable::WriteEntry(std::size_t idx, ShaderEntry entry)
+{
+    assert(entry.shaderIdentifier);
+    assert(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + entry.dataSize <= _stride);
+
+    uint8_t* ptr = _records.data() + _stride * idx;
+    std::memcpy(ptr, entry.shaderIdentifier, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+    ptr += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+
+    if (entry.dataSize)
+        std::memcpy(ptr, entry.data, entry.dataSize);
+
+    for (FrameBuffer& buffer : _frameBuffers)
+        buffer.pendingRecords.push_back(idx);
+}
+
+void ShaderTable::CreateBuffer(FrameBuffer& buffer, std::size_t capacity)
+{
+    D3D12_HEAP_PROPERTIES heapProps = {D3D12_HEAP_TYPE_UPLOAD};
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width               = capacity * _stride;
+    bufferDesc.Height              = 1;
+    bufferDesc.MipLevels           = 1;
+    bufferDesc.SampleDesc.Count    = 1;
+    bufferDesc.DepthOrArraySize    = 1;
+    bufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    ThrowIfFailed(_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                   D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                                                   IID_PPV_ARGS(&buffer.resource)));
+
+    // upload heaps may stay mapped for the whole lifetime of the resource
+    ThrowIfFailed(buffer.resource->Map(0, nullptr, reinterpret_cast<void**>(&buffer.data)));
+    buffer.capacity = capacity;
+}
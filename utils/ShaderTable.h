@@ -2,6 +2,8 @@
 
 #include "stdafx.h"
 
+#include <span>
+
 struct ShaderEntry
 {
     void*       shaderIdentifier = nullptr;
@@ -9,20 +11,46 @@ struct ShaderEntry
     std::size_t dataSize         = 0;
 };
 
+// Records are written to a CPU copy of the table, every frame in flight has its own persistently
+// mapped buffer which receives only the records changed since the frame used it last time. The GPU
+// never reads a buffer being written, so records may be changed at any time.
 class ShaderTable
 {
 public:
-    ShaderTable(std::size_t entriesCount, std::size_t dataSize, ComPtr<ID3D12Device> device);
+    ShaderTable(std::size_t dataSize, std::size_t framesCount, ComPtr<ID3D12Device> device);
+
+    // returns the index of the record, removed records are reused
+    std::size_t AddEntry(ShaderEntry entry);
+    // the records are contiguous, returns the index of the first one
+    std::size_t AddEntries(std::span<const ShaderEntry> entries);
+    void        UpdateEntry(std::size_t idx, ShaderEntry entry);
+    // the record becomes a null one, rays hitting it run no shaders
+    void        RemoveEntry(std::size_t idx);
 
-    void AddEntry(std::size_t idx, ShaderEntry entry);
+    // copies the changed records to the buffer of the frame and returns its address
+    D3D12_GPU_VIRTUAL_ADDRESS Commit(std::size_t frameIndex);
 
-    ComPtr<ID3D12Resource> GetResource() const;
-    std::size_t            GetStride() const;
-    std::size_t            GetSize() const;
+    std::size_t GetStride() const;
+    std::size_t GetSize() const;
 
 private:
+    struct FrameBuffer
+    {
+        ComPtr<ID3D12Resource>   resource = nullptr;
+        uint8_t*                 data     = nullptr;
+        std::size_t              capacity = 0;  // in records
+        std::vector<std::size_t> pendingRecords;
+    };
+
+    void WriteEntry(std::size_t idx, ShaderEntry entry);
+    void CreateBuffer(FrameBuffer& buffer, std::size_t capacity);
+
     std::size_t _stride       = 0;
     std::size_t _entriesCount = 0;
 
-    ComPtr<ID3D12Resource> _buffer;
+    std::vector<uint8_t>     _records;  // CPU copy of all the records
+    std::vector<std::size_t> _freeRecords;
+    std::vector<FrameBuffer> _frameBuffers;
+
+    ComPtr<ID3D12Device> _device;
 };
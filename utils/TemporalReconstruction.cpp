@@ -0,0 +1,153 @@
+#include "TemporalReconstruction.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+
+namespace
+{
+using namespace DirectX;
+
+// the camera rays reaching it hit nothing
+constexpr float skyDistance = 3000.0f;
+// the history is of the same surface if it is this close to its plane relative to the distance,
+// the interpolated normals differ a lot between the neighbours, so only the turned ones are rejected
+constexpr float maxPlaneDistance = 0.02f;
+constexpr float minNormalsDot    = 0.5f;
+
+// the nearest pixel of the previous frame, its weight falls to 0 at its borders
+struct HistorySample
+{
+    std::size_t index;
+    float       weight;
+};
+
+XMVECTOR CameraDirection(const ReconstructionParams& params, uint32_t x, uint32_t y, const XMMATRIX& inverseViewProj, FXMVECTOR viewPos)
+{
+    const float screenX = (x + 0.5f) / params.width * 2.0f - 1.0f;
+    const float screenY = -((y + 0.5f) / params.height * 2.0f - 1.0f);
+
+    XMVECTOR world = XMVector4Transform(XMVectorSet(screenX, screenY, 0.0f, 1.0f), inverseViewProj);
+    world          = XMVectorDivide(world, XMVectorSplatW(world));
+    return XMVector3Normalize(XMVectorSubtract(world, viewPos));
+}
+
+// the neighbours past the borders are mirrored, so they are traced ones too
+uint32_t Mirror(int coordinate, int size)
+{
+    if (coordinate < 0)
+        coordinate = -coordinate;
+    if (coordinate >= size)
+        coordinate = 2 * size - 2 - coordinate;
+    return (uint32_t)std::clamp(coordinate, 0, size - 1);
+}
+
+// Searches the previous frame for the surface of the normal and the distance along the ray of the
+// pixel, nothing if the pixel it is reprojected to sees another one.
+std::optional<HistorySample> Reproject(const ReconstructionParams& params, std::span<const XMFLOAT4> historyGbuffer, uint32_t x, uint32_t y, const XMFLOAT4& surface)
+{
+    const XMVECTOR position = XMVectorMultiplyAdd(CameraDirection(params, x, y, params.inverseViewProj, params.viewPos), XMVectorReplicate(surface.w), params.viewPos);
+
+    XMFLOAT4 previous;
+    XMStoreFloat4(&previous, XMVector4Transform(XMVectorSetW(position, 1.0f), params.previousViewProj));
+    const float previousX = (previous.x / previous.w * 0.5f + 0.5f) * params.width;
+    const float previousY = (-previous.y / previous.w * 0.5f + 0.5f) * params.height;
+    if (!(previous.w > 0.0f && previousX >= 0.0f && previousY >= 0.0f && previousX < params.width && previousY < params.height))
+        return std::nullopt;
+
+    const uint32_t      historyX        = (uint32_t)previousX;
+    const uint32_t      historyY        = (uint32_t)previousY;
+    const HistorySample sample          = {(std::size_t)historyY * params.width + historyX,
+                                           (1.0f - 2.0f * std::abs(previousX - historyX - 0.5f)) * (1.0f - 2.0f * std::abs(previousY - historyY - 0.5f))};
+    const XMFLOAT4&     previousGbuffer = historyGbuffer[sample.index];
+
+    // the sky is only replaced by the sky, the surfaces by the same surfaces
+    if (surface.w >= skyDistance || previousGbuffer.w >= skyDistance)
+        return surface.w >= skyDistance && previousGbuffer.w >= skyDistance ? std::optional(sample) : std::nullopt;
+
+    const XMVECTOR previousDirection = CameraDirection(params, historyX, historyY, params.previousInverseViewProj, params.previousViewPos);
+    const XMVECTOR previousPosition  = XMVectorMultiplyAdd(previousDirection, XMVectorReplicate(previousGbuffer.w), params.previousViewPos);
+    const XMVECTOR previousNormal    = XMVectorSet(previousGbuffer.x, previousGbuffer.y, previousGbuffer.z, 0.0f);
+    const XMVECTOR normal            = XMVectorSet(surface.x, surface.y, surface.z, 0.0f);
+
+    const float planeDistance = std::abs(XMVectorGetX(XMVector3Dot(XMVectorSubtract(position, previousPosition), previousNormal)));
+    if (planeDistance >= maxPlaneDistance * surface.w || XMVectorGetX(XMVector3Dot(normal, previousNormal)) <= minNormalsDot)
+        return std::nullopt;
+
+    return sample;
+}
+}  // namespace
+
+namespace TemporalReconstruction
+{
+void Reconstruct(const ReconstructionParams& params,
+                 std::span<XMFLOAT4>         color,
+                 std::span<XMFLOAT4>         gbuffer,
+                 std::span<const XMFLOAT4>   history,
+                 std::span<const XMFLOAT4>   historyGbuffer)
+{
+    PROFILE_SCOPE("TemporalReconstruction::Reconstruct");
+
+    const std::size_t pixelsCount = (std::size_t)params.width * params.height;
+    if (color.size() < pixelsCount || gbuffer.size() < pixelsCount)
+        throw std::runtime_error("TemporalReconstruction: the images are smaller than the params");
+    if (params.historyValid && (history.size() < pixelsCount || historyGbuffer.size() < pixelsCount))
+        throw std::runtime_error("TemporalReconstruction: the history is smaller than the params");
+
+    const int  width  = (int)params.width;
+    const int  height = (int)params.height;
+    const auto index  = [&](uint32_t x, uint32_t y) { return (std::size_t)y * params.width + x; };
+
+    // the untraced pixels read the traced ones only, so they are filled in place
+    for (uint32_t y = 0; y < params.height; ++y)
+    {
+        for (uint32_t x = (y + params.frameIndex + 1) & 1; x < params.width; x += 2)
+        {
+            const std::size_t left  = index(Mirror((int)x - 1, width), y);
+            const std::size_t right = index(Mirror((int)x + 1, width), y);
+            const std::size_t up    = index(x, Mirror((int)y - 1, height));
+            const std::size_t down  = index(x, Mirror((int)y + 1, height));
+
+            // the pair with the closer distances doesn't cross an edge
+            const bool        isHorizontal = std::abs(gbuffer[left].w - gbuffer[right].w) <= std::abs(gbuffer[up].w - gbuffer[down].w);
+            const std::size_t first        = isHorizontal ? left : up;
+            const std::size_t second       = isHorizontal ? right : down;
+
+            XMVECTOR normal = XMVectorSetW(XMVectorAdd(XMLoadFloat4(&gbuffer[first]), XMLoadFloat4(&gbuffer[second])), 0.0f);
+            if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+                normal = XMVector3Normalize(normal);
+
+            XMFLOAT4 surface;
+            XMStoreFloat4(&surface, XMVectorSetW(normal, (gbuffer[first].w + gbuffer[second].w) * 0.5f));
+            XMVECTOR pixelColor = XMVectorScale(XMVectorAdd(XMLoadFloat4(&color[first]), XMLoadFloat4(&color[second])), 0.5f);
+
+            // the interpolated surface is wrong at the edges, the pixel likely sees the one of a neighbour there
+            const XMFLOAT4 candidates[5] = {surface, gbuffer[left], gbuffer[right], gbuffer[up], gbuffer[down]};
+            for (std::size_t candidate = 0; params.historyValid && candidate < std::size(candidates); ++candidate)
+            {
+                const std::optional<HistorySample> sample = Reproject(params, historyGbuffer, x, y, candidates[candidate]);
+                if (!sample)
+                    continue;
+
+                // the history can't be out of the range of the neighbours, so the misses don't ghost
+                const XMVECTOR minColor = XMVectorMin(XMVectorMin(XMLoadFloat4(&color[left]), XMLoadFloat4(&color[right])),
+                                                      XMVectorMin(XMLoadFloat4(&color[up]), XMLoadFloat4(&color[down])));
+                const XMVECTOR maxColor = XMVectorMax(XMVectorMax(XMLoadFloat4(&color[left]), XMLoadFloat4(&color[right])),
+                                                      XMVectorMax(XMLoadFloat4(&color[up]), XMLoadFloat4(&color[down])));
+                const XMVECTOR previous = XMVectorClamp(XMLoadFloat4(&history[sample->index]), minColor, maxColor);
+                pixelColor              = XMVectorLerp(pixelColor, previous, sample->weight);
+
+                // the history distance is of the previous camera
+                const XMFLOAT4& previousGbuffer = historyGbuffer[sample->index];
+                surface                         = {previousGbuffer.x, previousGbuffer.y, previousGbuffer.z, candidates[candidate].w};
+                break;
+            }
+
+            XMStoreFloat4(&color[index(x, y)], XMVectorSetW(pixelColor, 1.0f));
+            gbuffer[index(x, y)] = surface;
+        }
+    }
+}
+}  // namespace TemporalReconstruction
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <shaders/Common.h>
+
+#include <span>
+
+// The CPU counterpart of Reconstruction.hlsl, it fills the pixels a checkerboard frame didn't trace
+// from the previous frame or from the traced neighbours. The images are row-major, of the width and
+// the height of the params, the gbuffers hold the normals and the hit distances of the camera rays.
+namespace TemporalReconstruction
+{
+// the traced pixels are those with even x + y + frameIndex, the color and the gbuffer are completed in place
+void Reconstruct(const ReconstructionParams&        params,
+                 std::span<DirectX::XMFLOAT4>       color,
+                 std::span<DirectX::XMFLOAT4>       gbuffer,
+                 std::span<const DirectX::XMFLOAT4> history,
+                 std::span<const DirectX::XMFLOAT4> historyGbuffer);
+}  // namespace TemporalReconstruction
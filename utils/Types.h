@@ -1,8 +1,6 @@
 #pragma once
 
-enum optTypes
-{
-};
+#include <cstdint>
 
 enum class ShaderType
 {
@@ -22,4 +20,6 @@ struct screenQuadVertex
 
 struct CommandLineOptions
 {
+    bool     island          = false;  // the generated island instead of the test scene
+    uint32_t maxFrameLatency = 2;      // frames recorded ahead of the GPU
 };
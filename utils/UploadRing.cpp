@@ -0,0 +1,68 @@
+#include "stdafx.h"
+
+#include "UploadRing.h"
+
+#include "DXSampleHelper.h"
+
+UploadRing::UploadRing(ComPtr<ID3D12Device> device, ComPtr<ID3D12Fence> frameFence, std::size_t size)
+    : _frameFence(frameFence)
+    , _allocator(size)
+{
+    assert(device);
+    assert(frameFence);
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension           = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width               = size;
+    bufferDesc.Height              = 1;
+    bufferDesc.MipLevels           = 1;
+    bufferDesc.SampleDesc.Count    = 1;
+    bufferDesc.DepthOrArraySize    = 1;
+    bufferDesc.Layout              = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    D3D12_HEAP_PROPERTIES heapProp = {D3D12_HEAP_TYPE_UPLOAD};
+    ThrowIfFailed(device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                  D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_buffer)));
+    _buffer->SetName(L"Upload ring");
+
+    // upload heaps may stay mapped for the whole lifetime of the resource
+    ThrowIfFailed(_buffer->Map(0, nullptr, reinterpret_cast<void**>(&_cpuAddress)));
+
+    _event = CreateEvent(NULL, FALSE, FALSE, nullptr);
+    assert(_event);
+}
+
+UploadRing::~UploadRing()
+{
+    CloseHandle(_event);
+}
+
+UploadRing::Allocation UploadRing::Allocate(std::size_t size, std::size_t alignment /*= D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT*/)
+{
+    std::optional<std::size_t> offset = _allocator.Allocate(size, alignment);
+
+    // the frames in flight use the whole ring, the oldest of them is waited for
+    while (!offset && _allocator.GetOldestFrameValue() != 0)
+    {
+        const uint64_t oldestValue = _allocator.GetOldestFrameValue();
+        if (_frameFence->GetCompletedValue() < oldestValue)
+        {
+            ThrowIfFailed(_frameFence->SetEventOnCompletion(oldestValue, _event));
+            WaitForSingleObject(_event, INFINITE);
+        }
+
+        _allocator.Release(oldestValue);
+        offset = _allocator.Allocate(size, alignment);
+    }
+
+    if (!offset)
+        throw std::runtime_error("Upload ring is too small for a single frame");
+
+    return {_buffer->GetGPUVirtualAddress() + *offset, _cpuAddress + *offset};
+}
+
+void UploadRing::FinishFrame(uint64_t fenceValue)
+{
+    _allocator.FinishFrame(fenceValue);
+    _allocator.Release(_frameFence->GetCompletedValue());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "RingAllocator.h"
+
+// Persistently mapped upload buffer for the data written every frame (constants), the memory of
+// a frame is reused once the frame fence shows the GPU is done with it. Nothing is mapped or
+// created per object, so CPU may record the next frames while the GPU reads the previous ones.
+class UploadRing
+{
+public:
+    struct Allocation
+    {
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+        uint8_t*                  cpuAddress = nullptr;
+    };
+
+    // the size has to cover all the frames in flight, otherwise allocations wait for the GPU
+    UploadRing(ComPtr<ID3D12Device> device, ComPtr<ID3D12Fence> frameFence, std::size_t size);
+    ~UploadRing();
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    Allocation Allocate(std::size_t size, std::size_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+    template <typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS Push(const T& data)
+    {
+        const Allocation allocation = Allocate(sizeof(T));
+        memcpy(allocation.cpuAddress, &data, sizeof(T));
+        return allocation.gpuAddress;
+    }
+
+    // to be called once the frame fence signal is queued, the value is the signalled one
+    void FinishFrame(uint64_t fenceValue);
+
+private:
+    ComPtr<ID3D12Resource> _buffer     = nullptr;
+    uint8_t*               _cpuAddress = nullptr;
+    ComPtr<ID3D12Fence>    _frameFence = nullptr;
+    HANDLE                 _event      = nullptr;
+    RingAllocator          _allocator;
+};
@@ -13,6 +13,11 @@ WASDCamera::WASDCamera(float nearPlane, float farPlane, float fov, float screenW
     UpdateRotation();
 }
 
+void WASDCamera::SetCollider(Collider collider)
+{
+    _collider = std::move(collider);
+}
+
 void WASDCamera::SetPosition(XMFLOAT3 position)
 {
     AbstractCamera::SetTriada(position, AbstractCamera::GetLookAt(), AbstractCamera::GetUp());
@@ -29,7 +34,7 @@ void WASDCamera::MoveForward(float delta)
     auto movedPos = XMVectorAdd(XMLoadFloat3(&lookAt), XMLoadFloat3(&pos));
     XMStoreFloat3(&pos, movedPos);
 
-    AbstractCamera::SetTriada(pos, AbstractCamera::GetLookAt(), AbstractCamera::GetUp());
+    MoveTo(pos);
 }
 
 void WASDCamera::MoveUpward(float delta)
@@ -43,7 +48,7 @@ void WASDCamera::MoveUpward(float delta)
     auto movedPos = XMVectorAdd(XMLoadFloat3(&up), XMLoadFloat3(&pos));
     XMStoreFloat3(&pos, movedPos);
 
-    AbstractCamera::SetTriada(pos, AbstractCamera::GetLookAt(), AbstractCamera::GetUp());
+    MoveTo(pos);
 }
 
 void WASDCamera::MoveSideward(float delta)
@@ -62,7 +67,7 @@ void WASDCamera::MoveSideward(float delta)
     auto movedPos = XMVectorAdd(XMLoadFloat3(&storedRight), XMLoadFloat3(&pos));
     XMStoreFloat3(&pos, movedPos);
 
-    AbstractCamera::SetTriada(pos, AbstractCamera::GetLookAt(), AbstractCamera::GetUp());
+    MoveTo(pos);
 }
 
 void WASDCamera::RotateHorizontally(float deltaAngle)
@@ -77,6 +82,14 @@ void WASDCamera::RotateVertically(float deltaAngle)
     UpdateRotation();
 }
 
+void WASDCamera::MoveTo(XMFLOAT3 position)
+{
+    if (_collider)
+        position = _collider(AbstractCamera::GetPosition(), position);
+
+    AbstractCamera::SetTriada(position, AbstractCamera::GetLookAt(), AbstractCamera::GetUp());
+}
+
 void WASDCamera::UpdateRotation()
 {
     auto lookAt = AbstractCamera::GetDefaultLookAt();
@@ -2,6 +2,8 @@
 
 #include "AbstractCamera.h"
 
+#include <functional>
+
 namespace Graphics
 {
 class WASDCamera : public AbstractCamera
@@ -9,6 +11,11 @@ class WASDCamera : public AbstractCamera
 public:
     WASDCamera(float nearPlane, float farPlane, float fov, float screenWidth, float screenHeight);
 
+    // resolves every move from the current position to the target one, e.g. by the collisions
+    using Collider = std::function<XMFLOAT3(const XMFLOAT3& from, const XMFLOAT3& to)>;
+
+    // it is not applied to SetPosition, the camera may be placed anywhere
+    void SetCollider(Collider collider);
     void SetPosition(XMFLOAT3 position);
 
     void MoveForward(float delta);
@@ -20,6 +27,9 @@ public:
 
 private:
     void UpdateRotation();
+    void MoveTo(XMFLOAT3 position);
+
+    Collider _collider;
 
     float _horizontalAngle = 0.0f;
     float _verticalAngle   = 0.0f;
@@ -0,0 +1,169 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(std::size_t workersCount /*= std::thread::hardware_concurrency()*/)
+    : _workersCount(std::max<std::size_t>(workersCount, 1))
+    , _ranges(std::make_unique<Range[]>(_workersCount))
+{
+    // the calling thread is the first worker
+    _threads.reserve(_workersCount - 1);
+    for (std::size_t worker = 1; worker < _workersCount; ++worker)
+        _threads.emplace_back(&WorkStealingPool::WorkerLoop, this, worker);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _started.notify_all();
+
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+void WorkStealingPool::ParallelFor(std::size_t count, const Task& task)
+{
+    if (count == 0)
+        return;
+
+    for (std::size_t worker = 0; worker < _workersCount; ++worker)
+    {
+        std::lock_guard<std::mutex> lock(_ranges[worker].mutex);
+        _ranges[worker].begin = count * worker / _workersCount;
+        _ranges[worker].end   = count * (worker + 1) / _workersCount;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task      = &task;
+        _running   = _threads.size();
+        _exception = nullptr;
+        ++_generation;
+    }
+    _started.notify_all();
+
+    Run(0);
+
+    std::exception_ptr exception;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _finished.wait(lock, [this]() { return _running == 0; });
+        _task = nullptr;
+        std::swap(exception, _exception);
+    }
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+std::size_t WorkStealingPool::GetWorkersCount() const
+{
+    return _workersCount;
+}
+
+void WorkStealingPool::WorkerLoop(std::size_t worker)
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _started.wait(lock, [&]() { return _stop || _generation != generation; });
+            if (_stop)
+                return;
+
+            generation = _generation;
+        }
+
+        Run(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_running == 0)
+                _finished.notify_one();
+        }
+    }
+}
+
+void WorkStealingPool::Run(std::size_t worker)
+{
+    Range& range = _ranges[worker];
+    while (true)
+    {
+        std::size_t task    = 0;
+        bool        hasTask = false;
+        {
+            std::lock_guard<std::mutex> lock(range.mutex);
+            if (range.begin < range.end)
+            {
+                task    = range.begin++;
+                hasTask = true;
+            }
+        }
+
+        if (!hasTask)
+        {
+            if (!Steal(worker))
+                return;
+
+            continue;
+        }
+
+        try
+        {
+            (*_task)(task, worker);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_exception)
+                _exception = std::current_exception();
+        }
+    }
+}
+
+bool WorkStealingPool::Steal(std::size_t worker)
+{
+    while (true)
+    {
+        // the sizes may change meanwhile, the victim is checked again once it is locked
+        std::size_t victim     = worker;
+        std::size_t victimSize = 0;
+        for (std::size_t other = 0; other < _workersCount; ++other)
+        {
+            std::lock_guard<std::mutex> lock(_ranges[other].mutex);
+            const std::size_t           size = _ranges[other].end - _ranges[other].begin;
+            if (size > victimSize)
+            {
+                victim     = other;
+                victimSize = size;
+            }
+        }
+
+        if (victimSize == 0)
+            return false;
+
+        std::size_t begin = 0;
+        std::size_t end   = 0;
+        {
+            std::lock_guard<std::mutex> lock(_ranges[victim].mutex);
+            Range&                      range = _ranges[victim];
+            if (range.begin == range.end)
+                continue;
+
+            // the victim keeps the front half, the last task is taken as a whole
+            begin     = range.begin + (range.end - range.begin) / 2;
+            end       = range.end;
+            range.end = begin;
+        }
+
+        // the own range is empty, so nobody steals from it till it is set
+        std::lock_guard<std::mutex> lock(_ranges[worker].mutex);
+        _ranges[worker].begin = begin;
+        _ranges[worker].end   = end;
+        return true;
+    }
+}
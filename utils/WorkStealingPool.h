@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers running ranges of tasks. Every worker starts with a contiguous part of the
+// range and takes the tasks from its front, the ones which run out of work steal the back half of
+// the biggest remaining part, so uneven tasks (e.g. image tiles) are balanced without a shared
+// counter. The calling thread is a worker as well, a pool of a single worker has no threads.
+class WorkStealingPool
+{
+public:
+    // the worker index is below GetWorkersCount(), so per worker data needs no locks
+    using Task = std::function<void(std::size_t task, std::size_t worker)>;
+
+    explicit WorkStealingPool(std::size_t workersCount = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&)            = delete;
+    WorkStealingPool(WorkStealingPool&&)                 = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(WorkStealingPool&&)      = delete;
+
+    // runs the tasks [0, count) and waits for them, the first exception thrown by a task is
+    // rethrown once all the others are finished; it is not reentrant
+    void ParallelFor(std::size_t count, const Task& task);
+
+    std::size_t GetWorkersCount() const;
+
+private:
+    struct alignas(64) Range
+    {
+        std::mutex  mutex;
+        std::size_t begin = 0;
+        std::size_t end   = 0;
+    };
+
+    void WorkerLoop(std::size_t worker);
+    // runs the tasks of the worker range and the stolen ones till all the ranges are empty
+    void Run(std::size_t worker);
+    bool Steal(std::size_t worker);
+
+    std::size_t              _workersCount = 1;
+    std::unique_ptr<Range[]> _ranges;
+    std::vector<std::thread> _threads;
+
+    std::mutex              _mutex;
+    std::condition_variable _started;
+    std::condition_variable _finished;
+    const Task*             _task       = nullptr;
+    uint64_t                _generation = 0;  // of the current ParallelFor, the threads wait for a new one
+    std::size_t             _running    = 0;  // threads which haven't finished the current generation
+    bool                    _stop       = false;
+    std::exception_ptr      _exception;
+};
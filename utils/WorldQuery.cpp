@@ -0,0 +1,182 @@
+#include "WorldQuery.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+using namespace DirectX;
+
+// the gap the moved spheres keep to the surfaces
+constexpr float contactOffset = 1e-3f;
+// the moves after the first one, every one of them slides along the next surface
+constexpr int maxSlides = 3;
+// the queries are cheap, so the batches are split into runs of them
+constexpr std::size_t queriesPerTask = 64;
+}  // namespace
+
+WorldQuery::WorldQuery(std::size_t threadsCount /*= std::thread::hardware_concurrency()*/)
+    : _pool(threadsCount)
+{
+}
+
+void WorldQuery::SetScene(std::shared_ptr<const BVH::Scene> scene)
+{
+    _scene = std::move(scene);
+}
+
+void WorldQuery::SetHeightField(std::shared_ptr<const HeightField> heightField)
+{
+    _heightField = std::move(heightField);
+}
+
+std::optional<WorldQuery::Hit> WorldQuery::Raycast(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance) const
+{
+    return Intersect({origin, direction, maxDistance});
+}
+
+std::optional<WorldQuery::Hit> WorldQuery::SphereCast(XMFLOAT3 origin, float radius, XMFLOAT3 direction, float maxDistance) const
+{
+    return Intersect({origin, direction, maxDistance, radius});
+}
+
+bool WorldQuery::HasLineOfSight(XMFLOAT3 from, XMFLOAT3 to) const
+{
+    if (_heightField)
+    {
+        BVH::Ray ray;
+        ray.origin    = from;
+        ray.direction = {to.x - from.x, to.y - from.y, to.z - from.z};
+        ray.tMax      = 1.0f;
+
+        if (_heightField->Raycast(ray))
+            return false;
+    }
+
+    return !_scene || _scene->HasLineOfSight(from, to);
+}
+
+std::optional<float> WorldQuery::GetGroundHeight(float x, float y) const
+{
+    return _heightField ? _heightField->GetHeight(x, y) : std::nullopt;
+}
+
+XMFLOAT3 WorldQuery::MoveSphere(XMFLOAT3 from, XMFLOAT3 to, float radius) const
+{
+    XMVECTOR position = XMLoadFloat3(&from);
+    XMVECTOR offset   = XMVectorSubtract(XMLoadFloat3(&to), position);
+
+    for (int move = 0; move <= maxSlides; ++move)
+    {
+        const float length = XMVectorGetX(XMVector3Length(offset));
+        if (length < contactOffset)
+            break;
+
+        XMFLOAT3 origin, direction;
+        XMStoreFloat3(&origin, position);
+        XMStoreFloat3(&direction, offset);
+
+        const std::optional<Hit> hit = SphereCast(origin, radius, direction, length + contactOffset);
+        if (!hit)
+        {
+            position = XMVectorAdd(position, offset);
+            break;
+        }
+
+        // the sphere stops short of the contact, the rest of the offset is projected to the contact plane
+        const XMVECTOR unit   = XMVectorScale(offset, 1.0f / length);
+        const XMVECTOR normal = XMLoadFloat3(&hit->normal);
+        const float    travel = std::max(hit->distance - contactOffset, 0.0f);
+
+        position = XMVectorMultiplyAdd(unit, XMVectorReplicate(travel), position);
+        offset   = XMVectorScale(unit, length - travel);
+        offset   = XMVectorSubtract(offset, XMVectorMultiply(normal, XMVector3Dot(offset, normal)));
+    }
+
+    XMFLOAT3 output;
+    XMStoreFloat3(&output, position);
+    return output;
+}
+
+void WorldQuery::Cast(std::span<const Query> queries, std::span<std::optional<Hit>> hits)
+{
+    if (hits.size() < queries.size())
+        throw std::runtime_error("WorldQuery: there are less hits than queries");
+
+    const std::size_t tasksCount = (queries.size() + queriesPerTask - 1) / queriesPerTask;
+    _pool.ParallelFor(tasksCount, [&](std::size_t task, std::size_t) {
+        const std::size_t end = std::min((task + 1) * queriesPerTask, queries.size());
+        for (std::size_t query = task * queriesPerTask; query < end; ++query)
+            hits[query] = Intersect(queries[query]);
+    });
+}
+
+std::optional<WorldQuery::Hit> WorldQuery::Intersect(const Query& query) const
+{
+    const XMVECTOR origin    = XMLoadFloat3(&query.origin);
+    const XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&query.direction));
+    if (XMVectorGetX(XMVector3LengthSq(direction)) == 0.0f)
+        return std::nullopt;
+
+    // the direction is normalized, so the distances are the world ones
+    BVH::Ray ray;
+    ray.origin = query.origin;
+    ray.tMax   = query.maxDistance;
+    XMStoreFloat3(&ray.direction, direction);
+
+    const bool isSweep = query.radius > 0.0f;
+
+    // the terrain goes first, its hit limits the scene traversal
+    std::optional<Hit> output;
+    if (_heightField)
+    {
+        const std::optional<HeightField::Hit> hit = isSweep ? _heightField->SphereCast(ray, query.radius) : _heightField->Raycast(ray);
+        if (hit)
+        {
+            output            = Hit{hit->t};
+            output->normal    = hit->normal;
+            output->isTerrain = true;
+            ray.tMax          = hit->t;
+        }
+    }
+
+    if (_scene)
+    {
+        const std::optional<BVH::Hit> hit = isSweep ? _scene->SphereCast(ray, query.radius) : _scene->Raycast(ray);
+        if (hit)
+        {
+            const std::array<XMFLOAT3, 3> triangle = _scene->GetTriangle(*hit);
+
+            const XMVECTOR p0 = XMLoadFloat3(&triangle[0]);
+            const XMVECTOR p1 = XMLoadFloat3(&triangle[1]);
+            const XMVECTOR p2 = XMLoadFloat3(&triangle[2]);
+
+            // the rays get the surface normal turned to them, the spheres are pushed away from the contact
+            XMVECTOR normal;
+            if (isSweep)
+            {
+                const float    weights[3] = {1.0f - hit->barycentrics.x - hit->barycentrics.y, hit->barycentrics.x, hit->barycentrics.y};
+                const XMVECTOR contact    = XMVectorAdd(XMVectorAdd(XMVectorScale(p0, weights[0]), XMVectorScale(p1, weights[1])), XMVectorScale(p2, weights[2]));
+                const XMVECTOR center     = XMVectorMultiplyAdd(direction, XMVectorReplicate(hit->t), origin);
+                normal                    = XMVector3Normalize(XMVectorSubtract(center, contact));
+            }
+            else
+            {
+                normal = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+                if (XMVectorGetX(XMVector3Dot(normal, direction)) > 0.0f)
+                    normal = XMVectorNegate(normal);
+            }
+
+            output           = Hit{hit->t};
+            output->instance = hit->instance;
+            output->geometry = hit->geometry;
+            output->triangle = hit->triangle;
+            XMStoreFloat3(&output->normal, normal);
+        }
+    }
+
+    if (output)
+        XMStoreFloat3(&output->position, XMVectorMultiplyAdd(direction, XMVectorReplicate(output->distance), origin));
+
+    return output;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "BVHScene.h"
+#include "HeightField.h"
+#include "WorkStealingPool.h"
+
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+
+// Picking and collision queries against the terrain height field and the CPU mirror of the scene.
+// The queries are const and may run on any number of threads, the batches are spread over the
+// workers of the service. The snapshots are replaced by the thread which runs the batches while
+// nobody else queries them, e.g. once per frame before the gameplay update.
+class WorldQuery
+{
+public:
+    struct Hit
+    {
+        float             distance = 0.0f;
+        DirectX::XMFLOAT3 position;  // of the ray (of the sphere center) at the hit
+        DirectX::XMFLOAT3 normal;    // of the surface at the contact, it faces the query
+        bool              isTerrain = false;
+        uint32_t          instance  = 0;  // the ids of BVH::Hit, for the scene hits only
+        uint32_t          geometry  = 0;
+        uint32_t          triangle  = 0;
+    };
+
+    // a ray if the radius is 0 and a sphere sweep otherwise, the direction is normalized by the query
+    struct Query
+    {
+        DirectX::XMFLOAT3 origin;
+        DirectX::XMFLOAT3 direction;
+        float             maxDistance = std::numeric_limits<float>::max();
+        float             radius      = 0.0f;
+    };
+
+    explicit WorldQuery(std::size_t threadsCount = std::thread::hardware_concurrency());
+
+    void SetScene(std::shared_ptr<const BVH::Scene> scene);
+    void SetHeightField(std::shared_ptr<const HeightField> heightField);
+
+    // the closest hit of both sides of the triangles
+    std::optional<Hit> Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance) const;
+    std::optional<Hit> SphereCast(DirectX::XMFLOAT3 origin, float radius, DirectX::XMFLOAT3 direction, float maxDistance) const;
+    // any hit finishes the search
+    bool HasLineOfSight(DirectX::XMFLOAT3 from, DirectX::XMFLOAT3 to) const;
+
+    // of the terrain surface, nothing out of the height field
+    std::optional<float> GetGroundHeight(float x, float y) const;
+
+    // Moves the sphere towards the target as far as it can, the rest of the way slides along the
+    // surfaces it hits. It keeps a small gap to them, so the next move doesn't start in touch.
+    DirectX::XMFLOAT3 MoveSphere(DirectX::XMFLOAT3 from, DirectX::XMFLOAT3 to, float radius) const;
+
+    // the hits are written by the indices of the queries; it is not reentrant
+    void Cast(std::span<const Query> queries, std::span<std::optional<Hit>> hits);
+
+private:
+    std::optional<Hit> Intersect(const Query& query) const;
+
+    std::shared_ptr<const BVH::Scene>  _scene;
+    std::shared_ptr<const HeightField> _heightField;
+    WorkStealingPool                   _pool;
+};